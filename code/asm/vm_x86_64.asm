@@ -37,6 +37,10 @@ qvmcall64 PROC
   push rsi							; push non-volatile registers to stack
   push rdi
   push rbx
+  push r12							; second tier code keeps opStack values in r10-r15
+  push r13
+  push r14
+  push r15
   ; need to save pointer in rcx so we can write back the programData value to caller
   push rcx
 
@@ -52,6 +56,10 @@ qvmcall64 PROC
   mov dword ptr [rcx], esi			; write back the programStack value
   mov al, bl						; return opStack offset
 
+  pop r15
+  pop r14
+  pop r13
+  pop r12
   pop rbx
   pop rdi
   pop rsi
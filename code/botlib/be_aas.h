@@ -219,3 +219,26 @@ typedef struct aas_predictroute_s
 	int numareas;			//number of areas predicted ahead
 	int time;				//time predicted ahead (in hundreth of a sec)
 } aas_predictroute_t;
+
+//routing cache statistics
+typedef struct aas_routecachestats_s
+{
+	int budget;				//size of the routing cache pool in bytes
+	int queries;			//route queries
+	int hits;				//cache lookups that found a cache
+	int misses;				//cache lookups that had to calculate a cache
+	int evictions;			//caches evicted to make room
+	int overflows;			//caches allocated from the heap because the pool was full
+	int portaltables;		//portal caches built from the portal tables
+	int bytes;				//bytes of routing cache in use
+	int peakbytes;			//most bytes of routing cache in use at once
+} aas_routecachestats_t;
+
+//goal of a batched travel time query
+typedef struct aas_goaltraveltime_s
+{
+	int areanum;			//goal area
+	float weight;			//weight of the goal, the goal with the highest weight / travel time is the best
+	int mintraveltime;		//the goal can't be the best when reached sooner than this
+	int traveltime;			//travel time towards the goal area, 0 if not reachable or can't be the best
+} aas_goaltraveltime_t;
@@ -142,6 +142,7 @@ typedef struct aas_settings_s
 
 #define CACHETYPE_PORTAL		0
 #define CACHETYPE_AREA			1
+#define CACHETYPE_FREE			2		//unused block in the routing cache pool
 
 //routing cache
 typedef struct aas_routingcache_s
@@ -156,6 +157,9 @@ typedef struct aas_routingcache_s
 	int travelflags;							//combinations of the travel flags
 	struct aas_routingcache_s *prev, *next;
 	struct aas_routingcache_s *time_prev, *time_next;
+	struct aas_routingcache_s *shard_prev, *shard_next;	//cache list of the shard sorted on time
+	int slab;									//slab in the routing cache pool, -1 if allocated from the heap
+	unsigned int query;							//last route query that used the cache
 	unsigned char *reachabilities;				//reachabilities used for routing
 	unsigned short int traveltimes[1];			//travel time for every area (variable sized)
 } aas_routingcache_t;
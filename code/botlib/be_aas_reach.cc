@@ -29,6 +29,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  *
  *****************************************************************************/
 
+#include <chrono>
+
 #include "../qcommon/q_shared.h"
 #include "../botlib/l_utils.h" //hypov8 add
 #ifdef BSPC
@@ -74,27 +76,66 @@ extern botlib_import_t botimport;
 //area flag used for weapon jumping
 #define AREA_WEAPONJUMP						8192	//valid area to weapon jump to
 //number of reachabilities of each type
-int reach_swim;			//swim
-int reach_equalfloor;	//walk on floors with equal height
-int reach_step;			//step up
-int reach_walk;			//walk of step
-int reach_barrier;		//jump up to a barrier
-int reach_waterjump;	//jump out of water
-int reach_walkoffledge;	//walk of a ledge
-int reach_jump;			//jump
-int reach_ladder;		//climb or descent a ladder
-int reach_teleport;		//teleport
-int reach_elevator;		//use an elevator
-int reach_funcbob;		//use a func bob
-int reach_grapple;		//grapple hook
-int reach_doublejump;	//double jump
-int reach_rampjump;		//ramp jump
-int reach_strafejump;	//strafe jump (just normal jump but further)
-int reach_rocketjump;	//rocket jump
-int reach_bfgjump;		//bfg jump
-int reach_jumppad;		//jump pads
+enum
+{
+	REACHCOUNT_SWIM,				//swim
+	REACHCOUNT_EQUALFLOOR,			//walk on floors with equal height
+	REACHCOUNT_STEP,				//step up
+	REACHCOUNT_WALK,				//walk of step
+	REACHCOUNT_BARRIER,				//jump up to a barrier
+	REACHCOUNT_WATERJUMP,			//jump out of water
+	REACHCOUNT_WALKOFFLEDGE,		//walk of a ledge
+	REACHCOUNT_JUMP,				//jump
+	REACHCOUNT_LADDER,				//climb or descent a ladder
+	REACHCOUNT_TELEPORT,			//teleport
+	REACHCOUNT_ELEVATOR,			//use an elevator
+	REACHCOUNT_FUNCBOB,				//use a func bob
+	REACHCOUNT_GRAPPLE,				//grapple hook
+	REACHCOUNT_DOUBLEJUMP,			//double jump
+	REACHCOUNT_RAMPJUMP,			//ramp jump
+	REACHCOUNT_STRAFEJUMP,			//strafe jump (just normal jump but further)
+	REACHCOUNT_ROCKETJUMP,			//rocket jump
+	REACHCOUNT_BFGJUMP,				//bfg jump
+	REACHCOUNT_JUMPPAD,				//jump pads
+	NUM_REACHCOUNTS
+};
+int reachcounts[NUM_REACHCOUNTS];
+static const char *reachcountnames[NUM_REACHCOUNTS] = {
+	"swim", "equal floor", "step", "walk", "barrier", "waterjump", "walkoffledge",
+	"jump", "ladder", "teleport", "elevator", "funcbob", "grapple", "doublejump",
+	"rampjump", "strafejump", "rocketjump", "bfgjump", "jumppad"
+};
+//the counts reachabilities are added to, a worker thread counts for itself
+static Q_THREADLOCAL int *reachcount = reachcounts;
 //if true grapple reachabilities are skipped
 int calcgrapplereach;
+//number of threads to calculate reachabilities on
+int calcreachthreads;
+//if true the time spent on every type of reachability is reported
+int calcreachtimings;
+//reachability tests that are timed
+enum
+{
+	REACHTEST_SWIM,
+	REACHTEST_EQUALFLOOR,
+	REACHTEST_STEP,
+	REACHTEST_LADDER,
+	REACHTEST_JUMP,
+	REACHTEST_GRAPPLE,
+	REACHTEST_WEAPONJUMP,
+	REACHTEST_WALKOFFLEDGE,
+	REACHTEST_JUMPPAD,
+	REACHTEST_TELEPORT,
+	REACHTEST_ELEVATOR,
+	REACHTEST_FUNCBOB,
+	NUM_REACHTESTS
+};
+static const char *reachtestnames[NUM_REACHTESTS] = {
+	"swim", "equal floor", "step/barrier/waterjump", "ladder", "jump", "grapple",
+	"weapon jump", "walk off ledge", "jump pad", "teleport", "elevator", "func bob"
+};
+long long reachtesttimes[NUM_REACHTESTS];	//nanoseconds spent on every test
+int reachtestcalls[NUM_REACHTESTS];
 //linked reachability
 typedef struct aas_lreachability_s
 {
@@ -114,6 +155,88 @@ aas_lreachability_t *nextreachability;	//next free reachability from the heap
 aas_lreachability_t **areareachability;	//reachability links for every area
 int numlreachabilities;
 
+/*
+
+ threaded reachability:
+ the areas of a cycle are handed out to worker threads that test them
+ against all the other areas just like the serial loop does. a thread
+ takes its reachability links from a heap of its own and keeps them to
+ itself, it only sees the links of the earlier cycles and the links it
+ created for the area it is working on. every pair of areas that created
+ links, or asked about links that may still change, is recorded together
+ with the answers it got. the records are merged in area order afterwards:
+ when an answer is different by now the pair is tested again on the main
+ thread, otherwise the links of the pair are stored as they are. this gives
+ the same links in the same order as the serial loop
+
+ */
+
+#define REACHTHREAD_MAXLINKS		2048		//links a thread can keep during one cycle
+#define REACHTHREAD_MAXQUERIES		4096		//queries a thread can record during one cycle
+#define REACHTHREAD_MAXPAIRS		1024		//area pairs a thread can record during one cycle
+#define REACHTHREAD_AREAS			8			//areas per thread in a cycle
+#define MAX_REACHTHREADS			64
+
+//link created by a worker thread
+typedef struct aas_reachlink_s
+{
+	int areanum;								//area the link starts in
+	aas_lreachability_t *lreach;
+} aas_reachlink_t;
+
+//reachability link a worker thread asked about
+typedef struct aas_reachquery_s
+{
+	int area1num;
+	int area2num;
+	int exists;									//the answer the thread got
+} aas_reachquery_t;
+
+//area pair tested by a worker thread
+typedef struct aas_reachpair_s
+{
+	int area1num;
+	int area2num;
+	int weaponjump;								//true if testing grapple and weapon jumps
+	int firstquery, numqueries;
+	int firstlink, numlinks;
+	int counts[NUM_REACHCOUNTS];				//reachabilities of each type created
+} aas_reachpair_t;
+
+//area of a cycle
+typedef struct aas_reacharea_s
+{
+	int areanum;
+	int thread;									//thread that tested the area
+	int firstpair, numpairs;
+	int overflow;								//true if the thread ran out of room for the area
+} aas_reacharea_t;
+
+typedef struct aas_reachthread_s
+{
+	aas_lreachability_t heap[REACHTHREAD_MAXLINKS];
+	int numheap;
+	aas_reachlink_t links[REACHTHREAD_MAXLINKS];
+	int numlinks;
+	int arealinks;								//first link of the current area
+	aas_reachquery_t queries[REACHTHREAD_MAXQUERIES];
+	int numqueries;
+	aas_reachpair_t pairs[REACHTHREAD_MAXPAIRS];
+	int numpairs;
+	aas_reachpair_t *pair;						//pair being tested, NULL if none
+	int overflow;
+	int counts[NUM_REACHCOUNTS];				//counts of the pair being tested
+	long long testtimes[NUM_REACHTESTS];
+	int testcalls[NUM_REACHTESTS];
+} aas_reachthread_t;
+
+static aas_reachthread_t *reachthreads;
+static int numreachthreads;
+static aas_reacharea_t *reachareas;
+static int numreachareas;
+//the worker thread state of the calling thread, NULL on the main thread
+static Q_THREADLOCAL aas_reachthread_t *reachthread;
+
 //===========================================================================
 // returns the surface area of the given face
 //
@@ -492,6 +615,41 @@ void AAS_ShutDownReachabilityHeap(void)
 	numlreachabilities = 0;
 } //end of the function AAS_ShutDownReachabilityHeap
 //===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_FreeReachabilityThreads(void)
+{
+	if (reachthreads) FreeMemory(reachthreads);
+	if (reachareas) FreeMemory(reachareas);
+	reachthreads = NULL;
+	reachareas = NULL;
+	numreachthreads = 0;
+} //end of the function AAS_FreeReachabilityThreads
+//===========================================================================
+// allocates the worker thread state when reachabilities are calculated
+// on more than one thread
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_SetupReachabilityThreads(void)
+{
+	AAS_FreeReachabilityThreads();
+	numreachthreads = calcreachthreads;
+	if (numreachthreads > MAX_REACHTHREADS) numreachthreads = MAX_REACHTHREADS;
+	if (numreachthreads <= 1 || !botimport.RunJobs)
+	{
+		numreachthreads = 0;
+		return;
+	} //end if
+	reachthreads = (aas_reachthread_t *) GetClearedMemory(numreachthreads * sizeof(aas_reachthread_t));
+	reachareas = (aas_reacharea_t *) GetClearedMemory(numreachthreads * REACHTHREAD_AREAS * sizeof(aas_reacharea_t));
+} //end of the function AAS_SetupReachabilityThreads
+//===========================================================================
 // returns a reachability link
 //
 // Parameter:				-
@@ -502,6 +660,19 @@ aas_lreachability_t *AAS_AllocReachability(void)
 {
 	aas_lreachability_t *r;
 
+	//a worker thread takes the link from its own heap
+	if (reachthread)
+	{
+		if (reachthread->numheap >= REACHTHREAD_MAXLINKS)
+		{
+			reachthread->overflow = qtrue;
+			return NULL;
+		} //end if
+		r = &reachthread->heap[reachthread->numheap++];
+		Com_Memset(r, 0, sizeof(aas_lreachability_t));
+		return r;
+	} //end if
+	//
 	if (!nextreachability) return NULL;
 	//make sure the error message only shows up once
 	if (!nextreachability->next) AAS_Error("AAS_MAX_REACHABILITYSIZE");
@@ -799,14 +970,124 @@ unsigned short int AAS_BarrierJumpTravelTime(void)
 qboolean AAS_ReachabilityExists(int area1num, int area2num)
 {
 	aas_lreachability_t *r;
+	aas_reachquery_t *query;
+	int i, exists;
 
 	for (r = areareachability[area1num]; r; r = r->next)
 	{
 		if (r->areanum == area2num) return qtrue;
 	} //end for
-	return qfalse;
+	if (!reachthread) return qfalse;
+	//the links created for the current area by this thread
+	exists = qfalse;
+	for (i = reachthread->arealinks; i < reachthread->numlinks; i++)
+	{
+		if (reachthread->links[i].areanum == area1num &&
+				reachthread->links[i].lreach->areanum == area2num)
+		{
+			exists = qtrue;
+			break;
+		} //end if
+	} //end for
+	//the answer may change when the other areas of the cycle are merged
+	if (reachthread->pair)
+	{
+		if (reachthread->numqueries >= REACHTHREAD_MAXQUERIES)
+		{
+			reachthread->overflow = qtrue;
+		} //end if
+		else
+		{
+			query = &reachthread->queries[reachthread->numqueries++];
+			query->area1num = area1num;
+			query->area2num = area2num;
+			query->exists = exists;
+			reachthread->pair->numqueries++;
+		} //end else
+	} //end if
+	return exists;
 } //end of the function AAS_ReachabilityExists
 //===========================================================================
+// adds a reachability link to the links of the given area
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_LinkReachability(int areanum, aas_lreachability_t *lreach)
+{
+	aas_reachlink_t *link;
+
+	if (reachthread)
+	{
+		//AAS_AllocReachability made sure there's room
+		link = &reachthread->links[reachthread->numlinks++];
+		link->areanum = areanum;
+		link->lreach = lreach;
+		if (reachthread->pair) reachthread->pair->numlinks++;
+		return;
+	} //end if
+	lreach->next = areareachability[areanum];
+	areareachability[areanum] = lreach;
+} //end of the function AAS_LinkReachability
+//===========================================================================
+// starts recording the links and queries of an area pair on a worker thread
+//
+// Parameter:				-
+// Returns:					false if the thread ran out of room
+// Changes Globals:		-
+//===========================================================================
+int AAS_StartReachabilityPair(int area1num, int area2num, int weaponjump)
+{
+	aas_reachpair_t *pair;
+
+	if (!reachthread) return qtrue;
+	if (reachthread->overflow) return qfalse;
+	if (reachthread->numpairs >= REACHTHREAD_MAXPAIRS)
+	{
+		reachthread->overflow = qtrue;
+		return qfalse;
+	} //end if
+	pair = &reachthread->pairs[reachthread->numpairs];
+	pair->area1num = area1num;
+	pair->area2num = area2num;
+	pair->weaponjump = weaponjump;
+	pair->firstquery = reachthread->numqueries;
+	pair->numqueries = 0;
+	pair->firstlink = reachthread->numlinks;
+	pair->numlinks = 0;
+	Com_Memset(reachthread->counts, 0, sizeof(reachthread->counts));
+	reachthread->pair = pair;
+	return qtrue;
+} //end of the function AAS_StartReachabilityPair
+//===========================================================================
+// keeps the record of the area pair when the merge has to look at it
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_EndReachabilityPair(void)
+{
+	aas_reachpair_t *pair;
+	aas_reachquery_t *query;
+
+	if (!reachthread || !reachthread->pair) return;
+	pair = reachthread->pair;
+	reachthread->pair = NULL;
+	//the first query is the check if the pair already has a link, when
+	//nothing was found and nothing else was asked the pair is done
+	query = &reachthread->queries[pair->firstquery];
+	if (!pair->numlinks && (!pair->numqueries ||
+			(pair->numqueries == 1 && !query->exists)))
+	{
+		reachthread->numqueries = pair->firstquery;
+		return;
+	} //end if
+	Com_Memcpy(pair->counts, reachthread->counts, sizeof(pair->counts));
+	reachthread->numpairs++;
+} //end of the function AAS_EndReachabilityPair
+//===========================================================================
 // returns true if there is a solid just after the end point when going
 // from start to end
 //
@@ -905,9 +1186,8 @@ int AAS_Reachability_Swim(int area1num, int area2num)
 						lreach->traveltime += 200;
 					//if (!(AAS_PointContents(start) & MASK_WATER)) lreach->traveltime += 500;
 					//link the reachability
-					lreach->next = areareachability[area1num];
-					areareachability[area1num] = lreach;
-					reach_swim++;
+					AAS_LinkReachability(area1num, lreach);
+					reachcount[REACHCOUNT_SWIM]++;
 					return qtrue;
 				} //end if
 			} //end if
@@ -1040,8 +1320,7 @@ int AAS_Reachability_EqualFloorHeight(int area1num, int area2num)
 		VectorCopy(lr.end, lreach->end);
 		lreach->traveltype = lr.traveltype;
 		lreach->traveltime = lr.traveltime;
-		lreach->next = areareachability[area1num];
-		areareachability[area1num] = lreach;
+		AAS_LinkReachability(area1num, lreach);
 		//if going into a crouch area
 		if (!AAS_AreaCrouch(area1num) && AAS_AreaCrouch(area2num))
 		{
@@ -1057,7 +1336,7 @@ int AAS_Reachability_EqualFloorHeight(int area1num, int area2num)
 		//avoid rather small areas
 		//if (AAS_AreaGroundFaceArea(lreach->areanum) < 500) lreach->traveltime += 100;
 		//
-		reach_equalfloor++;
+		reachcount[REACHCOUNT_EQUALFLOOR]++;
 		return qtrue;
 	} //end if
 	return qfalse;
@@ -1391,8 +1670,7 @@ int AAS_Reachability_Step_Barrier_WaterJump_WalkOffLedge(int area1num, int area2
 			{
 				lreach->traveltime += aassettings.rs_startcrouch;
 			} //end if
-			lreach->next = areareachability[area1num];
-			areareachability[area1num] = lreach;
+			AAS_LinkReachability(area1num, lreach);
 			//NOTE: if there's nearby solid or a gap area after this area
 			/*
 			if (!AAS_NearbySolidOrGap(lreach->start, lreach->end))
@@ -1403,7 +1681,7 @@ int AAS_Reachability_Step_Barrier_WaterJump_WalkOffLedge(int area1num, int area2
 			//avoid rather small areas
 			//if (AAS_AreaGroundFaceArea(lreach->areanum) < 500) lreach->traveltime += 100;
 			//
-			reach_step++;
+			reachcount[REACHCOUNT_STEP]++;
 			return qtrue;
 		} //end if
 	} //end if
@@ -1453,10 +1731,9 @@ int AAS_Reachability_Step_Barrier_WaterJump_WalkOffLedge(int area1num, int area2
 					VectorMA(water_bestend, INSIDEUNITS_WATERJUMP, water_bestnormal, lreach->end);
 					lreach->traveltype = TRAVEL_WATERJUMP;
 					lreach->traveltime = aassettings.rs_waterjump;
-					lreach->next = areareachability[area1num];
-					areareachability[area1num] = lreach;
+					AAS_LinkReachability(area1num, lreach);
 					//we've got another waterjump reachability
-					reach_waterjump++;
+					reachcount[REACHCOUNT_WATERJUMP]++;
 					return qtrue;
 				} //end if
 			} //end if
@@ -1501,10 +1778,9 @@ int AAS_Reachability_Step_Barrier_WaterJump_WalkOffLedge(int area1num, int area2
 					VectorMA(ground_bestend, INSIDEUNITS_WALKEND, ground_bestnormal, lreach->end);
 					lreach->traveltype = TRAVEL_BARRIERJUMP;
 					lreach->traveltime = aassettings.rs_barrierjump;//AAS_BarrierJumpTravelTime();
-					lreach->next = areareachability[area1num];
-					areareachability[area1num] = lreach;
+					AAS_LinkReachability(area1num, lreach);
 					//we've got another barrierjump reachability
-					reach_barrier++;
+					reachcount[REACHCOUNT_BARRIER]++;
 					return qtrue;
 				} //end if
 			} //end if
@@ -1548,10 +1824,9 @@ int AAS_Reachability_Step_Barrier_WaterJump_WalkOffLedge(int area1num, int area2
 				VectorMA(ground_bestend, INSIDEUNITS_WALKEND, ground_bestnormal, lreach->end);
 				lreach->traveltype = TRAVEL_WALK;
 				lreach->traveltime = 1;
-				lreach->next = areareachability[area1num];
-				areareachability[area1num] = lreach;
+				AAS_LinkReachability(area1num, lreach);
 				//we've got another walk reachability
-				reach_walk++;
+				reachcount[REACHCOUNT_WALK]++;
 				return qtrue;
 			} //end if
 			// if no maximum fall height set or less than the max
@@ -1599,10 +1874,9 @@ int AAS_Reachability_Step_Barrier_WaterJump_WalkOffLedge(int area1num, int area2
 									lreach->traveltime += aassettings.rs_falldamage10;
 								} //end if
 							} //end if
-							lreach->next = areareachability[area1num];
-							areareachability[area1num] = lreach;
+							AAS_LinkReachability(area1num, lreach);
 							//
-							reach_walkoffledge++;
+							reachcount[REACHCOUNT_WALKOFFLEDGE]++;
 							//NOTE: don't create a weapon (rl, bfg) jump reachability here
 							//because it interferes with other reachabilities
 							//like the ladder reachability
@@ -2377,13 +2651,12 @@ int AAS_Reachability_Jump(int area1num, int area2num)
 				lreach->traveltime += aassettings.rs_falldamage10;
 			} //end if
 		} //end if
-		lreach->next = areareachability[area1num];
-		areareachability[area1num] = lreach;
+		AAS_LinkReachability(area1num, lreach);
 		//
 		if ((traveltype & TRAVELTYPE_MASK) == TRAVEL_JUMP)
-			reach_jump++;
+			reachcount[REACHCOUNT_JUMP]++;
 		else
-			reach_walkoffledge++;
+			reachcount[REACHCOUNT_WALKOFFLEDGE]++;
 	} //end if
 	return qfalse;
 } //end of the function AAS_Reachability_Jump
@@ -2508,10 +2781,9 @@ int AAS_Reachability_Ladder(int area1num, int area2num)
 			VectorMA(area2point, -3, plane1->normal, lreach->end);
 			lreach->traveltype = TRAVEL_LADDER;
 			lreach->traveltime = 10;
-			lreach->next = areareachability[area1num];
-			areareachability[area1num] = lreach;
+			AAS_LinkReachability(area1num, lreach);
 			//
-			reach_ladder++;
+			reachcount[REACHCOUNT_LADDER]++;
 			//create a new reachability link
 			lreach = AAS_AllocReachability();
 			if (!lreach) return qfalse;
@@ -2523,10 +2795,9 @@ int AAS_Reachability_Ladder(int area1num, int area2num)
 			VectorMA(area1point, -3, plane1->normal, lreach->end);
 			lreach->traveltype = TRAVEL_LADDER;
 			lreach->traveltime = 10;
-			lreach->next = areareachability[area2num];
-			areareachability[area2num] = lreach;
+			AAS_LinkReachability(area2num, lreach);
 			//
-			reach_ladder++;
+			reachcount[REACHCOUNT_LADDER]++;
 			//
 			return qtrue;
 		} //end if
@@ -2547,10 +2818,9 @@ int AAS_Reachability_Ladder(int area1num, int area2num)
 			VectorMA(lreach->end, -15, plane1->normal, lreach->end);
 			lreach->traveltype = TRAVEL_LADDER;
 			lreach->traveltime = 10;
-			lreach->next = areareachability[area1num];
-			areareachability[area1num] = lreach;
+			AAS_LinkReachability(area1num, lreach);
 			//
-			reach_ladder++;
+			reachcount[REACHCOUNT_LADDER]++;
 			//create a new reachability link
 			lreach = AAS_AllocReachability();
 			if (!lreach) return qfalse;
@@ -2561,10 +2831,9 @@ int AAS_Reachability_Ladder(int area1num, int area2num)
 			VectorCopy(area1point, lreach->end);
 			lreach->traveltype = TRAVEL_WALKOFFLEDGE;
 			lreach->traveltime = 10;
-			lreach->next = areareachability[area2num];
-			areareachability[area2num] = lreach;
+			AAS_LinkReachability(area2num, lreach);
 			//
-			reach_walkoffledge++;
+			reachcount[REACHCOUNT_WALKOFFLEDGE]++;
 			//
 			return qtrue;
 		} //end if
@@ -2642,10 +2911,9 @@ int AAS_Reachability_Ladder(int area1num, int area2num)
 					VectorCopy(trace.endpos, lreach->end);
 					lreach->traveltype = TRAVEL_LADDER;
 					lreach->traveltime = 10;
-					lreach->next = areareachability[area1num];
-					areareachability[area1num] = lreach;
+					AAS_LinkReachability(area1num, lreach);
 					//
-					reach_ladder++;
+					reachcount[REACHCOUNT_LADDER]++;
 					//create a new reachability link
 					lreach = AAS_AllocReachability();
 					if (!lreach) return qfalse;
@@ -2659,10 +2927,9 @@ int AAS_Reachability_Ladder(int area1num, int area2num)
 					lreach->end[2] += 10;
 					lreach->traveltype = TRAVEL_JUMP;
 					lreach->traveltime = 10;
-					lreach->next = areareachability[area2num];
-					areareachability[area2num] = lreach;
+					AAS_LinkReachability(area2num, lreach);
 					//
-					reach_jump++;
+					reachcount[REACHCOUNT_JUMP]++;
 					//
 					return qtrue;
 #ifdef REACH_DEBUG
@@ -2708,10 +2975,9 @@ int AAS_Reachability_Ladder(int area1num, int area2num)
 					lreach->end[2] += 5;
 					lreach->traveltype = TRAVEL_JUMP;
 					lreach->traveltime = 10;
-					lreach->next = areareachability[area2num];
-					areareachability[area2num] = lreach;
+					AAS_LinkReachability(area2num, lreach);
 					//
-					reach_jump++;
+					reachcount[REACHCOUNT_JUMP]++;
 					//
 					Log_Write("jump far to ladder reach between %d and %d\r\n", area2num, area1num);
 					//
@@ -2938,10 +3204,9 @@ void AAS_Reachability_Teleport(void)
 			lreach->traveltype = TRAVEL_TELEPORT;
 			lreach->traveltype |= AAS_TravelFlagsForTeam(ent);
 			lreach->traveltime = aassettings.rs_teleport;
-			lreach->next = areareachability[area1num];
-			areareachability[area1num] = lreach;
+			AAS_LinkReachability(area1num, lreach);
 			//
-			reach_teleport++;
+			reachcount[REACHCOUNT_TELEPORT]++;
 		} //end for
 		//unlink the invalid entity
 		AAS_UnlinkFromAreas(areas);
@@ -3180,8 +3445,7 @@ void AAS_Reachability_Elevator(void)
 						lreach->traveltype = TRAVEL_ELEVATOR;
 						lreach->traveltype |= AAS_TravelFlagsForTeam(ent);
 						lreach->traveltime = aassettings.rs_startelevator + height * 100 / speed;
-						lreach->next = areareachability[area1num];
-						areareachability[area1num] = lreach;
+						AAS_LinkReachability(area1num, lreach);
 						//don't go any further to the outside
 						n = 9999;
 						//
@@ -3189,7 +3453,7 @@ void AAS_Reachability_Elevator(void)
 						Log_Write("elevator reach from %d to %d\r\n", area1num, area2num);
 #endif //REACH_DEBUG
 						//
-						reach_elevator++;
+						reachcount[REACHCOUNT_ELEVATOR]++;
 					} //end for
 				} //end for
 			} //end for
@@ -3513,9 +3777,8 @@ void AAS_Reachability_FuncBobbing(void)
 					lreach->traveltype = TRAVEL_FUNCBOB;
 					lreach->traveltype |= AAS_TravelFlagsForTeam(ent);
 					lreach->traveltime = aassettings.rs_funcbob;
-					reach_funcbob++;
-					lreach->next = areareachability[startreach->areanum];
-					areareachability[startreach->areanum] = lreach;
+					reachcount[REACHCOUNT_FUNCBOB]++;
+					AAS_LinkReachability(startreach->areanum, lreach);
 					//
 				} //end for
 			} //end for
@@ -3713,10 +3976,9 @@ void AAS_Reachability_JumpPad(void)
 					lreach->traveltype = TRAVEL_JUMPPAD;
 					lreach->traveltype |= AAS_TravelFlagsForTeam(ent);
 					lreach->traveltime = aassettings.rs_jumppad;
-					lreach->next = areareachability[link->areanum];
-					areareachability[link->areanum] = lreach;
+					AAS_LinkReachability(link->areanum, lreach);
 					//
-					reach_jumppad++;
+					reachcount[REACHCOUNT_JUMPPAD]++;
 				} //end for
 			} //end if
 		} //end if
@@ -3816,10 +4078,9 @@ void AAS_Reachability_JumpPad(void)
 									lreach->traveltype = TRAVEL_JUMPPAD;
 									lreach->traveltype |= AAS_TravelFlagsForTeam(ent);
 									lreach->traveltime = aassettings.rs_aircontrolledjumppad;
-									lreach->next = areareachability[link->areanum];
-									areareachability[link->areanum] = lreach;
+									AAS_LinkReachability(link->areanum, lreach);
 									//
-									reach_jumppad++;
+									reachcount[REACHCOUNT_JUMPPAD]++;
 								} //end for
 							}
 						} //end if
@@ -3965,10 +4226,9 @@ int AAS_Reachability_Grapple(int area1num, int area2num)
 		lreach->traveltype = TRAVEL_GRAPPLEHOOK;
 		VectorSubtract(lreach->end, lreach->start, dir);
 		lreach->traveltime = aassettings.rs_startgrapple + VectorLength(dir) * 0.25;
-		lreach->next = areareachability[area1num];
-		areareachability[area1num] = lreach;
+		AAS_LinkReachability(area1num, lreach);
 		//
-		reach_grapple++;
+		reachcount[REACHCOUNT_GRAPPLE]++;
 	} //end for
 	//
 	return qfalse;
@@ -4156,10 +4416,9 @@ int AAS_Reachability_WeaponJump(int area1num, int area2num)
 							lreach->traveltype = TRAVEL_ROCKETJUMP;
 							lreach->traveltime = aassettings.rs_rocketjump;
 						} //end else
-						lreach->next = areareachability[area1num];
-						areareachability[area1num] = lreach;
+						AAS_LinkReachability(area1num, lreach);
 						//
-						reach_rocketjump++;
+						reachcount[REACHCOUNT_ROCKETJUMP]++;
 						return qtrue;
 					} //end if
 				} //end if
@@ -4341,10 +4600,9 @@ void AAS_Reachability_WalkOffLedge(int areanum)
 								lreach->traveltime += aassettings.rs_falldamage10;
 							} //end if
 						} //end if
-						lreach->next = areareachability[areanum];
-						areareachability[areanum] = lreach;
+						AAS_LinkReachability(areanum, lreach);
 						//we've got another walk off ledge reachability
-						reach_walkoffledge++;
+						reachcount[REACHCOUNT_WALKOFFLEDGE]++;
 					} //end if
 				} //end for
 			} //end for
@@ -4390,6 +4648,295 @@ void AAS_StoreReachability(void)
 	} //end for
 } //end of the function AAS_StoreReachability
 //===========================================================================
+// adds the time spent on a reachability test
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_AddReachabilityTestTime(int test, std::chrono::steady_clock::time_point start)
+{
+	long long time;
+
+	time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+							std::chrono::steady_clock::now() - start).count();
+	if (reachthread)
+	{
+		reachthread->testtimes[test] += time;
+		reachthread->testcalls[test]++;
+	} //end if
+	else
+	{
+		reachtesttimes[test] += time;
+		reachtestcalls[test]++;
+	} //end else
+} //end of the function AAS_AddReachabilityTestTime
+//===========================================================================
+// runs a reachability test between two areas and times it when asked to
+//
+// Parameter:				-
+// Returns:					what the test returns
+// Changes Globals:		-
+//===========================================================================
+int AAS_ReachabilityTest(int test, int (*func)(int area1num, int area2num), int area1num, int area2num)
+{
+	std::chrono::steady_clock::time_point start;
+	int result;
+
+	if (!calcreachtimings) return func(area1num, area2num);
+	start = std::chrono::steady_clock::now();
+	result = func(area1num, area2num);
+	AAS_AddReachabilityTestTime(test, start);
+	return result;
+} //end of the function AAS_ReachabilityTest
+//===========================================================================
+// creates the reachabilities from area1 to area2
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_ReachabilityTests(int area1num, int area2num)
+{
+	//if there already is a reachability link from area1 to area2
+	if (AAS_ReachabilityExists(area1num, area2num)) return;
+	//check for a swim reachability
+	if (AAS_ReachabilityTest(REACHTEST_SWIM, AAS_Reachability_Swim, area1num, area2num)) return;
+	//check for a simple walk on equal floor height reachability
+	if (AAS_ReachabilityTest(REACHTEST_EQUALFLOOR, AAS_Reachability_EqualFloorHeight, area1num, area2num)) return;
+	//check for step, barrier, waterjump and walk off ledge reachabilities
+	if (AAS_ReachabilityTest(REACHTEST_STEP, AAS_Reachability_Step_Barrier_WaterJump_WalkOffLedge, area1num, area2num)) return;
+	//check for ladder reachabilities
+	if (AAS_ReachabilityTest(REACHTEST_LADDER, AAS_Reachability_Ladder, area1num, area2num)) return;
+	//check for a jump reachability
+	AAS_ReachabilityTest(REACHTEST_JUMP, AAS_Reachability_Jump, area1num, area2num);
+} //end of the function AAS_ReachabilityTests
+//===========================================================================
+// creates the grapple and weapon jump reachabilities from area1 to area2
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_WeaponJumpReachabilityTests(int area1num, int area2num)
+{
+	if (AAS_ReachabilityExists(area1num, area2num)) return;
+	//check for a grapple hook reachability
+	if (calcgrapplereach) AAS_ReachabilityTest(REACHTEST_GRAPPLE, AAS_Reachability_Grapple, area1num, area2num);
+	//check for a weapon jump reachability
+	AAS_ReachabilityTest(REACHTEST_WEAPONJUMP, AAS_Reachability_WeaponJump, area1num, area2num);
+} //end of the function AAS_WeaponJumpReachabilityTests
+//===========================================================================
+// creates the reachabilities from the given area to all other areas
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_AreaReachabilities(int areanum)
+{
+	int j;
+
+	//only create jumppad reachabilities from jumppad areas
+	if (aasworld.areasettings[areanum].contents & AREACONTENTS_JUMPPAD)
+	{
+		return;
+	} //end if
+	//loop over the areas
+	for (j = 1; j < aasworld.numareas; j++)
+	{
+		if (areanum == j) continue;
+		//never create reachabilities from teleporter or jumppad areas to regular areas
+		if (aasworld.areasettings[areanum].contents & (AREACONTENTS_TELEPORTER|AREACONTENTS_JUMPPAD))
+		{
+			if (!(aasworld.areasettings[j].contents & (AREACONTENTS_TELEPORTER|AREACONTENTS_JUMPPAD)))
+			{
+				continue;
+			} //end if
+		} //end if
+		if (!AAS_StartReachabilityPair(areanum, j, qfalse)) return;
+		AAS_ReachabilityTests(areanum, j);
+		AAS_EndReachabilityPair();
+	} //end for
+	//never create these reachabilities from teleporter or jumppad areas
+	if (aasworld.areasettings[areanum].contents & (AREACONTENTS_TELEPORTER|AREACONTENTS_JUMPPAD))
+	{
+		return;
+	} //end if
+	//loop over the areas
+	for (j = 1; j < aasworld.numareas; j++)
+	{
+		if (areanum == j) continue;
+		//
+		if (!AAS_StartReachabilityPair(areanum, j, qtrue)) return;
+		AAS_WeaponJumpReachabilityTests(areanum, j);
+		AAS_EndReachabilityPair();
+	} //end for
+} //end of the function AAS_AreaReachabilities
+//===========================================================================
+// worker thread job, creates the reachabilities of one area of the cycle
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_ReachabilityJob(int work, int threadnum)
+{
+	aas_reacharea_t *area;
+	aas_reachthread_t *thread;
+	int numheap, numqueries;
+
+	area = &reachareas[work];
+	thread = &reachthreads[threadnum];
+	area->thread = threadnum;
+	area->firstpair = thread->numpairs;
+	thread->arealinks = thread->numlinks;
+	thread->overflow = qfalse;
+	numheap = thread->numheap;
+	numqueries = thread->numqueries;
+	//
+	reachthread = thread;
+	reachcount = thread->counts;
+	AAS_AreaReachabilities(area->areanum);
+	reachthread = NULL;
+	reachcount = reachcounts;
+	//
+	thread->pair = NULL;
+	area->numpairs = thread->numpairs - area->firstpair;
+	area->overflow = thread->overflow;
+	//the area is done again on the main thread, give back the room
+	if (area->overflow)
+	{
+		thread->numpairs = area->firstpair;
+		thread->numlinks = thread->arealinks;
+		thread->numheap = numheap;
+		thread->numqueries = numqueries;
+		area->numpairs = 0;
+	} //end if
+} //end of the function AAS_ReachabilityJob
+//===========================================================================
+// stores the reachabilities a worker thread created for an area pair
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_MergeReachabilityPair(aas_reachthread_t *thread, aas_reachpair_t *pair)
+{
+	aas_reachquery_t *query;
+	aas_reachlink_t *link;
+	aas_lreachability_t *lreach;
+	int i;
+
+	//when a link the thread asked about was created by another area of the
+	//cycle in the meantime the thread got a different answer than the serial
+	//loop would have, so test the pair again
+	for (i = 0; i < pair->numqueries; i++)
+	{
+		query = &thread->queries[pair->firstquery + i];
+		if (AAS_ReachabilityExists(query->area1num, query->area2num) != query->exists)
+		{
+			if (pair->weaponjump) AAS_WeaponJumpReachabilityTests(pair->area1num, pair->area2num);
+			else AAS_ReachabilityTests(pair->area1num, pair->area2num);
+			return;
+		} //end if
+	} //end for
+	//store the links in the order they were created
+	for (i = 0; i < pair->numlinks; i++)
+	{
+		link = &thread->links[pair->firstlink + i];
+		lreach = AAS_AllocReachability();
+		if (!lreach) return;
+		*lreach = *link->lreach;
+		AAS_LinkReachability(link->areanum, lreach);
+	} //end for
+	for (i = 0; i < NUM_REACHCOUNTS; i++)
+	{
+		reachcounts[i] += pair->counts[i];
+	} //end for
+} //end of the function AAS_MergeReachabilityPair
+//===========================================================================
+// creates the reachabilities for a cycle of areas on the worker threads
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_ThreadedReachability(int firstarea, int lastarea)
+{
+	aas_reacharea_t *area;
+	aas_reachthread_t *thread;
+	int i, j;
+
+	numreachareas = numreachthreads * REACHTHREAD_AREAS;
+	if (firstarea + numreachareas > lastarea) numreachareas = lastarea - firstarea;
+	if (firstarea + numreachareas > aasworld.numareas) numreachareas = aasworld.numareas - firstarea;
+	for (i = 0; i < numreachareas; i++)
+	{
+		reachareas[i].areanum = firstarea + i;
+	} //end for
+	for (i = 0; i < numreachthreads; i++)
+	{
+		thread = &reachthreads[i];
+		thread->numheap = 0;
+		thread->numlinks = 0;
+		thread->numqueries = 0;
+		thread->numpairs = 0;
+	} //end for
+	//
+	botimport.RunJobs(numreachthreads, numreachareas, AAS_ReachabilityJob);
+	//merge in area order
+	for (i = 0; i < numreachareas; i++)
+	{
+		area = &reachareas[i];
+		aasworld.numreachabilityareas++;
+		if (area->overflow)
+		{
+			AAS_AreaReachabilities(area->areanum);
+			continue;
+		} //end if
+		thread = &reachthreads[area->thread];
+		for (j = 0; j < area->numpairs; j++)
+		{
+			AAS_MergeReachabilityPair(thread, &thread->pairs[area->firstpair + j]);
+		} //end for
+	} //end for
+	//
+	for (i = 0; i < numreachthreads; i++)
+	{
+		thread = &reachthreads[i];
+		for (j = 0; j < NUM_REACHTESTS; j++)
+		{
+			reachtesttimes[j] += thread->testtimes[j];
+			reachtestcalls[j] += thread->testcalls[j];
+			thread->testtimes[j] = 0;
+			thread->testcalls[j] = 0;
+		} //end for
+	} //end for
+} //end of the function AAS_ThreadedReachability
+//===========================================================================
+// prints the number of reachabilities of every type and the time spent
+// on every test
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_PrintReachabilityTimings(void)
+{
+	int i;
+
+	for (i = 0; i < NUM_REACHCOUNTS; i++)
+	{
+		botimport.Print(PRT_MESSAGE, "%6d reach %s\n", reachcounts[i], reachcountnames[i]);
+	} //end for
+	for (i = 0; i < NUM_REACHTESTS; i++)
+	{
+		botimport.Print(PRT_MESSAGE, "%10.1f ms %10d tests %s\n",
+						(double) reachtesttimes[i] / 1000000.0, reachtestcalls[i], reachtestnames[i]);
+	} //end for
+} //end of the function AAS_PrintReachabilityTimings
+//===========================================================================
 //
 // TRAVEL_WALK					100%	equal floor height + steps
 // TRAVEL_CROUCH				100%
@@ -4416,9 +4963,10 @@ void AAS_StoreReachability(void)
 //===========================================================================
 int AAS_ContinueInitReachability(float time)
 {
-	int i, j, todo, start_time;
+	int i, todo, start_time;
 	static float framereachability, reachability_delay;
 	static int lastpercentage;
+	std::chrono::steady_clock::time_point start;
 
 	if (!aasworld.loaded) return qfalse;
 	//if reachability is calculated for all areas
@@ -4435,55 +4983,18 @@ int AAS_ContinueInitReachability(float time)
 	todo = aasworld.numreachabilityareas + (int) framereachability;
 	start_time = Sys_MilliSeconds();
 	//loop over the areas
-	for (i = aasworld.numreachabilityareas; i < aasworld.numareas && i < todo; i++)
+	for (i = aasworld.numreachabilityareas; i < aasworld.numareas && i < todo; i = aasworld.numreachabilityareas)
 	{
-		aasworld.numreachabilityareas++;
-		//only create jumppad reachabilities from jumppad areas
-		if (aasworld.areasettings[i].contents & AREACONTENTS_JUMPPAD)
+		//calculate a cycle of areas on the worker threads
+		if (numreachthreads > 1)
 		{
-			continue;
+			AAS_ThreadedReachability(i, todo);
 		} //end if
-		//loop over the areas
-		for (j = 1; j < aasworld.numareas; j++)
-		{
-			if (i == j) continue;
-			//never create reachabilities from teleporter or jumppad areas to regular areas
-			if (aasworld.areasettings[i].contents & (AREACONTENTS_TELEPORTER|AREACONTENTS_JUMPPAD))
-			{
-				if (!(aasworld.areasettings[j].contents & (AREACONTENTS_TELEPORTER|AREACONTENTS_JUMPPAD)))
-				{
-					continue;
-				} //end if
-			} //end if
-			//if there already is a reachability link from area i to j
-			if (AAS_ReachabilityExists(i, j)) continue;
-			//check for a swim reachability
-			if (AAS_Reachability_Swim(i, j)) continue;
-			//check for a simple walk on equal floor height reachability
-			if (AAS_Reachability_EqualFloorHeight(i, j)) continue;
-			//check for step, barrier, waterjump and walk off ledge reachabilities
-			if (AAS_Reachability_Step_Barrier_WaterJump_WalkOffLedge(i, j)) continue;
-			//check for ladder reachabilities
-			if (AAS_Reachability_Ladder(i, j)) continue;
-			//check for a jump reachability
-			if (AAS_Reachability_Jump(i, j)) continue;
-		} //end for
-		//never create these reachabilities from teleporter or jumppad areas
-		if (aasworld.areasettings[i].contents & (AREACONTENTS_TELEPORTER|AREACONTENTS_JUMPPAD))
-		{
-			continue;
-		} //end if
-		//loop over the areas
-		for (j = 1; j < aasworld.numareas; j++)
+		else
 		{
-			if (i == j) continue;
-			//
-			if (AAS_ReachabilityExists(i, j)) continue;
-			//check for a grapple hook reachability
-			if (calcgrapplereach) AAS_Reachability_Grapple(i, j);
-			//check for a weapon jump reachability
-			AAS_Reachability_WeaponJump(i, j);
-		} //end for
+			aasworld.numreachabilityareas++;
+			AAS_AreaReachabilities(i);
+		} //end else
 		//if the calculation took more time than the max reachability delay
 		if (Sys_MilliSeconds() - start_time > (int) reachability_delay) break;
 		//
@@ -4500,6 +5011,7 @@ int AAS_ContinueInitReachability(float time)
 	else if (aasworld.numreachabilityareas == aasworld.numareas + 1)
 	{
 		//create additional walk off ledge reachabilities for every area
+		start = std::chrono::steady_clock::now();
 		for (i = 1; i < aasworld.numareas; i++)
 		{
 			//only create jumppad reachabilities from jumppad areas
@@ -4509,37 +5021,48 @@ int AAS_ContinueInitReachability(float time)
 			} //end if
 			AAS_Reachability_WalkOffLedge(i);
 		} //end for
+		AAS_AddReachabilityTestTime(REACHTEST_WALKOFFLEDGE, start);
 		//create jump pad reachabilities
+		start = std::chrono::steady_clock::now();
 		AAS_Reachability_JumpPad();
+		AAS_AddReachabilityTestTime(REACHTEST_JUMPPAD, start);
 		//create teleporter reachabilities
+		start = std::chrono::steady_clock::now();
 		AAS_Reachability_Teleport();
+		AAS_AddReachabilityTestTime(REACHTEST_TELEPORT, start);
 		//create elevator (func_plat) reachabilities
+		start = std::chrono::steady_clock::now();
 		AAS_Reachability_Elevator();
+		AAS_AddReachabilityTestTime(REACHTEST_ELEVATOR, start);
 		//create func_bobbing reachabilities
+		start = std::chrono::steady_clock::now();
 		AAS_Reachability_FuncBobbing();
+		AAS_AddReachabilityTestTime(REACHTEST_FUNCBOB, start);
 		//
+		if (calcreachtimings) AAS_PrintReachabilityTimings();
 #ifdef DEBUG
-		botimport.Print(PRT_MESSAGE, "%6d reach swim\n", reach_swim);
-		botimport.Print(PRT_MESSAGE, "%6d reach equal floor\n", reach_equalfloor);
-		botimport.Print(PRT_MESSAGE, "%6d reach step\n", reach_step);
-		botimport.Print(PRT_MESSAGE, "%6d reach barrier\n", reach_barrier);
-		botimport.Print(PRT_MESSAGE, "%6d reach waterjump\n", reach_waterjump);
-		botimport.Print(PRT_MESSAGE, "%6d reach walkoffledge\n", reach_walkoffledge);
-		botimport.Print(PRT_MESSAGE, "%6d reach jump\n", reach_jump);
-		botimport.Print(PRT_MESSAGE, "%6d reach ladder\n", reach_ladder);
-		botimport.Print(PRT_MESSAGE, "%6d reach walk\n", reach_walk);
-		botimport.Print(PRT_MESSAGE, "%6d reach teleport\n", reach_teleport);
-		botimport.Print(PRT_MESSAGE, "%6d reach funcbob\n", reach_funcbob);
-		botimport.Print(PRT_MESSAGE, "%6d reach elevator\n", reach_elevator);
-		botimport.Print(PRT_MESSAGE, "%6d reach grapple\n", reach_grapple);
-		botimport.Print(PRT_MESSAGE, "%6d reach rocketjump\n", reach_rocketjump);
-		botimport.Print(PRT_MESSAGE, "%6d reach jumppad\n", reach_jumppad);
+		botimport.Print(PRT_MESSAGE, "%6d reach swim\n", reachcounts[REACHCOUNT_SWIM]);
+		botimport.Print(PRT_MESSAGE, "%6d reach equal floor\n", reachcounts[REACHCOUNT_EQUALFLOOR]);
+		botimport.Print(PRT_MESSAGE, "%6d reach step\n", reachcounts[REACHCOUNT_STEP]);
+		botimport.Print(PRT_MESSAGE, "%6d reach barrier\n", reachcounts[REACHCOUNT_BARRIER]);
+		botimport.Print(PRT_MESSAGE, "%6d reach waterjump\n", reachcounts[REACHCOUNT_WATERJUMP]);
+		botimport.Print(PRT_MESSAGE, "%6d reach walkoffledge\n", reachcounts[REACHCOUNT_WALKOFFLEDGE]);
+		botimport.Print(PRT_MESSAGE, "%6d reach jump\n", reachcounts[REACHCOUNT_JUMP]);
+		botimport.Print(PRT_MESSAGE, "%6d reach ladder\n", reachcounts[REACHCOUNT_LADDER]);
+		botimport.Print(PRT_MESSAGE, "%6d reach walk\n", reachcounts[REACHCOUNT_WALK]);
+		botimport.Print(PRT_MESSAGE, "%6d reach teleport\n", reachcounts[REACHCOUNT_TELEPORT]);
+		botimport.Print(PRT_MESSAGE, "%6d reach funcbob\n", reachcounts[REACHCOUNT_FUNCBOB]);
+		botimport.Print(PRT_MESSAGE, "%6d reach elevator\n", reachcounts[REACHCOUNT_ELEVATOR]);
+		botimport.Print(PRT_MESSAGE, "%6d reach grapple\n", reachcounts[REACHCOUNT_GRAPPLE]);
+		botimport.Print(PRT_MESSAGE, "%6d reach rocketjump\n", reachcounts[REACHCOUNT_ROCKETJUMP]);
+		botimport.Print(PRT_MESSAGE, "%6d reach jumppad\n", reachcounts[REACHCOUNT_JUMPPAD]);
 #endif
 		//*/
 		//store all the reachabilities
 		AAS_StoreReachability();
 		//free the reachability link heap
 		AAS_ShutDownReachabilityHeap();
+		AAS_FreeReachabilityThreads();
 		//
 		FreeMemory(areareachability);
 		//
@@ -4580,6 +5103,7 @@ void AAS_InitReachability(void)
 	} //end if
 #ifndef BSPC
 	calcgrapplereach = LibVarGetValue("grapplereach");
+	calcreachthreads = LibVarValue("reachthreads", "0");
 #endif
 	aasworld.savefile = qtrue;
 	//start with area 1 because area zero is a dummy
@@ -4592,4 +5116,9 @@ void AAS_InitReachability(void)
 									aasworld.numareas * sizeof(aas_lreachability_t *));
 	//
 	AAS_SetWeaponJumpAreaFlags();
+	//
+	AAS_SetupReachabilityThreads();
+	Com_Memset(reachcounts, 0, sizeof(reachcounts));
+	Com_Memset(reachtesttimes, 0, sizeof(reachtesttimes));
+	Com_Memset(reachtestcalls, 0, sizeof(reachtestcalls));
 } //end of the function AAS_InitReachable
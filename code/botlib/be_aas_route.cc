@@ -44,6 +44,9 @@
 #include "be_aas_funcs.h"
 #include "be_interface.h"
 #include "be_aas_def.h"
+#include "be_threads.h"
+
+#include <mutex>
 
 #define ROUTING_DEBUG
 
@@ -56,6 +59,9 @@
 //maximum number of routing updates each frame
 #define MAX_FRAMEROUTINGUPDATES		10
 
+//serializes routing cache lookups and updates while bots think on several threads
+static std::recursive_mutex aasroutinglock;
+
 /*
 
  area routing cache:
@@ -73,13 +79,143 @@
 
  */
 
+/*
+
+ routing cache pool:
+ the routing cache lives in an arena of max_routingcache kilobytes that is
+ allocated once and cut into slabs of equal size. every slab belongs to a
+ shard and is split into blocks the size of the caches of that shard.
+ shard 0 holds the portal caches and shard N the area caches of cluster N,
+ so all the caches in a shard have the same size. every shard keeps its
+ caches in a list sorted on time, a full shard makes room by evicting its
+ least recently used cache and the slabs of caches that haven't been used
+ for a while go to the shards that need them.
+
+ the caches used by the current route query are never evicted because the
+ query holds pointers to them, and nothing is evicted while the bots think
+ on several threads. caches that don't fit then are allocated on the heap
+ and freed at the next route query on the main thread.
+
+ */
+
+#define ROUTINGCACHE_SLABSIZE		(16 * 1024)	//minimum size of a slab
+#define ROUTINGCACHE_STALETIME		10			//seconds before the slab of an unused cache may go to another shard
+
+typedef struct aas_cacheslab_s
+{
+  int shard;									//shard the slab belongs to, -1 if unused
+  int numblocks;								//number of blocks cut from the slab
+  int numused;									//number of blocks in use
+  aas_routingcache_t *freeblocks;				//unused blocks linked through next
+  struct aas_cacheslab_s *prev, *next;			//unused slabs or slabs of the shard with room
+} aas_cacheslab_t;
+
+typedef struct aas_cacheshard_s
+{
+  int numtraveltimes;							//travel times in a cache of the shard
+  int blocksize;								//size of a block in the shard
+  aas_cacheslab_t *slabs;						//slabs with room
+  aas_routingcache_t *oldest, *newest;			//caches of the shard sorted on time
+  int numcaches;
+  int hits, misses, evictions;
+} aas_cacheshard_t;
+
+/*
+
+ portal tables:
+ travel times between all the cluster portals for a few sets of travel
+ flags, calculated offline (libvar saveportaltables) and mapped from
+ maps/<mapname>.ptt as they are. for every portal and both clusters it
+ leads into there's a row with the travel times from all the portals to
+ that portal when leaving it into that cluster. a portal routing cache is
+ then the area cache of the goal area combined with the rows of the
+ portals of the goal cluster, instead of a flood through all the clusters
+
+ */
+
+#define PTID						(('L'<<24)+('B'<<16)+('T'<<8)+'P')
+#define PTVERSION					1
+#define MAX_PORTALTABLES			8
+
+//the portal table header, followed by numtables tables of
+//numportals * 2 * numportals unsigned shorts
+typedef struct portaltableheader_s
+{
+  int ident;
+  int version;
+  int numareas;
+  int numportals;
+  int numclusters;
+  int areacrc;
+  int clustercrc;
+  int numtables;
+  int travelflags[MAX_PORTALTABLES];		//travel flags of every table
+  int tableofs[MAX_PORTALTABLES];			//offset of every table from the start of the file
+} portaltableheader_t;
+
+//a recorded route query
+typedef struct aas_routequery_s
+{
+  int areanum;
+  vec3_t origin;
+  int goalareanum;
+  int travelflags;
+} aas_routequery_t;
+
+/*
+
+ area search:
+ a search from the area a bot is in that visits the areas in order of
+ travel time. it doesn't use or update the routing cache so one search
+ answers the travel times towards many goal areas at once, and it stops
+ as soon as the remaining goals can't be better than the best one found
+
+ */
+
+//state of an area in the current area search
+typedef struct aas_areasearch_s
+{
+  unsigned int search;							//search the state belongs to
+  int traveltime;								//travel time so far, 0 if not reached
+  int goal;										//first goal in the area, -1 if none
+  int settled;									//true if the travel time is final
+  vec3_t start;									//start point the area was entered
+} aas_areasearch_t;
+
+//an area waiting to be visited by the area search
+typedef struct aas_searchnode_s
+{
+  int traveltime;
+  int areanum;
+} aas_searchnode_t;
+
 #ifdef ROUTING_DEBUG
 int numareacacheupdates;
 int numportalcacheupdates;
 #endif //ROUTING_DEBUG
-int routingcachesize;
 int max_routingcachesize;
 
+static byte *cachearena;
+static aas_cacheslab_t *cacheslabs;
+static aas_cacheslab_t *freecacheslabs;
+static int numcacheslabs, cacheslabsize;
+static aas_cacheshard_t *cacheshards;
+static int numcacheshards;
+static int numheapcaches;						//caches allocated outside the arena
+static unsigned int routingquery;				//number of the current route query
+static aas_routecachestats_t routingcachestats;
+static aas_routequery_t *routequeries;
+static int numroutequeries, maxroutequeries;
+static const portaltableheader_t *portaltables;
+static void *portaltablecopy;					//the portal tables if they had to be copied
+static int numdisabledareas;
+static aas_areasearch_t *areasearch;			//search state of every area
+static aas_searchnode_t *searchheap;			//areas to visit sorted on travel time
+static int numsearchnodes;
+static unsigned int areasearchnum;				//number of the current area search
+static int *searchgoalnext;						//next goal in the same area
+static int maxsearchgoals;
+
 //===========================================================================
 //
 // Parameter:			-
@@ -89,9 +225,29 @@ int max_routingcachesize;
 #ifdef ROUTING_DEBUG
 void AAS_RoutingInfo(void)
 {
+  int i;
+  aas_cacheshard_t *shard;
+
   botimport.Print(PRT_MESSAGE, "%d area cache updates\n", numareacacheupdates);
   botimport.Print(PRT_MESSAGE, "%d portal cache updates\n", numportalcacheupdates);
-  botimport.Print(PRT_MESSAGE, "%d bytes routing cache\n", routingcachesize);
+  botimport.Print(PRT_MESSAGE, "%d portal caches from the portal tables\n", routingcachestats.portaltables);
+  botimport.Print(PRT_MESSAGE, "%d bytes routing cache, %d peak, %d budget\n", routingcachestats.bytes,
+                  routingcachestats.peakbytes, routingcachestats.budget);
+  botimport.Print(PRT_MESSAGE, "%d route queries, %d cache hits, %d misses, %d evictions, %d heap allocations\n",
+                  routingcachestats.queries, routingcachestats.hits, routingcachestats.misses,
+                  routingcachestats.evictions, routingcachestats.overflows);
+  for (i = 0; i < numcacheshards; i++)
+  {
+    shard = &cacheshards[i];
+    if (!shard->hits && !shard->misses)
+      continue;
+    if (i)
+      botimport.Print(PRT_MESSAGE, "cluster %4d:", i);
+    else
+      botimport.Print(PRT_MESSAGE, "portals     :");
+    botimport.Print(PRT_MESSAGE, " %4d caches of %6d bytes, %7d hits, %6d misses, %6d evictions\n",
+                    shard->numcaches, shard->blocksize, shard->hits, shard->misses, shard->evictions);
+  } //end for
 } //end of the function AAS_RoutingInfo
 #endif //ROUTING_DEBUG
 //===========================================================================
@@ -194,8 +350,20 @@ int AAS_TravelFlagForType(int traveltype)
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
+ID_INLINE aas_cacheshard_t *AAS_CacheShard(aas_routingcache_t *cache)
+{
+  return &cacheshards[cache->type == CACHETYPE_PORTAL ? 0 : cache->cluster];
+} //end of the function AAS_CacheShard
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
 void AAS_UnlinkCache(aas_routingcache_t *cache)
 {
+  aas_cacheshard_t *shard;
+
   if (cache->time_next)
     cache->time_next->time_prev = cache->time_prev;
   else
@@ -206,6 +374,18 @@ void AAS_UnlinkCache(aas_routingcache_t *cache)
     aasworld.oldestcache = cache->time_next;
   cache->time_next = NULL;
   cache->time_prev = NULL;
+  //unlink from the shard
+  shard = AAS_CacheShard(cache);
+  if (cache->shard_next)
+    cache->shard_next->shard_prev = cache->shard_prev;
+  else
+    shard->newest = cache->shard_prev;
+  if (cache->shard_prev)
+    cache->shard_prev->shard_next = cache->shard_next;
+  else
+    shard->oldest = cache->shard_next;
+  cache->shard_next = NULL;
+  cache->shard_prev = NULL;
 } //end of the function AAS_UnlinkCache
 //===========================================================================
 //
@@ -215,6 +395,8 @@ void AAS_UnlinkCache(aas_routingcache_t *cache)
 //===========================================================================
 void AAS_LinkCache(aas_routingcache_t *cache)
 {
+  aas_cacheshard_t *shard;
+
   if (aasworld.newestcache)
   {
     aasworld.newestcache->time_next = cache;
@@ -227,6 +409,20 @@ void AAS_LinkCache(aas_routingcache_t *cache)
   } //end else
   cache->time_next = NULL;
   aasworld.newestcache = cache;
+  //link into the shard
+  shard = AAS_CacheShard(cache);
+  if (shard->newest)
+  {
+    shard->newest->shard_next = cache;
+    cache->shard_prev = shard->newest;
+  } //end if
+  else
+  {
+    shard->oldest = cache;
+    cache->shard_prev = NULL;
+  } //end else
+  cache->shard_next = NULL;
+  shard->newest = cache;
 } //end of the function AAS_LinkCache
 //===========================================================================
 //
@@ -234,11 +430,119 @@ void AAS_LinkCache(aas_routingcache_t *cache)
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
+void AAS_LinkCacheSlab(aas_cacheslab_t **list, aas_cacheslab_t *slab)
+{
+  slab->prev = NULL;
+  slab->next = *list;
+  if (*list)
+    (*list)->prev = slab;
+  *list = slab;
+} //end of the function AAS_LinkCacheSlab
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_UnlinkCacheSlab(aas_cacheslab_t **list, aas_cacheslab_t *slab)
+{
+  if (slab->prev)
+    slab->prev->next = slab->next;
+  else
+    *list = slab->next;
+  if (slab->next)
+    slab->next->prev = slab->prev;
+  slab->prev = NULL;
+  slab->next = NULL;
+} //end of the function AAS_UnlinkCacheSlab
+//===========================================================================
+// returns a block from a slab of the shard or from an unused slab,
+// NULL if the arena is full
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+aas_routingcache_t *AAS_CacheSlabBlock(int shardnum)
+{
+  aas_cacheshard_t *shard;
+  aas_cacheslab_t *slab;
+  aas_routingcache_t *cache;
+
+  shard = &cacheshards[shardnum];
+  slab = shard->slabs;
+  if (!slab)
+  {
+    slab = freecacheslabs;
+    if (!slab)
+      return NULL;
+    AAS_UnlinkCacheSlab(&freecacheslabs, slab);
+    slab->shard = shardnum;
+    slab->numblocks = 0;
+    slab->numused = 0;
+    slab->freeblocks = NULL;
+    AAS_LinkCacheSlab(&shard->slabs, slab);
+  } //end if
+  if (slab->freeblocks)
+  {
+    cache = slab->freeblocks;
+    slab->freeblocks = cache->next;
+  } //end if
+  else
+  {
+    cache = (aas_routingcache_t *) (cachearena + (slab - cacheslabs) * cacheslabsize + slab->numblocks * shard->blocksize);
+    slab->numblocks++;
+  } //end else
+  slab->numused++;
+  //if the slab is full
+  if (!slab->freeblocks && (slab->numblocks + 1) * shard->blocksize > cacheslabsize)
+  {
+    AAS_UnlinkCacheSlab(&shard->slabs, slab);
+  } //end if
+  cache->slab = slab - cacheslabs;
+  return cache;
+} //end of the function AAS_CacheSlabBlock
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
 void AAS_FreeRoutingCache(aas_routingcache_t *cache)
 {
+  aas_cacheshard_t *shard;
+  aas_cacheslab_t *slab;
+  qboolean full;
+
   AAS_UnlinkCache(cache);
-  routingcachesize -= cache->size;
-  FreeMemory(cache);
+  shard = AAS_CacheShard(cache);
+  shard->numcaches--;
+  routingcachestats.bytes -= shard->blocksize;
+  if (cache->slab < 0)
+  {
+    numheapcaches--;
+    FreeMemory(cache);
+    return;
+  } //end if
+  //give the block back to the slab
+  slab = &cacheslabs[cache->slab];
+  full = !slab->freeblocks && (slab->numblocks + 1) * shard->blocksize > cacheslabsize;
+  cache->type = CACHETYPE_FREE;
+  cache->next = slab->freeblocks;
+  slab->freeblocks = cache;
+  slab->numused--;
+  if (!slab->numused)
+  {
+    //the slab is unused and can go to any shard
+    if (!full)
+      AAS_UnlinkCacheSlab(&shard->slabs, slab);
+    slab->shard = -1;
+    AAS_LinkCacheSlab(&freecacheslabs, slab);
+  } //end if
+  else if (full)
+  {
+    AAS_LinkCacheSlab(&shard->slabs, slab);
+  } //end else if
 } //end of the function AAS_FreeRoutingCache
 //===========================================================================
 //
@@ -321,6 +625,9 @@ int AAS_EnableRoutingArea(int areanum, int enable)
   flags = aasworld.areasettings[areanum].areaflags & AREA_DISABLED;
   if (enable < 0)
     return !flags;
+  //other bots may be routing through the area right now
+  if (BotDeferRoutingArea(areanum, enable))
+    return !flags;
 
   if (enable)
     aasworld.areasettings[areanum].areaflags &= ~AREA_DISABLED;
@@ -329,6 +636,7 @@ int AAS_EnableRoutingArea(int areanum, int enable)
   // if the status of the area changed
   if ((flags & AREA_DISABLED) != (aasworld.areasettings[areanum].areaflags & AREA_DISABLED))
   {
+    numdisabledareas += enable ? -1 : 1;
     //remove all routing cache involving this area
     AAS_RemoveRoutingCacheUsingArea(areanum);
   } //end if
@@ -701,69 +1009,162 @@ void AAS_InitPortalMaxTravelTimes(void)
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
-int AAS_FreeOldestCache(void)
+void AAS_EvictRoutingCache(aas_routingcache_t *cache)
 {
   int clusterareanum;
-  aas_routingcache_t *cache;
+  aas_cacheshard_t *shard;
 
-  for (cache = aasworld.oldestcache; cache; cache = cache->time_next)
+  // unlink the cache
+  if (cache->type == CACHETYPE_AREA)
   {
-    // never free area cache leading towards a portal
-    if (cache->type == CACHETYPE_AREA && aasworld.areasettings[cache->areanum].cluster < 0)
-    {
-      continue;
-    }
-    break;
+    //number of the area in the cluster
+    clusterareanum = AAS_ClusterAreaNum(cache->cluster, cache->areanum);
+    // unlink from cluster area cache
+    if (cache->prev)
+      cache->prev->next = cache->next;
+    else
+      aasworld.clusterareacache[cache->cluster][clusterareanum] = cache->next;
+    if (cache->next)
+      cache->next->prev = cache->prev;
   }
-  if (cache)
+  else
   {
-    // unlink the cache
-    if (cache->type == CACHETYPE_AREA)
-    {
-      //number of the area in the cluster
-      clusterareanum = AAS_ClusterAreaNum(cache->cluster, cache->areanum);
-      // unlink from cluster area cache
-      if (cache->prev)
-        cache->prev->next = cache->next;
-      else
-        aasworld.clusterareacache[cache->cluster][clusterareanum] = cache->next;
-      if (cache->next)
-        cache->next->prev = cache->prev;
-    }
+    // unlink from portal cache
+    if (cache->prev)
+      cache->prev->next = cache->next;
     else
-    {
-      // unlink from portal cache
-      if (cache->prev)
-        cache->prev->next = cache->next;
-      else
-        aasworld.portalcache[cache->areanum] = cache->next;
-      if (cache->next)
-        cache->next->prev = cache->prev;
-    }
-    AAS_FreeRoutingCache(cache);
-    return qtrue;
+      aasworld.portalcache[cache->areanum] = cache->next;
+    if (cache->next)
+      cache->next->prev = cache->prev;
   }
-  return qfalse;
-} //end of the function AAS_FreeOldestCache
+  shard = AAS_CacheShard(cache);
+  shard->evictions++;
+  routingcachestats.evictions++;
+  AAS_FreeRoutingCache(cache);
+} //end of the function AAS_EvictRoutingCache
+//===========================================================================
+// evicts all the caches in the slab of the given cache so the slab can
+// go to another shard, caches allocated on the heap are just evicted
+//
+// Parameter:			-
+// Returns:				qtrue if anything was evicted
+// Changes Globals:		-
+//===========================================================================
+int AAS_FreeCacheSlab(aas_routingcache_t *cache)
+{
+  int i, blocksize;
+  byte *base;
+  aas_cacheslab_t *slab;
+
+  if (cache->slab < 0)
+  {
+    AAS_EvictRoutingCache(cache);
+    return qtrue;
+  } //end if
+  slab = &cacheslabs[cache->slab];
+  blocksize = cacheshards[slab->shard].blocksize;
+  base = cachearena + cache->slab * cacheslabsize;
+  //the current route query may hold pointers to caches in the slab
+  for (i = 0; i < slab->numblocks; i++)
+  {
+    cache = (aas_routingcache_t *) (base + i * blocksize);
+    if (cache->type != CACHETYPE_FREE && cache->query == routingquery)
+      return qfalse;
+  } //end for
+  for (i = 0; i < slab->numblocks; i++)
+  {
+    cache = (aas_routingcache_t *) (base + i * blocksize);
+    if (cache->type != CACHETYPE_FREE)
+      AAS_EvictRoutingCache(cache);
+  } //end for
+  return qtrue;
+} //end of the function AAS_FreeCacheSlab
 //===========================================================================
 //
 // Parameter:			-
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
-aas_routingcache_t *AAS_AllocRoutingCache(int numtraveltimes)
+void AAS_FreeHeapRoutingCaches(void)
 {
-  aas_routingcache_t *cache;
-  int size;
+  aas_routingcache_t *cache, *nextcache;
 
-  //
-  size = sizeof(aas_routingcache_t) + numtraveltimes * sizeof(unsigned short int) + numtraveltimes * sizeof(unsigned char);
-  //
-  routingcachesize += size;
-  //
-  cache = (aas_routingcache_t *) GetClearedMemory(size);
-  cache->reachabilities = (unsigned char *) cache + sizeof(aas_routingcache_t) + numtraveltimes * sizeof(unsigned short int);
-  cache->size = size;
+  for (cache = aasworld.oldestcache; cache && numheapcaches; cache = nextcache)
+  {
+    nextcache = cache->time_next;
+    if (cache->slab < 0)
+      AAS_EvictRoutingCache(cache);
+  } //end for
+} //end of the function AAS_FreeHeapRoutingCaches
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+int AAS_RoutingCacheSize(int numtraveltimes)
+{
+  return sizeof(aas_routingcache_t) + numtraveltimes * sizeof(unsigned short int) + numtraveltimes * sizeof(unsigned char);
+} //end of the function AAS_RoutingCacheSize
+//===========================================================================
+// allocates a routing cache for the given shard, shard 0 holds the portal
+// caches and shard N the area caches of cluster N
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+aas_routingcache_t *AAS_AllocRoutingCache(int shardnum)
+{
+  int slab;
+  aas_cacheshard_t *shard;
+  aas_routingcache_t *cache, *victim, *oldest;
+
+  shard = &cacheshards[shardnum];
+  while (!(cache = AAS_CacheSlabBlock(shardnum)))
+  {
+    //other threads may hold pointers into the cache while the bots think
+    if (BotThreadedThink())
+      break;
+    //the least recently used cache of the shard and of all the shards
+    victim = shard->oldest;
+    if (victim && victim->query == routingquery)
+      victim = NULL;
+    oldest = aasworld.oldestcache;
+    if (oldest && oldest->query == routingquery)
+      oldest = NULL;
+    //take the slab of a cache that hasn't been used for a while
+    if (oldest && oldest != victim && (!victim || AAS_RoutingTime() - oldest->time > ROUTINGCACHE_STALETIME))
+    {
+      if (AAS_FreeCacheSlab(oldest))
+        continue;
+    } //end if
+    if (!victim)
+      break;
+    AAS_EvictRoutingCache(victim);
+  } //end while
+  //everything in the arena is in use
+  if (!cache)
+  {
+    cache = (aas_routingcache_t *) GetMemory(shard->blocksize);
+    cache->slab = -1;
+    numheapcaches++;
+    routingcachestats.overflows++;
+  } //end if
+  slab = cache->slab;
+  Com_Memset(cache, 0, shard->blocksize);
+  cache->slab = slab;
+  cache->type = shardnum ? CACHETYPE_AREA : CACHETYPE_PORTAL;
+  cache->cluster = shardnum;
+  cache->size = AAS_RoutingCacheSize(shard->numtraveltimes);
+  cache->reachabilities = (unsigned char *) cache + sizeof(aas_routingcache_t) + shard->numtraveltimes * sizeof(unsigned short int);
+  cache->time = AAS_RoutingTime();
+  cache->query = routingquery;
+  AAS_LinkCache(cache);
+  shard->numcaches++;
+  routingcachestats.bytes += shard->blocksize;
+  if (routingcachestats.bytes > routingcachestats.peakbytes)
+    routingcachestats.peakbytes = routingcachestats.bytes;
   return cache;
 } //end of the function AAS_AllocRoutingCache
 //===========================================================================
@@ -772,6 +1173,74 @@ aas_routingcache_t *AAS_AllocRoutingCache(int numtraveltimes)
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
+void AAS_FreeRoutingCachePool(void)
+{
+  if (cachearena)
+    FreeMemory(cachearena);
+  cachearena = NULL;
+  if (cacheslabs)
+    FreeMemory(cacheslabs);
+  cacheslabs = NULL;
+  freecacheslabs = NULL;
+  numcacheslabs = 0;
+  if (cacheshards)
+    FreeMemory(cacheshards);
+  cacheshards = NULL;
+  numcacheshards = 0;
+} //end of the function AAS_FreeRoutingCachePool
+//===========================================================================
+// all the routing cache must have been freed
+//
+// Parameter:			budget: size of the arena in bytes
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_InitRoutingCachePool(int budget)
+{
+  int i, maxblocksize;
+  aas_cacheshard_t *shard;
+
+  AAS_FreeRoutingCachePool();
+  //one shard for the portal cache and one for every cluster
+  numcacheshards = aasworld.numclusters > 1 ? aasworld.numclusters : 1;
+  cacheshards = (aas_cacheshard_t *) GetClearedMemory(numcacheshards * sizeof(aas_cacheshard_t));
+  maxblocksize = 0;
+  for (i = 0; i < numcacheshards; i++)
+  {
+    shard = &cacheshards[i];
+    if (i)
+      shard->numtraveltimes = aasworld.clusters[i].numreachabilityareas;
+    else
+      shard->numtraveltimes = aasworld.numportals;
+    shard->blocksize = PAD(AAS_RoutingCacheSize(shard->numtraveltimes), 16);
+    if (shard->blocksize > maxblocksize)
+      maxblocksize = shard->blocksize;
+  } //end for
+  //every slab holds at least one cache of every shard
+  cacheslabsize = maxblocksize > ROUTINGCACHE_SLABSIZE ? maxblocksize : ROUTINGCACHE_SLABSIZE;
+  numcacheslabs = budget / cacheslabsize;
+  if (numcacheslabs < 1)
+    numcacheslabs = 1;
+  cachearena = (byte *) GetMemory(numcacheslabs * cacheslabsize);
+  cacheslabs = (aas_cacheslab_t *) GetClearedMemory(numcacheslabs * sizeof(aas_cacheslab_t));
+  freecacheslabs = NULL;
+  for (i = numcacheslabs - 1; i >= 0; i--)
+  {
+    cacheslabs[i].shard = -1;
+    AAS_LinkCacheSlab(&freecacheslabs, &cacheslabs[i]);
+  } //end for
+  numheapcaches = 0;
+  aasworld.oldestcache = NULL;
+  aasworld.newestcache = NULL;
+  Com_Memset(&routingcachestats, 0, sizeof(routingcachestats));
+  routingcachestats.budget = numcacheslabs * cacheslabsize;
+} //end of the function AAS_InitRoutingCachePool
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
 void AAS_FreeAllClusterAreaCache(void)
 {
   int i, j;
@@ -893,6 +1362,15 @@ void AAS_InitRoutingUpdate(void)
     FreeMemory(aasworld.portalupdate);
   //allocate memory for the portal update fields
   aasworld.portalupdate = (aas_routingupdate_t *) GetClearedMemory((aasworld.numportals + 1) * sizeof(aas_routingupdate_t));
+  //
+  if (areasearch)
+    FreeMemory(areasearch);
+  //allocate memory for the area search, every reachability is followed at most once
+  areasearch = (aas_areasearch_t *) GetClearedMemory(aasworld.numareas * sizeof(aas_areasearch_t));
+  if (searchheap)
+    FreeMemory(searchheap);
+  searchheap = (aas_searchnode_t *) GetMemory((aasworld.reachabilitysize + 1) * sizeof(aas_searchnode_t));
+  areasearchnum = 0;
 } //end of the function AAS_InitRoutingUpdate
 //===========================================================================
 //
@@ -946,7 +1424,7 @@ typedef struct routecacheheader_s
 } routecacheheader_t;
 
 #define RCID						(('C'<<24)+('R'<<16)+('E'<<8)+'M')
-#define RCVERSION					2
+#define RCVERSION					3
 
 //void AAS_DecompressVis(byte *in, int numareas, byte *decompressed);
 //int AAS_CompressVis(byte *vis, int numareas, byte *dest);
@@ -1051,15 +1529,26 @@ void AAS_WriteRouteCache(void)
 //===========================================================================
 aas_routingcache_t *AAS_ReadCache(fileHandle_t fp)
 {
-  int size;
-  aas_routingcache_t *cache;
+  int shardnum;
+  aas_routingcache_t header, *cache;
 
-  botimport.FS_Read(&size, sizeof(size), fp);
-  cache = (aas_routingcache_t *) GetMemory(size);
-  cache->size = size;
-  botimport.FS_Read((unsigned char *) cache + sizeof(size), size - sizeof(size), fp);
-  cache->reachabilities = (unsigned char *) cache + sizeof(aas_routingcache_t) - sizeof(unsigned short) + (size
-      - sizeof(aas_routingcache_t) + sizeof(unsigned short)) / 3 * 2;
+  //the cache is written the way it is in memory, the links are meaningless
+  botimport.FS_Read(&header, sizeof(aas_routingcache_t), fp);
+  shardnum = header.type == CACHETYPE_PORTAL ? 0 : header.cluster;
+  if (shardnum < 0 || shardnum >= numcacheshards || header.size != AAS_RoutingCacheSize(cacheshards[shardnum].numtraveltimes))
+  {
+    return NULL;
+  } //end if
+  //nothing read so far is used by a route query
+  routingquery++;
+  cache = AAS_AllocRoutingCache(shardnum);
+  cache->cluster = header.cluster;
+  cache->areanum = header.areanum;
+  VectorCopy(header.origin, cache->origin);
+  cache->starttraveltime = header.starttraveltime;
+  cache->travelflags = header.travelflags;
+  Com_Memcpy(cache->traveltimes, header.traveltimes, sizeof(aas_routingcache_t) - ((byte *) header.traveltimes - (byte *) &header));
+  botimport.FS_Read((unsigned char *) cache + sizeof(aas_routingcache_t), header.size - sizeof(aas_routingcache_t), fp);
   return cache;
 } //end of the function AAS_ReadCache
 //===========================================================================
@@ -1118,6 +1607,11 @@ int AAS_ReadRouteCache(void)
   for (i = 0; i < routecacheheader.numportalcache; i++)
   {
     cache = AAS_ReadCache(fp);
+    if (!cache)
+    {
+      botimport.FS_FCloseFile(fp);
+      return qfalse;
+    } //end if
     cache->next = aasworld.portalcache[cache->areanum];
     cache->prev = NULL;
     if (aasworld.portalcache[cache->areanum])
@@ -1128,6 +1622,11 @@ int AAS_ReadRouteCache(void)
   for (i = 0; i < routecacheheader.numareacache; i++)
   {
     cache = AAS_ReadCache(fp);
+    if (!cache)
+    {
+      botimport.FS_FCloseFile(fp);
+      return qfalse;
+    } //end if
     clusterareanum = AAS_ClusterAreaNum(cache->cluster, cache->areanum);
     cache->next = aasworld.clusterareacache[cache->cluster][clusterareanum];
     cache->prev = NULL;
@@ -1269,10 +1768,12 @@ void AAS_InitRouting(void)
   numportalcacheupdates = 0;
 #endif //ROUTING_DEBUG
   //
-  routingcachesize = 0;
   max_routingcachesize = 1024 * (int) LibVarValue("max_routingcache", "4096");
+  AAS_InitRoutingCachePool(max_routingcachesize);
   // read any routing cache if available
   AAS_ReadRouteCache();
+  // map the portal tables if available
+  AAS_LoadPortalTables();
 } //end of the function AAS_InitRouting
 //===========================================================================
 //
@@ -1286,6 +1787,12 @@ void AAS_FreeRoutingCaches(void)
   AAS_FreeAllClusterAreaCache();
   // free all the existing portal cache
   AAS_FreeAllPortalCache();
+  // free the memory the routing cache lived in
+  AAS_FreeRoutingCachePool();
+  // free the recorded route queries
+  AAS_RecordRouteQueries(0);
+  // unmap the portal tables
+  AAS_FreePortalTables();
   // free cached travel times within areas
   if (aasworld.areatraveltimes)
     FreeMemory(aasworld.areatraveltimes);
@@ -1305,6 +1812,17 @@ void AAS_FreeRoutingCaches(void)
   if (aasworld.portalupdate)
     FreeMemory(aasworld.portalupdate);
   aasworld.portalupdate = NULL;
+  // free the area search
+  if (areasearch)
+    FreeMemory(areasearch);
+  areasearch = NULL;
+  if (searchheap)
+    FreeMemory(searchheap);
+  searchheap = NULL;
+  if (searchgoalnext)
+    FreeMemory(searchgoalnext);
+  searchgoalnext = NULL;
+  maxsearchgoals = 0;
   // free lists with areas the reachabilities go through
   if (aasworld.reachabilityareas)
     FreeMemory(aasworld.reachabilityareas);
@@ -1448,13 +1966,14 @@ aas_routingcache_t *AAS_GetAreaRoutingCache(int clusternum, int areanum, int tra
 {
   int clusterareanum;
   aas_routingcache_t *cache, *clustercache;
+  std::unique_lock<std::recursive_mutex> lock(aasroutinglock, std::defer_lock);
 
+  if (BotThreadedThink())
+    lock.lock();
   //number of the area in the cluster
   clusterareanum = AAS_ClusterAreaNum(clusternum, areanum);
-  //pointer to the cache for the area in the cluster
-  clustercache = aasworld.clusterareacache[clusternum][clusterareanum];
   //find the cache without undesired travel flags
-  for (cache = clustercache; cache; cache = cache->next)
+  for (cache = aasworld.clusterareacache[clusternum][clusterareanum]; cache; cache = cache->next)
   {
     //if there aren't used any undesired travel types for the cache
     if (cache->travelflags == travelflags)
@@ -1463,12 +1982,16 @@ aas_routingcache_t *AAS_GetAreaRoutingCache(int clusternum, int areanum, int tra
   //if there was no cache
   if (!cache)
   {
-    cache = AAS_AllocRoutingCache(aasworld.clusters[clusternum].numreachabilityareas);
-    cache->cluster = clusternum;
+    cacheshards[clusternum].misses++;
+    routingcachestats.misses++;
+    //allocating may evict caches of this area
+    cache = AAS_AllocRoutingCache(clusternum);
     cache->areanum = areanum;
     VectorCopy(aasworld.areas[areanum].center, cache->origin);
     cache->starttraveltime = 1;
     cache->travelflags = travelflags;
+    //pointer to the cache for the area in the cluster
+    clustercache = aasworld.clusterareacache[clusternum][clusterareanum];
     cache->prev = NULL;
     cache->next = clustercache;
     if (clustercache)
@@ -1478,11 +2001,13 @@ aas_routingcache_t *AAS_GetAreaRoutingCache(int clusternum, int areanum, int tra
   } //end if
   else
   {
-    AAS_UnlinkCache(cache);
+    cacheshards[clusternum].hits++;
+    routingcachestats.hits++;
   } //end else
   //the cache has been accessed
+  AAS_UnlinkCache(cache);
   cache->time = AAS_RoutingTime();
-  cache->type = CACHETYPE_AREA;
+  cache->query = routingquery;
   AAS_LinkCache(cache);
   return cache;
 } //end of the function AAS_GetAreaRoutingCache
@@ -1492,31 +2017,23 @@ aas_routingcache_t *AAS_GetAreaRoutingCache(int clusternum, int areanum, int tra
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
-void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
+void AAS_PortalRoutingFlood(unsigned short int *traveltimes, int clusternum, int areanum, int starttraveltime,
+                            int travelflags)
 {
-  int i, portalnum, clusterareanum, clusternum;
+  int i, portalnum, clusterareanum;
   unsigned short int t;
   aas_portal_t *portal;
   aas_cluster_t *cluster;
   aas_routingcache_t *cache;
   aas_routingupdate_t *updateliststart, *updatelistend, *curupdate, *nextupdate;
 
-#ifdef ROUTING_DEBUG
-  numportalcacheupdates++;
-#endif //ROUTING_DEBUG
   //clear the routing update fields
   //	Com_Memset(aasworld.portalupdate, 0, (aasworld.numportals+1) * sizeof(aas_routingupdate_t));
   //
   curupdate = &aasworld.portalupdate[aasworld.numportals];
-  curupdate->cluster = portalcache->cluster;
-  curupdate->areanum = portalcache->areanum;
-  curupdate->tmptraveltime = portalcache->starttraveltime;
-  //if the start area is a cluster portal, store the travel time for that portal
-  clusternum = aasworld.areasettings[portalcache->areanum].cluster;
-  if (clusternum < 0)
-  {
-    portalcache->traveltimes[-clusternum] = portalcache->starttraveltime;
-  } //end if
+  curupdate->cluster = clusternum;
+  curupdate->areanum = areanum;
+  curupdate->tmptraveltime = starttraveltime;
   //put the area to start with in the current read list
   curupdate->next = NULL;
   curupdate->prev = NULL;
@@ -1537,7 +2054,7 @@ void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
     //
     cluster = &aasworld.clusters[curupdate->cluster];
     //
-    cache = AAS_GetAreaRoutingCache(curupdate->cluster, curupdate->areanum, portalcache->travelflags);
+    cache = AAS_GetAreaRoutingCache(curupdate->cluster, curupdate->areanum, travelflags);
     //take all portals of the cluster
     for (i = 0; i < cluster->numportals; i++)
     {
@@ -1556,9 +2073,9 @@ void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
         continue;
       t += curupdate->tmptraveltime;
       //
-      if (!portalcache->traveltimes[portalnum] || portalcache->traveltimes[portalnum] > t)
+      if (!traveltimes[portalnum] || traveltimes[portalnum] > t)
       {
-        portalcache->traveltimes[portalnum] = t;
+        traveltimes[portalnum] = t;
         nextupdate = &aasworld.portalupdate[portalnum];
         if (portal->frontcluster == curupdate->cluster)
         {
@@ -1588,8 +2105,266 @@ void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
       } //end if
     } //end for
   } //end while
+} //end of the function AAS_PortalRoutingFlood
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
+{
+  int clusternum;
+
+#ifdef ROUTING_DEBUG
+  numportalcacheupdates++;
+#endif //ROUTING_DEBUG
+  //if the start area is a cluster portal, store the travel time for that portal
+  clusternum = aasworld.areasettings[portalcache->areanum].cluster;
+  if (clusternum < 0)
+  {
+    portalcache->traveltimes[-clusternum] = portalcache->starttraveltime;
+  } //end if
+  AAS_PortalRoutingFlood(portalcache->traveltimes, portalcache->cluster, portalcache->areanum,
+                         portalcache->starttraveltime, portalcache->travelflags);
 } //end of the function AAS_UpdatePortalRoutingCache
 //===========================================================================
+// builds the portal routing cache from the portal tables, returns qfalse
+// if there's no table for the travel flags
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+int AAS_PortalRoutingCacheFromTable(aas_routingcache_t *portalcache)
+{
+  int i, j, portalnum, clusterareanum, clusternum;
+  unsigned short int t, seed;
+  const unsigned short int *table, *row;
+  aas_portal_t *portal;
+  aas_cluster_t *cluster;
+  aas_routingcache_t *areacache;
+
+  //the tables don't know about disabled areas
+  if (!portaltables || numdisabledareas)
+    return qfalse;
+  for (i = 0; i < portaltables->numtables; i++)
+  {
+    if (portaltables->travelflags[i] == portalcache->travelflags)
+      break;
+  } //end for
+  if (i >= portaltables->numtables)
+    return qfalse;
+  table = (const unsigned short int *) ((const byte *) portaltables + portaltables->tableofs[i]);
+  //if the goal area is a cluster portal, store the travel time for that portal
+  clusternum = aasworld.areasettings[portalcache->areanum].cluster;
+  if (clusternum < 0)
+  {
+    portalcache->traveltimes[-clusternum] = portalcache->starttraveltime;
+  } //end if
+  //the travel times from the portals of the goal cluster to the goal area
+  cluster = &aasworld.clusters[portalcache->cluster];
+  areacache = AAS_GetAreaRoutingCache(portalcache->cluster, portalcache->areanum, portalcache->travelflags);
+  for (i = 0; i < cluster->numportals; i++)
+  {
+    portalnum = aasworld.portalindex[cluster->firstportal + i];
+    portal = &aasworld.portals[portalnum];
+    if (portal->areanum == portalcache->areanum)
+      continue;
+    //
+    clusterareanum = AAS_ClusterAreaNum(portalcache->cluster, portal->areanum);
+    if (clusterareanum >= cluster->numreachabilityareas)
+      continue;
+    //
+    t = areacache->traveltimes[clusterareanum];
+    if (!t)
+      continue;
+    t += portalcache->starttraveltime;
+    if (!portalcache->traveltimes[portalnum] || portalcache->traveltimes[portalnum] > t)
+      portalcache->traveltimes[portalnum] = t;
+    //the travel times of all the portals to this one when leaving it away from the goal cluster
+    seed = t + aasworld.portalmaxtraveltimes[portalnum];
+    row = table + (portalnum * 2 + (portal->frontcluster == portalcache->cluster)) * aasworld.numportals;
+    for (j = 0; j < aasworld.numportals; j++)
+    {
+      if (!row[j])
+        continue;
+      t = row[j] + seed;
+      if (!portalcache->traveltimes[j] || portalcache->traveltimes[j] > t)
+        portalcache->traveltimes[j] = t;
+    } //end for
+  } //end for
+  routingcachestats.portaltables++;
+  return qtrue;
+} //end of the function AAS_PortalRoutingCacheFromTable
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_FreePortalTables(void)
+{
+  if (portaltablecopy)
+    FreeMemory(portaltablecopy);
+  else if (portaltables)
+    botimport.FS_UnmapFile(portaltables);
+  portaltablecopy = NULL;
+  portaltables = NULL;
+} //end of the function AAS_FreePortalTables
+//===========================================================================
+// maps the portal tables of the map if they match the AAS file
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_LoadPortalTables(void)
+{
+  int i, tablesize;
+  long length;
+  char filename[MAX_QPATH];
+  const void *data;
+  const portaltableheader_t *header;
+
+  AAS_FreePortalTables();
+  numdisabledareas = 0;
+  for (i = 0; i < aasworld.numareas; i++)
+  {
+    if (aasworld.areasettings[i].areaflags & AREA_DISABLED)
+      numdisabledareas++;
+  } //end for
+  //
+  Com_sprintf(filename, MAX_QPATH, "maps/%s.ptt", aasworld.mapname);
+  length = botimport.FS_MapFile(filename, &data);
+  if (length < 0)
+    return;
+  header = (const portaltableheader_t *) data;
+  tablesize = aasworld.numportals * 2 * aasworld.numportals * sizeof(unsigned short int);
+  if (length < (long) sizeof(portaltableheader_t) || header->ident != PTID || header->version != PTVERSION
+      || header->numareas != aasworld.numareas || header->numportals != aasworld.numportals
+      || header->numclusters != aasworld.numclusters
+      || header->areacrc != CRC_ProcessString((unsigned char *) aasworld.areas, sizeof(aas_area_t) * aasworld.numareas)
+      || header->clustercrc != CRC_ProcessString((unsigned char *) aasworld.clusters, sizeof(aas_cluster_t) * aasworld.numclusters)
+      || header->numtables < 0 || header->numtables > MAX_PORTALTABLES)
+  {
+    botimport.Print(PRT_WARNING, "%s doesn't match the AAS file\n", filename);
+    botimport.FS_UnmapFile(data);
+    return;
+  } //end if
+  for (i = 0; i < header->numtables; i++)
+  {
+    if (header->tableofs[i] < (int) sizeof(portaltableheader_t) || (header->tableofs[i] & 1)
+        || header->tableofs[i] > length - tablesize)
+    {
+      botimport.Print(PRT_WARNING, "%s is truncated\n", filename);
+      botimport.FS_UnmapFile(data);
+      return;
+    } //end if
+  } //end for
+  //a file in a pk3 may not be aligned
+  if ((intptr_t) data & (sizeof(int) - 1))
+  {
+    portaltablecopy = GetMemory(length);
+    Com_Memcpy(portaltablecopy, data, length);
+    botimport.FS_UnmapFile(data);
+    data = portaltablecopy;
+  } //end if
+  portaltables = (const portaltableheader_t *) data;
+} //end of the function AAS_LoadPortalTables
+//===========================================================================
+// calculates the travel times between all the portals for the travel flags
+// of the portal caches in use and writes them to maps/<mapname>.ptt
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_WritePortalTables(void)
+{
+  int i, portalnum, side, numtables, travelflags[MAX_PORTALTABLES], tablesize;
+  unsigned short int *row;
+  char filename[MAX_QPATH];
+  aas_routingcache_t *cache;
+  aas_portal_t *portal;
+  portaltableheader_t header;
+  fileHandle_t fp;
+
+  if (numdisabledareas)
+  {
+    botimport.Print(PRT_WARNING, "can't calculate the portal tables while %d areas are disabled\n", numdisabledareas);
+    return;
+  } //end if
+  //the travel flags the bots route with on this map
+  numtables = 0;
+  travelflags[numtables++] = TFL_DEFAULT;
+  for (cache = aasworld.oldestcache; cache && numtables < MAX_PORTALTABLES; cache = cache->time_next)
+  {
+    if (cache->type != CACHETYPE_PORTAL)
+      continue;
+    for (i = 0; i < numtables; i++)
+    {
+      if (travelflags[i] == cache->travelflags)
+        break;
+    } //end for
+    if (i >= numtables)
+      travelflags[numtables++] = cache->travelflags;
+  } //end for
+  //
+  tablesize = aasworld.numportals * 2 * aasworld.numportals * sizeof(unsigned short int);
+  Com_Memset(&header, 0, sizeof(portaltableheader_t));
+  header.ident = PTID;
+  header.version = PTVERSION;
+  header.numareas = aasworld.numareas;
+  header.numportals = aasworld.numportals;
+  header.numclusters = aasworld.numclusters;
+  header.areacrc = CRC_ProcessString((unsigned char *) aasworld.areas, sizeof(aas_area_t) * aasworld.numareas);
+  header.clustercrc = CRC_ProcessString((unsigned char *) aasworld.clusters, sizeof(aas_cluster_t) * aasworld.numclusters);
+  header.numtables = numtables;
+  for (i = 0; i < numtables; i++)
+  {
+    header.travelflags[i] = travelflags[i];
+    header.tableofs[i] = sizeof(portaltableheader_t) + i * tablesize;
+  } //end for
+  //the file may be mapped right now
+  AAS_FreePortalTables();
+  Com_sprintf(filename, MAX_QPATH, "maps/%s.ptt", aasworld.mapname);
+  botimport.FS_FOpenFile(filename, &fp, FS_WRITE);
+  if (!fp)
+  {
+    AAS_Error("Unable to open file: %s\n", filename);
+    return;
+  } //end if
+  botimport.FS_Write(&header, sizeof(portaltableheader_t), fp);
+  row = (unsigned short int *) GetMemory(aasworld.numportals * sizeof(unsigned short int));
+  for (i = 0; i < numtables; i++)
+  {
+    for (portalnum = 0; portalnum < aasworld.numportals; portalnum++)
+    {
+      portal = &aasworld.portals[portalnum];
+      for (side = 0; side < 2; side++)
+      {
+        //the travel times of all portals to this one when leaving it into the front or back cluster
+        Com_Memset(row, 0, aasworld.numportals * sizeof(unsigned short int));
+        if (portalnum)
+        {
+          //the area caches of earlier floods may go
+          routingquery++;
+          if (numheapcaches)
+            AAS_FreeHeapRoutingCaches();
+          AAS_PortalRoutingFlood(row, side ? portal->backcluster : portal->frontcluster, portal->areanum, 0, travelflags[i]);
+        } //end if
+        botimport.FS_Write(row, aasworld.numportals * sizeof(unsigned short int), fp);
+      } //end for
+    } //end for
+  } //end for
+  FreeMemory(row);
+  botimport.FS_FCloseFile(fp);
+  botimport.Print(PRT_MESSAGE, "%d portal tables of %d portals written to %s\n", numtables, aasworld.numportals, filename);
+  //
+  AAS_LoadPortalTables();
+} //end of the function AAS_WritePortalTables
+//===========================================================================
 //
 // Parameter:			-
 // Returns:				-
@@ -1598,7 +2373,10 @@ void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
 aas_routingcache_t *AAS_GetPortalRoutingCache(int clusternum, int areanum, int travelflags)
 {
   aas_routingcache_t *cache;
+  std::unique_lock<std::recursive_mutex> lock(aasroutinglock, std::defer_lock);
 
+  if (BotThreadedThink())
+    lock.lock();
   //find the cached portal routing if existing
   for (cache = aasworld.portalcache[areanum]; cache; cache = cache->next)
   {
@@ -1608,7 +2386,9 @@ aas_routingcache_t *AAS_GetPortalRoutingCache(int clusternum, int areanum, int t
   //if the portal routing isn't cached
   if (!cache)
   {
-    cache = AAS_AllocRoutingCache(aasworld.numportals);
+    cacheshards[0].misses++;
+    routingcachestats.misses++;
+    cache = AAS_AllocRoutingCache(0);
     cache->cluster = clusternum;
     cache->areanum = areanum;
     VectorCopy(aasworld.areas[areanum].center, cache->origin);
@@ -1621,19 +2401,116 @@ aas_routingcache_t *AAS_GetPortalRoutingCache(int clusternum, int areanum, int t
       aasworld.portalcache[areanum]->prev = cache;
     aasworld.portalcache[areanum] = cache;
     //update the cache
-    AAS_UpdatePortalRoutingCache(cache);
+    if (!AAS_PortalRoutingCacheFromTable(cache))
+      AAS_UpdatePortalRoutingCache(cache);
   } //end if
   else
   {
-    AAS_UnlinkCache(cache);
+    cacheshards[0].hits++;
+    routingcachestats.hits++;
   } //end else
   //the cache has been accessed
+  AAS_UnlinkCache(cache);
   cache->time = AAS_RoutingTime();
-  cache->type = CACHETYPE_PORTAL;
+  cache->query = routingquery;
   AAS_LinkCache(cache);
   return cache;
 } //end of the function AAS_GetPortalRoutingCache
 //===========================================================================
+// called for every route query, caches used by earlier queries may be
+// evicted again from here on
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_StartRouteQuery(int areanum, vec3_t origin, int goalareanum, int travelflags)
+{
+  aas_routequery_t *query;
+  std::unique_lock<std::recursive_mutex> lock(aasroutinglock, std::defer_lock);
+
+  if (BotThreadedThink())
+    lock.lock();
+  else
+  {
+    routingquery++;
+    //the caches allocated on the heap while the bots thought on several threads go first
+    if (numheapcaches)
+      AAS_FreeHeapRoutingCaches();
+  } //end else
+  routingcachestats.queries++;
+  if (numroutequeries < maxroutequeries)
+  {
+    query = &routequeries[numroutequeries++];
+    query->areanum = areanum;
+    VectorCopy(origin, query->origin);
+    query->goalareanum = goalareanum;
+    query->travelflags = travelflags;
+  } //end if
+} //end of the function AAS_StartRouteQuery
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_RecordRouteQueries(int maxqueries)
+{
+  if (routequeries)
+    FreeMemory(routequeries);
+  routequeries = NULL;
+  numroutequeries = 0;
+  maxroutequeries = 0;
+  if (maxqueries <= 0)
+    return;
+  routequeries = (aas_routequery_t *) GetMemory(maxqueries * sizeof(aas_routequery_t));
+  maxroutequeries = maxqueries;
+} //end of the function AAS_RecordRouteQueries
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_FlushRoutingCache(void)
+{
+  while (aasworld.oldestcache)
+  {
+    AAS_EvictRoutingCache(aasworld.oldestcache);
+  } //end while
+} //end of the function AAS_FlushRoutingCache
+//===========================================================================
+// replays the recorded route queries on an empty routing cache of the
+// given size, afterwards the routing cache is empty again
+//
+// Parameter:			budget: size of the routing cache in bytes
+// Returns:				number of queries replayed
+// Changes Globals:		-
+//===========================================================================
+int AAS_ReplayRouteQueries(int budget, aas_routecachestats_t *stats)
+{
+  int i, maxqueries;
+  aas_routequery_t *query;
+
+  if (!aasworld.initialized || BotThreadedThink())
+    return 0;
+  //don't record the replay
+  maxqueries = maxroutequeries;
+  maxroutequeries = 0;
+  AAS_FlushRoutingCache();
+  AAS_InitRoutingCachePool(budget);
+  for (i = 0; i < numroutequeries; i++)
+  {
+    query = &routequeries[i];
+    AAS_AreaTravelTimeToGoalArea(query->areanum, query->origin, query->goalareanum, query->travelflags);
+  } //end for
+  *stats = routingcachestats;
+  AAS_FlushRoutingCache();
+  AAS_InitRoutingCachePool(max_routingcachesize);
+  maxroutequeries = maxqueries;
+  return numroutequeries;
+} //end of the function AAS_ReplayRouteQueries
+//===========================================================================
 //
 // Parameter:			-
 // Returns:				-
@@ -1674,12 +2551,8 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
     } //end if
     return qfalse;
   } //end if
-  // make sure the routing cache doesn't grow to large
-  while (AvailableMemory() < 1 * 1024 * 1024)
-  {
-    if (!AAS_FreeOldestCache())
-      break;
-  }
+  //
+  AAS_StartRouteQuery(areanum, origin, goalareanum, travelflags);
   //
   if (AAS_AreaDoNotEnter(areanum) || AAS_AreaDoNotEnter(goalareanum))
   {
@@ -1840,6 +2713,253 @@ int AAS_AreaTravelTimeToGoalArea(int areanum, vec3_t origin, int goalareanum, in
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
+aas_areasearch_t *AAS_AreaSearchState(int areanum)
+{
+  aas_areasearch_t *state;
+
+  state = &areasearch[areanum];
+  if (state->search != areasearchnum)
+  {
+    state->search = areasearchnum;
+    state->traveltime = 0;
+    state->goal = -1;
+    state->settled = qfalse;
+  } //end if
+  return state;
+} //end of the function AAS_AreaSearchState
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_PushSearchArea(int areanum, int traveltime)
+{
+  int i, parent;
+
+  i = numsearchnodes++;
+  //move the area up the heap
+  while (i > 0)
+  {
+    parent = (i - 1) >> 1;
+    if (searchheap[parent].traveltime <= traveltime)
+      break;
+    searchheap[i] = searchheap[parent];
+    i = parent;
+  } //end while
+  searchheap[i].traveltime = traveltime;
+  searchheap[i].areanum = areanum;
+} //end of the function AAS_PushSearchArea
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				the area with the shortest travel time, 0 if none left
+// Changes Globals:		-
+//===========================================================================
+int AAS_PopSearchArea(int *traveltime)
+{
+  int i, child, areanum;
+  aas_searchnode_t last;
+
+  if (!numsearchnodes)
+    return 0;
+  areanum = searchheap[0].areanum;
+  *traveltime = searchheap[0].traveltime;
+  last = searchheap[--numsearchnodes];
+  //move the last area down the heap
+  i = 0;
+  while ((child = (i << 1) + 1) < numsearchnodes)
+  {
+    if (child + 1 < numsearchnodes && searchheap[child + 1].traveltime < searchheap[child].traveltime)
+      child++;
+    if (last.traveltime <= searchheap[child].traveltime)
+      break;
+    searchheap[i] = searchheap[child];
+    i = child;
+  } //end while
+  searchheap[i] = last;
+  return areanum;
+} //end of the function AAS_PopSearchArea
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_StartAreaSearch(int areanum, vec3_t origin)
+{
+  aas_areasearch_t *state;
+
+  areasearchnum++;
+  //the area search states are reset when the search number wraps around
+  if (!areasearchnum)
+  {
+    Com_Memset(areasearch, 0, aasworld.numareas * sizeof(aas_areasearch_t));
+    areasearchnum = 1;
+  } //end if
+  numsearchnodes = 0;
+  //
+  state = AAS_AreaSearchState(areanum);
+  //same as the travel time towards the area the bot is in
+  state->traveltime = 1;
+  if (origin)
+    VectorCopy(origin, state->start);
+  else
+    VectorCopy(aasworld.areas[areanum].center, state->start);
+  AAS_PushSearchArea(areanum, state->traveltime);
+} //end of the function AAS_StartAreaSearch
+//===========================================================================
+// calculates the travel times from the area towards all the goal areas
+// with one search that visits the areas in order of travel time
+// the search stops when all goals are reached, when the travel time gets
+// above maxtraveltime or when none of the goals that are left can have a
+// higher weight / travel time than the best goal reached so far
+// (the goals with a weight of zero or less never stop the search)
+//
+// Parameter:			areanum, origin: start of the search
+//						goals: goal areas, travel times are stored in the goals
+//						maxtraveltime: maximum travel time, 0 for no maximum
+// Returns:				number of goals reached
+// Changes Globals:		-
+//===========================================================================
+int AAS_AreaTravelTimesToGoalAreas(int areanum, vec3_t origin, aas_goaltraveltime_t *goals, int numgoals,
+                                   int travelflags, int maxtraveltime)
+{
+  int i, numreach, nextareanum, badtravelflags, t, traveltime, numleft, numreached, goalnum;
+  float bestweight, maxweight;
+  aas_areasearch_t *state, *nextstate;
+  aas_reachability_t *reach;
+  std::unique_lock<std::recursive_mutex> lock(aasroutinglock, std::defer_lock);
+
+  for (i = 0; i < numgoals; i++)
+    goals[i].traveltime = 0;
+  //
+  if (!aasworld.initialized)
+    return 0;
+  if (areanum <= 0 || areanum >= aasworld.numareas)
+  {
+    if (botDeveloper)
+    {
+      botimport.Print(PRT_ERROR, "AAS_AreaTravelTimesToGoalAreas: areanum %d out of range\n", areanum);
+    } //end if
+    return 0;
+  } //end if
+  //the area search state is shared
+  if (BotThreadedThink())
+    lock.lock();
+  //
+  if (numgoals > maxsearchgoals)
+  {
+    if (searchgoalnext)
+      FreeMemory(searchgoalnext);
+    maxsearchgoals = numgoals;
+    searchgoalnext = (int *) GetMemory(maxsearchgoals * sizeof(int));
+  } //end if
+  //
+  AAS_StartAreaSearch(areanum, origin);
+  //link the goals into their areas
+  numleft = 0;
+  maxweight = 0;
+  for (i = 0; i < numgoals; i++)
+  {
+    if (goals[i].areanum <= 0 || goals[i].areanum >= aasworld.numareas)
+      continue;
+    state = AAS_AreaSearchState(goals[i].areanum);
+    searchgoalnext[i] = state->goal;
+    state->goal = i;
+    if (goals[i].weight > maxweight)
+      maxweight = goals[i].weight;
+    numleft++;
+  } //end for
+  //
+  if (AAS_AreaDoNotEnter(areanum))
+    travelflags |= TFL_DONOTENTER;
+  badtravelflags = ~travelflags;
+  bestweight = 0;
+  numreached = 0;
+  //
+  while (numleft && (areanum = AAS_PopSearchArea(&traveltime)) != 0)
+  {
+    state = &areasearch[areanum];
+    //skip areas that were reached again sooner
+    if (state->settled || state->traveltime != traveltime)
+      continue;
+    state->settled = qtrue;
+    //
+    if (maxtraveltime && traveltime >= maxtraveltime)
+      break;
+    //none of the goals left can be better than the best goal
+    if (bestweight > 0 && maxweight <= bestweight * traveltime)
+      break;
+    //the goals in this area
+    if (state->goal >= 0)
+    {
+      for (goalnum = state->goal; goalnum >= 0; goalnum = searchgoalnext[goalnum])
+      {
+        goals[goalnum].traveltime = traveltime;
+        numreached++;
+        numleft--;
+        if (goals[goalnum].weight > 0 && traveltime >= goals[goalnum].mintraveltime)
+        {
+          if (goals[goalnum].weight / traveltime > bestweight)
+            bestweight = goals[goalnum].weight / traveltime;
+        } //end if
+      } //end for
+      //the highest weight of the goals left
+      maxweight = 0;
+      for (i = 0; i < numgoals; i++)
+      {
+        if (!goals[i].traveltime && goals[i].weight > maxweight)
+          maxweight = goals[i].weight;
+      } //end for
+      //if the bot isn't allowed to travel through the goal area
+      if (AAS_AreaContentsTravelFlags_inline(areanum) & badtravelflags)
+        continue;
+    } //end if
+    //check all reachability links
+    numreach = aasworld.areasettings[areanum].numreachableareas;
+    reach = &aasworld.reachability[aasworld.areasettings[areanum].firstreachablearea];
+    //
+    for (i = 0; i < numreach; i++, reach++)
+    {
+      //if an undesired travel type is used
+      if (AAS_TravelFlagForType_inline(reach->traveltype) & badtravelflags)
+        continue;
+      //number of the area the reachability leads to
+      nextareanum = reach->areanum;
+      //if not allowed to enter the next area
+      if (aasworld.areasettings[nextareanum].areaflags & AREA_DISABLED)
+        continue;
+      nextstate = AAS_AreaSearchState(nextareanum);
+      if (nextstate->settled)
+        continue;
+      //if the next area has a not allowed travel flag it can only be a goal
+      if (AAS_AreaContentsTravelFlags_inline(nextareanum) & badtravelflags)
+      {
+        if (nextstate->goal < 0 || (AAS_AreaContentsTravelFlags_inline(nextareanum) & badtravelflags) != TFL_DONOTENTER)
+          continue;
+      } //end if
+      //time already travelled plus the traveltime through
+      //the current area plus the travel time from the reachability
+      t = traveltime + AAS_AreaTravelTime(areanum, state->start, reach->start) + reach->traveltime;
+      //
+      if (!nextstate->traveltime || nextstate->traveltime > t)
+      {
+        nextstate->traveltime = t;
+        //remember where we entered this area
+        VectorCopy(reach->end, nextstate->start);
+        AAS_PushSearchArea(nextareanum, t);
+      } //end if
+    } //end for
+  } //end while
+  return numreached;
+} //end of the function AAS_AreaTravelTimesToGoalAreas
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
 int AAS_AreaReachabilityToGoalArea(int areanum, vec3_t origin, int goalareanum, int travelflags)
 {
   int traveltime, reachnum;
@@ -2149,24 +3269,22 @@ float DistancePointToLine(vec3_t v1, vec3_t v2, vec3_t point)
 int AAS_NearestHideArea(int srcnum, vec3_t origin, int areanum, int enemynum, vec3_t enemyorigin, int enemyareanum,
                         int travelflags)
 {
-  int i, j, nextareanum, badtravelflags, numreach, bestarea;
-  unsigned short int t, besttraveltime;
-  static unsigned short int *hidetraveltimes;
-  aas_routingupdate_t *updateliststart, *updatelistend, *curupdate, *nextupdate;
+  int i, j, nextareanum, badtravelflags, numreach, bestarea, t, traveltime, besttraveltime;
+  aas_areasearch_t *state, *nextstate;
   aas_reachability_t *reach;
   float dist1, dist2;
   vec3_t v1, v2, p;
   qboolean startVisible;
+  std::unique_lock<std::recursive_mutex> lock(aasroutinglock, std::defer_lock);
 
+  if (!aasworld.initialized)
+    return 0;
+  if (areanum <= 0 || areanum >= aasworld.numareas)
+    return 0;
+  //the area search state is shared
+  if (BotThreadedThink())
+    lock.lock();
   //
-  if (!hidetraveltimes)
-  {
-    hidetraveltimes = (unsigned short int *) GetClearedMemory(aasworld.numareas * sizeof(unsigned short int));
-  } //end if
-  else
-  {
-    Com_Memset(hidetraveltimes, 0, aasworld.numareas * sizeof(unsigned short int));
-  } //end else
   besttraveltime = 0;
   bestarea = 0;
   //assume visible
@@ -2174,31 +3292,21 @@ int AAS_NearestHideArea(int srcnum, vec3_t origin, int areanum, int enemynum, ve
   //
   badtravelflags = ~travelflags;
   //
-  curupdate = &aasworld.areaupdate[areanum];
-  curupdate->areanum = areanum;
-  VectorCopy(origin, curupdate->start);
-  curupdate->areatraveltimes = aasworld.areatraveltimes[areanum][0];
-  curupdate->tmptraveltime = 0;
-  //put the area to start with in the current read list
-  curupdate->next = NULL;
-  curupdate->prev = NULL;
-  updateliststart = curupdate;
-  updatelistend = curupdate;
-  //while there are updates in the list
-  while (updateliststart)
+  AAS_StartAreaSearch(areanum, origin);
+  //visit the areas in order of travel time
+  while ((areanum = AAS_PopSearchArea(&traveltime)) != 0)
   {
-    curupdate = updateliststart;
-    //
-    if (curupdate->next)
-      curupdate->next->prev = NULL;
-    else
-      updatelistend = NULL;
-    updateliststart = curupdate->next;
-    //
-    curupdate->inlist = qfalse;
-    //check all reversed reachability links
-    numreach = aasworld.areasettings[curupdate->areanum].numreachableareas;
-    reach = &aasworld.reachability[aasworld.areasettings[curupdate->areanum].firstreachablearea];
+    state = &areasearch[areanum];
+    //skip areas that were reached again sooner
+    if (state->settled || state->traveltime != traveltime)
+      continue;
+    state->settled = qtrue;
+    //all areas left are further away than the best hide area
+    if (besttraveltime && traveltime >= besttraveltime)
+      break;
+    //check all reachability links
+    numreach = aasworld.areasettings[areanum].numreachableareas;
+    reach = &aasworld.reachability[aasworld.areasettings[areanum].firstreachablearea];
     //
     for (i = 0; i < numreach; i++, reach++)
     {
@@ -2213,14 +3321,18 @@ int AAS_NearestHideArea(int srcnum, vec3_t origin, int areanum, int enemynum, ve
       // if this moves us into the enemies area, skip it
       if (nextareanum == enemyareanum)
         continue;
+      //
+      nextstate = AAS_AreaSearchState(nextareanum);
+      if (nextstate->settled)
+        continue;
       //time already travelled plus the traveltime through
       //the current area plus the travel time from the reachability
-      t = curupdate->tmptraveltime + AAS_AreaTravelTime(curupdate->areanum, curupdate->start, reach->start) + reach->traveltime;
+      t = traveltime + AAS_AreaTravelTime(areanum, state->start, reach->start) + reach->traveltime;
 
       //avoid going near the enemy
-      AAS_ProjectPointOntoVector(enemyorigin, curupdate->start, reach->end, p);
+      AAS_ProjectPointOntoVector(enemyorigin, state->start, reach->end, p);
       for (j = 0; j < 3; j++)
-        if ((p[j] > curupdate->start[j] && p[j] > reach->end[j]) || (p[j] < curupdate->start[j] && p[j] < reach->end[j]))
+        if ((p[j] > state->start[j] && p[j] > reach->end[j]) || (p[j] < state->start[j] && p[j] < reach->end[j]))
           break;
       if (j < 3)
       {
@@ -2235,7 +3347,7 @@ int AAS_NearestHideArea(int srcnum, vec3_t origin, int areanum, int enemynum, ve
       if (dist2 < 40)
         continue;
       //
-      VectorSubtract(enemyorigin, curupdate->start, v1);
+      VectorSubtract(enemyorigin, state->start, v1);
       dist1 = VectorLength(v1);
       //
       if (dist2 < dist1)
@@ -2251,7 +3363,7 @@ int AAS_NearestHideArea(int srcnum, vec3_t origin, int areanum, int enemynum, ve
       if (besttraveltime && t >= besttraveltime)
         continue;
       //
-      if (!hidetraveltimes[nextareanum] || hidetraveltimes[nextareanum] > t)
+      if (!nextstate->traveltime || nextstate->traveltime > t)
       {
         //if the nextarea is not visible from the enemy area
         if (!AAS_AreaVisible(enemyareanum, nextareanum))
@@ -2259,25 +3371,10 @@ int AAS_NearestHideArea(int srcnum, vec3_t origin, int areanum, int enemynum, ve
           besttraveltime = t;
           bestarea = nextareanum;
         } //end if
-        hidetraveltimes[nextareanum] = t;
-        nextupdate = &aasworld.areaupdate[nextareanum];
-        nextupdate->areanum = nextareanum;
-        nextupdate->tmptraveltime = t;
+        nextstate->traveltime = t;
         //remember where we entered this area
-        VectorCopy(reach->end, nextupdate->start);
-        //if this update is not in the list yet
-        if (!nextupdate->inlist)
-        {
-          //add the new update to the end of the list
-          nextupdate->next = NULL;
-          nextupdate->prev = updatelistend;
-          if (updatelistend)
-            updatelistend->next = nextupdate;
-          else
-            updateliststart = nextupdate;
-          updatelistend = nextupdate;
-          nextupdate->inlist = qtrue;
-        } //end if
+        VectorCopy(reach->end, nextstate->start);
+        AAS_PushSearchArea(nextareanum, t);
       } //end if
     } //end for
   } //end while
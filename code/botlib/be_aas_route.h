@@ -40,6 +40,9 @@ unsigned short int AAS_AreaTravelTime(int areanum, vec3_t start, vec3_t end);
 //
 void AAS_CreateAllRoutingCache(void);
 void AAS_WriteRouteCache(void);
+void AAS_WritePortalTables(void);
+void AAS_LoadPortalTables(void);
+void AAS_FreePortalTables(void);
 //
 void AAS_RoutingInfo(void);
 #endif //AASINTERN
@@ -60,9 +63,16 @@ int AAS_EnableRoutingArea(int areanum, int enable);
 unsigned short int AAS_AreaTravelTime(int areanum, vec3_t start, vec3_t end);
 //returns the travel time from the area to the goal area using the given travel flags
 int AAS_AreaTravelTimeToGoalArea(int areanum, vec3_t origin, int goalareanum, int travelflags);
+//calculates the travel times from the area towards all the goal areas at once
+int AAS_AreaTravelTimesToGoalAreas(int areanum, vec3_t origin, struct aas_goaltraveltime_s *goals, int numgoals,
+							int travelflags, int maxtraveltime);
 //predict a route up to a stop event
 int AAS_PredictRoute(struct aas_predictroute_s *route, int areanum, vec3_t origin,
 							int goalareanum, int travelflags, int maxareas, int maxtime,
 							int stopevent, int stopcontents, int stoptfl, int stopareanum);
+//record up to maxqueries route queries for AAS_ReplayRouteQueries, 0 stops recording
+void AAS_RecordRouteQueries(int maxqueries);
+//replay the recorded route queries on an empty routing cache of the given budget in bytes
+int AAS_ReplayRouteQueries(int budget, struct aas_routecachestats_s *stats);
 
 
@@ -44,6 +44,7 @@
 #include "be_interface.h"
 #include "be_ea.h"
 #include "be_ai_chat.h"
+#include "be_threads.h"
 
 //escape character
 #define ESCAPE_CHAR				0x01	//'_'
@@ -2566,7 +2567,7 @@ char *BotChooseInitialChatMessage(bot_chatstate_t *cs, char *type)
             continue;
           if (--n < 0)
           {
-            m->time = AAS_Time() + CHATMESSAGE_RECENTTIME;
+            BotSetSharedFloat(&m->time, AAS_Time() + CHATMESSAGE_RECENTTIME);
             return m->chatmessage;
           }
         }
@@ -2919,7 +2920,7 @@ int BotReplyChat(int chatstate, char *message, int mcontext, int vcontext, char
     }
     else
     {
-      bestchatmessage->time = AAS_Time() + CHATMESSAGE_RECENTTIME;
+      BotSetSharedFloat(&bestchatmessage->time, AAS_Time() + CHATMESSAGE_RECENTTIME);
       BotConstructChatMessage(cs, bestchatmessage->chatmessage, mcontext, &bestmatch, vcontext, qtrue);
     }
     return qtrue;
@@ -180,6 +180,10 @@ typedef struct bot_goalstate_s
 	//
 	int avoidgoals[MAX_AVOIDGOALS];				//goals to avoid
 	float avoidgoaltimes[MAX_AVOIDGOALS];		//times to avoid the goals
+	//
+	aas_goaltraveltime_t *itemgoals;			//items to calculate the travel times for
+	levelitem_t **goalitems;					//level item of every item goal
+	int maxitemgoals;
 } bot_goalstate_t;
 
 bot_goalstate_t *botgoalstates[MAX_CLIENTS + 1]; // FIXME: init?
@@ -1353,6 +1357,29 @@ int BotGetSecondGoal(int goalstate, bot_goal_t *goal)
 	return qtrue;
 } //end of the function BotGetSecondGoal
 //===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void BotAllocItemGoals(bot_goalstate_t *gs)
+{
+	int num;
+	levelitem_t *li;
+
+	for (num = 0, li = levelitems; li; li = li->next)
+		num++;
+	if (gs->maxitemgoals >= num)
+		return;
+	if (gs->itemgoals)
+		FreeMemory(gs->itemgoals);
+	if (gs->goalitems)
+		FreeMemory(gs->goalitems);
+	gs->maxitemgoals = num;
+	gs->itemgoals = (aas_goaltraveltime_t *) GetMemory(gs->maxitemgoals * sizeof(aas_goaltraveltime_t));
+	gs->goalitems = (levelitem_t **) GetMemory(gs->maxitemgoals * sizeof(levelitem_t *));
+} //end of the function BotAllocItemGoals
+//===========================================================================
 // pops a new long term goal on the goal stack in the goalstate
 //
 // Parameter:				-
@@ -1361,11 +1388,12 @@ int BotGetSecondGoal(int goalstate, bot_goal_t *goal)
 //===========================================================================
 int BotChooseLTGItem(int goalstate, vec3_t origin, int *inventory, int travelflags)
 {
-	int areanum, t, weightnum;
+	int areanum, t, weightnum, i, numitemgoals;
 	float weight, bestweight, avoidtime;
 	iteminfo_t *iteminfo;
 	itemconfig_t *ic;
 	levelitem_t *li, *bestitem;
+	aas_goaltraveltime_t *itemgoal;
 	bot_goal_t goal;
 	bot_goalstate_t *gs;
 
@@ -1395,6 +1423,9 @@ int BotChooseLTGItem(int goalstate, vec3_t origin, int *inventory, int travelfla
 	bestweight = 0;
 	bestitem = NULL;
 	Com_Memset(&goal, 0, sizeof(bot_goal_t));
+	//room for a goal for every item in the level
+	BotAllocItemGoals(gs);
+	numitemgoals = 0;
 	//go through the items in the level
 	for (li = levelitems; li; li = li->next)
 	{
@@ -1459,23 +1490,35 @@ int BotChooseLTGItem(int goalstate, vec3_t origin, int *inventory, int travelfla
 		//
 		if (weight > 0)
 		{
-			//get the travel time towards the goal area
-			t = AAS_AreaTravelTimeToGoalArea(areanum, origin, li->goalareanum, travelflags);
-			//if the goal is reachable
-			if (t > 0)
+			itemgoal = &gs->itemgoals[numitemgoals];
+			itemgoal->areanum = li->goalareanum;
+			itemgoal->weight = weight;
+			//the item won't respawn before we get there when reached sooner
+			avoidtime = BotAvoidGoalTime(goalstate, li->number);
+			itemgoal->mintraveltime = avoidtime > 0 ? (int) (avoidtime / 0.009) + 1 : 0;
+			gs->goalitems[numitemgoals++] = li;
+		} //end if
+	} //end for
+	//get the travel times towards all the goal areas at once
+	AAS_AreaTravelTimesToGoalAreas(areanum, origin, gs->itemgoals, numitemgoals, travelflags, 0);
+	for (i = 0; i < numitemgoals; i++)
+	{
+		li = gs->goalitems[i];
+		t = gs->itemgoals[i].traveltime;
+		//if the goal is reachable
+		if (t > 0)
+		{
+			//if this item won't respawn before we get there
+			avoidtime = BotAvoidGoalTime(goalstate, li->number);
+			if (avoidtime - t * 0.009 > 0)
+				continue;
+			//
+			weight = gs->itemgoals[i].weight / ((float) t * TRAVELTIME_SCALE);
+			//
+			if (weight > bestweight)
 			{
-				//if this item won't respawn before we get there
-				avoidtime = BotAvoidGoalTime(goalstate, li->number);
-				if (avoidtime - t * 0.009 > 0)
-					continue;
-				//
-				weight /= (float) t * TRAVELTIME_SCALE;
-				//
-				if (weight > bestweight)
-				{
-					bestweight = weight;
-					bestitem = li;
-				} //end if
+				bestweight = weight;
+				bestitem = li;
 			} //end if
 		} //end if
 	} //end for
@@ -1549,11 +1592,12 @@ int BotChooseLTGItem(int goalstate, vec3_t origin, int *inventory, int travelfla
 int BotChooseNBGItem(int goalstate, vec3_t origin, int *inventory, int travelflags,
 														bot_goal_t *ltg, float maxtime)
 {
-	int areanum, t, weightnum, ltg_time;
+	int areanum, t, weightnum, ltg_time, i, numitemgoals;
 	float weight, bestweight, avoidtime;
 	iteminfo_t *iteminfo;
 	itemconfig_t *ic;
 	levelitem_t *li, *bestitem;
+	aas_goaltraveltime_t *itemgoal;
 	bot_goal_t goal;
 	bot_goalstate_t *gs;
 
@@ -1586,6 +1630,9 @@ int BotChooseNBGItem(int goalstate, vec3_t origin, int *inventory, int travelfla
 	bestweight = 0;
 	bestitem = NULL;
 	Com_Memset(&goal, 0, sizeof(bot_goal_t));
+	//room for a goal for every item in the level
+	BotAllocItemGoals(gs);
+	numitemgoals = 0;
 	//go through the items in the level
 	for (li = levelitems; li; li = li->next)
 	{
@@ -1650,32 +1697,44 @@ int BotChooseNBGItem(int goalstate, vec3_t origin, int *inventory, int travelfla
 		//
 		if (weight > 0)
 		{
-			//get the travel time towards the goal area
-			t = AAS_AreaTravelTimeToGoalArea(areanum, origin, li->goalareanum, travelflags);
-			//if the goal is reachable
-			if (t > 0 && t < maxtime)
+			itemgoal = &gs->itemgoals[numitemgoals];
+			itemgoal->areanum = li->goalareanum;
+			itemgoal->weight = weight;
+			//the travel time back to the long term goal decides which item is the best
+			itemgoal->mintraveltime = 99999;
+			gs->goalitems[numitemgoals++] = li;
+		} //end if
+	} //end for
+	//get the travel times towards all the goal areas within the maximum time at once
+	AAS_AreaTravelTimesToGoalAreas(areanum, origin, gs->itemgoals, numitemgoals, travelflags,
+									maxtime >= 1 ? (int) ceil(maxtime) : 1);
+	for (i = 0; i < numitemgoals; i++)
+	{
+		li = gs->goalitems[i];
+		t = gs->itemgoals[i].traveltime;
+		//if the goal is reachable
+		if (t > 0 && t < maxtime)
+		{
+			//if this item won't respawn before we get there
+			avoidtime = BotAvoidGoalTime(goalstate, li->number);
+			if (avoidtime - t * 0.009 > 0)
+				continue;
+			//
+			weight = gs->itemgoals[i].weight / ((float) t * TRAVELTIME_SCALE);
+			//
+			if (weight > bestweight)
 			{
-				//if this item won't respawn before we get there
-				avoidtime = BotAvoidGoalTime(goalstate, li->number);
-				if (avoidtime - t * 0.009 > 0)
-					continue;
-				//
-				weight /= (float) t * TRAVELTIME_SCALE;
-				//
-				if (weight > bestweight)
+				t = 0;
+				if (ltg && !li->timeout)
 				{
-					t = 0;
-					if (ltg && !li->timeout)
-					{
-						//get the travel time from the goal to the long term goal
-						t = AAS_AreaTravelTimeToGoalArea(li->goalareanum, li->goalorigin, ltg->areanum, travelflags);
-					} //end if
-					//if the travel back is possible and doesn't take too long
-					if (t <= ltg_time)
-					{
-						bestweight = weight;
-						bestitem = li;
-					} //end if
+					//get the travel time from the goal to the long term goal
+					t = AAS_AreaTravelTimeToGoalArea(li->goalareanum, li->goalorigin, ltg->areanum, travelflags);
+				} //end if
+				//if the travel back is possible and doesn't take too long
+				if (t <= ltg_time)
+				{
+					bestweight = weight;
+					bestitem = li;
 				} //end if
 			} //end if
 		} //end if
@@ -1880,6 +1939,10 @@ void BotFreeGoalState(int handle)
 		return;
 	} //end if
 	BotFreeItemWeights(handle);
+	if (botgoalstates[handle]->itemgoals)
+		FreeMemory(botgoalstates[handle]->itemgoals);
+	if (botgoalstates[handle]->goalitems)
+		FreeMemory(botgoalstates[handle]->goalitems);
 	FreeMemory(botgoalstates[handle]);
 	botgoalstates[handle] = NULL;
 } //end of the function BotFreeGoalState
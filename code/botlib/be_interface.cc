@@ -52,6 +52,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "be_ai_chat.h"
 #include "be_ai_char.h"
 #include "be_ai_gen.h"
+#include "be_threads.h"
 
 //library globals in a structure
 botlib_globals_t botlibglobals;
@@ -214,6 +215,7 @@ int Export_BotLibShutdown(void)
 	BotShutdownWeaponAI();		//be_ai_weap.c
 	BotShutdownWeights();		//be_ai_weight.c
 	BotShutdownCharacters();	//be_ai_char.c
+	BotShutdownThreads();		//be_threads.c
 	//shud down aas
 	AAS_Shutdown();
 	//shut down bot elemantary actions
@@ -721,6 +723,8 @@ static void Init_AAS_Export( aas_export_t *aas ) {
 	aas->AAS_AreaTravelTimeToGoalArea = AAS_AreaTravelTimeToGoalArea;
 	aas->AAS_EnableRoutingArea = AAS_EnableRoutingArea;
 	aas->AAS_PredictRoute = AAS_PredictRoute;
+	aas->AAS_RecordRouteQueries = AAS_RecordRouteQueries;
+	aas->AAS_ReplayRouteQueries = AAS_ReplayRouteQueries;
 	//--------------------------------------------
 	// be_aas_altroute.c
 	//--------------------------------------------
@@ -906,6 +910,8 @@ botlib_export_t *GetBotLibAPI(int apiVersion, botlib_import_t *import) {
 	be_botlib_export.BotLibStartFrame = Export_BotLibStartFrame;
 	be_botlib_export.BotLibLoadMap = Export_BotLibLoadMap;
 	be_botlib_export.BotLibUpdateEntity = Export_BotLibUpdateEntity;
+	be_botlib_export.BotLibThreadedThink = BotLibThreadedThink;
+	be_botlib_export.BotLibThinkClient = BotLibThinkClient;
 	be_botlib_export.Test = BotExportTest;
 
 	return &be_botlib_export;
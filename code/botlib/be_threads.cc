@@ -0,0 +1,214 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of KingpinQ3 source code.
+
+KingpinQ3 source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+KingpinQ3 source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with KingpinQ3 source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+
+/*****************************************************************************
+ * name:		be_threads.c
+ *
+ * desc:		bot think on worker threads
+ *
+ * $Archive: /source/code/botlib/be_threads.c $
+ *
+ *****************************************************************************/
+
+#include "../qcommon/q_shared.h"
+#include "l_memory.h"
+#include "aasfile.h"
+#include "botlib.h"
+#include "be_aas.h"
+#include "be_aas_funcs.h"
+#include "be_interface.h"
+#include "be_threads.h"
+
+//While the bots think on several threads, changes one bot makes to state the
+//other bots read are queued per bot and applied in client order once every bot
+//is done, so the outcome doesn't depend on how the threads were scheduled.
+
+#define DEFERRED_ROUTINGAREA		1
+#define DEFERRED_SHAREDFLOAT		2
+
+typedef struct bot_deferred_s
+{
+  int type;
+  int areanum;
+  int enable;
+  float *ptr;
+  float value;
+} bot_deferred_t;
+
+typedef struct bot_deferredlist_s
+{
+  bot_deferred_t *deferred;
+  int numdeferred;
+  int maxdeferred;
+} bot_deferredlist_t;
+
+static int botthreadedthink;
+static Q_THREADLOCAL int botthinkclient = -1;
+static bot_deferredlist_t botdeferred[MAX_CLIENTS];
+
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+int BotThreadedThink(void)
+{
+  return botthreadedthink;
+} //end of the function BotThreadedThink
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static bot_deferred_t *BotAllocDeferred(void)
+{
+  bot_deferredlist_t *list;
+  bot_deferred_t *deferred;
+
+  if (!botthreadedthink || botthinkclient < 0 || botthinkclient >= MAX_CLIENTS)
+    return NULL;
+  list = &botdeferred[botthinkclient];
+  if (list->numdeferred >= list->maxdeferred)
+  {
+    list->maxdeferred = list->maxdeferred ? list->maxdeferred * 2 : 16;
+    deferred = (bot_deferred_t *) GetMemory(list->maxdeferred * sizeof(bot_deferred_t));
+    if (list->deferred)
+    {
+      Com_Memcpy(deferred, list->deferred, list->numdeferred * sizeof(bot_deferred_t));
+      FreeMemory(list->deferred);
+    } //end if
+    list->deferred = deferred;
+  } //end if
+  return &list->deferred[list->numdeferred++];
+} //end of the function BotAllocDeferred
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+int BotDeferRoutingArea(int areanum, int enable)
+{
+  bot_deferred_t *deferred;
+
+  deferred = BotAllocDeferred();
+  if (!deferred)
+    return qfalse;
+  deferred->type = DEFERRED_ROUTINGAREA;
+  deferred->areanum = areanum;
+  deferred->enable = enable;
+  return qtrue;
+} //end of the function BotDeferRoutingArea
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void BotSetSharedFloat(float *ptr, float value)
+{
+  bot_deferred_t *deferred;
+
+  deferred = BotAllocDeferred();
+  if (!deferred)
+  {
+    *ptr = value;
+    return;
+  } //end if
+  deferred->type = DEFERRED_SHAREDFLOAT;
+  deferred->ptr = ptr;
+  deferred->value = value;
+} //end of the function BotSetSharedFloat
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void BotApplyDeferred(void)
+{
+  int i, j;
+  bot_deferredlist_t *list;
+  bot_deferred_t *deferred;
+
+  for (i = 0; i < MAX_CLIENTS; i++)
+  {
+    list = &botdeferred[i];
+    for (j = 0; j < list->numdeferred; j++)
+    {
+      deferred = &list->deferred[j];
+      if (deferred->type == DEFERRED_ROUTINGAREA)
+        AAS_EnableRoutingArea(deferred->areanum, deferred->enable);
+      else if (deferred->type == DEFERRED_SHAREDFLOAT)
+        *deferred->ptr = deferred->value;
+    } //end for
+    list->numdeferred = 0;
+  } //end for
+} //end of the function BotApplyDeferred
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+int BotLibThreadedThink(int enable)
+{
+  if (enable)
+  {
+    botthreadedthink = qtrue;
+    return BLERR_NOERROR;
+  } //end if
+  botthreadedthink = qfalse;
+  BotApplyDeferred();
+  return BLERR_NOERROR;
+} //end of the function BotLibThreadedThink
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+int BotLibThinkClient(int client)
+{
+  botthinkclient = client;
+  return BLERR_NOERROR;
+} //end of the function BotLibThinkClient
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void BotShutdownThreads(void)
+{
+  int i;
+
+  for (i = 0; i < MAX_CLIENTS; i++)
+  {
+    if (botdeferred[i].deferred)
+      FreeMemory(botdeferred[i].deferred);
+  } //end for
+  Com_Memset(botdeferred, 0, sizeof(botdeferred));
+  botthreadedthink = qfalse;
+} //end of the function BotShutdownThreads
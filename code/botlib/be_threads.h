@@ -0,0 +1,44 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of KingpinQ3 source code.
+
+KingpinQ3 source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+KingpinQ3 source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with KingpinQ3 source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+
+/*****************************************************************************
+ * name:		be_threads.h
+ *
+ * desc:		bot think on worker threads
+ *
+ * $Archive: /source/code/botlib/be_threads.h $
+ *
+ *****************************************************************************/
+
+//true while bot think runs on worker threads
+int BotThreadedThink(void);
+//defers an enable or disable of a routing area to the end of the threaded think,
+//returns false if nothing is deferred and the change should be made now
+int BotDeferRoutingArea(int areanum, int enable);
+//stores a value shared between bots, deferred while the think is threaded
+void BotSetSharedFloat(float *ptr, float value);
+//starts or ends the threaded think, ending it applies the deferred changes
+int BotLibThreadedThink(int enable);
+//sets the bot the calling thread is thinking for, -1 for none
+int BotLibThinkClient(int client);
+//frees the deferred change lists
+void BotShutdownThreads(void);
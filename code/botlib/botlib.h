@@ -29,7 +29,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  *
  *****************************************************************************/
 
-#define	BOTLIB_API_VERSION		2
+#define	BOTLIB_API_VERSION		6
 
 struct aas_clientmove_s;
 struct aas_entityinfo_s;
@@ -195,6 +195,10 @@ typedef struct botlib_import_s
 	int(*FS_Write)(const void *buffer, size_t len, fileHandle_t f);
 	void		(*FS_FCloseFile)( fileHandle_t f );
 	int			(*FS_Seek)( fileHandle_t f, long offset, int origin );
+	long		(*FS_MapFile)( const char *qpath, const void **data );	// read only until FS_UnmapFile, -1 if not found
+	void		(*FS_UnmapFile)( const void *data );
+	//runs func for every work item spread over numThreads threads, NULL if not supported
+	void		(*RunJobs)( int numThreads, int workcnt, void (*func)( int work, int threadnum ) );
 	//debug visualisation stuff
 	int			(*DebugLineCreate)(void);
 	void		(*DebugLineDelete)(int line);
@@ -245,6 +249,10 @@ typedef struct aas_export_s
 	int			(*AAS_PredictRoute)(struct aas_predictroute_s *route, int areanum, vec3_t origin,
 							int goalareanum, int travelflags, int maxareas, int maxtime,
 							int stopevent, int stopcontents, int stoptfl, int stopareanum);
+	//record up to maxqueries route queries for AAS_ReplayRouteQueries, 0 stops recording
+	void		(*AAS_RecordRouteQueries)(int maxqueries);
+	//replay the recorded route queries on an empty routing cache of the given budget in bytes
+	int			(*AAS_ReplayRouteQueries)(int budget, struct aas_routecachestats_s *stats);
 	//--------------------------------------------
 	// be_aas_altroute.c
 	//--------------------------------------------
@@ -425,6 +433,10 @@ typedef struct botlib_export_s
 	int (*BotLibLoadMap)(const char *mapname);
 	//entity updates
 	int (*BotLibUpdateEntity)(int ent, bot_entitystate_t *state);
+	//start or end bot think on several threads, ending it applies the changes the bots deferred
+	int (*BotLibThreadedThink)(int enable);
+	//set the bot the calling thread thinks for, -1 for none
+	int (*BotLibThinkClient)(int client);
 	//just for testing
 	int (*Test)(int parm0, char *parm1, vec3_t parm2, vec3_t parm3);
 } botlib_export_t;
@@ -483,8 +495,10 @@ name:						default:			module(s):			description:
 
 "max_aaslinks"				"4096"				be_aas_sample.c		maximum links in the AAS
 "max_routingcache"			"4096"				be_aas_route.c		maximum routing cache size in KB
+"saveportaltables"			"0"					be_aas_main.c		calculate and save the portal travel time tables
 "forceclustering"			"0"					be_aas_main.c		force recalculation of clusters
 "forcereachability"			"0"					be_aas_main.c		force recalculation of reachabilities
+"reachthreads"				"0"					be_aas_reach.c		threads to calculate reachabilities on
 "forcewrite"				"0"					be_aas_main.c		force writing of aas file
 "aasoptimize"				"0"					be_aas_main.c		enable aas optimization
 "sv_mapChecksum"			"0"					be_aas_main.c		BSP file checksum
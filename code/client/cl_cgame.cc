@@ -891,6 +891,10 @@ void CL_InitCGame(void)
 
   t1 = Sys_Milliseconds();
 
+  // a local server has cleared them for this map already
+  if (!com_sv_running->integer)
+    FS_ClearLookupStats();
+
   // put away the console
   Con_Close();
 
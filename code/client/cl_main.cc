@@ -3254,6 +3254,9 @@ void CL_InitRef(void)
   ri.FS_ListFiles            = FS_ListFiles;
   ri.FS_FileIsInPAK          = FS_FileIsInPAK;
   ri.FS_FileExists           = FS_FileExists;
+  ri.FS_FileExtensions       = FS_FileExtensions;
+  ri.StartJobs               = Com_StartJobs;
+  ri.WaitJobs                = Com_WaitJobs;
   ri.Cvar_Get                = Cvar_Get;
   ri.Cvar_Set                = Cvar_Set;
 	//ri.Cvar_SetValue           = Cvar_SetValue;
@@ -3631,6 +3634,14 @@ void CL_Init(void)
   Cmd_AddCommand("stopvideo", CL_StopVideo_f);
   CL_InitRef();
 
+  // "+set r_decodeBench maps/<name>.assets" times the image decoders on the
+  // asset list of a map and quits before any window or GL context exists
+  if (Cvar_VariableString("r_decodeBench")[0])
+  {
+    re.ImageDecodeBench(Cvar_VariableString("r_decodeBench"), Cvar_VariableIntegerValue("r_imageJobs"));
+    Com_Quit_f();
+  }
+
   SCR_Init();
 
 // Cbuf_Execute ();
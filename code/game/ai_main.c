@@ -85,6 +85,7 @@ int bot_interbreedmatchcount;
 vmCvar_t bot_thinktime;
 vmCvar_t bot_memorydump;
 vmCvar_t bot_saveroutingcache;
+vmCvar_t bot_saveportaltables;
 vmCvar_t bot_pause;
 vmCvar_t bot_report;
 vmCvar_t bot_testsolid;
@@ -1572,6 +1573,7 @@ int BotAIStartFrame(int time)
   trap_Cvar_Update(&bot_thinktime);
   trap_Cvar_Update(&bot_memorydump);
   trap_Cvar_Update(&bot_saveroutingcache);
+  trap_Cvar_Update(&bot_saveportaltables);
   trap_Cvar_Update(&bot_pause);
   trap_Cvar_Update(&bot_report);
 
@@ -1615,6 +1617,11 @@ int BotAIStartFrame(int time)
     trap_BotLibVarSet("saveroutingcache", "1");
     trap_Cvar_Set("bot_saveroutingcache", "0");
   }
+  if (bot_saveportaltables.integer)
+  {
+    trap_BotLibVarSet("saveportaltables", "1");
+    trap_Cvar_Set("bot_saveportaltables", "0");
+  }
   //check if bot interbreeding is activated
   BotInterbreeding();
   //cap the bot think time
@@ -1826,6 +1833,10 @@ int BotInitLibrary(void)
   trap_Cvar_VariableStringBuffer("bot_forcereachability", buf, sizeof(buf));
   if (qstrlen(buf))
     trap_BotLibVarSet("forcereachability", buf);
+  //threads to calculate reachabilities on
+  trap_Cvar_VariableStringBuffer("bot_reachthreads", buf, sizeof(buf));
+  if (qstrlen(buf))
+    trap_BotLibVarSet("reachthreads", buf);
   //force writing of AAS to file
   trap_Cvar_VariableStringBuffer("bot_forcewrite", buf, sizeof(buf));
   if (qstrlen(buf))
@@ -1873,6 +1884,7 @@ int BotAISetup(int restart)
   trap_Cvar_Register(&bot_thinktime, "bot_thinktime", "100", CVAR_CHEAT);
   trap_Cvar_Register(&bot_memorydump, "bot_memorydump", "0", CVAR_CHEAT);
   trap_Cvar_Register(&bot_saveroutingcache, "bot_saveroutingcache", "0", CVAR_CHEAT);
+  trap_Cvar_Register(&bot_saveportaltables, "bot_saveportaltables", "0", CVAR_CHEAT);
   trap_Cvar_Register(&bot_pause, "bot_pause", "0", CVAR_CHEAT);
   trap_Cvar_Register(&bot_report, "bot_report", "0", CVAR_CHEAT);
   trap_Cvar_Register(&bot_testsolid, "bot_testsolid", "0", CVAR_CHEAT);
@@ -1042,6 +1042,9 @@ void trap_FS_Write(const void *buffer, size_t len, fileHandle_t f);
 void trap_FS_FCloseFile(fileHandle_t f);
 int trap_FS_GetFileList(const char *path, const char *extension, char *listbuf, int bufsize);
 int trap_FS_Seek(fileHandle_t f, long offset, int origin); // fsOrigin_t
+#ifndef Q3_VM
+void trap_GetDirectCalls(void);
+#endif
 void trap_SendConsoleCommand(int exec_when, const char *text);
 void trap_Cvar_Register(vmCvar_t *cvar, const char *var_name, const char *value, int flags);
 void trap_Cvar_Update(vmCvar_t *cvar);
@@ -1059,6 +1062,7 @@ void trap_SetUserinfo(int num, const char *buffer);
 void trap_GetServerinfo(char *buffer, int bufferSize);
 void trap_SetBrushModel(gentity_t *ent, const char *name);
 void trap_Trace(trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask);
+void trap_TraceBatch(trace_t *results, int numTraces, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t *ends, int passEntityNum, int contentmask);
 int trap_PointContents(const vec3_t point, int passEntityNum);
 qboolean trap_InPVS(const vec3_t p1, const vec3_t p2);
 qboolean trap_InPVSIgnorePortals(const vec3_t p1, const vec3_t p2);
@@ -499,6 +499,10 @@ void G_InitGame(int levelTime, int randomSeed, int restart)
 
   srand(randomSeed);
 
+#ifndef Q3_VM
+  trap_GetDirectCalls();
+#endif
+
   G_RegisterCvars();
 
   G_ProcessIPBans();
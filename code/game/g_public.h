@@ -104,6 +104,21 @@ typedef struct
 
 //===============================================================
 
+#define MAX_TRACE_BATCH 64              // most traces a single G_TRACEBATCH may ask for
+
+// the hottest traps as plain functions, so a game dll can call them with
+// its own calling convention instead of going through the varargs syscall
+typedef struct
+{
+	void (*trace)(trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask);
+	void (*traceCapsule)(trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask);
+	void (*traceBatch)(trace_t *results, int numTraces, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t *ends, int passEntityNum, int contentmask);
+	int (*pointContents)(const vec3_t point, int passEntityNum);
+	void (*linkEntity)(sharedEntity_t *ent);
+	void (*unlinkEntity)(sharedEntity_t *ent);
+	int (*entitiesInBox)(const vec3_t mins, const vec3_t maxs, int *list, int maxcount);
+} gameDirectCalls_t;
+
 //
 // system traps provided by the main engine
 //
@@ -234,6 +249,14 @@ typedef enum
 	// 1.32
 	G_FS_SEEK,
 
+	G_TRACEBATCH,                   // ( trace_t *results, int numTraces, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t *ends, int passEntityNum, int contentmask );
+	// traces the same box from one start to up to MAX_TRACE_BATCH ends,
+	// each result is the same as a G_TRACE to that end
+
+	G_GET_DIRECT_CALLS,             // ( gameDirectCalls_t *calls );
+	// fills in calls and returns qtrue when the game is a dll,
+	// a qvm gets qfalse and has to keep using the traps
+
 	G_ACOS = 114,
 
 	BOTLIB_SETUP = 200,             // ( void );
@@ -31,6 +31,9 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 static intptr_t (QDECL * syscall)(intptr_t arg, ...) = (intptr_t (QDECL *)(intptr_t, ...)) - 1;
 
+// engine functions the hottest traps call directly, once G_InitGame got them
+static gameDirectCalls_t directCalls;
+
 #ifdef __cplusplus
 extern "C" Q_EXPORT void dllEntry(intptr_t (QDECL *syscallptr)(intptr_t arg, ...))
 #else
@@ -50,6 +53,15 @@ void trap_Error(const char *fmt)
 	syscall(G_ERROR, fmt);
 }
 
+void trap_GetDirectCalls(void)
+{
+	memset(&directCalls, 0, sizeof(directCalls));
+	if(!syscall(G_GET_DIRECT_CALLS, &directCalls))
+	{
+		memset(&directCalls, 0, sizeof(directCalls));
+	}
+}
+
 int trap_Milliseconds(void)
 {
 	return syscall(G_MILLISECONDS);
@@ -172,16 +184,40 @@ void trap_SetBrushModel(gentity_t *ent, const char *name)
 
 void trap_Trace(trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask)
 {
+	if(directCalls.trace)
+	{
+		directCalls.trace(results, start, mins, maxs, end, passEntityNum, contentmask);
+		return;
+	}
 	syscall(G_TRACE, results, start, mins, maxs, end, passEntityNum, contentmask);
 }
 
 void trap_TraceCapsule(trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask)
 {
+	if(directCalls.traceCapsule)
+	{
+		directCalls.traceCapsule(results, start, mins, maxs, end, passEntityNum, contentmask);
+		return;
+	}
 	syscall(G_TRACECAPSULE, results, start, mins, maxs, end, passEntityNum, contentmask);
 }
 
+void trap_TraceBatch(trace_t *results, int numTraces, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t *ends, int passEntityNum, int contentmask)
+{
+	if(directCalls.traceBatch)
+	{
+		directCalls.traceBatch(results, numTraces, start, mins, maxs, ends, passEntityNum, contentmask);
+		return;
+	}
+	syscall(G_TRACEBATCH, results, numTraces, start, mins, maxs, ends, passEntityNum, contentmask);
+}
+
 int trap_PointContents(const vec3_t point, int passEntityNum)
 {
+	if(directCalls.pointContents)
+	{
+		return directCalls.pointContents(point, passEntityNum);
+	}
 	return syscall(G_POINT_CONTENTS, point, passEntityNum);
 }
 
@@ -208,16 +244,30 @@ qboolean trap_AreasConnected(int area1, int area2)
 
 void trap_LinkEntity(gentity_t *ent)
 {
+	if(directCalls.linkEntity)
+	{
+		directCalls.linkEntity((sharedEntity_t *)ent);
+		return;
+	}
 	syscall(G_LINKENTITY, ent);
 }
 
 void trap_UnlinkEntity(gentity_t *ent)
 {
+	if(directCalls.unlinkEntity)
+	{
+		directCalls.unlinkEntity((sharedEntity_t *)ent);
+		return;
+	}
 	syscall(G_UNLINKENTITY, ent);
 }
 
 int trap_EntitiesInBox(const vec3_t mins, const vec3_t maxs, int *list, int maxcount)
 {
+	if(directCalls.entitiesInBox)
+	{
+		return directCalls.entitiesInBox(mins, maxs, list, maxcount);
+	}
 	return syscall(G_ENTITIES_IN_BOX, mins, maxs, list, maxcount);
 }
 
@@ -54,17 +54,24 @@ void G_ForceWeaponChange( gentity_t *ent, weapon_t weapon ) //unvan 0.52
 /*
 ===============
 Bullet_Fire
+
+All bullets of a shot are traced together with one trap_TraceBatch.
+A pellet that kills, frees, unlinks or changes the contents of what it
+hit retraces the remaining pellets so they see the same world the old
+one trace per pellet loop did
 ===============
 */
 void Bullet_Fire(gentity_t *ent, float spread, int damage, meansOfDeath_t mod, int bulletCount)
 {
   trace_t tr;
-  vec3_t end;
+  trace_t traces[MAX_TRACE_BATCH];
+  vec3_t ends[MAX_TRACE_BATCH];
   float r;
   float u;
   gentity_t *tent;
   gentity_t *traceEnt;
   int passent, i;
+  int contents, health;
   int showBlood = qtrue;
 //unlagged - attack prediction #2
   // we have to use something now that the client knows in advance
@@ -79,9 +86,11 @@ void Bullet_Fire(gentity_t *ent, float spread, int damage, meansOfDeath_t mod, i
 
   passent = ent->s.number;
 
+  if (bulletCount > MAX_TRACE_BATCH)
+    bulletCount = MAX_TRACE_BATCH;
+
   for (i = 0; i < bulletCount; i++)
   {
-
 #if 0 //std non predict
     r = random() * M_PI * 2.0f;
     u = sin(r) * crandom() * spread * 16;
@@ -95,11 +104,16 @@ void Bullet_Fire(gentity_t *ent, float spread, int damage, meansOfDeath_t mod, i
 //unlagged - attack prediction #2
 #endif
 
-    VectorMA(muzzle, 8192 * 16, forward, end);
-    VectorMA(end, r, right, end);
-    VectorMA(end, u,    up, end);
+    VectorMA(muzzle, 8192 * 16, forward, ends[i]);
+    VectorMA(ends[i], r, right, ends[i]);
+    VectorMA(ends[i], u,    up, ends[i]);
+  }
 
-    trap_Trace(&tr, muzzle, NULL, NULL, end, passent, MASK_SHOT);
+  trap_TraceBatch(traces, bulletCount, muzzle, NULL, NULL, (const vec3_t *)ends, passent, MASK_SHOT);
+
+  for (i = 0; i < bulletCount; i++)
+  {
+    tr = traces[i];
 
     if (tr.surfaceFlags & SURF_NOIMPACT)
       return;
@@ -159,7 +173,15 @@ void Bullet_Fire(gentity_t *ent, float spread, int damage, meansOfDeath_t mod, i
       else if (distoEnt < 64 && mod == MOD_SHOTGUN) //hypov8 add close range to damage amount
         damage = (int)ceil(1.5f*damage);
 
+      contents = traceEnt->r.contents;
+      health = traceEnt->health;
       G_Damage(traceEnt, ent, ent, forward, tr.endpos, damage, 0, mod);
+
+      // the batch was traced against the world before this hit
+      if (i + 1 < bulletCount && (!traceEnt->inuse || !traceEnt->r.linked ||
+          traceEnt->r.contents != contents || (health > 0 && traceEnt->health <= 0)))
+        trap_TraceBatch(traces + i + 1, bulletCount - i - 1, muzzle, NULL, NULL,
+                        (const vec3_t *)(ends + i + 1), passent, MASK_SHOT);
     }
   }
 
@@ -39,6 +39,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "be_aas_bspc.h" //hypov8 add
 
 #include "../kaas/l_cmd.h"
+#include "l_threads.h"
 
 //#define BSPC
 
@@ -153,6 +154,39 @@ void *BotImport_GetMemory(int size)
 } //end of the function BotImport_GetMemory
 //===========================================================================
 //
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+static void (*jobfunction)(int work, int threadnum);
+
+void BotImport_JobThread(int threadnum)
+{
+	int work;
+
+	while ((work = GetThreadWork()) != -1)
+	{
+		jobfunction(work, threadnum);
+	} //end while
+} //end of the function BotImport_JobThread
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void BotImport_RunJobs(int numThreads, int workcnt, void (*func)(int work, int threadnum))
+{
+	int oldnumthreads;
+
+	oldnumthreads = numthreads;
+	numthreads = numThreads;
+	jobfunction = func;
+	RunThreadsOn(workcnt, qfalse, BotImport_JobThread);
+	numthreads = oldnumthreads;
+} //end of the function BotImport_RunJobs
+//===========================================================================
+//
 // Parameter:			-
 // Returns:				-
 // Changes Globals:		-
@@ -267,6 +301,7 @@ void AAS_InitBotImport(void)
 	botimport.PointContents = BotImport_PointContents;
 	botimport.Print = BotImport_Print;
 	botimport.BSPModelMinsMaxsOrigin = BotImport_BSPModelMinsMaxsOrigin;
+	botimport.RunJobs = BotImport_RunJobs;
 } //end of the function AAS_InitBotImport
 //===========================================================================
 //
@@ -46,6 +46,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 //FIXME: 0xA5EA, reicht auch für win ?
 extern	int use_nodequeue;		//brushbsp.c
 extern	int calcgrapplereach;	//be_aas_reach.c
+extern	int calcreachthreads;	//be_aas_reach.c
+extern	int calcreachtimings;	//be_aas_reach.c
 
 float			subdivide_size = 240;
 char			source[1024];
@@ -514,6 +516,7 @@ int main (int argc, char **argv)
 	quakefile_t *qfiles = NULL, *qf;
 	double start_time;
 	qboolean tmp_verbose = qtrue;
+	qboolean threadsset = qfalse;
 
 	myargc = argc;
 	myargv = argv;
@@ -530,6 +533,7 @@ int main (int argc, char **argv)
 		{
 			if (i + 1 >= argc) {i = 0; break;}
 			numthreads = atoi(argv[++i]);
+			threadsset = qtrue;
 			Log_Print("threads = %d\n", numthreads);
 		} //end if
 		else if (!Q_stricmp(argv[i], "-noverbose"))
@@ -807,6 +811,14 @@ int main (int argc, char **argv)
 			} //end case
 			case COMP_REACH:
 			{
+				//use all processors unless told otherwise
+				if (!threadsset)
+				{
+					numthreads = -1;
+					ThreadSetDefault();
+				} //end if
+				calcreachthreads = numthreads;
+				calcreachtimings = qtrue;
 				if (!qfiles) Log_Print("no files found\n");
 				for (qf = qfiles; qf; qf = qf->next)
 				{
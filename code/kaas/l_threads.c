@@ -767,6 +767,7 @@ int GetNumThreads(void)
 
 #include <pthread.h>
 #include <semaphore.h>
+#include <unistd.h>
 
 typedef struct thread_s
 {
@@ -799,7 +800,9 @@ void ThreadSetDefault(void)
 {
 	if (numthreads == -1)	// not set manually
 	{
-		numthreads = 1;
+		numthreads = sysconf(_SC_NPROCESSORS_ONLN);
+		if (numthreads < 1 || numthreads > MAX_THREADS)
+			numthreads = 1;
 	} //end if
 	qprintf("%i threads\n", numthreads);
 } //end of the function ThreadSetDefault
@@ -27,19 +27,33 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #ifdef BSPC
   #include "../kaas/l_qfiles.h"
+#else
+  #include <atomic>
 #endif
 
 // to allow boxes to be treated as brush models, we allocate
-// some extra indexes along with those needed by the map
-#define	BOX_BRUSHES		1
-#define	BOX_SIDES		6
+// some extra indexes along with those needed by the map,
+// one box per thread that may trace
+#ifdef BSPC
+#define	BOX_HULLS		1
+#else
+#define	BOX_HULLS		(MAX_WORKER_THREADS + 1)
+#endif
+#define	BOX_BRUSHES		(1 * BOX_HULLS)
+#define	BOX_SIDES		(6 * BOX_HULLS)
 #define	BOX_LEAFS		2
-#define	BOX_PLANES		12
+#define	BOX_PLANES		(12 * BOX_HULLS)
 
 #define	LL(x) x=LittleLong(x)
 
 
 clipMap_t       cm;
+Q_THREADLOCAL int cm_checkcount;
+#ifdef BSPC
+static int      cm_checkcounter;
+#else
+static std::atomic<int> cm_checkcounter;
+#endif
 int             c_pointcontents;
 int             c_traces, c_brush_traces, c_patch_traces, c_trisoup_traces;
 
@@ -52,9 +66,14 @@ cvar_t         *cm_forceTriangles;
 cvar_t         *cm_showCurves;
 cvar_t         *cm_showTriangles;
 #endif
-cmodel_t        box_model;
-cplane_t       *box_planes;
-cbrush_t       *box_brush;
+typedef struct
+{
+	cmodel_t        model;
+	cplane_t       *planes;
+	cbrush_t       *brush;
+} boxHull_t;
+
+static boxHull_t cm_boxHulls[BOX_HULLS];
 
 
 
@@ -62,6 +81,36 @@ void            CM_InitBoxHull(void);
 void            CM_FloodAreaConnections(void);
 
 
+/*
+==================
+CM_NextCheckCount
+
+Starts a new trace or box test.  The count comes from a shared counter
+so traces running on different threads never mistake each other's marks.
+==================
+*/
+void CM_NextCheckCount(void)
+{
+	cm_checkcount = ++cm_checkcounter;
+}
+
+/*
+==================
+CM_BoxHull
+
+The temp box of the calling thread
+==================
+*/
+static boxHull_t *CM_BoxHull(void)
+{
+#ifdef BSPC
+	return &cm_boxHulls[0];
+#else
+	return &cm_boxHulls[Com_WorkerThreadNum()];
+#endif
+}
+
+
 /*
 ===============================================================================
 
@@ -222,6 +271,48 @@ void CM_BoundBrush(cbrush_t * b)
 	b->bounds[1][2] = b->sides[5].plane->dist;
 }
 
+#if defined(idx86_sse)
+/*
+=================
+CM_PackBrushPlanes
+
+Copies the side planes of a brush into its sidePlanes groups
+=================
+*/
+void CM_PackBrushPlanes(cbrush_t * b)
+{
+	int             i, j, axis;
+	cplane_t       *plane;
+	cbrushPlanes_t *planes;
+	ALIGN(16) float normal[3][4];
+	ALIGN(16) float dist[4];
+	ALIGN(16) int   signMask[3][4];
+
+	for(i = 0; i < b->numsides; i += 4)
+	{
+		for(j = 0; j < 4; j++)
+		{
+			plane = b->sides[(i + j < b->numsides) ? i + j : b->numsides - 1].plane;
+
+			for(axis = 0; axis < 3; axis++)
+			{
+				normal[axis][j] = plane->normal[axis];
+				signMask[axis][j] = (plane->signbits & (1 << axis)) ? -1 : 0;
+			}
+			dist[j] = plane->dist;
+		}
+
+		planes = b->sidePlanes + (i >> 2);
+		for(axis = 0; axis < 3; axis++)
+		{
+			planes->normal[axis] = _mm_load_ps(normal[axis]);
+			planes->signMask[axis] = _mm_load_ps((float *)signMask[axis]);
+		}
+		planes->dist = _mm_load_ps(dist);
+	}
+}
+#endif
+
 
 /*
 =================
@@ -234,6 +325,10 @@ void CMod_LoadBrushes(lump_t * l)
 	dbrush_t       *in;
 	cbrush_t       *out;
 	int             i, count;
+#if defined(idx86_sse)
+	int             numPlaneGroups;
+	cbrushPlanes_t *planes;
+#endif
 
 	in = (dbrush_t *)(cmod_base + l->fileofs);
 	if(l->filelen % sizeof(*in))
@@ -262,6 +357,27 @@ void CMod_LoadBrushes(lump_t * l)
 		CM_BoundBrush(out);
 	}
 
+#if defined(idx86_sse)
+	// pack the side planes of every brush for the SSE box tests
+	numPlaneGroups = 0;
+	for(i = 0, out = cm.brushes; i < count; i++, out++)
+	{
+		numPlaneGroups += (out->numsides + 3) >> 2;
+	}
+
+	// the hunk of the tools does not align its blocks
+	planes = (cbrushPlanes_t *) PADP(Hunk_Alloc(numPlaneGroups * sizeof(*planes) + 15, h_high), 16);
+
+	for(i = 0, out = cm.brushes; i < count; i++, out++)
+	{
+		out->sidePlanes = planes;
+		planes += (out->numsides + 3) >> 2;
+
+		CM_PackBrushPlanes(out);
+	}
+
+	Com_DPrintf("%i brush side planes packed in %i bytes\n", cm.numBrushSides, (int)(numPlaneGroups * sizeof(*planes)));
+#endif
 }
 
 /*
@@ -891,7 +1007,8 @@ void CM_LoadMap(const char *name, qboolean clientload, int *checksum)
 	// load the file
 	//
 #ifndef BSPC
-	length = FS_ReadFile(name, (void **)&buf);
+	// only read, so a bsp stored in a pk3 needn't be copied
+	length = FS_ReadFileMapped(name, (const void **)&buf);
 #else
 	length = LoadQuakeFile((quakefile_t *) name, (void **)&buf);
 #endif
@@ -1041,11 +1158,11 @@ cmodel_t       *CM_ClipHandleToModel(clipHandle_t handle)
 	}
 	if(handle == BOX_MODEL_HANDLE)
 	{
-		return &box_model;
+		return &CM_BoxHull()->model;
 	}
 	if(handle == CAPSULE_MODEL_HANDLE)
 	{
-		return &box_model;
+		return &CM_BoxHull()->model;
 	}
 	if(handle < MAX_SUBMODELS)
 	{
@@ -1113,52 +1230,67 @@ CM_InitBoxHull
 
 Set up the planes and nodes so that the six floats of a bounding box
 can just be stored out and get a proper clipping hull structure.
+Every thread gets its own hull so boxes can be traced concurrently.
 ===================
 */
 void CM_InitBoxHull(void)
 {
-	int             i;
+	int             i, h;
 	int             side;
 	cplane_t       *p;
 	cbrushside_t   *s;
+	boxHull_t      *hull;
+	cplane_t       *box_planes;
+	cbrush_t       *box_brush;
 
-	box_planes = &cm.planes[cm.numPlanes];
+	for(h = 0; h < BOX_HULLS; h++)
+	{
+		hull = &cm_boxHulls[h];
+
+		box_planes = hull->planes = &cm.planes[cm.numPlanes + h * 12];
+
+		box_brush = hull->brush = &cm.brushes[cm.numBrushes + h];
+		box_brush->numsides = 6;
+		box_brush->sides = cm.brushsides + cm.numBrushSides + h * 6;
+		box_brush->contents = CONTENTS_BODY;
+		box_brush->edges = (cbrushedge_t *) Hunk_Alloc(sizeof(cbrushedge_t) * 12, h_low);
+		box_brush->numEdges = 12;
+#if defined(idx86_sse)
+		box_brush->sidePlanes = (cbrushPlanes_t *) PADP(Hunk_Alloc(sizeof(cbrushPlanes_t) * 2 + 15, h_low), 16);
+#endif
 
-	box_brush = &cm.brushes[cm.numBrushes];
-	box_brush->numsides = 6;
-	box_brush->sides = cm.brushsides + cm.numBrushSides;
-	box_brush->contents = CONTENTS_BODY;
-	box_brush->edges = (cbrushedge_t *) Hunk_Alloc(sizeof(cbrushedge_t) * 12, h_low);
-	box_brush->numEdges = 12;
+		hull->model.leaf.numLeafBrushes = 1;
+		hull->model.leaf.firstLeafBrush = cm.numLeafBrushes + h;
+		cm.leafbrushes[cm.numLeafBrushes + h] = cm.numBrushes + h;
 
-	box_model.leaf.numLeafBrushes = 1;
-//  box_model.leaf.firstLeafBrush = cm.numBrushes;
-	box_model.leaf.firstLeafBrush = cm.numLeafBrushes;
-	cm.leafbrushes[cm.numLeafBrushes] = cm.numBrushes;
+		for(i = 0; i < 6; i++)
+		{
+			side = i & 1;
+
+			// brush sides
+			s = &box_brush->sides[i];
+			s->plane = box_planes + (i * 2 + side);
+			s->surfaceFlags = 0;
+
+			// planes
+			p = &box_planes[i * 2];
+			p->type = i >> 1;
+			p->signbits = 0;
+			VectorClear(p->normal);
+			p->normal[i >> 1] = 1;
+
+			p = &box_planes[i * 2 + 1];
+			p->type = 3 + (i >> 1);
+			p->signbits = 0;
+			VectorClear(p->normal);
+			p->normal[i >> 1] = -1;
+
+			SetPlaneSignbits(p);
+		}
 
-	for(i = 0; i < 6; i++)
-	{
-		side = i & 1;
-
-		// brush sides
-		s = &cm.brushsides[cm.numBrushSides + i];
-		s->plane = cm.planes + (cm.numPlanes + i * 2 + side);
-		s->surfaceFlags = 0;
-
-		// planes
-		p = &box_planes[i * 2];
-		p->type = i >> 1;
-		p->signbits = 0;
-		VectorClear(p->normal);
-		p->normal[i >> 1] = 1;
-
-		p = &box_planes[i * 2 + 1];
-		p->type = 3 + (i >> 1);
-		p->signbits = 0;
-		VectorClear(p->normal);
-		p->normal[i >> 1] = -1;
-
-		SetPlaneSignbits(p);
+#if defined(idx86_sse)
+		CM_PackBrushPlanes(box_brush);
+#endif
 	}
 }
 
@@ -1173,9 +1305,12 @@ Capsules are handled differently though.
 */
 clipHandle_t CM_TempBoxModel(const vec3_t mins, const vec3_t maxs, int capsule)
 {
+	boxHull_t      *hull = CM_BoxHull();
+	cplane_t       *box_planes = hull->planes;
+	cbrush_t       *box_brush = hull->brush;
 
-	VectorCopy(mins, box_model.mins);
-	VectorCopy(maxs, box_model.maxs);
+	VectorCopy(mins, hull->model.mins);
+	VectorCopy(maxs, hull->model.maxs);
 
 	if(capsule)
 	{
@@ -1195,6 +1330,12 @@ clipHandle_t CM_TempBoxModel(const vec3_t mins, const vec3_t maxs, int capsule)
 	box_planes[10].dist = mins[2];
 	box_planes[11].dist = -mins[2];
 
+#if defined(idx86_sse)
+	// only the distances of the box sides change
+	box_brush->sidePlanes[0].dist = _mm_setr_ps(box_planes[0].dist, box_planes[3].dist, box_planes[4].dist, box_planes[7].dist);
+	box_brush->sidePlanes[1].dist = _mm_setr_ps(box_planes[8].dist, box_planes[11].dist, box_planes[11].dist, box_planes[11].dist);
+#endif
+
 	// First side
 	VectorSet(box_brush->edges[0].p0, mins[0], mins[1], mins[2]);
 	VectorSet(box_brush->edges[0].p1, mins[0], maxs[1], mins[2]);
@@ -75,6 +75,17 @@ typedef struct
 	winding_t      *winding;
 } cbrushside_t;
 
+#if defined(idx86_sse)
+// the side planes of a brush packed four at a time for the SSE box tests,
+// the last group repeats the last side to fill its lanes
+typedef struct
+{
+	__m128          normal[3];	// one axis of the four normals per vector
+	__m128          dist;
+	__m128          signMask[3];	// all bits set where the plane signbits select the box maxs for the axis
+} cbrushPlanes_t;
+#endif
+
 typedef struct
 {
 	int             shaderNum;	// the shader that determined the contents
@@ -82,7 +93,11 @@ typedef struct
 	vec3_t          bounds[2];
 	int             numsides;
 	cbrushside_t   *sides;
+#if defined(idx86_sse)
+	cbrushPlanes_t *sidePlanes;	// (numsides + 3) / 4 groups
+#endif
 	int             checkcount;	// to avoid repeated testings
+	int             checkLanes;	// traces of a batch that already tested it, valid with checkcount
 	qboolean        collided;	// marker for optimisation
 	cbrushedge_t   *edges;
 	int             numEdges;
@@ -139,6 +154,7 @@ typedef struct
 	int             type;
 
 	int             checkcount;	// to avoid repeated testings
+	int             checkLanes;	// traces of a batch that already tested it, valid with checkcount
 	int             surfaceFlags;
 	int             contents;
 
@@ -198,7 +214,6 @@ typedef struct
 	cSurface_t    **surfaces;	// non-patches will be NULL
 
 	int             floodvalid;
-	int             checkcount;	// incremented on each trace
 
 	qboolean        perPolyCollision;
 } clipMap_t;
@@ -217,6 +232,9 @@ extern cvar_t  *cm_forceTriangles;
 extern cvar_t  *cm_showCurves;
 extern cvar_t  *cm_showTriangles;
 
+extern Q_THREADLOCAL int cm_checkcount;	// mark of the trace or box test running on this thread
+void            CM_NextCheckCount(void);
+
 
 typedef struct
 {
@@ -252,6 +270,11 @@ typedef struct
 	sphere_t        sphere;		// sphere for oriendted capsule collision
 	biSphere_t      biSphere;
 	qboolean        testLateralCollision;	// whether or not to test for lateral collision
+#if defined(idx86_sse)
+	__m128          startLanes[3];	// start and end with each axis in all four lanes, for CM_SideDistances
+	__m128          endLanes[3];
+	__m128          sizeLanes[2][3];	// size the same way, for CM_BoxSideDists
+#endif
 
 #ifdef BSPC
 #ifdef MRE_OPTIMIZE
@@ -43,6 +43,8 @@ int             CM_TransformedPointContents(const vec3_t p, clipHandle_t model,
 
 void            CM_BoxTrace(trace_t * results, const vec3_t start, const vec3_t end,
 							vec3_t mins, vec3_t maxs, clipHandle_t model, int brushmask, traceType_t type);
+void            CM_BoxTraceBatch(trace_t * results, int numTraces, const vec3_t * starts, const vec3_t * ends,
+								 vec3_t mins, vec3_t maxs, clipHandle_t model, int brushmask);
 void            CM_TransformedBoxTrace(trace_t * results, const vec3_t start, const vec3_t end,
 									   vec3_t mins, vec3_t maxs,
 									   clipHandle_t model, int brushmask,
@@ -110,11 +110,11 @@ void CM_StoreBrushes(leafList_t *ll, int nodenum)
 	{
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush + k];
 		b        = &cm.brushes[brushnum];
-		if(b->checkcount == cm.checkcount)
+		if(b->checkcount == cm_checkcount)
 		{
 			continue;   // already checked this brush in another leaf
 		}
-		b->checkcount = cm.checkcount;
+		b->checkcount = cm_checkcount;
 		for(i = 0; i < 3; i++)
 		{
 			if(b->bounds[0][i] >= ll->bounds[1][i] || b->bounds[1][i] <= ll->bounds[0][i])
@@ -197,7 +197,7 @@ int CM_BoxLeafnums(const vec3_t mins, const vec3_t maxs, int *list, int listsize
 {
 	leafList_t ll;
 
-	cm.checkcount++;
+	CM_NextCheckCount();
 
 	VectorCopy(mins, ll.bounds[0]);
 	VectorCopy(maxs, ll.bounds[1]);
@@ -223,7 +223,7 @@ int CM_BoxBrushes(const vec3_t mins, const vec3_t maxs, cbrush_t **list, int lis
 {
 	leafList_t ll;
 
-	cm.checkcount++;
+	CM_NextCheckCount();
 
 	VectorCopy(mins, ll.bounds[0]);
 	VectorCopy(maxs, ll.bounds[1]);
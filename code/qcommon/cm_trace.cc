@@ -24,6 +24,10 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "cm_local.h"
 #include "cm_patch.h" //hypov8. bspc. re'add, wolf
 
+#if defined(idx86_sse)
+#include <emmintrin.h>
+#endif
+
 // always use bbox vs. bbox collision and never capsule vs. bbox or vice versa
 //#define ALWAYS_BBOX_VS_BBOX
 // always use capsule vs. capsule collision and never capsule vs. bbox or vice versa
@@ -163,6 +167,126 @@ float SquareRootFloat(float number)
 }
 
 
+/*
+===============================================================================
+
+SSE BRUSH SIDE TESTS
+
+===============================================================================
+*/
+
+#if defined(idx86_sse)
+/*
+================
+CM_LaneMask
+
+Expands the low four bits of lanes to a per lane mask
+================
+*/
+static ID_INLINE __m128 CM_LaneMask(int lanes)
+{
+	__m128i         bits;
+
+	bits = _mm_set_epi32(8, 4, 2, 1);
+
+	return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(lanes), bits), bits));
+}
+
+/*
+================
+CM_SelectPS
+================
+*/
+static ID_INLINE __m128 CM_SelectPS(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+/*
+================
+CM_ClipFractions
+
+(d1 + eps) / (d1 - d2) for the lanes.  SURFACE_CLIP_EPSILON is a double, so
+the division is done in double precision like the plain C expression, two
+lanes at a time and only for the halves that have lanes in them.  Single
+box traces use it for their lane as well, -ffast-math lets the compiler
+turn the C division into a reciprocal multiply.
+================
+*/
+static ID_INLINE __m128 CM_ClipFractions(__m128 d1, __m128 d2, __m128 eps, int lanes)
+{
+	__m128          den, lo, hi;
+
+	den = _mm_sub_ps(d1, d2);
+
+	lo = hi = _mm_setzero_ps();
+	if(lanes & 3)
+	{
+		lo = _mm_cvtpd_ps(_mm_div_pd(_mm_add_pd(_mm_cvtps_pd(d1), _mm_cvtps_pd(eps)), _mm_cvtps_pd(den)));
+	}
+	if(lanes & 12)
+	{
+		hi = _mm_cvtpd_ps(_mm_div_pd(_mm_add_pd(_mm_cvtps_pd(_mm_movehl_ps(d1, d1)), _mm_cvtps_pd(_mm_movehl_ps(eps, eps))),
+									 _mm_cvtps_pd(_mm_movehl_ps(den, den))));
+	}
+
+	return _mm_movelh_ps(lo, hi);
+}
+
+/*
+================
+CM_BoxSideDists
+
+plane->dist - DotProduct(tw->offsets[plane->signbits], plane->normal) for
+four packed brush sides, the plane distances moved out by the box
+================
+*/
+static ID_INLINE __m128 CM_BoxSideDists(const traceWork_t * tw, const cbrushPlanes_t * planes)
+{
+	__m128          offset;
+
+	offset = _mm_mul_ps(planes->normal[0], CM_SelectPS(planes->signMask[0], tw->sizeLanes[1][0], tw->sizeLanes[0][0]));
+	offset = _mm_add_ps(offset, _mm_mul_ps(planes->normal[1], CM_SelectPS(planes->signMask[1], tw->sizeLanes[1][1], tw->sizeLanes[0][1])));
+	offset = _mm_add_ps(offset, _mm_mul_ps(planes->normal[2], CM_SelectPS(planes->signMask[2], tw->sizeLanes[1][2], tw->sizeLanes[0][2])));
+
+	return _mm_sub_ps(planes->dist, offset);
+}
+
+/*
+================
+CM_SideDistances
+
+DotProduct(point, normal) - dist for the lanes
+================
+*/
+static ID_INLINE __m128 CM_SideDistances(const __m128 * point, const __m128 * normal, __m128 dist)
+{
+	return _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(point[0], normal[0]), _mm_mul_ps(point[1], normal[1])),
+								 _mm_mul_ps(point[2], normal[2])), dist);
+}
+
+/*
+================
+CM_BoxSideGroup
+
+Distances of the start and end point of a box trace from four packed brush
+sides.  Batches run it once per trace as well and transpose the results,
+with -ffast-math the compiler is free to reorder the sums of a plain C or a
+differently shaped version of it, so sharing it whole is what keeps batched
+and single traces identical.
+================
+*/
+static ID_INLINE void CM_BoxSideGroup(const traceWork_t * tw, const cbrushPlanes_t * planes, __m128 * d1, __m128 * d2)
+{
+	__m128          dist;
+
+	dist = CM_BoxSideDists(tw, planes);
+
+	*d1 = CM_SideDistances(tw->startLanes, planes->normal, dist);
+	*d2 = CM_SideDistances(tw->endLanes, planes->normal, dist);
+}
+#endif
+
 /*
 ===============================================================================
 
@@ -185,6 +309,10 @@ static void CM_TestBoxInBrush(traceWork_t * tw, cbrush_t * brush)
 	cbrushside_t   *side;
 	float           t;
 	vec3_t          startp;
+#if defined(idx86_sse)
+	cbrushPlanes_t *planes;
+	__m128          d1s;
+#endif
 
 	if(!brush->numsides)
 	{
@@ -232,6 +360,23 @@ static void CM_TestBoxInBrush(traceWork_t * tw, cbrush_t * brush)
 	}
 	else
 	{
+#if defined(idx86_sse)
+		// the first six planes are the axial planes, so we only
+		// need to test the remainder, four at a time from the packed
+		// planes starting with the group of sides 4 to 7
+		for(i = 4; i < brush->numsides; i += 4)
+		{
+			planes = brush->sidePlanes + (i >> 2);
+
+			d1s = _mm_cmpgt_ps(CM_SideDistances(tw->startLanes, planes->normal, CM_BoxSideDists(tw, planes)), _mm_setzero_ps());
+
+			// if completely in front of face, no intersection
+			if(_mm_movemask_ps(d1s) & (i == 4 ? 12 : 15))
+			{
+				return;
+			}
+		}
+#else
 		// the first six planes are the axial planes, so we only
 		// need to test the remainder
 		for(i = 6; i < brush->numsides; i++)
@@ -250,6 +395,7 @@ static void CM_TestBoxInBrush(traceWork_t * tw, cbrush_t * brush)
 				return;
 			}
 		}
+#endif
 	}
 
 	// inside this brush
@@ -387,10 +533,10 @@ void CM_TestInLeaf(traceWork_t * tw, cLeaf_t * leaf)
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush + k];
 		b = &cm.brushes[brushnum];
 
-		if(b->checkcount == cm.checkcount)
+		if(b->checkcount == cm_checkcount)
 			continue;			// already checked this brush in another leaf
 
-		b->checkcount = cm.checkcount;
+		b->checkcount = cm_checkcount;
 
 		if(!(b->contents & tw->contents))
 			continue;
@@ -409,10 +555,10 @@ void CM_TestInLeaf(traceWork_t * tw, cLeaf_t * leaf)
 		if(!surface)
 			continue;
 
-		if(surface->checkcount == cm.checkcount)
+		if(surface->checkcount == cm_checkcount)
 			continue;			// already checked this surface in another leaf
 
-		surface->checkcount = cm.checkcount;
+		surface->checkcount = cm_checkcount;
 
 		if(!(surface->contents & tw->contents))
 			continue;
@@ -593,12 +739,12 @@ void CM_PositionTest(traceWork_t * tw)
 	ll.lastLeaf = 0;
 	ll.overflowed = qfalse;
 
-	cm.checkcount++;
+	CM_NextCheckCount();
 
 	CM_BoxLeafnums_r(&ll, 0);
 
 
-	cm.checkcount++;
+	CM_NextCheckCount();
 
 	// test the contents of the leafs
 	for(i = 0; i < ll.count; i++)
@@ -1019,6 +1165,165 @@ void CM_TraceThroughPatch( traceWork_t *tw, cSurface_t *patch )
 #endif
 
 
+#define TRACE_BATCH_LANES	4		// traces CM_BoxTraceBatch runs together
+
+#if defined(idx86_sse)
+static const int laneCounts[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+/*
+================
+CM_TraceThroughBrushLanes
+
+The box trace of CM_TraceThroughBrush against the side planes of a brush
+for up to four traces of the same box at once.  The side distances come
+in groups of four sides for four traces, transposed to a side at a time.
+================
+*/
+static void CM_TraceThroughBrushLanes(traceWork_t * const *tws, cbrush_t * brush, int lanes)
+{
+	int             i, lane, alive, getout, startout, crossing;
+	cbrushside_t   *side;
+	traceWork_t    *tw;
+	__m128          d1s[TRACE_BATCH_LANES], d2s[TRACE_BATCH_LANES];
+	__m128          d1, d2, f, zero, one, epsilon;
+	__m128          aliveMask, getoutMask, startoutMask, cross, enter, leave;
+	__m128          enterFrac, leaveFrac;
+	__m128i         leadSide;
+	ALIGN(16) float enterFracs[TRACE_BATCH_LANES];
+	ALIGN(16) float leaveFracs[TRACE_BATCH_LANES];
+	ALIGN(16) int   leadSides[TRACE_BATCH_LANES];
+
+	if(!brush->numsides)
+	{
+		return;
+	}
+
+	c_brush_traces += laneCounts[lanes];
+
+	zero = _mm_setzero_ps();
+	one = _mm_set1_ps(1.0f);
+	epsilon = _mm_set1_ps(SURFACE_CLIP_EPSILON);
+
+	aliveMask = CM_LaneMask(lanes);
+	getoutMask = zero;
+	startoutMask = zero;
+
+	enterFrac = _mm_set1_ps(-1.0f);
+	leaveFrac = one;
+	leadSide = _mm_setzero_si128();
+
+	//
+	// compare the traces against all planes of the brush
+	// find the latest time a trace crosses a plane towards the interior
+	// and the earliest time a trace crosses a plane towards the exterior
+	//
+	for(i = 0; i < brush->numsides; i++)
+	{
+		if(!(i & 3))
+		{
+			for(lane = 0; lane < TRACE_BATCH_LANES; lane++)
+			{
+				CM_BoxSideGroup(tws[lane], brush->sidePlanes + (i >> 2), &d1s[lane], &d2s[lane]);
+			}
+			_MM_TRANSPOSE4_PS(d1s[0], d1s[1], d1s[2], d1s[3]);
+			_MM_TRANSPOSE4_PS(d2s[0], d2s[1], d2s[2], d2s[3]);
+		}
+
+		d1 = d1s[i & 3];
+		d2 = d2s[i & 3];
+
+		// endpoint is not in solid
+		getoutMask = _mm_or_ps(getoutMask, _mm_cmpgt_ps(d2, zero));
+		startoutMask = _mm_or_ps(startoutMask, _mm_cmpgt_ps(d1, zero));
+
+		// if completely in front of face, no intersection with the entire brush
+		aliveMask = _mm_andnot_ps(_mm_and_ps(_mm_cmpgt_ps(d1, zero),
+											 _mm_or_ps(_mm_cmpge_ps(d2, epsilon), _mm_cmpge_ps(d2, d1))), aliveMask);
+		if(!_mm_movemask_ps(aliveMask))
+		{
+			return;
+		}
+
+		// if it doesn't cross the plane, the plane isn't relevant
+		cross = _mm_andnot_ps(_mm_and_ps(_mm_cmple_ps(d1, zero), _mm_cmple_ps(d2, zero)), aliveMask);
+		crossing = _mm_movemask_ps(cross);
+		if(!crossing)
+		{
+			continue;
+		}
+
+		brush->collided = qtrue;
+
+		// crosses face
+		enter = _mm_and_ps(cross, _mm_cmpgt_ps(d1, d2));
+		leave = _mm_andnot_ps(enter, cross);
+
+		f = CM_ClipFractions(d1, d2, CM_SelectPS(enter, _mm_sub_ps(zero, epsilon), epsilon), crossing);
+
+		// enter, masking instead of max keeps a -0 fraction like the C clamp does
+		enter = _mm_and_ps(enter, _mm_cmpgt_ps(_mm_andnot_ps(_mm_cmplt_ps(f, zero), f), enterFrac));
+		enterFrac = CM_SelectPS(enter, _mm_andnot_ps(_mm_cmplt_ps(f, zero), f), enterFrac);
+		leadSide = _mm_or_si128(_mm_and_si128(_mm_castps_si128(enter), _mm_set1_epi32(i)),
+								_mm_andnot_si128(_mm_castps_si128(enter), leadSide));
+
+		// leave
+		f = CM_SelectPS(_mm_cmpgt_ps(f, one), one, f);
+		leave = _mm_and_ps(leave, _mm_cmplt_ps(f, leaveFrac));
+		leaveFrac = CM_SelectPS(leave, f, leaveFrac);
+	}
+
+	_mm_store_ps(enterFracs, enterFrac);
+	_mm_store_ps(leaveFracs, leaveFrac);
+	_mm_store_si128((__m128i *) leadSides, leadSide);
+
+	alive = _mm_movemask_ps(aliveMask);
+	getout = _mm_movemask_ps(getoutMask);
+	startout = _mm_movemask_ps(startoutMask);
+
+	//
+	// all planes have been checked, and the trace was not
+	// completely outside the brush
+	//
+	for(lane = 0; lane < TRACE_BATCH_LANES; lane++)
+	{
+		if(!(alive & (1 << lane)))
+		{
+			continue;
+		}
+
+		tw = tws[lane];
+
+		if(!(startout & (1 << lane)))
+		{						// original point was inside brush
+			tw->trace.startsolid = qtrue;
+			if(!(getout & (1 << lane)))
+			{
+				tw->trace.allsolid = qtrue;
+				tw->trace.fraction = 0;
+				tw->trace.contents = brush->contents;
+			}
+			continue;
+		}
+
+		if(enterFracs[lane] < leaveFracs[lane])
+		{
+			if(enterFracs[lane] > -1 && enterFracs[lane] < tw->trace.fraction)
+			{
+				if(enterFracs[lane] < 0)
+				{
+					enterFracs[lane] = 0;
+				}
+				side = brush->sides + leadSides[lane];
+				tw->trace.fraction = enterFracs[lane];
+				tw->trace.plane = *side->plane;
+				tw->trace.surfaceFlags = side->surfaceFlags;
+				tw->trace.contents = brush->contents;
+			}
+		}
+	}
+}
+#endif
+
 /*
 ================
 CM_TraceThroughBrush
@@ -1037,6 +1342,12 @@ void CM_TraceThroughBrush(traceWork_t * tw, cbrush_t * brush)
 	float           t;
 	vec3_t          startp;
 	vec3_t          endp;
+#if defined(idx86_sse)
+	int             front, crossing;
+	cbrushPlanes_t *planes;
+	__m128          zero, epsilon;
+	float128_u      d1s, d2s, fs;
+#endif
 
 	enterFrac = -1.0;
 	leaveFrac = 1.0;
@@ -1219,11 +1530,47 @@ void CM_TraceThroughBrush(traceWork_t * tw, cbrush_t * brush)
 			side = brush->sides + i;
 			plane = side->plane;
 
+#if defined(idx86_sse)
+			if(!(i & 3))
+			{
+				// test the next four sides at once from the packed planes
+				planes = brush->sidePlanes + (i >> 2);
+				CM_BoxSideGroup(tw, planes, &d1s.m128, &d2s.m128);
+
+				zero = _mm_setzero_ps();
+				epsilon = _mm_set1_ps(SURFACE_CLIP_EPSILON);
+
+				front = _mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(d1s.m128, zero),
+												   _mm_or_ps(_mm_cmpge_ps(d2s.m128, epsilon), _mm_cmpge_ps(d2s.m128, d1s.m128))));
+				crossing = ~_mm_movemask_ps(_mm_and_ps(_mm_cmple_ps(d1s.m128, zero), _mm_cmple_ps(d2s.m128, zero))) & 15;
+
+				// if completely in front of a face, no intersection with the entire brush,
+				// the crossed faces before it still count as collided
+				if(front)
+				{
+					if(crossing & ((front & -front) - 1))
+					{
+						brush->collided = qtrue;
+					}
+					return;
+				}
+
+				if(crossing)
+				{
+					fs.m128 = CM_ClipFractions(d1s.m128, d2s.m128,
+											   CM_SelectPS(_mm_cmpgt_ps(d1s.m128, d2s.m128), _mm_sub_ps(zero, epsilon), epsilon), crossing);
+				}
+			}
+
+			d1 = d1s.f[i & 3];
+			d2 = d2s.f[i & 3];
+#else
 			// adjust the plane distance appropriately for mins/maxs
 			dist = plane->dist - DotProduct(tw->offsets[plane->signbits], plane->normal);
 
 			d1 = DotProduct(tw->start, plane->normal) - dist;
 			d2 = DotProduct(tw->end, plane->normal) - dist;
+#endif
 
 			if(d2 > 0)
 			{
@@ -1251,7 +1598,11 @@ void CM_TraceThroughBrush(traceWork_t * tw, cbrush_t * brush)
 			// crosses face
 			if(d1 > d2)
 			{					// enter
+#if defined(idx86_sse)
+				f = fs.f[i & 3];
+#else
 				f = (d1 - SURFACE_CLIP_EPSILON) / (d1 - d2);
+#endif
 				if(f < 0)
 				{
 					f = 0;
@@ -1265,7 +1616,11 @@ void CM_TraceThroughBrush(traceWork_t * tw, cbrush_t * brush)
 			}
 			else
 			{					// leave
+#if defined(idx86_sse)
+				f = fs.f[i & 3];
+#else
 				f = (d1 + SURFACE_CLIP_EPSILON) / (d1 - d2);
+#endif
 				if(f > 1)
 				{
 					f = 1;
@@ -1552,11 +1907,11 @@ static void CM_TraceThroughLeaf(traceWork_t * tw, cLeaf_t * leaf)
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush + k];
 
 		brush = &cm.brushes[brushnum];
-		if(brush->checkcount == cm.checkcount)
+		if(brush->checkcount == cm_checkcount)
 		{
 			continue;			// already checked this brush in another leaf
 		}
-		brush->checkcount = cm.checkcount;
+		brush->checkcount = cm_checkcount;
 
 		if(!(brush->contents & tw->contents))
 		{
@@ -1597,11 +1952,11 @@ static void CM_TraceThroughLeaf(traceWork_t * tw, cLeaf_t * leaf)
 		{
 			continue;
 		}
-		if(patch->checkcount == cm.checkcount)
+		if(patch->checkcount == cm_checkcount)
 		{
 			continue;		// already checked this patch in another leaf
 		}
-		patch->checkcount = cm.checkcount;
+		patch->checkcount = cm_checkcount;
 
 		if(!(patch->contents & tw->contents))
 		{
@@ -1651,10 +2006,10 @@ void CM_TraceThroughLeaf(traceWork_t * tw, cLeaf_t * leaf)
 
 		b = &cm.brushes[brushnum];
 
-		if(b->checkcount == cm.checkcount)
+		if(b->checkcount == cm_checkcount)
 			continue;			// already checked this brush in another leaf
 
-		b->checkcount = cm.checkcount;
+		b->checkcount = cm_checkcount;
 
 		if(!(b->contents & tw->contents))
 			continue;
@@ -1683,10 +2038,10 @@ void CM_TraceThroughLeaf(traceWork_t * tw, cLeaf_t * leaf)
 		if(!surface)
 			continue;
 
-		if(surface->checkcount == cm.checkcount)
+		if(surface->checkcount == cm_checkcount)
 			continue;			// already checked this surface in another leaf
 
-		surface->checkcount = cm.checkcount;
+		surface->checkcount = cm_checkcount;
 
 		if(!(surface->contents & tw->contents))
 			continue;
@@ -2072,45 +2427,30 @@ void CM_TraceBoundingBoxThroughCapsule(traceWork_t * tw, clipHandle_t model)
 
 //=========================================================================================
 
+typedef enum
+{
+	TS_FRONT,					// entirely on the front side
+	TS_BACK,					// entirely on the back side
+	TS_CROSS_FRONT,				// crosses, starting on the front side
+	TS_CROSS_BACK				// crosses, starting on the back side
+} traceSplit_t;
+
 /*
 ==================
-CM_TraceThroughTree
+CM_SplitTrace
 
-Traverse all the contacted leafs from the start to the end position.
-If the trace is a point, they will be exactly in order, but for larger
-trace volumes it is possible to hit something in a later leaf with
-a smaller intercept fraction.
+Classifies the part p1f to p2f of a trace against a node plane.  If it
+crosses, near is the part on the starting side and far the rest, both
+pulled out by SURFACE_CLIP_EPSILON so the box is in both.
 ==================
 */
-static void CM_TraceThroughTree(traceWork_t * tw, int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
+static traceSplit_t CM_SplitTrace(const traceWork_t * tw, const cplane_t * plane, float p1f, float p2f, const vec3_t p1,
+								  const vec3_t p2, float *nearf, vec3_t nearp, float *farf, vec3_t farp)
 {
-	cNode_t        *node;
-	cplane_t       *plane;
 	float           t1, t2, offset;
 	float           frac, frac2;
 	float           idist;
-	vec3_t          mid;
 	int             side;
-	float           midf;
-
-	if(tw->trace.fraction <= p1f)
-	{
-		return;					// already hit something nearer
-	}
-
-	// if < 0, we are in a leaf node
-	if(num < 0)
-	{
-		CM_TraceThroughLeaf(tw, &cm.leafs[-1 - num]);
-		return;
-	}
-
-	//
-	// find the point distances to the seperating plane
-	// and the offset for the size of the box
-	//
-	node = cm.nodes + num;
-	plane = node->plane;
 
 	// adjust the plane distance appropriately for mins/maxs
 	if(plane->type < 3)
@@ -2137,13 +2477,11 @@ static void CM_TraceThroughTree(traceWork_t * tw, int num, float p1f, float p2f,
 	// see which sides we need to consider
 	if(t1 >= offset + 1 && t2 >= offset + 1)
 	{
-		CM_TraceThroughTree(tw, node->children[0], p1f, p2f, p1, p2);
-		return;
+		return TS_FRONT;
 	}
 	if(t1 < -offset - 1 && t2 < -offset - 1)
 	{
-		CM_TraceThroughTree(tw, node->children[1], p1f, p2f, p1, p2);
-		return;
+		return TS_BACK;
 	}
 
 	// put the crosspoint SURFACE_CLIP_EPSILON pixels on the near side
@@ -2178,14 +2516,11 @@ static void CM_TraceThroughTree(traceWork_t * tw, int num, float p1f, float p2f,
 		frac = 1;
 	}
 
-	midf = p1f + (p2f - p1f) * frac;
-
-	mid[0] = p1[0] + frac * (p2[0] - p1[0]);
-	mid[1] = p1[1] + frac * (p2[1] - p1[1]);
-	mid[2] = p1[2] + frac * (p2[2] - p1[2]);
-
-	CM_TraceThroughTree(tw, node->children[side], p1f, midf, p1, mid);
+	*nearf = p1f + (p2f - p1f) * frac;
 
+	nearp[0] = p1[0] + frac * (p2[0] - p1[0]);
+	nearp[1] = p1[1] + frac * (p2[1] - p1[1]);
+	nearp[2] = p1[2] + frac * (p2[2] - p1[2]);
 
 	// go past the node
 	if(frac2 < 0)
@@ -2197,140 +2532,193 @@ static void CM_TraceThroughTree(traceWork_t * tw, int num, float p1f, float p2f,
 		frac2 = 1;
 	}
 
-	midf = p1f + (p2f - p1f) * frac2;
+	*farf = p1f + (p2f - p1f) * frac2;
 
-	mid[0] = p1[0] + frac2 * (p2[0] - p1[0]);
-	mid[1] = p1[1] + frac2 * (p2[1] - p1[1]);
-	mid[2] = p1[2] + frac2 * (p2[2] - p1[2]);
+	farp[0] = p1[0] + frac2 * (p2[0] - p1[0]);
+	farp[1] = p1[1] + frac2 * (p2[1] - p1[1]);
+	farp[2] = p1[2] + frac2 * (p2[2] - p1[2]);
 
-	CM_TraceThroughTree(tw, node->children[side ^ 1], midf, p2f, mid, p2);
+	return side ? TS_CROSS_BACK : TS_CROSS_FRONT;
 }
 
-
-//======================================================================
-
-
 /*
 ==================
-CM_Trace
+CM_TraceThroughTree
+
+Traverse all the contacted leafs from the start to the end position.
+If the trace is a point, they will be exactly in order, but for larger
+trace volumes it is possible to hit something in a later leaf with
+a smaller intercept fraction.
 ==================
 */
-static void CM_Trace(trace_t * results, const vec3_t start,
-			  const vec3_t end, vec3_t mins, vec3_t maxs,
-			  clipHandle_t model, const vec3_t origin, int brushmask, traceType_t type, sphere_t * sphere)
+static void CM_TraceThroughTree(traceWork_t * tw, int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
 {
-	int             i;
-	traceWork_t     tw;
-	vec3_t          offset;
-	cmodel_t       *cmod;
-
-	cmod = CM_ClipHandleToModel(model);
-
-	cm.checkcount++;			// for multi-check avoidance
-
-	c_traces++;					// for statistics, may be zeroed
-
-	// fill in a default trace
-	Com_Memset(&tw, 0, sizeof(tw));
-	tw.trace.fraction = 1;		// assume it goes the entire distance until shown otherwise
-	VectorCopy(origin, tw.modelOrigin);
-	tw.type = type;
+	cNode_t        *node;
+	vec3_t          mid, mid2;
+	int             side;
+	float           midf, midf2;
 
-	if(!cm.numNodes)
+	if(tw->trace.fraction <= p1f)
 	{
-		*results = tw.trace;
-
-		return;					// map not loaded, shouldn't happen
+		return;					// already hit something nearer
 	}
 
-	// allow NULL to be passed in for 0,0,0
-	if(!mins)
-	{
-		mins = vec3_origin;
-	}
-	if(!maxs)
+	// if < 0, we are in a leaf node
+	if(num < 0)
 	{
-		maxs = vec3_origin;
+		CM_TraceThroughLeaf(tw, &cm.leafs[-1 - num]);
+		return;
 	}
 
-	// set basic parms
-	tw.contents = brushmask;
-
-	// adjust so that mins and maxs are always symetric, which
+	//
+	// find the point distances to the seperating plane
+	// and the offset for the size of the box
+	//
+	node = cm.nodes + num;
+
+	switch(CM_SplitTrace(tw, node->plane, p1f, p2f, p1, p2, &midf, mid, &midf2, mid2))
+	{
+		case TS_FRONT:
+			CM_TraceThroughTree(tw, node->children[0], p1f, p2f, p1, p2);
+			return;
+
+		case TS_BACK:
+			CM_TraceThroughTree(tw, node->children[1], p1f, p2f, p1, p2);
+			return;
+
+		case TS_CROSS_FRONT:
+			side = 0;
+			break;
+
+		default:
+			side = 1;
+			break;
+	}
+
+	// move up to the node
+	CM_TraceThroughTree(tw, node->children[side], p1f, midf, p1, mid);
+
+	// go past the node
+	CM_TraceThroughTree(tw, node->children[side ^ 1], midf2, p2f, mid2, p2);
+}
+
+
+//======================================================================
+
+
+/*
+==================
+CM_InitTraceWork
+
+Fills in the trace work for a box moving from start to end
+==================
+*/
+static void CM_InitTraceWork(traceWork_t * tw, const vec3_t start, const vec3_t end, vec3_t mins, vec3_t maxs,
+							 const vec3_t origin, int brushmask, traceType_t type, sphere_t * sphere)
+{
+	int             i;
+	vec3_t          offset;
+
+	// fill in a default trace
+	Com_Memset(tw, 0, sizeof(*tw));
+	tw->trace.fraction = 1;		// assume it goes the entire distance until shown otherwise
+	VectorCopy(origin, tw->modelOrigin);
+	tw->type = type;
+
+	// allow NULL to be passed in for 0,0,0
+	if(!mins)
+	{
+		mins = vec3_origin;
+	}
+	if(!maxs)
+	{
+		maxs = vec3_origin;
+	}
+
+	// set basic parms
+	tw->contents = brushmask;
+
+	// adjust so that mins and maxs are always symetric, which
 	// avoids some complications with plane expanding of rotated
 	// bmodels
 	for(i = 0; i < 3; i++)
 	{
 		offset[i] = (mins[i] + maxs[i]) * 0.5;
-		tw.size[0][i] = mins[i] - offset[i];
-		tw.size[1][i] = maxs[i] - offset[i];
-		tw.start[i] = start[i] + offset[i];
-		tw.end[i] = end[i] + offset[i];
+		tw->size[0][i] = mins[i] - offset[i];
+		tw->size[1][i] = maxs[i] - offset[i];
+		tw->start[i] = start[i] + offset[i];
+		tw->end[i] = end[i] + offset[i];
+#if defined(idx86_sse)
+		tw->startLanes[i] = _mm_set1_ps(tw->start[i]);
+		tw->endLanes[i] = _mm_set1_ps(tw->end[i]);
+		tw->sizeLanes[0][i] = _mm_set1_ps(tw->size[0][i]);
+		tw->sizeLanes[1][i] = _mm_set1_ps(tw->size[1][i]);
+#endif
 	}
 
 	// if a sphere is already specified
 	if(sphere)
 	{
-		tw.sphere = *sphere;
+		tw->sphere = *sphere;
 	}
 	else
 	{
-		tw.sphere.radius = (tw.size[1][0] > tw.size[1][2]) ? tw.size[1][2] : tw.size[1][0];
-		tw.sphere.halfheight = tw.size[1][2];
-		VectorSet(tw.sphere.offset, 0, 0, tw.size[1][2] - tw.sphere.radius);
+		tw->sphere.radius = (tw->size[1][0] > tw->size[1][2]) ? tw->size[1][2] : tw->size[1][0];
+		tw->sphere.halfheight = tw->size[1][2];
+		VectorSet(tw->sphere.offset, 0, 0, tw->size[1][2] - tw->sphere.radius);
 	}
 
-	tw.maxOffset = tw.size[1][0] + tw.size[1][1] + tw.size[1][2];
+	tw->maxOffset = tw->size[1][0] + tw->size[1][1] + tw->size[1][2];
 
-	// tw.offsets[signbits] = vector to apropriate corner from origin
-	tw.offsets[0][0] = tw.size[0][0];
-	tw.offsets[0][1] = tw.size[0][1];
-	tw.offsets[0][2] = tw.size[0][2];
+	// tw->offsets[signbits] = vector to apropriate corner from origin
+	tw->offsets[0][0] = tw->size[0][0];
+	tw->offsets[0][1] = tw->size[0][1];
+	tw->offsets[0][2] = tw->size[0][2];
 
-	tw.offsets[1][0] = tw.size[1][0];
-	tw.offsets[1][1] = tw.size[0][1];
-	tw.offsets[1][2] = tw.size[0][2];
+	tw->offsets[1][0] = tw->size[1][0];
+	tw->offsets[1][1] = tw->size[0][1];
+	tw->offsets[1][2] = tw->size[0][2];
 
-	tw.offsets[2][0] = tw.size[0][0];
-	tw.offsets[2][1] = tw.size[1][1];
-	tw.offsets[2][2] = tw.size[0][2];
+	tw->offsets[2][0] = tw->size[0][0];
+	tw->offsets[2][1] = tw->size[1][1];
+	tw->offsets[2][2] = tw->size[0][2];
 
-	tw.offsets[3][0] = tw.size[1][0];
-	tw.offsets[3][1] = tw.size[1][1];
-	tw.offsets[3][2] = tw.size[0][2];
+	tw->offsets[3][0] = tw->size[1][0];
+	tw->offsets[3][1] = tw->size[1][1];
+	tw->offsets[3][2] = tw->size[0][2];
 
-	tw.offsets[4][0] = tw.size[0][0];
-	tw.offsets[4][1] = tw.size[0][1];
-	tw.offsets[4][2] = tw.size[1][2];
+	tw->offsets[4][0] = tw->size[0][0];
+	tw->offsets[4][1] = tw->size[0][1];
+	tw->offsets[4][2] = tw->size[1][2];
 
-	tw.offsets[5][0] = tw.size[1][0];
-	tw.offsets[5][1] = tw.size[0][1];
-	tw.offsets[5][2] = tw.size[1][2];
+	tw->offsets[5][0] = tw->size[1][0];
+	tw->offsets[5][1] = tw->size[0][1];
+	tw->offsets[5][2] = tw->size[1][2];
 
-	tw.offsets[6][0] = tw.size[0][0];
-	tw.offsets[6][1] = tw.size[1][1];
-	tw.offsets[6][2] = tw.size[1][2];
+	tw->offsets[6][0] = tw->size[0][0];
+	tw->offsets[6][1] = tw->size[1][1];
+	tw->offsets[6][2] = tw->size[1][2];
 
-	tw.offsets[7][0] = tw.size[1][0];
-	tw.offsets[7][1] = tw.size[1][1];
-	tw.offsets[7][2] = tw.size[1][2];
+	tw->offsets[7][0] = tw->size[1][0];
+	tw->offsets[7][1] = tw->size[1][1];
+	tw->offsets[7][2] = tw->size[1][2];
 
 	//
 	// calculate bounds
 	//
-	if(tw.type == TT_CAPSULE)
+	if(tw->type == TT_CAPSULE)
 	{
 		for(i = 0; i < 3; i++)
 		{
-			if(tw.start[i] < tw.end[i])
+			if(tw->start[i] < tw->end[i])
 			{
-				tw.bounds[0][i] = tw.start[i] - fabs(tw.sphere.offset[i]) - tw.sphere.radius;
-				tw.bounds[1][i] = tw.end[i] + fabs(tw.sphere.offset[i]) + tw.sphere.radius;
+				tw->bounds[0][i] = tw->start[i] - fabs(tw->sphere.offset[i]) - tw->sphere.radius;
+				tw->bounds[1][i] = tw->end[i] + fabs(tw->sphere.offset[i]) + tw->sphere.radius;
 			}
 			else
 			{
-				tw.bounds[0][i] = tw.end[i] - fabs(tw.sphere.offset[i]) - tw.sphere.radius;
-				tw.bounds[1][i] = tw.start[i] + fabs(tw.sphere.offset[i]) + tw.sphere.radius;
+				tw->bounds[0][i] = tw->end[i] - fabs(tw->sphere.offset[i]) - tw->sphere.radius;
+				tw->bounds[1][i] = tw->start[i] + fabs(tw->sphere.offset[i]) + tw->sphere.radius;
 			}
 		}
 	}
@@ -2338,18 +2726,46 @@ static void CM_Trace(trace_t * results, const vec3_t start,
 	{
 		for(i = 0; i < 3; i++)
 		{
-			if(tw.start[i] < tw.end[i])
+			if(tw->start[i] < tw->end[i])
 			{
-				tw.bounds[0][i] = tw.start[i] + tw.size[0][i];
-				tw.bounds[1][i] = tw.end[i] + tw.size[1][i];
+				tw->bounds[0][i] = tw->start[i] + tw->size[0][i];
+				tw->bounds[1][i] = tw->end[i] + tw->size[1][i];
 			}
 			else
 			{
-				tw.bounds[0][i] = tw.end[i] + tw.size[0][i];
-				tw.bounds[1][i] = tw.start[i] + tw.size[1][i];
+				tw->bounds[0][i] = tw->end[i] + tw->size[0][i];
+				tw->bounds[1][i] = tw->start[i] + tw->size[1][i];
 			}
 		}
 	}
+}
+
+/*
+==================
+CM_Trace
+==================
+*/
+static void CM_Trace(trace_t * results, const vec3_t start,
+			  const vec3_t end, vec3_t mins, vec3_t maxs,
+			  clipHandle_t model, const vec3_t origin, int brushmask, traceType_t type, sphere_t * sphere)
+{
+	traceWork_t     tw;
+	cmodel_t       *cmod;
+
+	cmod = CM_ClipHandleToModel(model);
+
+	CM_NextCheckCount();			// for multi-check avoidance
+
+	c_traces++;					// for statistics, may be zeroed
+
+	CM_InitTraceWork(&tw, start, end, mins, maxs, origin, brushmask, type, sphere);
+
+	if(!cm.numNodes)
+	{
+		*results = tw.trace;
+
+		return;					// map not loaded, shouldn't happen
+	}
 
 	//
 	// check for position test special case
@@ -2482,6 +2898,389 @@ void CM_BoxTrace(trace_t * results, const vec3_t start, const vec3_t end,
 	CM_Trace(results, start, end, mins, maxs, model, vec3_origin, brushmask, type, NULL);
 }
 
+/*
+===============================================================================
+
+BATCHED TRACES
+
+Sweeps of the same box are traced in groups of TRACE_BATCH_LANES.  A group
+walks the tree together so every node is classified once for all the traces
+that reach it, and the brush sides of a leaf are tested against all of them
+at once.  Each trace still visits the nodes, leafs, brushes and surfaces in
+the same order it would on its own, so the results match CM_BoxTrace exactly.
+
+===============================================================================
+*/
+
+typedef struct
+{
+	traceWork_t     tw[TRACE_BATCH_LANES];
+	traceWork_t    *work[TRACE_BATCH_LANES];	// &tw[lane]
+	int             contents;
+} traceBatch_t;
+
+typedef struct
+{
+	float           p1f, p2f;
+	vec3_t          p1, p2;
+} traceSpan_t;
+
+/*
+================
+CM_TraceThroughBrushBatch
+================
+*/
+static void CM_TraceThroughBrushBatch(traceBatch_t * tb, cbrush_t * brush, int lanes)
+{
+#if defined(idx86_sse)
+	CM_TraceThroughBrushLanes(tb->work, brush, lanes);
+#else
+	int             lane;
+
+	for(lane = 0; lane < TRACE_BATCH_LANES; lane++)
+	{
+		if(lanes & (1 << lane))
+		{
+			CM_TraceThroughBrush(tb->work[lane], brush);
+		}
+	}
+#endif
+}
+
+/*
+================
+CM_TraceThroughLeafBatch
+
+CM_TraceThroughLeaf for all traces of lanes.  A brush or surface remembers
+which lanes of the current batch already tested it, so a trace that reaches
+it again through another leaf skips it just like a single trace does.
+================
+*/
+static void CM_TraceThroughLeafBatch(traceBatch_t * tb, cLeaf_t * leaf, int lanes)
+{
+	int             k, lane, test, hit;
+	cbrush_t       *b;
+	cSurface_t     *surface;
+	traceWork_t    *tw;
+
+	// trace lines against all brushes in the leaf
+	for(k = 0; k < leaf->numLeafBrushes && lanes; k++)
+	{
+		b = &cm.brushes[cm.leafbrushes[leaf->firstLeafBrush + k]];
+
+		if(b->checkcount != cm_checkcount)
+		{
+			b->checkcount = cm_checkcount;
+			b->checkLanes = 0;
+		}
+
+		test = lanes & ~b->checkLanes;
+		if(!test)
+			continue;			// already checked this brush in another leaf
+
+		b->checkLanes |= test;
+
+		if(!(b->contents & tb->contents))
+			continue;
+
+		b->collided = qfalse;
+
+		hit = 0;
+		for(lane = 0; lane < TRACE_BATCH_LANES; lane++)
+		{
+			tw = &tb->tw[lane];
+
+			if((test & (1 << lane)) && CM_BoundsIntersect(tw->bounds[0], tw->bounds[1], b->bounds[0], b->bounds[1]))
+			{
+				hit |= 1 << lane;
+			}
+		}
+
+		if(!hit)
+			continue;
+
+		CM_TraceThroughBrushBatch(tb, b, hit);
+
+		for(lane = 0; lane < TRACE_BATCH_LANES; lane++)
+		{
+			tw = &tb->tw[lane];
+
+			if((hit & (1 << lane)) && !tw->trace.fraction)
+			{
+				tw->trace.lateralFraction = 0.0f;
+				lanes &= ~(1 << lane);
+			}
+		}
+	}
+
+	// trace lines against all surfaces in the leaf
+	for(k = 0; k < leaf->numLeafSurfaces && lanes; k++)
+	{
+		surface = cm.surfaces[cm.leafsurfaces[leaf->firstLeafSurface + k]];
+
+		if(!surface)
+			continue;
+
+		if(surface->checkcount != cm_checkcount)
+		{
+			surface->checkcount = cm_checkcount;
+			surface->checkLanes = 0;
+		}
+
+		test = lanes & ~surface->checkLanes;
+		if(!test)
+			continue;			// already checked this surface in another leaf
+
+		surface->checkLanes |= test;
+
+		if(!(surface->contents & tb->contents))
+			continue;
+
+		for(lane = 0; lane < TRACE_BATCH_LANES; lane++)
+		{
+			tw = &tb->tw[lane];
+
+			if(!(test & (1 << lane)))
+				continue;
+
+			if(!CM_BoundsIntersect(tw->bounds[0], tw->bounds[1], surface->sc->bounds[0], surface->sc->bounds[1]))
+				continue;
+
+			CM_TraceThroughSurface(tw, surface);
+
+			if(!tw->trace.fraction)
+			{
+				tw->trace.lateralFraction = 0.0f;
+				lanes &= ~(1 << lane);
+			}
+		}
+	}
+}
+
+/*
+==================
+CM_TraceThroughTreeBatch
+
+CM_TraceThroughTree for all traces of lanes.  Traces that cross a node go
+down their near side first and their far side afterwards, so the children
+are visited front, back, front with only the traces that need each visit.
+==================
+*/
+static void CM_TraceThroughTreeBatch(traceBatch_t * tb, int num, int lanes, const traceSpan_t * spans)
+{
+	cNode_t        *node;
+	const traceSpan_t *span;
+	traceSpan_t     nearSpans[TRACE_BATCH_LANES];
+	traceSpan_t     farSpans[TRACE_BATCH_LANES];
+	int             lane;
+	int             front, back, crossFront, crossBack;
+
+	for(lane = 0; lane < TRACE_BATCH_LANES; lane++)
+	{
+		if((lanes & (1 << lane)) && tb->tw[lane].trace.fraction <= spans[lane].p1f)
+		{
+			lanes &= ~(1 << lane);	// already hit something nearer
+		}
+	}
+
+	if(!lanes)
+	{
+		return;
+	}
+
+	// if < 0, we are in a leaf node
+	if(num < 0)
+	{
+		CM_TraceThroughLeafBatch(tb, &cm.leafs[-1 - num], lanes);
+		return;
+	}
+
+	node = cm.nodes + num;
+
+	front = back = crossFront = crossBack = 0;
+
+	for(lane = 0; lane < TRACE_BATCH_LANES; lane++)
+	{
+		if(!(lanes & (1 << lane)))
+		{
+			continue;
+		}
+
+		span = &spans[lane];
+		nearSpans[lane] = *span;
+		farSpans[lane] = *span;
+
+		switch(CM_SplitTrace(&tb->tw[lane], node->plane, span->p1f, span->p2f, span->p1, span->p2,
+							 &nearSpans[lane].p2f, nearSpans[lane].p2, &farSpans[lane].p1f, farSpans[lane].p1))
+		{
+			case TS_FRONT:
+				front |= 1 << lane;
+				break;
+
+			case TS_BACK:
+				back |= 1 << lane;
+				break;
+
+			case TS_CROSS_FRONT:
+				crossFront |= 1 << lane;
+				break;
+
+			default:
+				crossBack |= 1 << lane;
+				break;
+		}
+	}
+
+	if(front | crossFront)
+	{
+		CM_TraceThroughTreeBatch(tb, node->children[0], front | crossFront, nearSpans);
+	}
+
+	if(back | crossBack | crossFront)
+	{
+		// traces that went down the front already continue on their far side
+		for(lane = 0; lane < TRACE_BATCH_LANES; lane++)
+		{
+			if(crossFront & (1 << lane))
+			{
+				nearSpans[lane] = farSpans[lane];
+			}
+		}
+
+		CM_TraceThroughTreeBatch(tb, node->children[1], back | crossBack | crossFront, nearSpans);
+	}
+
+	if(crossBack)
+	{
+		CM_TraceThroughTreeBatch(tb, node->children[0], crossBack, farSpans);
+	}
+}
+
+/*
+==================
+CM_TraceBatchLanes
+
+Sweeps the box through the world or an inline model for up to
+TRACE_BATCH_LANES of the traces
+==================
+*/
+static void CM_TraceBatchLanes(trace_t * results, const int *traces, int numLanes, const vec3_t * starts, const vec3_t * ends,
+							   vec3_t mins, vec3_t maxs, clipHandle_t model, int brushmask)
+{
+	traceBatch_t    tb;
+	traceSpan_t     spans[TRACE_BATCH_LANES];
+	traceWork_t    *tw;
+	int             i, lane;
+
+	CM_NextCheckCount();			// one check for the whole batch, the lanes are told apart by checkLanes
+
+	for(lane = 0; lane < TRACE_BATCH_LANES; lane++)
+	{
+		// unused lanes repeat the first trace so the side tests stay finite
+		i = traces[lane < numLanes ? lane : 0];
+		tw = &tb.tw[lane];
+		tb.work[lane] = tw;
+
+		if(lane < numLanes)
+		{
+			c_traces++;
+		}
+
+		CM_InitTraceWork(tw, starts[i], ends[i], mins, maxs, vec3_origin, brushmask, TT_AABB, NULL);
+
+		//
+		// check for point special case
+		//
+		if(tw->size[0][0] == 0 && tw->size[0][1] == 0 && tw->size[0][2] == 0)
+		{
+			tw->isPoint = qtrue;
+			VectorClear(tw->extents);
+		}
+		else
+		{
+			tw->isPoint = qfalse;
+			tw->extents[0] = tw->size[1][0];
+			tw->extents[1] = tw->size[1][1];
+			tw->extents[2] = tw->size[1][2];
+		}
+
+		spans[lane].p1f = 0;
+		spans[lane].p2f = 1;
+		VectorCopy(tw->start, spans[lane].p1);
+		VectorCopy(tw->end, spans[lane].p2);
+	}
+
+	tb.contents = brushmask;
+
+	if(model)
+	{
+		CM_TraceThroughLeafBatch(&tb, &CM_ClipHandleToModel(model)->leaf, (1 << numLanes) - 1);
+	}
+	else
+	{
+		CM_TraceThroughTreeBatch(&tb, 0, (1 << numLanes) - 1, spans);
+	}
+
+	for(lane = 0; lane < numLanes; lane++)
+	{
+		i = traces[lane];
+		tw = &tb.tw[lane];
+
+		// generate endpos from the original, unmodified start/end
+		if(tw->trace.fraction == 1)
+		{
+			VectorCopy(ends[i], tw->trace.endpos);
+		}
+		else
+		{
+			VectorLerp(starts[i], ends[i], tw->trace.fraction, tw->trace.endpos);
+		}
+
+		results[i] = tw->trace;
+	}
+}
+
+/*
+==================
+CM_BoxTraceBatch
+
+Traces the same box along numTraces paths, the results are identical to
+calling CM_BoxTrace with TT_AABB for each of them.  Position tests and
+capsule models are handed to CM_BoxTrace one by one.
+==================
+*/
+void CM_BoxTraceBatch(trace_t * results, int numTraces, const vec3_t * starts, const vec3_t * ends,
+					  vec3_t mins, vec3_t maxs, clipHandle_t model, int brushmask)
+{
+	int             i, numLanes;
+	int             traces[TRACE_BATCH_LANES];
+
+	numLanes = 0;
+
+	for(i = 0; i < numTraces; i++)
+	{
+		if(!cm.numNodes || model == CAPSULE_MODEL_HANDLE || VectorCompare(starts[i], ends[i]))
+		{
+			CM_BoxTrace(&results[i], starts[i], ends[i], mins, maxs, model, brushmask, TT_AABB);
+			continue;
+		}
+
+		traces[numLanes++] = i;
+
+		if(numLanes == TRACE_BATCH_LANES)
+		{
+			CM_TraceBatchLanes(results, traces, numLanes, starts, ends, mins, maxs, model, brushmask);
+			numLanes = 0;
+		}
+	}
+
+	if(numLanes)
+	{
+		CM_TraceBatchLanes(results, traces, numLanes, starts, ends, mins, maxs, model, brushmask);
+	}
+}
+
+
 /*
 ==================
 CM_TransformedBoxTrace
@@ -2720,7 +3519,7 @@ void CM_BiSphereTrace(trace_t * results, const vec3_t start,
 
 	cmod = CM_ClipHandleToModel(model);
 
-	cm.checkcount++;			// for multi-check avoidance
+	CM_NextCheckCount();			// for multi-check avoidance
 
 	c_traces++;					// for statistics, may be zeroed
 
@@ -281,6 +281,14 @@ void QDECL Com_Error(int code, const char *fmt, ...)
   static int lastErrorTime;
   static int errorCount;
   int currentTime;
+  char jobMessage[MAXPRINTMSG];
+
+  // errors inside a work item are raised on the main thread after the job
+  va_start(argptr, fmt);
+  Q_vsnprintf(jobMessage, sizeof(jobMessage), fmt, argptr);
+  va_end(argptr);
+  Com_JobError(code, jobMessage);
+
   if (com_errorEntered)
     Sys_Error("recursive error after: %s", com_errorMessage);
 
@@ -785,7 +793,8 @@ int Com_RealTime(qtime_t *qtime)
  The rover can be left pointing at a non-empty block
 
  The zone calls are pretty much only used for small strings and structures,
- all big things are allocated on the hunk.
+ all big things are allocated on the hunk.  Most of the small ones are
+ handed to the slab pools in slab.cc and never reach the zone.
  ==============================================================================
  */
 
@@ -872,6 +881,28 @@ int Z_AvailableMemory(void)
   return Z_AvailableZoneMemory(mainzone);
 }
 
+/*
+ ========================
+ Z_FreeBlocks
+
+ Number of free blocks in the main zone, a measure of fragmentation
+ ========================
+ */
+int Z_FreeBlocks(void)
+{
+  memblock_t *block;
+  int count;
+
+  count = 0;
+  for (block = mainzone->blocklist.next; block != &mainzone->blocklist; block = block->next)
+  {
+    if (!block->tag)
+      count++;
+  }
+
+  return count;
+}
+
 /*
  ========================
  Z_Free
@@ -885,6 +916,11 @@ void Z_Free(void *ptr)
   if (!ptr)
     Com_Error(ERR_DROP, "Z_Free: NULL pointer");
 
+  Z_TraceFree(ptr);
+
+  if (Z_SlabFree(ptr))
+    return;
+
   block = (memblock_t *)((byte *)ptr - sizeof(memblock_t));
   if (block->id != ZONEID)
     Com_Error(ERR_FATAL, "Z_Free: freed a pointer without ZONEID");
@@ -951,6 +987,8 @@ void Z_FreeTags(int tag)
   int count;
   memzone_t *zone;
 
+  Z_SlabFreeTags(tag);
+
   if (tag == TAG_SMALL)
     zone = smallzone;
   else
@@ -990,10 +1028,24 @@ void *Z_TagMalloc(size_t size, int tag)
 #endif
   memblock_t *start, *rover, *neww, *base;
   memzone_t *zone;
+  size_t requestSize = size;
+#ifndef ZONE_DEBUG
+  void *ptr;
+#endif
 
   if (!tag)
     Com_Error(ERR_FATAL, "Z_TagMalloc: tried to use a 0 tag");
 
+#ifndef ZONE_DEBUG
+  // small allocations come from the slab pools
+  ptr = Z_SlabAlloc(size, tag);
+  if (ptr)
+  {
+    Z_TraceAlloc(ptr, size, tag);
+    return ptr;
+  }
+#endif
+
   if (tag == TAG_SMALL)
     zone = smallzone;
   else
@@ -1068,6 +1120,8 @@ void *Z_TagMalloc(size_t size, int tag)
   // marker for memory trash testing
   *(int *)((byte *)base + base->size - 4) = ZONEID;
 
+  Z_TraceAlloc(base + 1, requestSize, tag);
+
   return (void *)((byte *)base + sizeof(memblock_t));
 }
 
@@ -1433,6 +1487,8 @@ void Com_Meminfo_f(void)
   Com_Printf("        %9i bytes (%6.2f MB) in dynamic other\n", zoneBytes - (botlibBytes + rendererBytes),
          (zoneBytes - (botlibBytes + rendererBytes)) / Square(1024.f));
   Com_Printf("        %9i bytes (%6.2f MB) in small Zone memory\n", smallZoneBytes, smallZoneBytes / Square(1024.f));
+  Com_Printf("\n");
+  Z_SlabMeminfo();
 }
 
 /*
@@ -1534,6 +1590,7 @@ void Com_InitZoneMemory(void)
   }
   Z_ClearZone(mainzone, s_zoneTotal);
 
+  Z_InitSlabs();
 }
 
 /*
@@ -1683,6 +1740,8 @@ void Com_InitHunkMemory(void)
   Hunk_Clear();
 
   Cmd_AddCommand("meminfo", Com_Meminfo_f);
+  Cmd_AddCommand("zonetrace", Z_Trace_f);
+  Cmd_AddCommand("zonereplay", Z_Replay_f);
 #ifdef ZONE_DEBUG
   Cmd_AddCommand("zonelog", Z_LogHeap);
 #endif
@@ -2855,6 +2914,8 @@ void Com_Init(char *commandLine)
   }
   Cmd_AddCommand("quit", Com_Quit_f);
   Cmd_AddCommand("changeVectors", MSG_ReportChangeVectors_f);
+  Cmd_AddCommand("huffTest", MSG_HuffTest_f);
+  Cmd_AddCommand("bitsTest", MSG_BitsTest_f);
   Cmd_AddCommand("writeconfig", Com_WriteConfig_f);
   Cmd_SetCommandCompletionFunc("writeconfig", Cmd_CompleteCfgName);
   Cmd_AddCommand("game_restart", Com_GameRestart_f);
@@ -3416,6 +3477,8 @@ void Com_Frame( void ) {
  */
 void Com_Shutdown(void)
 {
+  Com_ShutdownThreads();
+
   if (logfile)
   {
     FS_FCloseFile(logfile);
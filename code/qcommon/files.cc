@@ -201,11 +201,26 @@ static const unsigned pak_checksums[] = {
 #define MAX_SEARCH_PATHS 4096
 #define MAX_FILEHASH_SIZE 1024
 
+#define ZIP_LOCAL_HEADER_SIG 0x04034b50
+#define ZIP_LOCAL_HEADER_SIZE 30
+#define ZIP_CENTRAL_HEADER_SIG 0x02014b50
+#define ZIP_CENTRAL_HEADER_SIZE 46
+#define ZIP_END_HEADER_SIG 0x06054b50
+#define ZIP_END_HEADER_SIZE 22
+
+#define PAKCACHE_IDENT (('C'<<24)+('K'<<16)+('A'<<8)+'P')
+#define PAKCACHE_VERSION 2
+
 typedef struct fileInPack_s
 {
 	char *name;                              // name of the file
 	unsigned long pos;                       // file info position in zip
 	unsigned long			len;		// uncompress file size
+	unsigned long csize;                     // compressed file size
+	unsigned long localPos;                  // local header position in zip
+	unsigned long dataPos;                   // file data position in zip, 0 until first read from the mapping
+	unsigned long crc;
+	int method;                              // Z_DEFLATED or 0 when stored
 	struct  fileInPack_s *next;              // next file in the hash
 } fileInPack_t;
 
@@ -214,7 +229,9 @@ typedef struct {
 	char pakFilename[MAX_OSPATH];            // c:\quake3\baseq3\pak0.pk3
 	char pakBasename[MAX_OSPATH];            // pak0
 	char pakGamename[MAX_OSPATH];            // baseq3
-	unzFile handle;                          // handle to zip file
+	unzFile handle;                          // handle to zip file, opened on first streamed read
+	byte *mapped;                            // the whole zip file mapped read only, or NULL
+	long mappedLength;
 	int checksum;                            // regular checksum
 	int pure_checksum;                       // checksum for pure
 	int numfiles;                            // number of files in pk3
@@ -239,6 +256,45 @@ typedef struct searchpath_s
 	directory_t *dir;
 } searchpath_t;
 
+// a pak's directory as FS_WritePakCache keeps it
+typedef struct
+{
+	int ident;
+	int version;
+	int64_t fileLength;                      // the zip file it was read from
+	int64_t fileTime;
+	int numFiles;
+	int namesLength;
+	char pakFilename[MAX_OSPATH];
+} pakCacheHeader_t;
+
+typedef struct
+{
+	unsigned int pos;
+	unsigned int len;
+	unsigned int csize;
+	unsigned int localPos;
+	unsigned int crc;
+	int method;
+	int nameOfs;                             // into the names after the files
+} pakCacheFile_t;
+
+// every file of every pak, hashed once across all of them
+typedef struct fsIndexFile_s
+{
+	fileInPack_t *pakFile;
+	searchpath_t *search;
+	int order;                               // position of search in fs_searchpaths
+	struct fsIndexFile_s *nextPak;           // the same name in a later pak
+	struct fsIndexFile_s *next;              // next name in the hash
+} fsIndexFile_t;
+
+typedef struct
+{
+	searchpath_t *search;
+	int order;
+} fsIndexDir_t;
+
 static char fs_gamedir[MAX_OSPATH];          // this will be a single file name with no separators
 static cvar_t *fs_debug;
 static cvar_t *fs_homepath;
@@ -251,11 +307,29 @@ static cvar_t *fs_apppath;
 static cvar_t *fs_basepath;
 static cvar_t *fs_basegame;
 static cvar_t *fs_gamedirvar;
+static cvar_t *fs_mmap;                      // map pk3 files instead of reading them through stdio, 2 maps all files
+static cvar_t *fs_pakCache;                  // keep the parsed zip directories in pakcache/ under fs_homepath
 static searchpath_t *fs_searchpaths;
 static int fs_readCount;                     // total bytes read
 static int fs_loadCount;                     // total files read
 static int fs_loadStack;                     // total files in memory
 static	int			fs_packFiles = 0;		// total number of files in packs
+static int fs_packsCached;                   // packs whose directory came from the cache this FS_Startup
+static int fs_packsParsed;                   // packs whose directory had to be parsed
+
+static cvar_t *fs_index;                     // look files up in one index instead of in each pak
+static fsIndexFile_t **fs_indexHash;         // NULL when there is no index
+static fsIndexFile_t *fs_indexFiles;
+static int fs_indexHashSize;
+static int fs_indexNumFiles;
+static fsIndexDir_t fs_indexDirs[MAX_SEARCH_PATHS];   // directories are still probed, in search order
+static int fs_numIndexDirs;
+
+// since the last map load
+static int fs_lookups;                       // FS_FOpenFileRead calls
+static int fs_lookupMisses;
+static int fs_lookupProbes;                  // search paths tried by them
+static int fs_extensionQueries;
 
 static int fs_checksumFeed;
 
@@ -279,6 +353,9 @@ typedef struct
 	int zipFilePos;
 	int			zipFileLen;
 	qboolean zipFile;
+	qboolean zipOpened;                      // the zip file is opened on the first streamed read
+	pack_t *zipPack;
+	fileInPack_t *zipEntry;
 	qboolean streamed;
 	char name[MAX_ZPATH];
 } fileHandleData_t;
@@ -594,6 +671,29 @@ void FS_HomeRemove( const char *homePath ) {
 	remove( FS_BuildOSPath( fs_homepath->string,
 			fs_gamedir, homePath ) );
 }
+/*
+================
+FS_MapAllowed
+
+A mapped file raises SIGBUS once it is truncated or rewritten in place,
+which downloads and updates do to the files under fs_homepath.  fs_mmap 1
+only maps files outside of it, fs_mmap 2 maps everything.
+================
+*/
+static qboolean FS_MapAllowed(const char *ospath)
+{
+	size_t len;
+
+	if(fs_mmap->integer <= 0)
+		return qfalse;
+	if(fs_mmap->integer >= 2)
+		return qtrue;
+
+	len = strlen(fs_homepath->string);
+
+	return (len && !Q_stricmpn(ospath, fs_homepath->string, len)) ? qfalse : qtrue;
+}
+
 /*
 ================
 FS_FileInPathExists
@@ -760,6 +860,84 @@ long FS_SV_FOpenFileRead(const char *filename, fileHandle_t *fp)
 }
 
 
+/*
+===========
+FS_SV_MapFile
+===========
+*/
+long FS_SV_MapFile(const char *filename, void **data, qboolean *mapped)
+{
+	fileHandle_t f;
+	long len;
+	char *ospath;
+
+	*data = NULL;
+	*mapped = qfalse;
+
+	len = FS_SV_FOpenFileRead(filename, &f);
+	if(!f)
+	{
+		return -1;
+	}
+
+	if(len <= 0)
+	{
+		FS_FCloseFile(f);
+		return len;
+	}
+
+	// FS_SV_FOpenFileRead prefers fs_homepath
+	ospath = FS_BuildOSPath(fs_homepath->string, filename, "");
+	ospath[qstrlen(ospath) - 1] = '\0';
+	if(FS_FileInPathExists(ospath) ? FS_MapAllowed(ospath) : fs_mmap->integer > 0)
+	{
+		// the mapping outlives the handle
+		*data = Sys_MapFile(fsh[f].handleFiles.file.o, len);
+		*mapped = *data ? qtrue : qfalse;
+	}
+
+	// a copy doesn't care about the file changing afterwards
+	if(!*data)
+	{
+		*data = malloc(len);
+		if(*data && FS_Read(*data, len, f) != len)
+		{
+			free(*data);
+			*data = NULL;
+		}
+	}
+	FS_FCloseFile(f);
+
+	if(!*data)
+	{
+		return -1;
+	}
+
+	return len;
+}
+
+/*
+===========
+FS_UnmapFile
+===========
+*/
+void FS_UnmapFile(void *data, long length, qboolean mapped)
+{
+	if(!data)
+	{
+		return;
+	}
+
+	if(mapped)
+	{
+		Sys_UnmapFile(data, length);
+	}
+	else
+	{
+		free(data);
+	}
+}
+
 /*
 ===========
 FS_SV_Rename
@@ -839,9 +1017,11 @@ void FS_FCloseFile( fileHandle_t f ) {
 	}
 
 	if (fsh[f].zipFile == qtrue) {
-		unzCloseCurrentFile(fsh[f].handleFiles.file.z);
-		if ( fsh[f].handleFiles.unique ) {
-			unzClose(fsh[f].handleFiles.file.z);
+		if ( fsh[f].zipOpened ) {
+			unzCloseCurrentFile(fsh[f].handleFiles.file.z);
+			if ( fsh[f].handleFiles.unique ) {
+				unzClose(fsh[f].handleFiles.file.z);
+			}
 		}
 		Com_Memset(&fsh[f], 0, sizeof(fsh[f]));
 		return;
@@ -1217,23 +1397,12 @@ long FS_FOpenFileReadDir(const char *filename, searchpath_t *search, fileHandle_
           if(!(pak->referenced & FS_UI_REF) && strstr(filename, "uillvm.bc"))
             pak->referenced |= FS_UI_REF;
 #endif
-          if(uniqueFILE)
-          {
-            // open a new file on the pakfile
-            fsh[*file].handleFiles.file.z = unzOpen (pak->pakFilename);
-
-            if(fsh[*file].handleFiles.file.z == NULL)
-              Com_Error (ERR_FATAL, "Couldn't open %s", pak->pakFilename);
-          }
-          else
-            fsh[*file].handleFiles.file.z = pak->handle;
-
+          // the zip file is only opened if the file gets streamed,
+          // FS_ReadFile reads it straight out of a mapped pak
           Q_strncpyz(fsh[*file].name, filename, sizeof(fsh[*file].name));
           fsh[*file].zipFile = qtrue;
-          // set the file position in the zip file (also sets the current file info)
-          unzSetOffset(fsh[*file].handleFiles.file.z, pakFile->pos);
-          // open the file in the zip
-          unzOpenCurrentFile(fsh[*file].handleFiles.file.z);
+          fsh[*file].zipPack = pak;
+          fsh[*file].zipEntry = pakFile;
           fsh[*file].zipFilePos = pakFile->pos;
 					fsh[*file].zipFileLen = pakFile->len;
 
@@ -1296,6 +1465,140 @@ long FS_FOpenFileReadDir(const char *filename, searchpath_t *search, fileHandle_
   }
   return -1;
 }
+/*
+===========
+FS_FreeIndex
+===========
+*/
+static void FS_FreeIndex(void)
+{
+	if(fs_indexHash)
+	{
+		Z_Free(fs_indexHash);
+		Z_Free(fs_indexFiles);
+	}
+	fs_indexHash = NULL;
+	fs_indexFiles = NULL;
+	fs_indexHashSize = 0;
+	fs_indexNumFiles = 0;
+	fs_numIndexDirs = 0;
+}
+
+/*
+===========
+FS_BuildIndex
+
+Hashes the files of all paks into one table, where each name leads to
+the paks having it in search order. Has to be redone whenever
+fs_searchpaths changes.
+===========
+*/
+static void FS_BuildIndex(void)
+{
+	searchpath_t *search;
+	fsIndexFile_t *indexFile, *found;
+	fileInPack_t *pakFile;
+	int numFiles, order, hash, i;
+
+	FS_FreeIndex();
+
+	if(!fs_index->integer)
+		return;
+
+	numFiles = 0;
+	for(search = fs_searchpaths; search; search = search->next)
+	{
+		if(search->pack)
+			numFiles += search->pack->numfiles;
+	}
+
+	for(fs_indexHashSize = 1024; fs_indexHashSize < numFiles && fs_indexHashSize < (1 << 20); fs_indexHashSize <<= 1)
+		;
+
+	fs_indexHash = (fsIndexFile_t **)Z_Malloc(fs_indexHashSize * sizeof(*fs_indexHash));
+	fs_indexFiles = (fsIndexFile_t *)Z_Malloc((numFiles + 1) * sizeof(*fs_indexFiles));
+	fs_indexNumFiles = numFiles;
+
+	indexFile = fs_indexFiles;
+	for(search = fs_searchpaths, order = 0; search; search = search->next, order++)
+	{
+		if(!search->pack)
+		{
+			fs_indexDirs[fs_numIndexDirs].search = search;
+			fs_indexDirs[fs_numIndexDirs].order = order;
+			fs_numIndexDirs++;
+			continue;
+		}
+
+		for(i = 0; i < search->pack->numfiles; i++)
+		{
+			pakFile = &search->pack->buildBuffer[i];
+			hash = FS_HashFileName(pakFile->name, fs_indexHashSize);
+
+			indexFile->pakFile = pakFile;
+			indexFile->search = search;
+			indexFile->order = order;
+
+			for(found = fs_indexHash[hash]; found; found = found->next)
+			{
+				if(!FS_FilenameCompare(found->pakFile->name, pakFile->name))
+					break;
+			}
+
+			if(found)
+			{
+				// an earlier pak has it already
+				while(found->nextPak)
+					found = found->nextPak;
+				found->nextPak = indexFile;
+			}
+			else
+			{
+				indexFile->next = fs_indexHash[hash];
+				fs_indexHash[hash] = indexFile;
+			}
+			indexFile++;
+		}
+	}
+}
+
+/*
+===========
+FS_IndexFind
+
+The first pak in search order having filename
+===========
+*/
+static fsIndexFile_t *FS_IndexFind(const char *filename)
+{
+	fsIndexFile_t *indexFile;
+
+	if(filename[0] == '/' || filename[0] == '\\')
+		filename++;
+
+	for(indexFile = fs_indexHash[FS_HashFileName(filename, fs_indexHashSize)]; indexFile; indexFile = indexFile->next)
+	{
+		if(!FS_FilenameCompare(indexFile->pakFile->name, filename))
+			return indexFile;
+	}
+	return NULL;
+}
+
+/*
+===========
+FS_OpenedFile
+
+Whether FS_FOpenFileReadDir found the file
+===========
+*/
+static qboolean FS_OpenedFile(long len, fileHandle_t *file)
+{
+	if(file == NULL)
+		return len > 0 ? qtrue : qfalse;
+
+	return (len >= 0 && *file) ? qtrue : qfalse;
+}
+
 /*
 ===========
 FS_FOpenFileRead
@@ -1308,24 +1611,48 @@ separate file or a ZIP file.
 long FS_FOpenFileRead(const char *filename, fileHandle_t *file, qboolean uniqueFILE)
 {
   searchpath_t *search;
+  fsIndexFile_t *indexFile;
   long len;
+  int dir;
   if(!fs_searchpaths)
     Com_Error(ERR_FATAL, "Filesystem call made without initialization");
 
-  for(search = fs_searchpaths; search; search = search->next)
+  fs_lookups++;
+
+  if(fs_indexHash && filename)
   {
-	        len = FS_FOpenFileReadDir(filename, search, file, uniqueFILE, qfalse);
-    if(file == NULL)
+    // only the paks having the file and the directories need a look,
+    // in the same order as fs_searchpaths
+    indexFile = FS_IndexFind(filename);
+    dir = 0;
+    while(indexFile || dir < fs_numIndexDirs)
     {
-      if(len > 0)
+      if(dir < fs_numIndexDirs && (!indexFile || fs_indexDirs[dir].order < indexFile->order))
+        search = fs_indexDirs[dir++].search;
+      else
+      {
+        search = indexFile->search;
+        indexFile = indexFile->nextPak;
+      }
+
+      fs_lookupProbes++;
+      len = FS_FOpenFileReadDir(filename, search, file, uniqueFILE, qfalse);
+      if(FS_OpenedFile(len, file))
         return len;
     }
-    else
+  }
+  else
+  {
+    for(search = fs_searchpaths; search; search = search->next)
     {
-      if(len >= 0 && *file)
+      fs_lookupProbes++;
+      len = FS_FOpenFileReadDir(filename, search, file, uniqueFILE, qfalse);
+      if(FS_OpenedFile(len, file))
         return len;
     }
   }
+
+  fs_lookupMisses++;
 #ifdef FS_MISSING
 if(missingFiles)
     fprintf(missingFiles, "%s\n", filename);
@@ -1344,6 +1671,88 @@ if(missingFiles)
 	}
 }
 
+/*
+===========
+FS_FileExtensions
+
+Which of the extensions exist for the file name without extension,
+bit i is set if name.exts[i] is in the search path
+===========
+*/
+int FS_FileExtensions(const char *name, const char **exts, int numExts)
+{
+	char path[MAX_QPATH];
+	int mask, i, dir;
+
+	if(!fs_searchpaths)
+		Com_Error(ERR_FATAL, "Filesystem call made without initialization");
+
+	fs_extensionQueries++;
+
+	mask = 0;
+	for(i = 0; i < numExts && i < 32; i++)
+	{
+		Com_sprintf(path, sizeof(path), "%s.%s", name, exts[i]);
+
+		if(!fs_indexHash)
+		{
+			if(FS_FOpenFileRead(path, NULL, qfalse) > 0)
+				mask |= 1 << i;
+			continue;
+		}
+
+		if(FS_IndexFind(path))
+		{
+			mask |= 1 << i;
+			continue;
+		}
+
+		for(dir = 0; dir < fs_numIndexDirs; dir++)
+		{
+			if(FS_FOpenFileReadDir(path, fs_indexDirs[dir].search, NULL, qfalse, qfalse) > 0)
+			{
+				mask |= 1 << i;
+				break;
+			}
+		}
+	}
+
+	return mask;
+}
+
+/*
+===========
+FS_ClearLookupStats
+
+Called on map load
+===========
+*/
+void FS_ClearLookupStats(void)
+{
+	fs_lookups = 0;
+	fs_lookupMisses = 0;
+	fs_lookupProbes = 0;
+	fs_extensionQueries = 0;
+}
+
+/*
+===========
+FS_LookupStats_f
+===========
+*/
+static void FS_LookupStats_f(void)
+{
+	Com_Printf("since the last map load:\n");
+	Com_Printf("%9i file lookups, %i not found\n", fs_lookups, fs_lookupMisses);
+	Com_Printf("%9i search paths tried, %.2f per lookup\n", fs_lookupProbes, fs_lookups ? (float)fs_lookupProbes / fs_lookups : 0.0f);
+	Com_Printf("%9i extension queries\n", fs_extensionQueries);
+	if(fs_indexHash)
+		Com_Printf("index of %i pak files in %i buckets, %i directories probed\n",
+			fs_indexNumFiles, fs_indexHashSize, fs_numIndexDirs);
+	else
+		Com_Printf("no index, every search path is tried\n");
+}
+
 /*
 =================
 FS_FindVM
@@ -1454,6 +1863,42 @@ int FS_Read2( void *buffer, size_t len, fileHandle_t f ) {
 	}
 }
 
+/*
+=================
+FS_OpenZipFile
+
+Opens the file of a zip handle in the zip for streaming
+=================
+*/
+static void FS_OpenZipFile( fileHandle_t f ) {
+	pack_t *pak;
+
+	if ( fsh[f].zipOpened ) {
+		return;
+	}
+
+	pak = fsh[f].zipPack;
+	if ( fsh[f].handleFiles.unique ) {
+		// open a new file on the pakfile
+		fsh[f].handleFiles.file.z = unzOpen( pak->pakFilename );
+	} else {
+		if ( !pak->handle ) {
+			pak->handle = unzOpen( pak->pakFilename );
+		}
+		fsh[f].handleFiles.file.z = pak->handle;
+	}
+
+	if ( fsh[f].handleFiles.file.z == NULL ) {
+		Com_Error( ERR_FATAL, "Couldn't open %s", pak->pakFilename );
+	}
+
+	// set the file position in the zip file (also sets the current file info)
+	unzSetOffset( fsh[f].handleFiles.file.z, fsh[f].zipFilePos );
+	// open the file in the zip
+	unzOpenCurrentFile( fsh[f].handleFiles.file.z );
+	fsh[f].zipOpened = qtrue;
+}
+
 int FS_Read( void *buffer, size_t len, fileHandle_t f ) {
 	int block, remaining;
 	int read;
@@ -1496,6 +1941,7 @@ int FS_Read( void *buffer, size_t len, fileHandle_t f ) {
 		}
 		return len;
 	} else {
+		FS_OpenZipFile(f);
 		return unzReadCurrentFile(fsh[f].handleFiles.file.z, buffer, len);
 	}
 }
@@ -1593,7 +2039,10 @@ int FS_Seek( fileHandle_t f, long offset, int origin ) {
 		//(but better than what was here before)
 		byte buffer[PK3_SEEK_BUFFER_SIZE];
 		int		remainder;
-		int		currentPosition = FS_FTell( f );
+		int		currentPosition;
+
+		FS_OpenZipFile( f );
+		currentPosition = FS_FTell( f );
 
 		// change negative offsets into FS_SEEK_SET
 		if ( offset < 0 ) {
@@ -1735,19 +2184,164 @@ int	FS_FileIsInPAK(const char *filename, int *pChecksum ) {
 			} while(pakFile != NULL);
 		}
 	}
-	return -1;
+	return -1;
+}
+
+/*
+============
+FS_ZipShort
+============
+*/
+static unsigned int FS_ZipShort(const byte *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+/*
+============
+FS_ZipLong
+============
+*/
+static unsigned int FS_ZipLong(const byte *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+/*
+============
+FS_MappedZipData
+
+Where the file of a zip handle starts in its mapped pak,
+NULL if the pak isn't mapped or the local header looks broken or
+belongs to another file, so the caller falls back to unzip
+============
+*/
+static const byte *FS_MappedZipData(fileHandle_t f)
+{
+	pack_t *pak;
+	fileInPack_t *entry;
+	const byte *local;
+	int nameLen;
+
+	pak = fsh[f].zipPack;
+	entry = fsh[f].zipEntry;
+	if(!fsh[f].zipFile || !pak || !pak->mapped)
+		return NULL;
+
+	if(!entry->dataPos)
+	{
+		if(entry->localPos + ZIP_LOCAL_HEADER_SIZE > (unsigned long)pak->mappedLength)
+			return NULL;
+
+		local = pak->mapped + entry->localPos;
+		if(FS_ZipLong(local) != ZIP_LOCAL_HEADER_SIG)
+			return NULL;
+
+		// the names are lowercased when the directory is read
+		nameLen = FS_ZipShort(local + 26);
+		if(entry->localPos + ZIP_LOCAL_HEADER_SIZE + nameLen > (unsigned long)pak->mappedLength ||
+			nameLen != (int)strlen(entry->name) ||
+			Q_stricmpn((const char *)local + ZIP_LOCAL_HEADER_SIZE, entry->name, nameLen))
+			return NULL;
+
+		entry->dataPos = entry->localPos + ZIP_LOCAL_HEADER_SIZE + FS_ZipShort(local + 26) + FS_ZipShort(local + 28);
+	}
+
+	if(entry->dataPos + entry->csize > (unsigned long)pak->mappedLength)
+		return NULL;
+
+	return pak->mapped + entry->dataPos;
+}
+
+/*
+============
+FS_ReadMappedZipFile
+
+Copies or inflates the whole file of a zip handle from its mapped
+pak straight into buffer, qfalse if it has to be streamed instead
+============
+*/
+static qboolean FS_ReadMappedZipFile(fileHandle_t f, void *buffer)
+{
+	const byte *data;
+	fileInPack_t *entry;
+	z_stream zs;
+	int err;
+
+	if(fsh[f].zipOpened)
+		return qfalse;
+
+	data = FS_MappedZipData(f);
+	if(!data)
+		return qfalse;
+
+	entry = fsh[f].zipEntry;
+	if(entry->method == 0)
+	{
+		if(entry->csize != entry->len)
+			return qfalse;
+
+		Com_Memcpy(buffer, data, entry->len);
+		fs_readCount += entry->len;
+		return qtrue;
+	}
+
+	if(entry->method != Z_DEFLATED)
+		return qfalse;
+
+	Com_Memset(&zs, 0, sizeof(zs));
+	if(inflateInit2(&zs, -MAX_WBITS) != Z_OK)
+		return qfalse;
+
+	zs.next_in = (Bytef *)data;
+	zs.avail_in = entry->csize;
+	zs.next_out = (Bytef *)buffer;
+	zs.avail_out = entry->len;
+	err = inflate(&zs, Z_FINISH);
+	inflateEnd(&zs);
+
+	if(err != Z_STREAM_END || zs.total_out != entry->len)
+		return qfalse;
+
+	fs_readCount += entry->len;
+	return qtrue;
+}
+
+/*
+============
+FS_IsMappedData
+
+Whether buffer points into a mapped pak
+============
+*/
+static qboolean FS_IsMappedData(const void *buffer)
+{
+	searchpath_t *search;
+	const byte *data;
+
+	data = (const byte *)buffer;
+	for(search = fs_searchpaths; search; search = search->next)
+	{
+		if(search->pack && search->pack->mapped &&
+			data >= search->pack->mapped && data < search->pack->mapped + search->pack->mappedLength)
+		{
+			return qtrue;
+		}
+	}
+	return qfalse;
 }
 
 /*
 ============
-FS_ReadFileDir
+FS_ReadFileInternal
 
 Filename are relative to the quake search path
 a null buffer will just return the file length without loading
 If searchPath is non-NULL search only in that specific search path
+If inPlace is set a file stored in a mapped pak isn't copied
 ============
 */
-long FS_ReadFileDir(const char *qpath, void *searchPath, qboolean unpure, void **buffer)
+static long FS_ReadFileInternal(const char *qpath, void *searchPath, qboolean unpure, void **buffer, qboolean inPlace)
 {
 	fileHandle_t h;
 	searchpath_t	*search;
@@ -1848,10 +2442,26 @@ long FS_ReadFileDir(const char *qpath, void *searchPath, qboolean unpure, void *
 	fs_loadCount++;
 	fs_loadStack++;
 
+	if(inPlace && !isConfig && fsh[h].zipFile && fsh[h].zipEntry->method == 0 &&
+		fsh[h].zipEntry->csize == fsh[h].zipEntry->len)
+	{
+		const byte *data = FS_MappedZipData(h);
+
+		if(data)
+		{
+			*buffer = (void *)data;
+			FS_FCloseFile(h);
+			return len;
+		}
+	}
+
 	buf     = (byte*) Hunk_AllocateTempMemory(len + 1);
 	*buffer = buf;
 
-	FS_Read(buf, len, h);
+	if(!FS_ReadMappedZipFile(h, buf))
+	{
+		FS_Read(buf, len, h);
+	}
 
 	// guarantee that it will have a trailing 0 for string operations
 	buf[len] = 0;
@@ -1876,7 +2486,146 @@ a null buffer will just return the file length without loading
 */
 long FS_ReadFile(const char *qpath, void **buffer)
 {
-	return FS_ReadFileDir(qpath, NULL, qfalse, buffer);
+	return FS_ReadFileInternal(qpath, NULL, qfalse, buffer, qfalse);
+}
+
+/*
+============
+FS_ReadFileDir
+If searchPath is non-NULL search only in that specific search path
+============
+*/
+long FS_ReadFileDir(const char *qpath, void *searchPath, qboolean unpure, void **buffer)
+{
+	return FS_ReadFileInternal(qpath, searchPath, unpure, buffer, qfalse);
+}
+
+/*
+============
+FS_ReadFileMapped
+The buffer may point into a mapped pak, so it is read only
+============
+*/
+long FS_ReadFileMapped(const char *qpath, const void **buffer)
+{
+	return FS_ReadFileInternal(qpath, NULL, qfalse, (void **)buffer, qtrue);
+}
+
+#define MAX_MAPPED_GAME_FILES 16
+
+typedef enum
+{
+	MGF_PAK,                        // points into a mapped pak
+	MGF_MAPPED,                     // a loose file mapped on its own
+	MGF_COPY                        // read into the zone
+} mappedGameFileType_t;
+
+typedef struct
+{
+	const void *data;
+	long length;
+	mappedGameFileType_t type;
+} mappedGameFile_t;
+
+static mappedGameFile_t fs_mappedGameFiles[MAX_MAPPED_GAME_FILES];
+
+/*
+============
+FS_MapGameFile
+
+Makes a whole file of the search path readable in memory for as long as
+the caller likes: in place in a mapped pk3, mapped on its own when it's a
+loose file, or read into the zone when it's compressed
+============
+*/
+long FS_MapGameFile(const char *qpath, const void **data)
+{
+	mappedGameFile_t *mgf;
+	fileHandle_t f;
+	byte *buf;
+	long len;
+	int i;
+
+	*data = NULL;
+
+	for(i = 0; i < MAX_MAPPED_GAME_FILES; i++)
+	{
+		if(!fs_mappedGameFiles[i].data)
+			break;
+	}
+	if(i == MAX_MAPPED_GAME_FILES)
+	{
+		Com_Printf(S_COLOR_YELLOW "WARNING: FS_MapGameFile: too many mapped files for %s\n", qpath);
+		return -1;
+	}
+	mgf = &fs_mappedGameFiles[i];
+
+	len = FS_FOpenFileRead(qpath, &f, qfalse);
+	if(!f)
+		return -1;
+	if(len <= 0)
+	{
+		FS_FCloseFile(f);
+		return -1;
+	}
+
+	if(fsh[f].zipFile)
+	{
+		if(fsh[f].zipEntry->method == 0 && fsh[f].zipEntry->csize == fsh[f].zipEntry->len)
+		{
+			mgf->data = FS_MappedZipData(f);
+			mgf->type = MGF_PAK;
+		}
+	}
+	else if(fs_mmap->integer >= 2)
+	{
+		// loose files are often rewritten in place, so only with fs_mmap 2
+		// the mapping outlives the handle
+		mgf->data = Sys_MapFile(fsh[f].handleFiles.file.o, len);
+		mgf->type = MGF_MAPPED;
+	}
+
+	if(!mgf->data)
+	{
+		buf = (byte *)Z_Malloc(len);
+		if(!FS_ReadMappedZipFile(f, buf))
+		{
+			FS_Read(buf, len, f);
+		}
+		mgf->data = buf;
+		mgf->type = MGF_COPY;
+	}
+	FS_FCloseFile(f);
+
+	mgf->length = len;
+	*data = mgf->data;
+	return len;
+}
+
+/*
+============
+FS_UnmapGameFile
+============
+*/
+void FS_UnmapGameFile(const void *data)
+{
+	mappedGameFile_t *mgf;
+	int i;
+
+	for(i = 0; i < MAX_MAPPED_GAME_FILES; i++)
+	{
+		mgf = &fs_mappedGameFiles[i];
+		if(mgf->data != data)
+			continue;
+
+		if(mgf->type == MGF_MAPPED)
+			Sys_UnmapFile((void *)mgf->data, mgf->length);
+		else if(mgf->type == MGF_COPY)
+			Z_Free((void *)mgf->data);
+		mgf->data = NULL;
+		return;
+	}
+	Com_Error(ERR_FATAL, "FS_UnmapGameFile: %p wasn't mapped", data);
 }
 /*
 =============
@@ -1892,7 +2641,11 @@ void FS_FreeFile( void *buffer ) {
 	}
 	fs_loadStack--;
 
-	Hunk_FreeTempMemory(buffer);
+	// FS_ReadFileMapped may hand out the pak itself
+	if(!FS_IsMappedData(buffer))
+	{
+		Hunk_FreeTempMemory(buffer);
+	}
 
 	// if all of our temp files are free, clear all of our space
 	if ( fs_loadStack == 0 ) {
@@ -1937,36 +2690,40 @@ ZIP FILE LOADING
 
 /*
 =================
-FS_LoadZipFile
+FS_AllocPakFiles
 
-Creates a new pak_t in the search chain for the contents
-of a zip file.
+One block for the files of a pak followed by their names
 =================
 */
-static pack_t *FS_LoadZipFile(const char *zipfile, const char *basename)
+static fileInPack_t *FS_AllocPakFiles(int numFiles, int namesLength)
 {
-	fileInPack_t *buildBuffer;
-	pack_t *pack;
+	return (fileInPack_t *)Z_Malloc(numFiles * sizeof(fileInPack_t) + namesLength);
+}
+
+/*
+=================
+FS_ParseZip
+
+Reads the zip directory through unzip, for zip files that can't be mapped
+=================
+*/
+static fileInPack_t *FS_ParseZip(const char *zipfile, int *numFiles, int *namesLength)
+{
+	fileInPack_t *files;
 	unzFile uf;
 	int err;
 	unz_global_info gi;
 	char filename_inzip[MAX_ZPATH];
 	unz_file_info file_info;
 	int				i, len;
-	long hash;
-	int fs_numHeaderLongs;
-	int *fs_headerLongs;
 	char *namePtr;
 
-	fs_numHeaderLongs = 0;
-
 	uf  = unzOpen(zipfile);
 	err = unzGetGlobalInfo(uf, &gi);
 
 	if(err != UNZ_OK)
 		return NULL;
 
-
 	len = 0;
 	unzGoToFirstFile(uf);
 	for(i = 0; i < (int)gi.number_entry; i++)
@@ -1979,15 +2736,334 @@ static pack_t *FS_LoadZipFile(const char *zipfile, const char *basename)
 		unzGoToNextFile(uf);
 	}
 
-	buildBuffer = (fileInPack_t*)Z_Malloc((gi.number_entry * sizeof(fileInPack_t)) + len);
-	namePtr = ((char *)buildBuffer) + gi.number_entry * sizeof(fileInPack_t);
-	fs_headerLongs  = (int*)Z_Malloc((gi.number_entry + 1) * sizeof(int));
+	files = FS_AllocPakFiles(gi.number_entry, len);
+	namePtr = (char *)(files + gi.number_entry);
+
+	unzGoToFirstFile(uf);
+	for(i = 0; i < (int)gi.number_entry; i++)
+	{
+		err = unzGetCurrentFileInfo(uf, &file_info, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0);
+		if (err != UNZ_OK) {
+			break;
+		}
+		Q_strlwr(filename_inzip);
+		files[i].name = namePtr;
+		qstrcpy(files[i].name, filename_inzip);
+		namePtr += qstrlen(filename_inzip) + 1;
+		// store the file position in the zip
+		files[i].pos = unzGetOffset(uf);
+		files[i].localPos = unzGetLocalOffset(uf);
+		files[i].len = file_info.uncompressed_size;
+		files[i].csize = file_info.compressed_size;
+		files[i].crc = file_info.crc;
+		files[i].method = file_info.compression_method;
+		unzGoToNextFile(uf);
+	}
+
+	unzClose(uf);
+
+	*numFiles = i;
+	*namesLength = len;
+	return files;
+}
+
+/*
+=================
+FS_ParseMappedZip
+
+Reads the zip directory straight out of the mapped zip file
+=================
+*/
+static fileInPack_t *FS_ParseMappedZip(const byte *data, long length, int *numFiles, int *namesLength)
+{
+	fileInPack_t *files;
+	const byte *end, *dir, *p;
+	long before;
+	int count, len, nameLen, i;
+	char *namePtr;
+
+	if(length < ZIP_END_HEADER_SIZE)
+		return NULL;
+
+	// the end of central directory record may be followed by a comment
+	end = NULL;
+	for(p = data + length - ZIP_END_HEADER_SIZE; p >= data && p >= data + length - ZIP_END_HEADER_SIZE - 0xffff; p--)
+	{
+		if(FS_ZipLong(p) == ZIP_END_HEADER_SIG)
+		{
+			end = p;
+			break;
+		}
+	}
+	if(!end)
+		return NULL;
+
+	count = FS_ZipShort(end + 10);
+	// anything in front of the zip, like a self extractor
+	before = (end - data) - (long)(FS_ZipLong(end + 16) + FS_ZipLong(end + 12));
+	if(before < 0)
+		return NULL;
+	dir = data + before + FS_ZipLong(end + 16);
+
+	len = 0;
+	for(i = 0, p = dir; i < count; i++)
+	{
+		if(p + ZIP_CENTRAL_HEADER_SIZE > end || FS_ZipLong(p) != ZIP_CENTRAL_HEADER_SIG)
+			return NULL;
+
+		nameLen = FS_ZipShort(p + 28);
+		if(p + ZIP_CENTRAL_HEADER_SIZE + nameLen > end)
+			return NULL;
+
+		len += Q_min(nameLen, MAX_ZPATH - 1) + 1;
+		p += ZIP_CENTRAL_HEADER_SIZE + nameLen + FS_ZipShort(p + 30) + FS_ZipShort(p + 32);
+	}
+
+	files = FS_AllocPakFiles(count, len);
+	namePtr = (char *)(files + count);
+
+	for(i = 0, p = dir; i < count; i++)
+	{
+		nameLen = Q_min((int)FS_ZipShort(p + 28), MAX_ZPATH - 1);
+		files[i].name = namePtr;
+		Com_Memcpy(namePtr, p + ZIP_CENTRAL_HEADER_SIZE, nameLen);
+		namePtr[nameLen] = 0;
+		Q_strlwr(namePtr);
+		namePtr += nameLen + 1;
+
+		// same as unzGetOffset
+		files[i].pos = (p - data) - before;
+		files[i].method = FS_ZipShort(p + 10);
+		files[i].crc = FS_ZipLong(p + 16);
+		files[i].csize = FS_ZipLong(p + 20);
+		files[i].len = FS_ZipLong(p + 24);
+		files[i].localPos = FS_ZipLong(p + 42) + before;
+
+		p += ZIP_CENTRAL_HEADER_SIZE + FS_ZipShort(p + 28) + FS_ZipShort(p + 30) + FS_ZipShort(p + 32);
+	}
+
+	*numFiles = count;
+	*namesLength = len;
+	return files;
+}
+
+/*
+=================
+FS_ReadPakCache
+
+The files of a pak as the last FS_WritePakCache left them,
+NULL if there is no cache for this exact zip file
+=================
+*/
+static fileInPack_t *FS_ReadPakCache(const char *cachefile, const char *zipfile, long length, int64_t fileTime, int *numFiles, int *namesLength)
+{
+	pakCacheHeader_t header;
+	pakCacheFile_t *cached;
+	fileInPack_t *files;
+	char *names;
+	FILE *f;
+	int i;
+
+	f = Sys_FOpen(cachefile, "rb");
+	if(!f)
+		return NULL;
+
+	if(fread(&header, sizeof(header), 1, f) != 1 || header.ident != PAKCACHE_IDENT || header.version != PAKCACHE_VERSION ||
+		header.fileLength != length || header.fileTime != fileTime ||
+		header.numFiles < 0 || header.numFiles > 0xffff || header.namesLength < 0 || header.namesLength > 0xffff * MAX_ZPATH)
+	{
+		fclose(f);
+		return NULL;
+	}
+
+	header.pakFilename[sizeof(header.pakFilename) - 1] = 0;
+	if(qstrcmp(header.pakFilename, zipfile))
+	{
+		fclose(f);
+		return NULL;
+	}
+
+	cached = (pakCacheFile_t *)Z_Malloc(header.numFiles * sizeof(*cached) + 1);
+	files = FS_AllocPakFiles(header.numFiles, header.namesLength);
+	names = (char *)(files + header.numFiles);
+
+	if((int)fread(cached, sizeof(*cached), header.numFiles, f) != header.numFiles ||
+		(int)fread(names, 1, header.namesLength, f) != header.namesLength ||
+		(header.namesLength && names[header.namesLength - 1]))
+	{
+		Z_Free(cached);
+		Z_Free(files);
+		fclose(f);
+		return NULL;
+	}
+	fclose(f);
+
+	for(i = 0; i < header.numFiles; i++)
+	{
+		if(cached[i].nameOfs < 0 || cached[i].nameOfs >= header.namesLength)
+		{
+			Z_Free(cached);
+			Z_Free(files);
+			return NULL;
+		}
+		files[i].name = names + cached[i].nameOfs;
+		files[i].pos = cached[i].pos;
+		files[i].len = cached[i].len;
+		files[i].csize = cached[i].csize;
+		files[i].localPos = cached[i].localPos;
+		files[i].crc = cached[i].crc;
+		files[i].method = cached[i].method;
+	}
+	Z_Free(cached);
+
+	*numFiles = header.numFiles;
+	*namesLength = header.namesLength;
+	return files;
+}
+
+/*
+=================
+FS_WritePakCache
+
+Keeps the files of a pak, keyed by the zip file's name, size and time
+=================
+*/
+static void FS_WritePakCache(const char *cachefile, const char *zipfile, long length, int64_t fileTime, fileInPack_t *files, int numFiles, int namesLength)
+{
+	pakCacheHeader_t header;
+	pakCacheFile_t *cached;
+	char ospath[MAX_OSPATH];
+	char *names;
+	FILE *f;
+	int i;
+
+	Q_strncpyz(ospath, cachefile, sizeof(ospath));
+	if(FS_CreatePath(ospath))
+		return;
+
+	f = Sys_FOpen(cachefile, "wb");
+	if(!f)
+		return;
+
+	Com_Memset(&header, 0, sizeof(header));
+	header.ident = PAKCACHE_IDENT;
+	header.version = PAKCACHE_VERSION;
+	header.fileLength = length;
+	header.fileTime = fileTime;
+	header.numFiles = numFiles;
+	header.namesLength = namesLength;
+	Q_strncpyz(header.pakFilename, zipfile, sizeof(header.pakFilename));
+
+	names = (char *)(files + numFiles);
+	cached = (pakCacheFile_t *)Z_Malloc(numFiles * sizeof(*cached) + 1);
+	for(i = 0; i < numFiles; i++)
+	{
+		cached[i].nameOfs = files[i].name - names;
+		cached[i].pos = files[i].pos;
+		cached[i].len = files[i].len;
+		cached[i].csize = files[i].csize;
+		cached[i].localPos = files[i].localPos;
+		cached[i].crc = files[i].crc;
+		cached[i].method = files[i].method;
+	}
+
+	if(fwrite(&header, sizeof(header), 1, f) != 1 ||
+		(int)fwrite(cached, sizeof(*cached), numFiles, f) != numFiles ||
+		(int)fwrite(names, 1, namesLength, f) != namesLength)
+	{
+		Com_Printf("WARNING: couldn't write %s\n", cachefile);
+	}
+
+	Z_Free(cached);
+	fclose(f);
+}
+
+/*
+=================
+FS_LoadZipFile
+
+Creates a new pak_t in the search chain for the contents
+of a zip file.
+The zip file is mapped when FS_MapAllowed agrees, and its directory
+comes from the pak cache when gamedir is given and fs_pakCache is set.
+=================
+*/
+static pack_t *FS_LoadZipFile(const char *zipfile, const char *basename, const char *gamedir)
+{
+	fileInPack_t *buildBuffer;
+	pack_t *pack;
+	FILE *f;
+	byte *mapped;
+	long length;
+	int64_t fileTime;
+	char cachefile[MAX_OSPATH];
+	char cachename[MAX_OSPATH];
+	int numFiles, namesLength;
+	int				i;
+	long hash;
+	int fs_numHeaderLongs;
+	int *fs_headerLongs;
+	qboolean cached;
+
+	f = Sys_FOpen(zipfile, "rb");
+	if(!f)
+		return NULL;
+
+	length = FS_fplength(f);
+	fileTime = Sys_FileTime(f);
+	mapped = NULL;
+	if(FS_MapAllowed(zipfile) && length > 0)
+		mapped = (byte *)Sys_MapFile(f, length);
+
+	// the mapping outlives the file
+	fclose(f);
+
+	buildBuffer = NULL;
+	cached = qfalse;
+	cachefile[0] = 0;
+	if(gamedir && fs_pakCache->integer && fs_homepath->string[0])
+	{
+		// the same pak name can be in more than one search path
+		COM_StripExtension(basename, cachename, sizeof(cachename));
+		Q_strncpyz(cachefile, FS_BuildOSPath(fs_homepath->string, "pakcache",
+			va("%s/%s_%08x.pkc", gamedir, cachename, (unsigned)Com_BlockChecksum(zipfile, strlen(zipfile)))), sizeof(cachefile));
+		buildBuffer = FS_ReadPakCache(cachefile, zipfile, length, fileTime, &numFiles, &namesLength);
+		cached = buildBuffer ? qtrue : qfalse;
+	}
+
+	if(!buildBuffer && mapped)
+		buildBuffer = FS_ParseMappedZip(mapped, length, &numFiles, &namesLength);
+
+	if(!buildBuffer)
+		buildBuffer = FS_ParseZip(zipfile, &numFiles, &namesLength);
+
+	if(!buildBuffer)
+	{
+		if(mapped)
+			Sys_UnmapFile(mapped, length);
+		return NULL;
+	}
+
+	if(gamedir)
+	{
+		if(cached)
+			fs_packsCached++;
+		else
+		{
+			fs_packsParsed++;
+			if(cachefile[0])
+				FS_WritePakCache(cachefile, zipfile, length, fileTime, buildBuffer, numFiles, namesLength);
+		}
+	}
+
+	fs_numHeaderLongs = 0;
+	fs_headerLongs  = (int*)Z_Malloc((numFiles + 1) * sizeof(int));
 	fs_headerLongs[fs_numHeaderLongs++] = LittleLong(fs_checksumFeed);
 
 	// get the hash table size from the number of files in the zip
 	// because lots of custom pk3 files have less than 32 or 64 files
 	for (i = 1; i <= MAX_FILEHASH_SIZE; i <<= 1) {
-		if (i > (int)gi.number_entry) {
+		if (i > numFiles) {
 			break;
 		}
 	}
@@ -2007,30 +3083,18 @@ static pack_t *FS_LoadZipFile(const char *zipfile, const char *basename)
 		pack->pakBasename[strlen( pack->pakBasename ) - 4] = 0;
 	}
 
-	pack->handle   = uf;
-	pack->numfiles = gi.number_entry;
-	unzGoToFirstFile(uf);
+	pack->mapped = mapped;
+	pack->mappedLength = mapped ? length : 0;
+	pack->numfiles = numFiles;
 
-	for(i = 0; i < (int)gi.number_entry; i++)
+	for(i = 0; i < numFiles; i++)
 	{
-		err = unzGetCurrentFileInfo(uf, &file_info, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0);
-		if (err != UNZ_OK) {
-			break;
+		if (buildBuffer[i].len > 0) {
+			fs_headerLongs[fs_numHeaderLongs++] = LittleLong(buildBuffer[i].crc);
 		}
-		if (file_info.uncompressed_size > 0) {
-			fs_headerLongs[fs_numHeaderLongs++] = LittleLong(file_info.crc);
-		}
-		Q_strlwr(filename_inzip);
-		hash                = FS_HashFileName(filename_inzip, pack->hashSize);
-		buildBuffer[i].name = namePtr;
-		qstrcpy(buildBuffer[i].name, filename_inzip);
-		namePtr += qstrlen(filename_inzip) + 1;
-		// store the file position in the zip
-		buildBuffer[i].pos = unzGetOffset(uf);
-		buildBuffer[i].len = file_info.uncompressed_size;
+		hash                = FS_HashFileName(buildBuffer[i].name, pack->hashSize);
 		buildBuffer[i].next   = pack->hashTable[hash];
 		pack->hashTable[hash] = &buildBuffer[i];
-		unzGoToNextFile(uf);
 	}
 
 	pack->checksum = Com_BlockChecksum( &fs_headerLongs[ 1 ], sizeof(*fs_headerLongs) * ( fs_numHeaderLongs - 1 ) );
@@ -2052,7 +3116,10 @@ Frees a pak structure and releases all associated resources
 */
 static void FS_FreePak(pack_t *thepak)
 {
-	unzClose(thepak->handle);
+	if(thepak->handle)
+		unzClose(thepak->handle);
+	if(thepak->mapped)
+		Sys_UnmapFile(thepak->mapped, thepak->mappedLength);
 	Z_Free(thepak->buildBuffer);
 	Z_Free(thepak);
 }
@@ -2067,7 +3134,7 @@ qboolean FS_CompareZipChecksum(const char *zipfile)
 	pack_t *thepak;
 	int index, checksum;
 
-	thepak = FS_LoadZipFile(zipfile, "");
+	thepak = FS_LoadZipFile(zipfile, "", NULL);
 	if(!thepak)
 		return qfalse;
 	checksum = thepak->checksum;
@@ -2865,7 +3932,7 @@ void FS_AddGameDirectory( const char *path, const char *dir ) {
 		if (pakwhich) {
 			// The next .pk3 file is before the next .pk3dir
 			pakfile = FS_BuildOSPath(path, dir, pakfiles[pakfilesi]);
-			if ((pak = FS_LoadZipFile(pakfile, pakfiles[pakfilesi])) == 0) {
+			if ((pak = FS_LoadZipFile(pakfile, pakfiles[pakfilesi], dir)) == 0) {
 				// This isn't a .pk3! Next!
 				pakfilesi++;
 			continue;
@@ -3107,6 +4174,8 @@ void FS_Shutdown( qboolean closemfp ) {
 		}
 	}
 
+	FS_FreeIndex();
+
 	// free everything
 	for(p = fs_searchpaths; p; p = next)
 	{
@@ -3128,6 +4197,7 @@ void FS_Shutdown( qboolean closemfp ) {
 	Cmd_RemoveCommand("fdir");
 	Cmd_RemoveCommand("touchFile");
 	Cmd_RemoveCommand( "which" );
+	Cmd_RemoveCommand("fs_lookupStats");
 
 #ifdef FS_MISSING
 	if (closemfp) {
@@ -3193,7 +4263,12 @@ static void FS_Startup(const char *gameName)
 	Com_Printf("----- FS_Startup -----\n");
 
 	fs_packFiles = 0;
+	fs_packsCached = 0;
+	fs_packsParsed = 0;
 	fs_debug    = Cvar_Get("fs_debug", "0", 0);
+	fs_mmap     = Cvar_Get("fs_mmap", "1", 0);
+	fs_pakCache = Cvar_Get("fs_pakCache", "1", 0);
+	fs_index    = Cvar_Get("fs_index", "1", 0);
 	fs_basepath = Cvar_Get ("fs_basepath", Sys_DefaultInstallPath(), CVAR_INIT|CVAR_PROTECTED );
 	fs_basegame = Cvar_Get("fs_basegame", "", CVAR_INIT);
 	homePath    = Sys_DefaultHomePath();
@@ -3261,10 +4336,12 @@ static void FS_Startup(const char *gameName)
 	Cmd_AddCommand("fdir", FS_NewDir_f);
 	Cmd_AddCommand("touchFile", FS_TouchFile_f);
 	Cmd_AddCommand ("which", FS_Which_f );
+	Cmd_AddCommand("fs_lookupStats", FS_LookupStats_f);
 
 	// https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=506
 	// reorder the pure pk3 files according to server order
 	FS_ReorderPurePaks();
+	FS_BuildIndex();
 
 	// print the current search paths
 	FS_Path_f();
@@ -3279,6 +4356,7 @@ static void FS_Startup(const char *gameName)
 	}
 #endif
 	Com_Printf("%d files in pk3 files\n", fs_packFiles);
+	Com_Printf("%d pk3 directories from the pak cache, %d parsed\n", fs_packsCached, fs_packsParsed);
 }
 
 #ifndef STANDALONE
@@ -3905,7 +4983,10 @@ qboolean FS_ConditionalRestart(int checksumFeed, qboolean disconnect)
 	if(checksumFeed != fs_checksumFeed)
 		FS_Restart(checksumFeed);
 	else if(fs_numServerPaks && !fs_reordered)
+	{
 		FS_ReorderPurePaks();
+		FS_BuildIndex();
+	}
 
 	return qfalse;
 }
@@ -3969,7 +5050,7 @@ int		FS_FOpenFileByMode( const char *qpath, fileHandle_t *f, fsMode_t mode ) {
 int		FS_FTell( fileHandle_t f ) {
 	int pos;
 	if (fsh[f].zipFile == qtrue) {
-		pos = unztell(fsh[f].handleFiles.file.z);
+		pos = fsh[f].zipOpened ? unztell(fsh[f].handleFiles.file.z) : 0;
 	} else {
 		pos = ftell(fsh[f].handleFiles.file.o);
 	}
@@ -28,7 +28,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "q_shared.h"
 #include "qcommon.h"
 
-static int bloc = 0;
+// per thread, so snapshots can be encoded on worker threads
+static thread_local int bloc = 0;
 
 void Huff_putBit(int bit, byte *fout, int *offset)
 {
@@ -486,7 +487,7 @@ void Huff_Decompress(msg_t *mbuf, int offset)
 	Com_Memcpy(mbuf->data + offset, seq, cch);
 }
 
-extern int oldsize;
+extern thread_local int oldsize;
 
 void Huff_Compress(msg_t *mbuf, int offset)
 {
@@ -551,3 +552,181 @@ void Huff_Init(huffman_t *huff)
 	huff->compressor.tree->parent = huff->compressor.tree->left = huff->compressor.tree->right = NULL;
 	huff->compressor.loc[NYT]     = huff->compressor.tree;
 }
+
+/*
+===============================================================================
+
+STATIC TABLES
+
+The message Huffman tree is built once from msg_hData and never adapted
+afterwards, so its codes can be flattened into tables: the encoder writes a
+whole code at once, and the decoder resolves the first HUFF_LOOKUP_BITS bits
+of the input with a single lookup.  Codes are kept in wire order, the first
+bit sent is bit 0, which is also the order Huff_putBit fills a byte in.
+
+===============================================================================
+*/
+
+/*
+==================
+Huff_BuildCodes
+
+Collects the codes of all leaves below node, codes longer than 32 bits are
+left to the tree walker
+==================
+*/
+static void Huff_BuildCodes(huffTable_t *table, node_t *node, unsigned int code, int length)
+{
+	if(!node)
+	{
+		return;
+	}
+
+	if(node->symbol != INTERNAL_NODE)
+	{
+		if(node->symbol < HMAX && length <= 32)
+		{
+			table->code[node->symbol]       = code;
+			table->codeLength[node->symbol] = length;
+		}
+		return;
+	}
+
+	if(length < 32)
+	{
+		Huff_BuildCodes(table, node->left, code, length + 1);
+		Huff_BuildCodes(table, node->right, code | (1u << length), length + 1);
+	}
+	else
+	{
+		Huff_BuildCodes(table, node->left, 0, 33);
+		Huff_BuildCodes(table, node->right, 0, 33);
+	}
+}
+
+/*
+==================
+Huff_BuildTable
+
+Flattens a tree that is not going to change anymore
+==================
+*/
+void Huff_BuildTable(huffTable_t *table, huff_t *huff)
+{
+	node_t *node;
+	int i, bits;
+
+	Com_Memset(table, 0, sizeof(*table));
+
+	table->huff = huff;
+
+	Huff_BuildCodes(table, huff->tree, 0, 0);
+
+	for(i = 0; i < (1 << HUFF_LOOKUP_BITS); i++)
+	{
+		node = huff->tree;
+
+		for(bits = 0; node && node->symbol == INTERNAL_NODE && bits < HUFF_LOOKUP_BITS; bits++)
+		{
+			node = ((i >> bits) & 1) ? node->right : node->left;
+		}
+
+		if(node && node->symbol != INTERNAL_NODE)
+		{
+			table->symbol[i]       = node->symbol;
+			table->symbolLength[i] = bits;
+		}
+		else
+		{
+			// longer code, or a hole in the tree if node is NULL
+			table->symbol[i] = -1;
+			table->node[i]   = node;
+		}
+	}
+}
+
+/*
+==================
+Huff_TableTransmit
+
+Same output as Huff_offsetTransmit, including leaving the bits that follow
+the code alone unless a new byte is started
+==================
+*/
+void Huff_TableTransmit(const huffTable_t *table, int ch, byte *fout, int *offset)
+{
+	unsigned int code;
+	int length, pos, written;
+	byte *p;
+
+	length = table->codeLength[ch];
+	if(!length)
+	{
+		Huff_offsetTransmit(table->huff, ch, fout, offset);
+		return;
+	}
+
+	code = table->code[ch];
+	pos  = *offset;
+	p    = fout + (pos >> 3);
+
+	if((pos & 7) == 0)
+	{
+		*p = 0;
+	}
+	*p |= (byte)(code << (pos & 7));
+
+	for(written = 8 - (pos & 7); written < length; written += 8)
+	{
+		*++p = (byte)(code >> written);
+	}
+
+	*offset = pos + length;
+}
+
+/*
+==================
+Huff_TableReceive
+
+Same result as Huff_offsetReceive on the table's tree.  size is the size of
+the fin buffer in bytes, the lookup is only done if it can't read past it.
+==================
+*/
+void Huff_TableReceive(const huffTable_t *table, int *ch, byte *fin, int *offset, int size)
+{
+	const byte *p;
+	int pos, bits, next;
+
+	pos = *offset;
+
+	if((pos >> 3) + 3 > size)
+	{
+		Huff_offsetReceive(table->huff->tree, ch, fin, offset);
+		return;
+	}
+
+	p    = fin + (pos >> 3);
+	bits = ((p[0] | (p[1] << 8) | (p[2] << 16)) >> (pos & 7)) & ((1 << HUFF_LOOKUP_BITS) - 1);
+
+	if(table->symbol[bits] >= 0)
+	{
+		*ch     = table->symbol[bits];
+		*offset = pos + table->symbolLength[bits];
+		return;
+	}
+
+	if(!table->node[bits])
+	{
+		Huff_offsetReceive(table->huff->tree, ch, fin, offset);
+		return;
+	}
+
+	// the walk from an internal node reads at least one more bit unless it
+	// runs into a hole, in which case the offset stays where it was
+	next = pos + HUFF_LOOKUP_BITS;
+	Huff_offsetReceive(table->node[bits], ch, fin, &next);
+	if(next != pos + HUFF_LOOKUP_BITS)
+	{
+		*offset = next;
+	}
+}
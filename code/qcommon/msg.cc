@@ -24,6 +24,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "qcommon.h"
 
 static huffman_t msgHuff;
+static huffTable_t msgHuffTable;
 
 static qboolean msgInit = qfalse;
 
@@ -37,7 +38,8 @@ Handles byte ordering and avoids alignment errors
 ==============================================================================
 */
 
-int oldsize = 0;
+// statistics only, counted per thread as snapshots are encoded on workers
+thread_local int oldsize = 0;
 
 void MSG_initHuffman(void);
 
@@ -108,7 +110,63 @@ bit functions
 =============================================================================
 */
 
-int overflows;
+thread_local int overflows;
+
+/*
+=================
+MSG_PutBits
+
+Stores the low count bits of acc at msg->bit with the same semantics as
+Huff_putBit: a byte is cleared when the first bit goes into it, a partially
+written byte is or'ed into
+=================
+*/
+static void MSG_PutBits(msg_t *msg, uint64_t acc, int count)
+{
+	byte *p;
+	int pos, written;
+
+	if(!count)
+	{
+		return;
+	}
+
+	pos = msg->bit;
+	p   = msg->data + (pos >> 3);
+
+	if((pos & 7) == 0)
+	{
+		*p = 0;
+	}
+	*p |= (byte)(acc << (pos & 7));
+
+	written = 8 - (pos & 7);
+	acc   >>= written;
+
+	for(; written < count; written += 8)
+	{
+		*++p  = (byte)acc;
+		acc >>= 8;
+	}
+
+	msg->bit = pos + count;
+}
+
+/*
+=================
+MSG_LoadBits
+
+Loads the 64 bits starting at the byte msg->bit is in, the caller has to
+make sure they are inside the buffer
+=================
+*/
+static ID_INLINE uint64_t MSG_LoadBits(const msg_t *msg)
+{
+	const byte *p = msg->data + (msg->bit >> 3);
+
+	return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+	       ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
 
 // negative bit values include signs
 void MSG_WriteBits(msg_t *msg, int value, int bits)
@@ -182,31 +240,96 @@ void MSG_WriteBits(msg_t *msg, int value, int bits)
 	}
 	else
 	{
-//		fp = fopen("c:\\netchan.bin", "a");
-		value &= (0xffffffff >> (32 - bits));
-		if (bits & 7)
+		unsigned int v;
+		uint64_t acc;
+		int nbits, accBits, ch, length;
+
+		// the raw bits and the Huffman codes of the whole bytes are
+		// collected in a register and stored in one go
+		v       = (unsigned int)value & (0xffffffff >> (32 - bits));
+		nbits   = bits & 7;
+		acc     = v & ((1 << nbits) - 1);
+		accBits = nbits;
+		v     >>= nbits;
+
+		for(i = nbits; i < bits; i += 8)
 		{
-			int nbits;
-			nbits = bits & 7;
-			for(i = 0; i < nbits; i++)
+			ch     = v & 0xff;
+			v    >>= 8;
+			length = msgHuffTable.codeLength[ch];
+
+			if(!length || accBits + length > 64)
 			{
-				Huff_putBit((value & 1), msg->data, &msg->bit);
-				value = (value >> 1);
+				MSG_PutBits(msg, acc, accBits);
+				acc     = 0;
+				accBits = 0;
+
+				if(!length)
+				{
+					Huff_TableTransmit(&msgHuffTable, ch, msg->data, &msg->bit);
+					continue;
+				}
 			}
-			bits = bits - nbits;
+
+			acc     |= (uint64_t)msgHuffTable.code[ch] << accBits;
+			accBits += length;
 		}
-		if (bits)
+
+		MSG_PutBits(msg, acc, accBits);
+
+		msg->cursize = (msg->bit >> 3) + 1;
+	}
+}
+
+/*
+=================
+MSG_WriteRawBits
+
+Appends bits that were already written to another bitstream message
+starting at bit 0, Huffman codes included, so they come out exactly like
+the MSG_WriteBits calls that produced them
+=================
+*/
+void MSG_WriteRawBits(msg_t *msg, const byte *data, int bits)
+{
+	uint64_t acc;
+	int count, i;
+
+	if (bits <= 0)
+	{
+		return;
+	}
+
+	// whole bytes plus the one MSG_WriteBits keeps as slack
+	if (msg->maxsize - msg->cursize < ((bits + 7) >> 3) + 4)
+	{
+		msg->overflowed = qtrue;
+		return;
+	}
+
+	oldsize += bits;
+
+	while (bits > 0)
+	{
+		count = bits < 56 ? bits : 56;
+
+		acc = 0;
+		for (i = 0; i < (count + 7) >> 3; i++)
 		{
-			for(i = 0; i < bits; i += 8)
-			{
-//				fwrite(bp, 1, 1, fp);
-				Huff_offsetTransmit(&msgHuff.compressor, (value & 0xff), msg->data, &msg->bit);
-				value = (value >> 8);
-			}
+			acc |= (uint64_t)data[i] << (i << 3);
 		}
-		msg->cursize = (msg->bit >> 3) + 1;
-//		fclose(fp);
+		if (count & 7)
+		{
+			acc &= ((uint64_t)1 << count) - 1;
+		}
+
+		MSG_PutBits(msg, acc, count);
+
+		data += 7;
+		bits -= count;
 	}
+
+	msg->cursize = (msg->bit >> 3) + 1;
 }
 
 int MSG_ReadBits(msg_t *msg, int bits)
@@ -259,27 +382,49 @@ int MSG_ReadBits(msg_t *msg, int bits)
 	}
 	else
 	{
-		nbits = 0;
-		if (bits & 7)
+		nbits = bits & 7;
+		i     = 0;
+
+		// the longest read, 7 raw bits and four lookups, fits into the
+		// 57 bits that are left of a 64 bit load after the alignment
+		if ((msg->bit >> 3) + 8 <= msg->maxsize)
 		{
-			nbits = bits & 7;
-			for(i = 0; i < nbits; i++)
+			uint64_t window;
+			int code;
+
+			window = MSG_LoadBits(msg) >> (msg->bit & 7);
+
+			value     = (int)(window & ((1 << nbits) - 1));
+			window  >>= nbits;
+			msg->bit += nbits;
+
+			for(i = nbits; i < bits; i += 8)
 			{
-				value |= (Huff_getBit(msg->data, &msg->bit) << i);
+				code = (int)(window & ((1 << HUFF_LOOKUP_BITS) - 1));
+				if (msgHuffTable.symbol[code] < 0)
+					break;              // long code, finish with the tree
+
+				get       = msgHuffTable.symbol[code];
+				window  >>= msgHuffTable.symbolLength[code];
+				msg->bit += msgHuffTable.symbolLength[code];
+				value    |= (get << i);
 			}
-			bits = bits - nbits;
 		}
-		if (bits)
+		else
 		{
-//			fp = fopen("c:\\netchan.bin", "a");
-			for(i = 0; i < bits; i += 8)
+			for(; i < nbits; i++)
 			{
-				Huff_offsetReceive(msgHuff.decompressor.tree, &get, msg->data, &msg->bit);
-//				fwrite(&get, 1, 1, fp);
-				value |= (get << (i + nbits));
+				value |= (Huff_getBit(msg->data, &msg->bit) << i);
 			}
-//			fclose(fp);
 		}
+
+		for(; i < bits; i += 8)
+		{
+			Huff_TableReceive(&msgHuffTable, &get, msg->data, &msg->bit, msg->maxsize);
+			value |= (get << i);
+		}
+
+		bits = bits - nbits;
 		msg->readcount = (msg->bit >> 3) + 1;
 	}
 	if (sgn)
@@ -2096,6 +2241,182 @@ void MSG_initHuffman(void)
 			Huff_addRef(&msgHuff.decompressor,  (byte)i);           // Do update
 		}
 	}
+
+	// the tree is final now, flatten it for MSG_WriteBits/MSG_ReadBits
+	Huff_BuildTable(&msgHuffTable, &msgHuff.compressor);
+}
+
+/*
+=================
+MSG_HuffTestSymbol
+
+Random symbol distributed like msg_hData
+=================
+*/
+static int MSG_HuffTestSymbol(int *seed, int total)
+{
+	int i, r;
+
+	r = ((unsigned int)Q_rand(seed) >> 8) % total;
+
+	for(i = 0; i < 255; i++)
+	{
+		r -= msg_hData[i];
+		if(r < 0)
+			break;
+	}
+
+	return i;
+}
+
+/*
+=================
+MSG_HuffTest_f
+
+Checks the table driven codec against the tree walker on random messages and
+garbage input, then times both
+=================
+*/
+void MSG_HuffTest_f(void)
+{
+	static byte src[4096];
+	static byte treeBuf[32768];
+	static byte tableBuf[32768];
+	int iterations, seed, total, mismatches;
+	int it, i, len, start, size, pass;
+	int offTree, offTable, chTree, chTable;
+	int t0, msecTree, msecTable, bytes;
+
+	iterations = Cmd_Argc() > 1 ? atoi(Cmd_Argv(1)) : 1000;
+	seed       = Cmd_Argc() > 2 ? atoi(Cmd_Argv(2)) : Sys_Milliseconds();
+
+	if(!msgInit)
+	{
+		MSG_initHuffman();
+	}
+
+	for(i = 0, total = 0; i < 256; i++)
+	{
+		total += msg_hData[i];
+	}
+
+	Com_Printf("huffTest: %i iterations, seed %i\n", iterations, seed);
+
+	mismatches = 0;
+
+	for(it = 0; it < iterations; it++)
+	{
+		len   = 1 + ((unsigned int)Q_rand(&seed) >> 8) % sizeof(src);
+		start = ((unsigned int)Q_rand(&seed) >> 8) % 64;
+
+		for(i = 0; i < len; i++)
+		{
+			src[i] = (it & 1) ? MSG_HuffTestSymbol(&seed, total) : (Q_rand(&seed) >> 16);
+		}
+
+		// the encoders must leave the same garbage behind, too.  Like
+		// MSG_WriteBits, expect the bits from start on to be cleared.
+		for(i = 0; i < (int)sizeof(treeBuf); i++)
+		{
+			treeBuf[i] = tableBuf[i] = Q_rand(&seed) >> 16;
+		}
+		treeBuf[start >> 3] &= (1 << (start & 7)) - 1;
+		tableBuf[start >> 3] = treeBuf[start >> 3];
+
+		offTree = offTable = start;
+
+		for(i = 0; i < len; i++)
+		{
+			Huff_offsetTransmit(&msgHuff.compressor, src[i], treeBuf, &offTree);
+			Huff_TableTransmit(&msgHuffTable, src[i], tableBuf, &offTable);
+		}
+
+		if(offTree != offTable || memcmp(treeBuf, tableBuf, sizeof(treeBuf)))
+		{
+			Com_Printf("huffTest: encoder mismatch in iteration %i\n", it);
+			mismatches++;
+			continue;
+		}
+
+		// decode the message, then the garbage, which is now in tableBuf
+		for(pass = 0; pass < 2; pass++)
+		{
+			byte *buf = pass ? tableBuf : treeBuf;
+
+			if(pass)
+			{
+				for(i = 0; i < (int)sizeof(tableBuf); i++)
+				{
+					tableBuf[i] = Q_rand(&seed) >> 16;
+				}
+			}
+
+			// pretend the buffer ends right behind the message so the
+			// fallback near the end gets some exercise as well
+			size = (offTree >> 3) + 1 + ((unsigned int)Q_rand(&seed) >> 8) % 4;
+
+			offTree = offTable = start;
+
+			for(i = 0; i < len; i++)
+			{
+				Huff_offsetReceive(msgHuff.decompressor.tree, &chTree, buf, &offTree);
+				Huff_TableReceive(&msgHuffTable, &chTable, buf, &offTable, size);
+
+				if(chTree != chTable || offTree != offTable || (!pass && chTree != src[i]))
+				{
+					Com_Printf("huffTest: decoder mismatch in iteration %i, pass %i, symbol %i\n", it, pass, i);
+					mismatches++;
+					break;
+				}
+			}
+		}
+	}
+
+	Com_Printf("huffTest: %i mismatches\n", mismatches);
+
+	// microbenchmark on data shaped like network traffic
+	for(i = 0; i < (int)sizeof(src); i++)
+	{
+		src[i] = MSG_HuffTestSymbol(&seed, total);
+	}
+
+	bytes = 0;
+	t0    = Sys_Milliseconds();
+	for(it = 0; it < iterations; it++)
+	{
+		for(i = 0, offTree = 0; i < (int)sizeof(src); i++)
+			Huff_offsetTransmit(&msgHuff.compressor, src[i], treeBuf, &offTree);
+		bytes += sizeof(src);
+	}
+	msecTree = Sys_Milliseconds() - t0;
+
+	t0 = Sys_Milliseconds();
+	for(it = 0; it < iterations; it++)
+	{
+		for(i = 0, offTable = 0; i < (int)sizeof(src); i++)
+			Huff_TableTransmit(&msgHuffTable, src[i], tableBuf, &offTable);
+	}
+	msecTable = Sys_Milliseconds() - t0;
+
+	Com_Printf("encode: %i bytes, tree %i msec, table %i msec\n", bytes, msecTree, msecTable);
+
+	t0 = Sys_Milliseconds();
+	for(it = 0; it < iterations; it++)
+	{
+		for(i = 0, offTree = 0; i < (int)sizeof(src); i++)
+			Huff_offsetReceive(msgHuff.decompressor.tree, &chTree, treeBuf, &offTree);
+	}
+	msecTree = Sys_Milliseconds() - t0;
+
+	t0 = Sys_Milliseconds();
+	for(it = 0; it < iterations; it++)
+	{
+		for(i = 0, offTable = 0; i < (int)sizeof(src); i++)
+			Huff_TableReceive(&msgHuffTable, &chTable, tableBuf, &offTable, sizeof(tableBuf));
+	}
+	msecTable = Sys_Milliseconds() - t0;
+
+	Com_Printf("decode: %i bytes, tree %i msec, table %i msec\n", bytes, msecTree, msecTable);
 }
 
 /*
@@ -2134,3 +2455,303 @@ void MSG_NUinitHuffman() {
 */
 
 //===========================================================================
+
+/*
+=================
+MSG_WriteBitsReference
+
+The bit at a time writer MSG_WriteBits used to be, for MSG_BitsTest_f
+=================
+*/
+static void MSG_WriteBitsReference(msg_t *msg, int value, int bits)
+{
+	int i;
+
+	oldsize += bits;
+
+	if(msg->maxsize - msg->cursize < 4)
+	{
+		msg->overflowed = qtrue;
+		return;
+	}
+
+	if(bits == 0 || bits < -31 || bits > 32)
+	{
+		Com_Error(ERR_DROP, "MSG_WriteBits: bad bits %i", bits);
+	}
+
+	if(bits != 32)
+	{
+		if(bits > 0)
+		{
+			if(value > ((1 << bits) - 1) || value < 0)
+				overflows++;
+		}
+		else
+		{
+			int r = 1 << (bits - 1);
+
+			if(value >  r - 1 || value < -r)
+				overflows++;
+		}
+	}
+
+	if(bits < 0)
+	{
+		bits = -bits;
+	}
+
+	value &= (0xffffffff >> (32 - bits));
+
+	for(i = 0; i < (bits & 7); i++)
+	{
+		Huff_putBit((value & 1), msg->data, &msg->bit);
+		value = (value >> 1);
+	}
+	for(i = bits & 7; i < bits; i += 8)
+	{
+		Huff_TableTransmit(&msgHuffTable, (value & 0xff), msg->data, &msg->bit);
+		value = (value >> 8);
+	}
+
+	msg->cursize = (msg->bit >> 3) + 1;
+}
+
+/*
+=================
+MSG_ReadBitsReference
+=================
+*/
+static int MSG_ReadBitsReference(msg_t *msg, int bits)
+{
+	int i, nbits, get, value;
+	qboolean sgn;
+
+	sgn = bits < 0 ? qtrue : qfalse;
+	if(sgn)
+	{
+		bits = -bits;
+	}
+
+	value = 0;
+	nbits = bits & 7;
+
+	for(i = 0; i < nbits; i++)
+	{
+		value |= (Huff_getBit(msg->data, &msg->bit) << i);
+	}
+	bits = bits - nbits;
+	for(i = 0; i < bits; i += 8)
+	{
+		Huff_TableReceive(&msgHuffTable, &get, msg->data, &msg->bit, msg->maxsize);
+		value |= (get << (i + nbits));
+	}
+
+	msg->readcount = (msg->bit >> 3) + 1;
+
+	if(sgn)
+	{
+		if(value & (1 << (bits - 1)))
+			value |= -1 ^ ((1 << bits) - 1);
+	}
+
+	return value;
+}
+
+/*
+=================
+MSG_BitsTest_f
+
+Writes and reads a stream shaped like entity deltas, a change bit followed
+by the field for every field of entityStateFields, with the word at a time
+MSG_WriteBits/MSG_ReadBits and the bit at a time reference.  The values are
+taken from a demo if one is given, the contents of recorded snapshots.
+=================
+*/
+void MSG_BitsTest_f(void)
+{
+	static byte refBuf[MAX_MSGLEN];
+	static byte newBuf[MAX_MSGLEN];
+	static int widths[2 * ARRAY_LEN(entityStateFields)];
+	static int values[MAX_MSGLEN];
+	msg_t ref, msg;
+	byte *src;
+	void *file;
+	int iterations, srcLen, numWidths, numValues;
+	int i, j, it, pos, mismatches, t0, msecRef, msecNew;
+
+	iterations = Cmd_Argc() > 1 ? atoi(Cmd_Argv(1)) : 200;
+	file       = NULL;
+
+	if(Cmd_Argc() > 2)
+	{
+		srcLen = FS_ReadFile(Cmd_Argv(2), &file);
+		if(srcLen < 16)
+		{
+			Com_Printf("bitsTest: couldn't load %s\n", Cmd_Argv(2));
+			if(file)
+				FS_FreeFile(file);
+			return;
+		}
+
+		// keep only the message payloads of the demo blocks
+		// (sequence, length, data)
+		src = (byte *)file;
+		for(pos = 0, i = 0; pos + 8 <= srcLen; )
+		{
+			int len = LittleLong(*(int *)(src + pos + 4));
+
+			if(len <= 0 || pos + 8 + len > srcLen)
+				break;
+
+			memmove(src + i, src + pos + 8, len);
+			i   += len;
+			pos += 8 + len;
+		}
+		srcLen = i;
+	}
+	else
+	{
+		int seed = Sys_Milliseconds();
+
+		srcLen = 65536;
+		src    = (byte *)Z_Malloc(srcLen);
+		for(i = 0; i < srcLen; i++)
+			src[i] = Q_rand(&seed) >> 16;
+	}
+
+	if(srcLen < 4)
+	{
+		Com_Printf("bitsTest: no data\n");
+		if(file)
+			FS_FreeFile(file);
+		return;
+	}
+
+	if(!msgInit)
+	{
+		MSG_initHuffman();
+	}
+
+	numWidths = 0;
+	for(i = 0; i < (int)ARRAY_LEN(entityStateFields); i++)
+	{
+		widths[numWidths++] = 1;
+		if(entityStateFields[i].bits)
+			widths[numWidths++] = entityStateFields[i].bits;
+		else
+			widths[numWidths++] = (i & 1) ? 32 : FLOAT_INT_BITS;
+	}
+
+	// values for a message that is close to full
+	numValues = 0;
+	MSG_Init(&msg, newBuf, sizeof(newBuf));
+	for(i = 0, pos = 0; msg.cursize < msg.maxsize - 64 && numValues < (int)ARRAY_LEN(values); i++)
+	{
+		values[numValues] = src[pos] | (src[(pos + 1) % srcLen] << 8) | (src[(pos + 2) % srcLen] << 16) | (src[(pos + 3) % srcLen] << 24);
+		MSG_WriteBits(&msg, values[numValues], widths[numValues % numWidths]);
+		numValues++;
+		pos = (pos + 4) % srcLen;
+	}
+
+	// both writers must produce the same bytes, both readers the same values
+	MSG_Init(&ref, refBuf, sizeof(refBuf));
+	MSG_Init(&msg, newBuf, sizeof(newBuf));
+	Com_Memset(refBuf, 0, sizeof(refBuf));
+	Com_Memset(newBuf, 0, sizeof(newBuf));
+
+	for(i = 0; i < numValues; i++)
+	{
+		MSG_WriteBitsReference(&ref, values[i], widths[i % numWidths]);
+		MSG_WriteBits(&msg, values[i], widths[i % numWidths]);
+	}
+
+	mismatches = 0;
+	if(ref.bit != msg.bit || ref.cursize != msg.cursize || memcmp(refBuf, newBuf, sizeof(refBuf)))
+	{
+		Com_Printf("bitsTest: writer mismatch\n");
+		mismatches++;
+	}
+
+	// runs of values written on their own and appended with MSG_WriteRawBits
+	// at whatever alignment the message is at must not change a bit
+	MSG_Init(&msg, newBuf, sizeof(newBuf));
+	Com_Memset(newBuf, 0, sizeof(newBuf));
+	for(i = 0; i < numValues; i += j)
+	{
+		static byte runBuf[1024 + 32];
+		msg_t run;
+
+		MSG_Init(&run, runBuf, 1024);
+		for(j = 0; j < 1 + (i % 37) && i + j < numValues; j++)
+			MSG_WriteBits(&run, values[i + j], widths[(i + j) % numWidths]);
+
+		MSG_WriteRawBits(&msg, runBuf, run.bit);
+	}
+
+	if(ref.bit != msg.bit || ref.cursize != msg.cursize || memcmp(refBuf, newBuf, sizeof(refBuf)))
+	{
+		Com_Printf("bitsTest: raw bits mismatch\n");
+		mismatches++;
+	}
+
+	MSG_BeginReading(&ref);
+	MSG_BeginReading(&msg);
+	for(i = 0; i < numValues; i++)
+	{
+		j = widths[i % numWidths];
+		if(MSG_ReadBitsReference(&ref, j) != MSG_ReadBits(&msg, j) || ref.bit != msg.bit)
+		{
+			Com_Printf("bitsTest: reader mismatch at value %i\n", i);
+			mismatches++;
+			break;
+		}
+	}
+
+	Com_Printf("bitsTest: %i values, %i bytes, %i mismatches\n", numValues, msg.cursize, mismatches);
+
+	t0 = Sys_Milliseconds();
+	for(it = 0; it < iterations; it++)
+	{
+		MSG_Init(&ref, refBuf, sizeof(refBuf));
+		for(i = 0; i < numValues; i++)
+			MSG_WriteBitsReference(&ref, values[i], widths[i % numWidths]);
+	}
+	msecRef = Sys_Milliseconds() - t0;
+
+	t0 = Sys_Milliseconds();
+	for(it = 0; it < iterations; it++)
+	{
+		MSG_Init(&msg, newBuf, sizeof(newBuf));
+		for(i = 0; i < numValues; i++)
+			MSG_WriteBits(&msg, values[i], widths[i % numWidths]);
+	}
+	msecNew = Sys_Milliseconds() - t0;
+
+	Com_Printf("write: %i messages, bit at a time %i msec, word at a time %i msec\n", iterations, msecRef, msecNew);
+
+	t0 = Sys_Milliseconds();
+	for(it = 0; it < iterations; it++)
+	{
+		MSG_BeginReading(&ref);
+		for(i = 0; i < numValues; i++)
+			MSG_ReadBitsReference(&ref, widths[i % numWidths]);
+	}
+	msecRef = Sys_Milliseconds() - t0;
+
+	t0 = Sys_Milliseconds();
+	for(it = 0; it < iterations; it++)
+	{
+		MSG_BeginReading(&msg);
+		for(i = 0; i < numValues; i++)
+			MSG_ReadBits(&msg, widths[i % numWidths]);
+	}
+	msecNew = Sys_Milliseconds() - t0;
+
+	Com_Printf("read:  %i messages, bit at a time %i msec, word at a time %i msec\n", iterations, msecRef, msecNew);
+
+	if(file)
+		FS_FreeFile(file);
+	else
+		Z_Free(src);
+}
@@ -24,6 +24,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "../qcommon/q_shared.h"
 #include "../qcommon/qcommon.h"
 
+#include <atomic>
+
 #ifdef _WIN32
 #  include <winsock2.h>
 #  include <ws2tcpip.h>
@@ -73,6 +75,8 @@ static qboolean winsockInitialized = qfalse;
 #  include <sys/types.h>
 #  include <sys/time.h>
 #  include <unistd.h>
+#  include <pthread.h>
+#  include <sched.h>
 #  if !defined(__sun) && !defined(__sgi)
 #    include <ifaddrs.h>
 #  endif
@@ -92,6 +96,10 @@ typedef int	ioctlarg_t;
 #define EAGAIN2 EAGAIN
 #endif
 
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+#  define USE_MMSG
+#endif
+
 #if defined __GNUC__
 #  pragma GCC diagnostic ignored "-Wstrict-aliasing"
 #endif
@@ -114,6 +122,8 @@ static cvar_t *net_mcast6addr;
 static cvar_t *net_mcast6iface;
 
 static cvar_t	*net_dropsim;
+static cvar_t	*net_batch;
+static cvar_t	*net_thread;
 static struct sockaddr socksRelayAddr;
 
 static SOCKET ip_socket         = INVALID_SOCKET;
@@ -148,6 +158,16 @@ typedef struct
 static nip_localaddr_t localIP[MAX_IPS];
 static int numIP;
 
+static qboolean netThreadRunning;
+static thread_local qboolean netThreadSelf;
+static int netThreadBatching;
+
+static void NET_ThreadPrint(const char *text);
+static void NET_ThreadSend(int length, const void *data, netadr_t to);
+static void NET_ThreadKick(void);
+static void NET_StartThread(void);
+static void NET_StopThread(void);
+
 //=============================================================================
 /*
  ====================
@@ -211,6 +231,28 @@ char *NET_ErrorString(void)
 #endif
 }
 
+/*
+====================
+NET_Warning
+
+Socket errors can come up on the network thread, which must not print
+====================
+*/
+static void QDECL NET_Warning(const char *fmt, ...)
+{
+	va_list argptr;
+	char text[MAXPRINTMSG];
+
+	va_start(argptr, fmt);
+	Q_vsnprintf(text, sizeof(text), fmt, argptr);
+	va_end(argptr);
+
+	if(netThreadSelf)
+		NET_ThreadPrint(text);
+	else
+		Com_Printf("%s", text);
+}
+
 static void NetadrToSockadr( netadr_t *a, struct sockaddr *s ) {
 	if( a->type == NA_BROADCAST ) {
 		((struct sockaddr_in *)s)->sin_family      = AF_INET;
@@ -459,17 +501,25 @@ qboolean NET_CompareBaseAdr (netadr_t a, netadr_t b)
 	return NET_CompareBaseAdrMask(a, b, -1);
 }
 
-const char *NET_AdrToString(netadr_t a)
+/*
+===================
+NET_AdrToStringBuf
+
+Like NET_AdrToString, but into the caller's buffer so the network thread
+can use it
+===================
+*/
+static const char *NET_AdrToStringBuf(netadr_t a, char *s, int size)
 {
-	static char s[NET_ADDRSTRMAXLEN];
+	*s = '\0';
 
 	if(a.type == NA_LOOPBACK)
 	{
-		Com_sprintf(s, sizeof(s), "loopback");
+		Com_sprintf(s, size, "loopback");
 	}
 	else if(a.type == NA_BOT)
 	{
-		Com_sprintf(s, sizeof(s), "bot");
+		Com_sprintf(s, size, "bot");
 	}
 	else if(a.type == NA_IP || a.type == NA_IP6)
 	{
@@ -477,12 +527,19 @@ const char *NET_AdrToString(netadr_t a)
 
 		Com_Memset(&sadr, 0, sizeof(sadr));
 		NetadrToSockadr(&a, (struct sockaddr *)&sadr);
-		Sys_SockaddrToString(s, sizeof(s), (struct sockaddr *)&sadr);
+		Sys_SockaddrToString(s, size, (struct sockaddr *)&sadr);
 	}
 
 	return s;
 }
 
+const char *NET_AdrToString(netadr_t a)
+{
+	static char s[NET_ADDRSTRMAXLEN];
+
+	return NET_AdrToStringBuf(a, s, sizeof(s));
+}
+
 const char *NET_AdrToStringwPort(netadr_t a)
 {
 	static char s[NET_ADDRSTRMAXLEN];
@@ -541,6 +598,7 @@ qboolean NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
 	struct sockaddr_storage from;
 	socklen_t fromlen;
 	int err;
+	char adrString[NET_ADDRSTRMAXLEN];
 
 #ifdef _DEBUG
 	recvfromCount++;        // performance check
@@ -560,7 +618,7 @@ qboolean NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
 			err = socketError;
 
 			if(err != EAGAIN2 && err != ECONNRESET)
-				Com_Printf("NET_GetPacket: %s\n", NET_ErrorString());
+				NET_Warning("NET_GetPacket: %s\n", NET_ErrorString());
 		}
 		else
 		{
@@ -587,7 +645,7 @@ qboolean NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
 
 			if(ret == net_message->maxsize)
 			{
-				Com_Printf("Oversize packet from %s\n", NET_AdrToString(*net_from));
+				NET_Warning("Oversize packet from %s\n", NET_AdrToStringBuf(*net_from, adrString, sizeof(adrString)));
 				return qfalse;
 			}
 
@@ -610,7 +668,7 @@ qboolean NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
 			err = socketError;
 
 			if(err != EAGAIN2 && err != ECONNRESET)
-				Com_Printf("NET_GetPacket: %s\n", NET_ErrorString());
+				NET_Warning("NET_GetPacket: %s\n", NET_ErrorString());
 		}
 		else
 		{
@@ -619,7 +677,7 @@ qboolean NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
 
 			if(ret >= net_message->maxsize)
 			{
-				Com_Printf("Oversize packet from %s\n", NET_AdrToString(*net_from));
+				NET_Warning("Oversize packet from %s\n", NET_AdrToStringBuf(*net_from, adrString, sizeof(adrString)));
 				return qfalse;
 			}
 
@@ -643,7 +701,7 @@ qboolean NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
 			err = socketError;
 
 			if(err != EAGAIN2 && err != ECONNRESET)
-				Com_Printf("NET_GetPacket: %s\n", NET_ErrorString());
+				NET_Warning("NET_GetPacket: %s\n", NET_ErrorString());
 		}
 		else
 		{
@@ -652,7 +710,7 @@ qboolean NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
 
 			if(ret >= net_message->maxsize)
 			{
-				Com_Printf("Oversize packet from %s\n", NET_AdrToString(*net_from));
+				NET_Warning("Oversize packet from %s\n", NET_AdrToStringBuf(*net_from, adrString, sizeof(adrString)));
 				return qfalse;
 			}
 
@@ -665,6 +723,260 @@ qboolean NET_GetPacket(netadr_t *net_from, msg_t *net_message, fd_set *fdr)
 
 //=============================================================================
 
+/*
+===============================================================================
+
+BATCHED PACKET I/O
+
+On Linux the game sockets can be drained with recvmmsg and outgoing packets
+collected over a frame and flushed with sendmmsg, so a busy server does one
+syscall per batch instead of one per datagram.  net_batch selects it, the
+recvfrom/sendto path above stays in place for everything else: other
+platforms, SOCKS relaying, broadcasts, oversized packets and kernels
+without the syscalls.
+
+===============================================================================
+*/
+
+#define NET_BATCH_PACKETS 32
+#define NET_BATCH_PACKETLEN 1400        // MAX_PACKETLEN in net_chan.cc
+
+#ifdef USE_MMSG
+static qboolean netBatchUnsupported;
+
+static byte netRecvData[NET_BATCH_PACKETS][MAX_MSGLEN + 1];
+static msg_t netRecvMsg[NET_BATCH_PACKETS];
+static netadr_t netRecvFrom[NET_BATCH_PACKETS];
+
+static int netSendBatching;
+static int netSendCount;
+static byte netSendData[NET_BATCH_PACKETS][NET_BATCH_PACKETLEN];
+static struct sockaddr_storage netSendAddr[NET_BATCH_PACKETS];
+static SOCKET netSendSocket[NET_BATCH_PACKETS];
+static struct iovec netSendIov[NET_BATCH_PACKETS];
+static struct mmsghdr netSendHdr[NET_BATCH_PACKETS];
+
+/*
+==================
+NET_BatchUnsupported
+
+Falls back to the single packet path for good
+==================
+*/
+static void NET_BatchUnsupported(const char *func)
+{
+	NET_Warning("WARNING: %s: %s, batched packet I/O disabled\n", func, NET_ErrorString());
+	netBatchUnsupported = qtrue;
+}
+
+/*
+==================
+NET_GetPacketBatch
+
+Receives up to NET_BATCH_PACKETS packets from sock into the receive ring,
+count is set to the number of usable ones.  Returns the number of datagrams
+read, or -1 if batching is not available.
+==================
+*/
+static int NET_GetPacketBatch(SOCKET sock, int *count)
+{
+	struct sockaddr_storage from[NET_BATCH_PACKETS];
+	struct iovec iov[NET_BATCH_PACKETS];
+	struct mmsghdr hdr[NET_BATCH_PACKETS];
+	int i, ret, err;
+	char adrString[NET_ADDRSTRMAXLEN];
+
+	*count = 0;
+
+	for(i = 0; i < NET_BATCH_PACKETS; i++)
+	{
+		iov[i].iov_base = netRecvData[i];
+		iov[i].iov_len  = sizeof(netRecvData[i]);
+
+		Com_Memset(&hdr[i], 0, sizeof(hdr[i]));
+		hdr[i].msg_hdr.msg_name    = &from[i];
+		hdr[i].msg_hdr.msg_namelen = sizeof(from[i]);
+		hdr[i].msg_hdr.msg_iov     = &iov[i];
+		hdr[i].msg_hdr.msg_iovlen  = 1;
+	}
+
+	ret = recvmmsg(sock, hdr, NET_BATCH_PACKETS, MSG_DONTWAIT, NULL);
+
+	if(ret == SOCKET_ERROR)
+	{
+		err = socketError;
+
+		if(err == ENOSYS || err == EOPNOTSUPP)
+		{
+			NET_BatchUnsupported("recvmmsg");
+			return -1;
+		}
+
+		if(err != EAGAIN2 && err != ECONNRESET)
+			NET_Warning("NET_GetPacket: %s\n", NET_ErrorString());
+
+		return 0;
+	}
+
+	for(i = 0; i < ret; i++)
+	{
+		msg_t *msg = &netRecvMsg[*count];
+
+		MSG_Init(msg, netRecvData[i], sizeof(netRecvData[i]));
+		SockadrToNetadr((struct sockaddr *)&from[i], &netRecvFrom[*count]);
+
+		if((int)hdr[i].msg_len >= msg->maxsize)
+		{
+			NET_Warning("Oversize packet from %s\n", NET_AdrToStringBuf(netRecvFrom[*count], adrString, sizeof(adrString)));
+			continue;
+		}
+
+		msg->cursize = hdr[i].msg_len;
+		(*count)++;
+	}
+
+	return ret;
+}
+
+/*
+==================
+NET_FlushPacketBatch
+
+Hands all collected packets to the kernel, one sendmmsg per run of packets
+going out on the same socket
+==================
+*/
+static void NET_FlushPacketBatch(void)
+{
+	int start, end, ret, err;
+
+	for(start = 0; start < netSendCount; start = end)
+	{
+		for(end = start + 1; end < netSendCount && netSendSocket[end] == netSendSocket[start]; end++)
+			;
+
+		while(start < end)
+		{
+			if(netBatchUnsupported)
+			{
+				ret = sendto(netSendSocket[start], netSendIov[start].iov_base, netSendIov[start].iov_len, 0,
+				             (struct sockaddr *)&netSendAddr[start], netSendHdr[start].msg_hdr.msg_namelen);
+			}
+			else
+			{
+				ret = sendmmsg(netSendSocket[start], &netSendHdr[start], end - start, 0);
+			}
+
+			if(ret == SOCKET_ERROR)
+			{
+				err = socketError;
+
+				if(err == ENOSYS && !netBatchUnsupported)
+				{
+					NET_BatchUnsupported("sendmmsg");
+					continue;
+				}
+
+				// wouldblock is silent, like for single packets, and
+				// the datagram that failed is dropped either way
+				if(err != EAGAIN2)
+					NET_Warning("NET_SendPacket: %s\n", NET_ErrorString());
+
+				ret = 1;
+			}
+			else if(netBatchUnsupported)
+			{
+				ret = 1;
+			}
+
+			start += ret;
+		}
+	}
+
+	netSendCount = 0;
+}
+
+/*
+==================
+NET_QueueBatchPacket
+
+Returns qfalse if the packet has to be sent right away
+==================
+*/
+static qboolean NET_QueueBatchPacket(SOCKET sock, int length, const void *data, const struct sockaddr_storage *addr)
+{
+	int i;
+
+	if(!netSendBatching || netBatchUnsupported || length > NET_BATCH_PACKETLEN)
+		return qfalse;
+
+	if(netSendCount == NET_BATCH_PACKETS)
+		NET_FlushPacketBatch();
+
+	i = netSendCount++;
+
+	Com_Memcpy(netSendData[i], data, length);
+	netSendAddr[i]   = *addr;
+	netSendSocket[i] = sock;
+
+	netSendIov[i].iov_base = netSendData[i];
+	netSendIov[i].iov_len  = length;
+
+	Com_Memset(&netSendHdr[i], 0, sizeof(netSendHdr[i]));
+	netSendHdr[i].msg_hdr.msg_name    = &netSendAddr[i];
+	netSendHdr[i].msg_hdr.msg_namelen = addr->ss_family == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+	netSendHdr[i].msg_hdr.msg_iov     = &netSendIov[i];
+	netSendHdr[i].msg_hdr.msg_iovlen  = 1;
+
+	return qtrue;
+}
+#endif
+
+/*
+==================
+NET_BeginPacketBatch
+
+Packets sent until the matching NET_EndPacketBatch may be held back and
+sent together.  Batches can be nested.
+==================
+*/
+void NET_BeginPacketBatch(void)
+{
+	if(netThreadRunning)
+	{
+		// the network thread batches on its own, just hold back the kick
+		netThreadBatching++;
+		return;
+	}
+
+#ifdef USE_MMSG
+	if(net_batch && net_batch->integer)
+		netSendBatching++;
+#endif
+}
+
+/*
+==================
+NET_EndPacketBatch
+==================
+*/
+void NET_EndPacketBatch(void)
+{
+	if(netThreadRunning)
+	{
+		if(netThreadBatching > 0 && --netThreadBatching == 0)
+			NET_ThreadKick();
+		return;
+	}
+
+#ifdef USE_MMSG
+	if(netSendBatching > 0 && --netSendBatching == 0)
+		NET_FlushPacketBatch();
+#endif
+}
+
+//=============================================================================
+
 static char socksBuf[4096];
 
 /*
@@ -683,6 +995,12 @@ void Sys_SendPacket(int length, const void *data, netadr_t to)
 		return;
 	}
 
+	if(netThreadRunning && !netThreadSelf)
+	{
+		NET_ThreadSend(length, data, to);
+		return;
+	}
+
 	if((ip_socket == INVALID_SOCKET && to.type == NA_IP) ||
 		(ip_socket == INVALID_SOCKET && to.type == NA_BROADCAST) ||
 	   (ip6_socket == INVALID_SOCKET && to.type == NA_IP6) ||
@@ -711,6 +1029,11 @@ void Sys_SendPacket(int length, const void *data, netadr_t to)
 	  typedef char* casttype;
 #else
     typedef void* casttype;
+#endif
+#ifdef USE_MMSG
+    if((to.type == NA_IP || to.type == NA_IP6) &&
+       NET_QueueBatchPacket(addr.ss_family == AF_INET ? ip_socket : ip6_socket, length, data, &addr))
+      return;
 #endif
     if(addr.ss_family == AF_INET)
 		  ret = sendto(ip_socket, (casttype)data, length, 0, (struct sockaddr *)&addr, sizeof(struct sockaddr_in));
@@ -732,7 +1055,7 @@ void Sys_SendPacket(int length, const void *data, netadr_t to)
 			return;
 		}
 
-		Com_Printf("NET_SendPacket: %s\n", NET_ErrorString());
+		NET_Warning("NET_SendPacket: %s\n", NET_ErrorString());
 	}
 }
 
@@ -1557,6 +1880,13 @@ static qboolean NET_GetCvars( void ) {
 	net_socksPassword->modified = qfalse;
 
 	net_dropsim = Cvar_Get("net_dropsim", "", CVAR_TEMP);
+	net_batch = Cvar_Get("net_batch", "1", CVAR_ARCHIVE);
+
+#ifdef DEDICATED
+	net_thread = Cvar_Get("net_thread", "0", CVAR_LATCH | CVAR_ARCHIVE);
+	modified += net_thread->modified;
+	net_thread->modified = qfalse;
+#endif
 	return modified ? qtrue : qfalse;
 }
 
@@ -1613,6 +1943,8 @@ void NET_Config(qboolean enableNetworking)
 
 	if(stop)
 	{
+		NET_StopThread();
+
 		if(ip_socket != INVALID_SOCKET)
 		{
 			closesocket(ip_socket);
@@ -1639,6 +1971,11 @@ void NET_Config(qboolean enableNetworking)
 			socks_socket = INVALID_SOCKET;
 		}
 
+#ifdef USE_MMSG
+		// whatever is still batched was meant for the old sockets
+		netSendCount = 0;
+#endif
+
 	}
 
 	if(start)
@@ -1647,11 +1984,130 @@ void NET_Config(qboolean enableNetworking)
 		{
 			NET_OpenIP();
 			NET_SetMulticast6();
+			NET_StartThread();
 		}
 	}
 }
 
 
+/*
+====================
+NET_Benchmark_f
+
+Bounces packets between two sockets on the loopback interface and reports
+the packet rate of the single packet and, where available, the batched path
+====================
+*/
+static void NET_Benchmark_f(void)
+{
+	static byte data[NET_BATCH_PACKETS][NET_BATCH_PACKETLEN];
+	SOCKET rx, tx;
+	struct sockaddr_in to;
+	socklen_t tolen;
+	int count, size, err, mode, modes;
+	int i, burst, sent, received, start, msec;
+
+	count = Cmd_Argc() > 1 ? atoi(Cmd_Argv(1)) : 100000;
+	size  = Cmd_Argc() > 2 ? atoi(Cmd_Argv(2)) : 1200;
+
+	if(count < NET_BATCH_PACKETS)
+		count = NET_BATCH_PACKETS;
+	if(size < 1 || size > NET_BATCH_PACKETLEN)
+		size = NET_BATCH_PACKETLEN;
+
+	rx = NET_IPSocket((char *)"127.0.0.1", PORT_ANY, &err);
+	if(rx == INVALID_SOCKET)
+		return;
+
+	tx = NET_IPSocket((char *)"127.0.0.1", PORT_ANY, &err);
+	if(tx == INVALID_SOCKET)
+	{
+		closesocket(rx);
+		return;
+	}
+
+	tolen = sizeof(to);
+	if(getsockname(rx, (struct sockaddr *)&to, &tolen) == SOCKET_ERROR)
+	{
+		Com_Printf("NET_Benchmark: getsockname: %s\n", NET_ErrorString());
+		closesocket(rx);
+		closesocket(tx);
+		return;
+	}
+
+	Com_Memset(data, 0x55, sizeof(data));
+
+	modes = 1;
+#ifdef USE_MMSG
+	if(!netBatchUnsupported)
+		modes = 2;
+#endif
+
+	for(mode = 0; mode < modes; mode++)
+	{
+		sent     = 0;
+		received = 0;
+		start    = Sys_Milliseconds();
+
+		while(sent < count)
+		{
+			burst = count - sent;
+			if(burst > NET_BATCH_PACKETS)
+				burst = NET_BATCH_PACKETS;
+
+			if(mode == 0)
+			{
+				for(i = 0; i < burst; i++)
+					sendto(tx, (char *)data[i], size, 0, (struct sockaddr *)&to, tolen);
+
+				while(recvfrom(rx, (char *)data[0], sizeof(data[0]), 0, NULL, NULL) != SOCKET_ERROR)
+					received++;
+			}
+#ifdef USE_MMSG
+			else
+			{
+				struct iovec iov[NET_BATCH_PACKETS];
+				struct mmsghdr hdr[NET_BATCH_PACKETS];
+				int ret, got;
+
+				for(i = 0; i < burst; i++)
+				{
+					iov[i].iov_base = data[i];
+					iov[i].iov_len  = size;
+
+					Com_Memset(&hdr[i], 0, sizeof(hdr[i]));
+					hdr[i].msg_hdr.msg_name    = &to;
+					hdr[i].msg_hdr.msg_namelen = tolen;
+					hdr[i].msg_hdr.msg_iov     = &iov[i];
+					hdr[i].msg_hdr.msg_iovlen  = 1;
+				}
+
+				sendmmsg(tx, hdr, burst, 0);
+
+				do
+				{
+					ret = NET_GetPacketBatch(rx, &got);
+					received += got;
+				}
+				while(ret == NET_BATCH_PACKETS);
+			}
+#endif
+
+			sent += burst;
+		}
+
+		msec = Sys_Milliseconds() - start;
+		if(msec < 1)
+			msec = 1;
+
+		Com_Printf("%-10s %i of %i packets of %i bytes in %i msec, %i packets/sec\n",
+		           mode ? "mmsg:" : "sendto:", received, sent, size, msec, (int)(received * 1000.0 / msec));
+	}
+
+	closesocket(rx);
+	closesocket(tx);
+}
+
 /*
 ====================
 NET_Init
@@ -1676,6 +2132,7 @@ void NET_Init(void)
 
 	NET_Config(qtrue);
 	Cmd_AddCommand ("net_restart", NET_Restart_f);
+	Cmd_AddCommand ("net_benchmark", NET_Benchmark_f);
 }
 
 
@@ -1701,31 +2158,82 @@ void NET_Shutdown(void)
 
 /*
 ====================
-NET_Event
-Called from NET_Sleep which uses select() to determine which sockets have seen action.
+NET_DispatchPacket
 ====================
 */
-void NET_Event(fd_set *fdr)
+static void NET_DispatchPacket(netadr_t *from, msg_t *netmsg)
+{
+	if(net_dropsim->value > 0.0f && net_dropsim->value <= 100.0f)
+	{
+		// com_dropsim->value percent of incoming packets get dropped.
+		if(rand() < (int) (((double) RAND_MAX) / 100.0 * (double) net_dropsim->value))
+			return;          // drop this packet
+	}
+	if(com_sv_running->integer)
+		Com_RunAndTimeServerPacket(from, netmsg);
+	else
+		CL_PacketEvent(*from, netmsg);
+}
+
+#ifdef USE_MMSG
+/*
+====================
+NET_BatchEvent
+
+Drains sock with recvmmsg and takes it out of fdr.  Leaves fdr alone if
+batching turns out not to be available.
+====================
+*/
+static void NET_BatchEvent(SOCKET sock, fd_set *fdr, void (*dispatch)(netadr_t *from, msg_t *netmsg))
+{
+	int i, ret, count;
+
+	if(sock == INVALID_SOCKET || !FD_ISSET(sock, fdr))
+		return;
+
+	do
+	{
+		ret = NET_GetPacketBatch(sock, &count);
+		if(ret < 0)
+			return;
+
+		for(i = 0; i < count; i++)
+			dispatch(&netRecvFrom[i], &netRecvMsg[i]);
+	}
+	while(ret == NET_BATCH_PACKETS);
+
+	FD_CLR(sock, fdr);
+}
+#endif
+
+/*
+====================
+NET_ReadPackets
+
+Reads everything that is waiting on the sockets in fdr
+====================
+*/
+static void NET_ReadPackets(fd_set *fdr, void (*dispatch)(netadr_t *from, msg_t *netmsg))
 {
 	byte bufData[MAX_MSGLEN + 1];
 	netadr_t from;
 	msg_t netmsg;
+
+#ifdef USE_MMSG
+	if(net_batch->integer && !netBatchUnsupported)
+	{
+		// SOCKS relayed packets carry an extra header, leave them to NET_GetPacket
+		if(!usingSocks)
+			NET_BatchEvent(ip_socket, fdr, dispatch);
+		NET_BatchEvent(ip6_socket, fdr, dispatch);
+	}
+#endif
+
 	while(1)
 	{
 		MSG_Init(&netmsg, bufData, sizeof(bufData));
 		if(NET_GetPacket(&from, &netmsg, fdr))
-		{
-			if(net_dropsim->value > 0.0f && net_dropsim->value <= 100.0f)
-			{
-				// com_dropsim->value percent of incoming packets get dropped.
-				if(rand() < (int) (((double) RAND_MAX) / 100.0 * (double) net_dropsim->value))
-					continue;          // drop this packet
-                        }
-			if(com_sv_running->integer)
-				Com_RunAndTimeServerPacket(&from, &netmsg);
-			else
-				CL_PacketEvent(from, &netmsg);
-		}
+			dispatch(&from, &netmsg);
 		else
 			break;
 	}
@@ -1733,12 +2241,546 @@ void NET_Event(fd_set *fdr)
 
 /*
 ====================
-NET_Sleep
-
-Sleeps msec or until something happens on the network
+NET_Event
+Called from NET_Sleep which uses select() to determine which sockets have seen action.
 ====================
 */
-void NET_Sleep(int msec)
+void NET_Event(fd_set *fdr)
+{
+	NET_ReadPackets(fdr, NET_DispatchPacket);
+}
+
+/*
+===============================================================================
+
+NETWORK THREAD
+
+With net_thread 1 a dedicated server hands all socket I/O to a thread of its
+own.  It receives and timestamps packets while the main thread is busy with
+the game frame, and sends what the main thread queued up, so neither has to
+wait for the other.  Both directions go through single producer, single
+consumer rings:
+
+  netRecvRing: network thread -> main thread, packets and deferred prints
+  netSendRing: main thread -> network thread, outgoing packets
+
+The event queue and the zone allocator are main thread only, so received
+packets are not posted with Com_QueueEvent but picked up from the ring by
+NET_Sleep, where NET_Event used to read them from the sockets.
+
+===============================================================================
+*/
+
+#define NET_RECV_SLOTS 128              // must be a power of two
+#define NET_SEND_SLOTS 512              // must be a power of two
+
+typedef struct
+{
+	int time;                           // Sys_Milliseconds when it was received
+	netadr_t from;
+	int cursize;                        // -1 for text to print
+	byte data[MAX_MSGLEN + 1];
+} netRecvSlot_t;
+
+typedef struct
+{
+	netadr_t to;
+	int length;
+	byte *big;                          // malloc'd for packets that don't fit into data
+	byte data[NET_BATCH_PACKETLEN];
+} netSendSlot_t;
+
+static netRecvSlot_t *netRecvRing;
+static std::atomic<int> netRecvHead, netRecvTail;
+static int netRecvDropped;
+
+static netSendSlot_t *netSendRing;
+static std::atomic<int> netSendHead, netSendTail;
+
+static std::atomic<qboolean> netThreadQuit;
+static std::atomic<qboolean> netKickPending;
+static SOCKET netKickSocket = INVALID_SOCKET;
+static struct sockaddr_in netKickAddr;
+static qboolean netThreadWaiting;
+static int netThreadGeneration;         // bumped whenever the thread is started
+
+#ifdef _WIN32
+static HANDLE netThread;
+static CRITICAL_SECTION netThreadLock;
+static CONDITION_VARIABLE netThreadWake;
+
+static void NET_ThreadLock(void)    { EnterCriticalSection(&netThreadLock); }
+static void NET_ThreadUnlock(void)  { LeaveCriticalSection(&netThreadLock); }
+static void NET_ThreadSignal(void)  { WakeConditionVariable(&netThreadWake); }
+static void NET_ThreadYield(void)   { Sleep(0); }
+#else
+static pthread_t netThread;
+static pthread_mutex_t netThreadLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t netThreadWake = PTHREAD_COND_INITIALIZER;
+
+static void NET_ThreadLock(void)    { pthread_mutex_lock(&netThreadLock); }
+static void NET_ThreadUnlock(void)  { pthread_mutex_unlock(&netThreadLock); }
+static void NET_ThreadSignal(void)  { pthread_cond_signal(&netThreadWake); }
+static void NET_ThreadYield(void)   { sched_yield(); }
+#endif
+
+/*
+====================
+NET_ThreadWait
+
+Waits up to msec for the network thread to queue something, called with the
+lock held
+====================
+*/
+static void NET_ThreadWait(int msec)
+{
+#ifdef _WIN32
+	SleepConditionVariableCS(&netThreadWake, &netThreadLock, msec);
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec  += msec / 1000;
+	ts.tv_nsec += (msec % 1000) * 1000000;
+	if(ts.tv_nsec >= 1000000000)
+	{
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+
+	pthread_cond_timedwait(&netThreadWake, &netThreadLock, &ts);
+#endif
+}
+
+/*
+====================
+NET_ThreadRecvSlot
+
+Returns the next free receive slot, or NULL if the main thread has fallen
+too far behind
+====================
+*/
+static netRecvSlot_t *NET_ThreadRecvSlot(void)
+{
+	int head = netRecvHead.load(std::memory_order_relaxed);
+
+	if(head - netRecvTail.load(std::memory_order_acquire) >= NET_RECV_SLOTS)
+		return NULL;
+
+	return &netRecvRing[head & (NET_RECV_SLOTS - 1)];
+}
+
+/*
+====================
+NET_ThreadPublish
+
+Makes the slot returned by NET_ThreadRecvSlot visible to the main thread
+====================
+*/
+static void NET_ThreadPublish(void)
+{
+	netRecvHead.store(netRecvHead.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+/*
+====================
+NET_ThreadPrint
+
+Prints from the network thread are handed to the main thread
+====================
+*/
+static void NET_ThreadPrint(const char *text)
+{
+	netRecvSlot_t *slot = NET_ThreadRecvSlot();
+
+	if(!slot)
+		return;
+
+	slot->time    = Sys_Milliseconds();
+	slot->cursize = -1;
+	Q_strncpyz((char *)slot->data, text, sizeof(slot->data));
+
+	NET_ThreadPublish();
+}
+
+/*
+====================
+NET_ThreadQueuePacket
+====================
+*/
+static void NET_ThreadQueuePacket(netadr_t *from, msg_t *netmsg)
+{
+	netRecvSlot_t *slot = NET_ThreadRecvSlot();
+
+	if(!slot)
+	{
+		// the kernel would have dropped it as well
+		netRecvDropped++;
+		return;
+	}
+
+	slot->time    = Sys_Milliseconds();
+	slot->from    = *from;
+	slot->cursize = netmsg->cursize;
+	Com_Memcpy(slot->data, netmsg->data, netmsg->cursize);
+
+	NET_ThreadPublish();
+}
+
+/*
+====================
+NET_ThreadKick
+
+Wakes the network thread up to send what has been queued
+====================
+*/
+static void NET_ThreadKick(void)
+{
+	byte b = 0;
+
+	if(netKickPending.exchange(qtrue))
+		return;
+
+	sendto(netKickSocket, (char *)&b, 1, 0, (struct sockaddr *)&netKickAddr, sizeof(netKickAddr));
+}
+
+/*
+====================
+NET_ThreadSend
+
+Queues a packet for the network thread
+====================
+*/
+static void NET_ThreadSend(int length, const void *data, netadr_t to)
+{
+	netSendSlot_t *slot;
+	int head;
+
+	head = netSendHead.load(std::memory_order_relaxed);
+
+	while(head - netSendTail.load(std::memory_order_acquire) >= NET_SEND_SLOTS)
+	{
+		NET_ThreadKick();
+		NET_ThreadYield();
+	}
+
+	slot = &netSendRing[head & (NET_SEND_SLOTS - 1)];
+	slot->to     = to;
+	slot->length = length;
+
+	if(length > (int)sizeof(slot->data))
+	{
+		slot->big = (byte *)malloc(length);
+		Com_Memcpy(slot->big, data, length);
+	}
+	else
+	{
+		slot->big = NULL;
+		Com_Memcpy(slot->data, data, length);
+	}
+
+	netSendHead.store(head + 1, std::memory_order_release);
+
+	if(!netThreadBatching)
+		NET_ThreadKick();
+}
+
+/*
+====================
+NET_ThreadFlushSends
+====================
+*/
+static void NET_ThreadFlushSends(void)
+{
+	netSendSlot_t *slot;
+	int tail, head;
+
+	netKickPending.store(qfalse);
+
+	tail = netSendTail.load(std::memory_order_relaxed);
+	head = netSendHead.load(std::memory_order_acquire);
+
+	if(tail == head)
+		return;
+
+#ifdef USE_MMSG
+	if(net_batch->integer)
+		netSendBatching++;
+#endif
+
+	for(; tail != head; tail++)
+	{
+		slot = &netSendRing[tail & (NET_SEND_SLOTS - 1)];
+
+		if(slot->big)
+		{
+			Sys_SendPacket(slot->length, slot->big, slot->to);
+			free(slot->big);
+		}
+		else
+			Sys_SendPacket(slot->length, slot->data, slot->to);
+	}
+
+#ifdef USE_MMSG
+	if(netSendBatching > 0 && --netSendBatching == 0)
+		NET_FlushPacketBatch();
+#endif
+
+	netSendTail.store(tail, std::memory_order_release);
+}
+
+/*
+====================
+NET_ThreadLoop
+====================
+*/
+static void NET_ThreadLoop(void)
+{
+	struct timeval timeout;
+	fd_set fdr;
+	SOCKET highestfd;
+	byte b[16];
+	int head, dropped;
+
+	netThreadSelf = qtrue;
+	dropped = 0;
+
+	while(!netThreadQuit.load())
+	{
+		NET_ThreadFlushSends();
+
+		FD_ZERO(&fdr);
+		FD_SET(netKickSocket, &fdr);
+		highestfd = netKickSocket;
+
+		if(ip_socket != INVALID_SOCKET)
+		{
+			FD_SET(ip_socket, &fdr);
+			if(ip_socket > highestfd)
+				highestfd = ip_socket;
+		}
+		if(ip6_socket != INVALID_SOCKET)
+		{
+			FD_SET(ip6_socket, &fdr);
+			if(ip6_socket > highestfd)
+				highestfd = ip6_socket;
+		}
+
+		timeout.tv_sec  = 0;
+		timeout.tv_usec = 100000;
+
+		if(select(highestfd + 1, &fdr, NULL, NULL, &timeout) <= 0)
+			continue;
+
+		if(FD_ISSET(netKickSocket, &fdr))
+		{
+			while(recvfrom(netKickSocket, (char *)b, sizeof(b), 0, NULL, NULL) != SOCKET_ERROR)
+				;
+			FD_CLR(netKickSocket, &fdr);
+		}
+
+		head = netRecvHead.load(std::memory_order_relaxed);
+
+		NET_ReadPackets(&fdr, NET_ThreadQueuePacket);
+
+		if(netRecvDropped != dropped)
+		{
+			NET_Warning("WARNING: network thread dropped %i packets\n", netRecvDropped - dropped);
+			dropped = netRecvDropped;
+		}
+
+		if(netRecvHead.load(std::memory_order_relaxed) != head)
+		{
+			NET_ThreadLock();
+			if(netThreadWaiting)
+				NET_ThreadSignal();
+			NET_ThreadUnlock();
+		}
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI NET_ThreadMain(LPVOID arg)
+{
+	NET_ThreadLoop();
+	return 0;
+}
+#else
+static void *NET_ThreadMain(void *arg)
+{
+	NET_ThreadLoop();
+	return NULL;
+}
+#endif
+
+/*
+====================
+NET_StartThread
+====================
+*/
+static void NET_StartThread(void)
+{
+	socklen_t len;
+	int err;
+
+	// only registered for dedicated servers, a client has no frame to overlap with
+	if(!net_thread || !net_thread->integer)
+		return;
+
+	if(netThreadRunning || (ip_socket == INVALID_SOCKET && ip6_socket == INVALID_SOCKET))
+		return;
+
+	netKickSocket = NET_IPSocket((char *)"127.0.0.1", PORT_ANY, &err);
+	if(netKickSocket == INVALID_SOCKET)
+		return;
+
+	len = sizeof(netKickAddr);
+	if(getsockname(netKickSocket, (struct sockaddr *)&netKickAddr, &len) == SOCKET_ERROR)
+	{
+		Com_Printf("WARNING: NET_StartThread: getsockname: %s\n", NET_ErrorString());
+		closesocket(netKickSocket);
+		netKickSocket = INVALID_SOCKET;
+		return;
+	}
+
+	netRecvRing = (netRecvSlot_t *)Z_Malloc(NET_RECV_SLOTS * sizeof(*netRecvRing));
+	netSendRing = (netSendSlot_t *)Z_Malloc(NET_SEND_SLOTS * sizeof(*netSendRing));
+	netRecvHead = netRecvTail = 0;
+	netSendHead = netSendTail = 0;
+	netRecvDropped    = 0;
+	netThreadBatching = 0;
+	netThreadQuit     = qfalse;
+	netKickPending    = qfalse;
+
+#ifdef _WIN32
+	InitializeCriticalSection(&netThreadLock);
+	InitializeConditionVariable(&netThreadWake);
+	netThread = CreateThread(NULL, 0, NET_ThreadMain, NULL, 0, NULL);
+	if(!netThread)
+#else
+	if(pthread_create(&netThread, NULL, NET_ThreadMain, NULL))
+#endif
+	{
+		Com_Printf(S_COLOR_YELLOW "WARNING: could not create network thread\n");
+		Z_Free(netRecvRing);
+		Z_Free(netSendRing);
+		closesocket(netKickSocket);
+		netKickSocket = INVALID_SOCKET;
+		return;
+	}
+
+	netThreadRunning = qtrue;
+	netThreadGeneration++;
+	Com_Printf("Network thread started\n");
+}
+
+/*
+====================
+NET_StopThread
+
+Sends whatever is still queued and joins the network thread
+====================
+*/
+static void NET_StopThread(void)
+{
+	if(!netThreadRunning)
+		return;
+
+	netThreadQuit = qtrue;
+	netKickPending = qfalse;
+	NET_ThreadKick();
+
+#ifdef _WIN32
+	WaitForSingleObject(netThread, INFINITE);
+	CloseHandle(netThread);
+	DeleteCriticalSection(&netThreadLock);
+#else
+	pthread_join(netThread, NULL);
+#endif
+
+	netThreadRunning = qfalse;
+
+	NET_ThreadFlushSends();
+
+	Z_Free(netRecvRing);
+	Z_Free(netSendRing);
+	netRecvRing = NULL;
+	netSendRing = NULL;
+
+	closesocket(netKickSocket);
+	netKickSocket = INVALID_SOCKET;
+}
+
+/*
+====================
+NET_ThreadEvent
+
+Dispatches the packets the network thread has received, after waiting up
+to msec for one to show up
+====================
+*/
+static void NET_ThreadEvent(int msec)
+{
+	static byte data[MAX_MSGLEN + 1];
+	netRecvSlot_t *slot;
+	netadr_t from;
+	msg_t netmsg;
+	int tail, generation, cursize, time;
+
+	generation = netThreadGeneration;
+	tail = netRecvTail.load(std::memory_order_relaxed);
+
+	if(msec > 0 && tail == netRecvHead.load(std::memory_order_acquire))
+	{
+		NET_ThreadLock();
+		netThreadWaiting = qtrue;
+		if(tail == netRecvHead.load(std::memory_order_acquire))
+			NET_ThreadWait(msec);
+		netThreadWaiting = qfalse;
+		NET_ThreadUnlock();
+	}
+
+	while(tail != netRecvHead.load(std::memory_order_acquire))
+	{
+		slot = &netRecvRing[tail & (NET_RECV_SLOTS - 1)];
+
+		// take the packet out of the ring before handling it, a Com_Error
+		// while it is handled must not get it handled again
+		cursize = slot->cursize;
+		time    = slot->time;
+		from    = slot->from;
+		Com_Memcpy(data, slot->data, cursize < 0 ? sizeof(data) : cursize);
+
+		netRecvTail.store(++tail, std::memory_order_release);
+
+		if(cursize < 0)
+			Com_Printf("%s", (char *)data);
+		else
+		{
+			if(com_speeds->integer == 3)
+				Com_Printf("packet queued for %i msec\n", Sys_Milliseconds() - time);
+
+			MSG_Init(&netmsg, data, sizeof(data));
+			netmsg.cursize = cursize;
+
+			NET_DispatchPacket(&from, &netmsg);
+		}
+
+		// the packet may have restarted networking
+		if(!netThreadRunning || netThreadGeneration != generation)
+			return;
+	}
+}
+
+
+/*
+====================
+NET_Sleep
+
+Sleeps msec or until something happens on the network
+====================
+*/
+void NET_Sleep(int msec)
 {
 	struct timeval timeout;
 	fd_set fdr;
@@ -1747,8 +2789,30 @@ void NET_Sleep(int msec)
 
 	if(msec < 0)
 		msec = 0;
+
+	if(netThreadRunning)
+	{
+		if(netThreadBatching)
+		{
+			netThreadBatching = 0;
+			NET_ThreadKick();
+		}
+
+		NET_ThreadEvent(msec);
+		return;
+	}
+
 	FD_ZERO(&fdr);
 
+#ifdef USE_MMSG
+	// a batch never outlives a frame, even if an error skipped its end
+	if(netSendBatching)
+	{
+		netSendBatching = 1;
+		NET_EndPacketBatch();
+	}
+#endif
+
 
 
 
@@ -193,6 +193,17 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "q_platform.h" //hypov8 linked elsewhere
 
+// storage that is private to each thread; the VM has no threads
+#if defined(Q3_VM)
+# define Q_THREADLOCAL
+#elif defined(__cplusplus)
+# define Q_THREADLOCAL thread_local
+#elif defined(_MSC_VER)
+# define Q_THREADLOCAL __declspec(thread)
+#else
+# define Q_THREADLOCAL __thread
+#endif
+
 
 //=============================================================
 
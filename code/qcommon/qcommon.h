@@ -70,6 +70,7 @@ struct entityState_s;
 struct playerState_s;
 
 void MSG_WriteBits(msg_t *msg, int value, int bits);
+void MSG_WriteRawBits(msg_t *msg, const byte *data, int bits);
 
 void MSG_WriteChar(msg_t *sb, int c);
 void MSG_WriteByte(msg_t *sb, int c);
@@ -113,6 +114,8 @@ void MSG_ReadDeltaPlayerstate(msg_t *msg, struct playerState_s *from, struct pla
 
 
 void MSG_ReportChangeVectors_f(void);
+void MSG_HuffTest_f(void);
+void MSG_BitsTest_f(void);
 
 //============================================================================
 
@@ -189,6 +192,8 @@ qboolean NET_GetLoopPacket(netsrc_t sock, netadr_t *net_from, msg_t *net_message
 void NET_JoinMulticast6(void);
 void NET_LeaveMulticast6(void);
 void NET_Sleep(int msec);
+void NET_BeginPacketBatch(void);
+void NET_EndPacketBatch(void);
 
 
 #define	MAX_MSGLEN				(16384)	// max length of a message, which may
@@ -576,6 +581,11 @@ fileHandle_t	FS_FCreateOpenPipeFile( const char *filename );
 
 fileHandle_t FS_SV_FOpenFileWrite(const char *filename);
 long		FS_SV_FOpenFileRead( const char *filename, fileHandle_t *fp );
+long		FS_SV_MapFile( const char *filename, void **data, qboolean *mapped );
+void		FS_UnmapFile( void *data, long length, qboolean mapped );
+// maps a file found by FS_SV_FOpenFileRead read only into memory, or reads
+// a copy of it where fs_mmap doesn't allow mapping, returns the length or
+// -1 if the file can't be found or read
 void FS_SV_Rename(const char *from, const char *to, qboolean safe);
 long		FS_FOpenFileRead( const char *qpath, fileHandle_t *file, qboolean uniqueFILE );
 // if uniqueFILE is true, then a new FILE will be fopened even if the file
@@ -605,6 +615,23 @@ long	FS_ReadFile(const char *qpath, void **buffer);
 // the buffer should be considered read-only, because it may be cached
 // for other uses.
 
+int		FS_FileExtensions(const char *name, const char **exts, int numExts);
+// bit i is set when name.exts[i] exists, for loaders trying several formats
+
+void	FS_ClearLookupStats(void);
+// fs_lookupStats counts from the last call, made on map load
+
+long	FS_ReadFileMapped(const char *qpath, const void **buffer);
+// like FS_ReadFile, but a file stored uncompressed in a mapped pk3 is
+// returned in place, so the buffer is read only and has no trailing 0.
+// still freed with FS_FreeFile
+
+long	FS_MapGameFile(const char *qpath, const void **data);
+void	FS_UnmapGameFile(const void *data);
+// keeps a whole file readable in memory until FS_UnmapGameFile, without a
+// copy if it is a loose file or stored uncompressed in a mapped pk3.
+// the data is read only and has no trailing 0
+
 void FS_ForceFlush(fileHandle_t f);
 // forces flush on files we're writing to.
 
@@ -676,6 +703,34 @@ qboolean FS_Which(const char *filename, void *searchPath);
 /*
 ==============================================================
 
+THREADS
+
+==============================================================
+*/
+
+#define MAX_WORKER_THREADS 16
+
+void Com_RunJobs(int numThreads, int workcnt, void (*func)(int work, int threadnum));
+// calls func for every work item, spread over numThreads threads
+// including the calling one, and returns when all of them are done
+
+void Com_StartJobs(int numThreads, int workcnt, void (*func)(int work, int threadnum));
+void Com_WaitJobs(void);
+// like Com_RunJobs, but the work is left to numThreads worker threads
+// until Com_WaitJobs is called
+
+int Com_WorkerThreadNum(void);
+// threadnum of the calling thread, in [0, MAX_WORKER_THREADS]
+
+qboolean Com_JobError(int code, const char *message);
+// called by Com_Error, leaves the running work item and has the error
+// raised on the main thread when the job is done
+
+void Com_ShutdownThreads(void);
+
+/*
+==============================================================
+
 Edit fields and command line history/completion
 
 ==============================================================
@@ -879,8 +934,21 @@ void *S_Malloc(size_t size);
 void Z_Free(void *ptr);
 void Z_FreeTags(int tag);
 int Z_AvailableMemory(void);
+int Z_FreeBlocks(void);
 void Z_LogHeap(void);
 
+// slab.cc, Z_SlabAlloc and Z_SlabFree are safe on any thread, Z_TagMalloc
+// only when the allocation fits a slab class and the slab arena isn't full
+void Z_InitSlabs(void);
+void *Z_SlabAlloc(size_t size, int tag);                                      // NULL if it has to come from the zone
+qboolean Z_SlabFree(void *ptr);                                               // qfalse if ptr isn't slab memory
+void Z_SlabFreeTags(int tag);
+void Z_SlabMeminfo(void);
+void Z_TraceAlloc(void *ptr, size_t size, int tag);
+void Z_TraceFree(void *ptr);
+void Z_Trace_f(void);
+void Z_Replay_f(void);
+
 void Hunk_Clear(void);
 void Hunk_ClearToMark(void);
 void Hunk_SetMark(void);
@@ -1044,6 +1112,9 @@ void Sys_Print(const char *msg);
 // any game related timing information should come from event timestamps
 int Sys_Milliseconds(void);
 
+// monotonic high resolution time for benchmarks and profiles
+int64_t Sys_Nanoseconds(void);
+
 void	Sys_SnapVector( float *v );
 qboolean Sys_RandomBytes(byte *string, int len);
 
@@ -1063,6 +1134,9 @@ qboolean Sys_IsLANAddress(netadr_t adr);
 void Sys_ShowIP(void);
 
 FILE	*Sys_FOpen( const char *ospath, const char *mode );
+void	*Sys_MapFile( FILE *f, long length );
+void	Sys_UnmapFile( void *data, long length );
+int64_t	Sys_FileTime( FILE *f );
 qboolean Sys_Mkdir( const char *path );
 FILE	*Sys_Mkfifo( const char *ospath );
 char *Sys_Cwd(void);
@@ -1146,6 +1220,23 @@ typedef struct
 	huff_t decompressor;
 } huffman_t;
 
+#define HUFF_LOOKUP_BITS 11
+
+// flattened static tree, see Huff_BuildTable
+typedef struct
+{
+	huff_t *huff;
+
+	// encoder, codes in wire order, a length of 0 falls back to the tree
+	unsigned int code[HMAX];
+	byte codeLength[HMAX];
+
+	// decoder, indexed by the next HUFF_LOOKUP_BITS input bits
+	short symbol[1 << HUFF_LOOKUP_BITS];         // -1 if the code is longer
+	byte symbolLength[1 << HUFF_LOOKUP_BITS];
+	node_t *node[1 << HUFF_LOOKUP_BITS];         // where to continue the walk if it is
+} huffTable_t;
+
 void Huff_Compress(msg_t *buf, int offset);
 void Huff_Decompress(msg_t *buf, int offset);
 void Huff_Init(huffman_t *huff);
@@ -1156,6 +1247,9 @@ void Huff_offsetReceive(node_t *node, int *ch, byte *fin, int *offset);
 void Huff_offsetTransmit(huff_t *huff, int ch, byte *fout, int *offset);
 void Huff_putBit(int bit, byte *fout, int *offset);
 int Huff_getBit(byte *fout, int *offset);
+void Huff_BuildTable(huffTable_t *table, huff_t *huff);
+void Huff_TableTransmit(const huffTable_t *table, int ch, byte *fout, int *offset);
+void Huff_TableReceive(const huffTable_t *table, int *ch, byte *fin, int *offset, int size);
 
 // don't use if you don't know what you're doing.
 int Huff_getBloc(void);
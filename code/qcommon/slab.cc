@@ -0,0 +1,1141 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+Copyright (C) 2006-xyyz Lars '0xA5EA' Kandler
+
+This file is part of KingpinQ3 source code.
+
+KingpinQ3 source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+KingpinQ3 source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with KingpinQ3 source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// slab.cc -- size class pools for small zone allocations
+
+#include "q_shared.h"
+#include "qcommon.h"
+
+#include <atomic>
+#include <mutex>
+
+/*
+===============================================================================
+
+SLAB ALLOCATION
+
+Z_TagMalloc hands allocations of up to SLAB_MAX_SIZE bytes to a set of
+size classes instead of the zone rover.  Every class keeps a free list of
+equally sized chunks, carved from SLAB_PAGE_SIZE pages of one arena that
+is allocated next to the main zone (com_slabMegs).  An allocation takes a
+chunk and a free gives it back, so the cost does not depend on what else
+is in the zone and small strings no longer fragment it.
+
+Every thread keeps a cache of free chunks per class and only goes to the
+shared free lists when its cache runs empty, taking up to half of
+SLAB_CACHE_CHUNKS, or holds more than SLAB_CACHE_CHUNKS, giving half of
+them back.  A thread that exits gives all of its cached chunks back and
+its cache to the next thread that starts.  The shared lists are lock
+free stacks.  Their heads carry a change counter next to
+the chunk offset so a compare and swap can't be fooled by a chunk that was
+taken and given back in between, and the arena is never released, so
+reading the link of a chunk someone else just took is harmless.
+
+Z_SlabAlloc and Z_SlabFree can therefore be called from worker threads.
+Z_TagMalloc and Z_Free only can if the allocation fits a slab class and
+the arena isn't full, since they fall back to the zone otherwise.
+Allocations that don't fit, or every allocation when com_slabMegs is 0 or
+ZONE_DEBUG is defined, come from the zone.
+
+===============================================================================
+*/
+
+#define SLAB_PAGE_SIZE      65536
+#define SLAB_MAX_SIZE       256
+#define SLAB_ID             0x5ab1d
+#define SLAB_CACHE_CHUNKS   256
+#define MAX_SLAB_CACHES     (MAX_WORKER_THREADS + 8)
+
+typedef struct
+{
+	int tag;                                 // 0 while free
+	int id;                                  // should be SLAB_ID
+	std::atomic<unsigned int> next;          // offset + 1 of the next free chunk
+	int size;                                // requested size
+} slabchunk_t;
+
+typedef struct
+{
+	std::atomic<uint64_t> head;              // change counter << 32 | offset + 1
+	int chunkSize;                           // including the slabchunk_t
+	int maxSize;                             // largest allocation that goes here
+	std::atomic<int> pages;
+	char pad[64];                            // keep the heads on their own cache lines
+} slabclass_t;
+
+static const int slabSizes[] = { 16, 32, 48, 64, 96, 128, 192, SLAB_MAX_SIZE };
+
+#define NUM_SLAB_CLASSES ARRAY_LEN(slabSizes)
+
+// only touched by the thread that owns it, meminfo reads the counters
+typedef struct
+{
+	unsigned int free[NUM_SLAB_CLASSES];     // offset + 1 of the first cached chunk
+	int numFree[NUM_SLAB_CLASSES];
+	int64_t allocs[NUM_SLAB_CLASSES];
+	int64_t frees[NUM_SLAB_CLASSES];
+	int64_t fallbacks;                       // small allocations that went to the zone
+	std::atomic<int> owned;                  // a live thread uses this cache
+	char pad[64];
+} slabcache_t;
+
+static slabclass_t slabClasses[NUM_SLAB_CLASSES];
+static byte slabSizeToClass[SLAB_MAX_SIZE / 16 + 1];
+
+static slabcache_t slabCaches[MAX_SLAB_CACHES];
+static std::atomic<int> slabNumCaches;       // caches ever handed out, meminfo reads that many
+static thread_local slabcache_t *slabCache;
+static slabcache_t slabNoCache;              // slabCache of threads that got none
+
+static void Z_SlabFlushCache(slabcache_t *cache);
+
+// gives the cache of a thread back when the thread exits
+struct slabCacheOwner_t
+{
+	slabcache_t *cache;
+
+	~slabCacheOwner_t()
+	{
+		if(cache)
+		{
+			Z_SlabFlushCache(cache);
+		}
+	}
+};
+
+static thread_local slabCacheOwner_t slabCacheOwner;
+
+// counters of the threads that got no cache
+static std::atomic<int64_t> slabSharedAllocs[NUM_SLAB_CLASSES];
+static std::atomic<int64_t> slabSharedFrees[NUM_SLAB_CLASSES];
+
+static byte *slabArena;
+static int slabArenaSize;
+static int slabNumPages;
+static byte *slabPageClass;
+static std::atomic<int> slabPagesUsed;
+static qboolean slabBypass;                  // zonereplay compares against the plain zone
+
+static cvar_t *com_slabMegs;
+
+#define SLAB_CHUNK(offset)  ((slabchunk_t *)(slabArena + (offset) - 1))
+#define SLAB_OFFSET(chunk)  ((unsigned int)((byte *)(chunk) - slabArena) + 1)
+
+/*
+=================
+Z_InitSlabs
+=================
+*/
+void Z_InitSlabs(void)
+{
+	int i, size;
+
+	com_slabMegs = Cvar_Get("com_slabMegs", "8", CVAR_LATCH | CVAR_ARCHIVE);
+
+	for(i = 0, size = 0; i <= SLAB_MAX_SIZE / 16; i++)
+	{
+		while(slabSizes[size] < i * 16)
+		{
+			size++;
+		}
+		slabSizeToClass[i] = size;
+	}
+
+	for(i = 0; i < (int)NUM_SLAB_CLASSES; i++)
+	{
+		slabClasses[i].maxSize = slabSizes[i];
+		slabClasses[i].chunkSize = slabSizes[i] + sizeof(slabchunk_t);
+	}
+
+	if(com_slabMegs->integer <= 0)
+	{
+		return;
+	}
+
+	slabNumPages = com_slabMegs->integer * (1024 * 1024 / SLAB_PAGE_SIZE);
+	slabArenaSize = slabNumPages * SLAB_PAGE_SIZE;
+
+	// pages are only touched once a class needs them
+	slabArena = (byte *)calloc(slabArenaSize, 1);
+	slabPageClass = (byte *)calloc(slabNumPages, 1);
+	if(!slabArena || !slabPageClass)
+	{
+		Com_Error(ERR_FATAL, "Slab data failed to allocate %i megs", com_slabMegs->integer);
+	}
+}
+
+/*
+=================
+Z_SlabCache
+
+The cache of the calling thread, NULL if there are too many threads.
+Caches of exited threads are reused, their counters keep adding up.
+=================
+*/
+static slabcache_t *Z_SlabCache(void)
+{
+	int i, expected, numCaches;
+
+	if(!slabCache)
+	{
+		slabCache = &slabNoCache;
+		for(i = 0; i < MAX_SLAB_CACHES; i++)
+		{
+			expected = 0;
+			if(slabCaches[i].owned.compare_exchange_strong(expected, 1, std::memory_order_acquire))
+			{
+				slabCache = &slabCaches[i];
+				slabCacheOwner.cache = slabCache;
+
+				numCaches = slabNumCaches.load();
+				while(numCaches < i + 1 && !slabNumCaches.compare_exchange_weak(numCaches, i + 1))
+				{
+				}
+				break;
+			}
+		}
+	}
+
+	return slabCache != &slabNoCache ? slabCache : NULL;
+}
+
+/*
+=================
+Z_SlabPush
+
+Gives the linked chunks first..last back to the shared list of class
+=================
+*/
+static void Z_SlabPush(slabclass_t *cls, slabchunk_t *first, slabchunk_t *last)
+{
+	uint64_t head, neww;
+
+	head = cls->head.load(std::memory_order_relaxed);
+	do
+	{
+		last->next.store((unsigned int)head, std::memory_order_relaxed);
+		neww = ((head >> 32) + 1) << 32 | SLAB_OFFSET(first);
+	} while(!cls->head.compare_exchange_weak(head, neww, std::memory_order_release, std::memory_order_relaxed));
+}
+
+/*
+=================
+Z_SlabPop
+
+Takes one chunk from the shared list of class
+=================
+*/
+static slabchunk_t *Z_SlabPop(slabclass_t *cls)
+{
+	uint64_t head, neww;
+	slabchunk_t *chunk;
+
+	head = cls->head.load(std::memory_order_acquire);
+	while((unsigned int)head)
+	{
+		chunk = SLAB_CHUNK((unsigned int)head);
+		neww = ((head >> 32) + 1) << 32 | chunk->next.load(std::memory_order_relaxed);
+		if(cls->head.compare_exchange_weak(head, neww, std::memory_order_acquire, std::memory_order_acquire))
+		{
+			return chunk;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+=================
+Z_SlabCarve
+
+Splits a new page into chunks for class, keeps the first and returns the
+others linked behind it.  Returns NULL once the arena is used up.
+=================
+*/
+static slabchunk_t *Z_SlabCarve(slabclass_t *cls, int *count)
+{
+	int page, i;
+	byte *base;
+	slabchunk_t *chunk;
+
+	if(slabPagesUsed.load(std::memory_order_relaxed) >= slabNumPages)
+	{
+		return NULL;
+	}
+
+	page = slabPagesUsed.fetch_add(1);
+	if(page >= slabNumPages)
+	{
+		return NULL;
+	}
+
+	slabPageClass[page] = cls - slabClasses;
+	base = slabArena + page * SLAB_PAGE_SIZE;
+	*count = SLAB_PAGE_SIZE / cls->chunkSize;
+
+	for(i = 0; i < *count; i++)
+	{
+		chunk = (slabchunk_t *)(base + i * cls->chunkSize);
+		chunk->tag = 0;
+		chunk->id = SLAB_ID;
+		chunk->next.store(i + 1 < *count ? SLAB_OFFSET(base + (i + 1) * cls->chunkSize) : 0, std::memory_order_relaxed);
+	}
+
+	cls->pages++;
+
+	return (slabchunk_t *)base;
+}
+
+/*
+=================
+Z_SlabRefill
+
+Fills the empty cache of class with up to SLAB_CACHE_CHUNKS / 2 chunks of
+the shared list, or with a new page, and returns the first chunk.  The
+chunks are popped one at a time, taking the whole list at once would
+leave it empty for a moment and make other threads carve new pages.
+=================
+*/
+static slabchunk_t *Z_SlabRefill(slabcache_t *cache, int c)
+{
+	slabclass_t *cls = &slabClasses[c];
+	slabchunk_t *chunk, *next;
+	int count;
+
+	chunk = Z_SlabPop(cls);
+	if(chunk)
+	{
+		cache->free[c] = 0;
+		for(count = 1; count < SLAB_CACHE_CHUNKS / 2 && (next = Z_SlabPop(cls)) != NULL; count++)
+		{
+			next->next.store(cache->free[c], std::memory_order_relaxed);
+			cache->free[c] = SLAB_OFFSET(next);
+		}
+		cache->numFree[c] = count - 1;
+		return chunk;
+	}
+
+	chunk = Z_SlabCarve(cls, &count);
+	if(!chunk)
+	{
+		return NULL;
+	}
+
+	cache->free[c] = chunk->next.load(std::memory_order_relaxed);
+	cache->numFree[c] = count - 1;
+
+	return chunk;
+}
+
+/*
+=================
+Z_SlabFlushCache
+
+Gives all chunks of an exiting thread's cache back to the shared lists
+and frees the cache for another thread
+=================
+*/
+static void Z_SlabFlushCache(slabcache_t *cache)
+{
+	slabchunk_t *first, *last;
+	int c;
+
+	for(c = 0; c < (int)NUM_SLAB_CLASSES; c++)
+	{
+		if(!cache->free[c])
+		{
+			continue;
+		}
+
+		first = last = SLAB_CHUNK(cache->free[c]);
+		while(last->next.load(std::memory_order_relaxed))
+		{
+			last = SLAB_CHUNK(last->next.load(std::memory_order_relaxed));
+		}
+
+		Z_SlabPush(&slabClasses[c], first, last);
+		cache->free[c] = 0;
+		cache->numFree[c] = 0;
+	}
+
+	// frees during the rest of the thread's exit go to the shared lists
+	slabCache = &slabNoCache;
+	cache->owned.store(0, std::memory_order_release);
+}
+
+/*
+=================
+Z_SlabAlloc
+
+Returns NULL if the allocation has to come from the zone, safe to call
+from any thread.  NOT 0 filled memory.
+=================
+*/
+void *Z_SlabAlloc(size_t size, int tag)
+{
+	slabcache_t *cache;
+	slabclass_t *cls;
+	slabchunk_t *chunk;
+	int c, count;
+
+	if(size > SLAB_MAX_SIZE || !slabArena || slabBypass)
+	{
+		return NULL;
+	}
+
+	c = slabSizeToClass[(size + 15) >> 4];
+	cls = &slabClasses[c];
+	cache = Z_SlabCache();
+
+	if(cache && cache->free[c])
+	{
+		chunk = SLAB_CHUNK(cache->free[c]);
+		cache->free[c] = chunk->next.load(std::memory_order_relaxed);
+		cache->numFree[c]--;
+	}
+	else if(cache)
+	{
+		chunk = Z_SlabRefill(cache, c);
+	}
+	else
+	{
+		// more threads than caches, work on the shared list directly
+		chunk = Z_SlabPop(cls);
+		if(!chunk && (chunk = Z_SlabCarve(cls, &count)) != NULL && count > 1)
+		{
+			Z_SlabPush(cls, SLAB_CHUNK(chunk->next.load(std::memory_order_relaxed)),
+			           (slabchunk_t *)((byte *)chunk + (count - 1) * cls->chunkSize));
+		}
+	}
+
+	if(!chunk)
+	{
+		if(cache)
+		{
+			cache->fallbacks++;
+		}
+		return NULL;
+	}
+
+	if(cache)
+	{
+		cache->allocs[c]++;
+	}
+	else
+	{
+		slabSharedAllocs[c]++;
+	}
+
+	chunk->tag = tag;
+	chunk->size = size;
+
+	return chunk + 1;
+}
+
+/*
+=================
+Z_SlabFree
+
+Returns qfalse if ptr is not slab memory, safe to call from any thread
+=================
+*/
+qboolean Z_SlabFree(void *ptr)
+{
+	slabcache_t *cache;
+	slabclass_t *cls;
+	slabchunk_t *chunk, *last;
+	int c, i;
+
+	if((byte *)ptr < slabArena || (byte *)ptr >= slabArena + slabArenaSize)
+	{
+		return qfalse;
+	}
+
+	chunk = (slabchunk_t *)ptr - 1;
+	if(chunk->id != SLAB_ID)
+	{
+		Com_Error(ERR_FATAL, "Z_Free: freed a pointer without SLAB_ID");
+	}
+
+	if(chunk->tag == 0)
+	{
+		Com_Error(ERR_FATAL, "Z_Free: freed a freed pointer");
+	}
+
+	c = slabPageClass[((byte *)chunk - slabArena) / SLAB_PAGE_SIZE];
+	cls = &slabClasses[c];
+
+	// set the chunk to something that should cause problems
+	// if it is referenced...
+	Com_Memset(ptr, 0xaa, cls->maxSize);
+	chunk->tag = 0;
+
+	cache = Z_SlabCache();
+	if(!cache)
+	{
+		slabSharedFrees[c]++;
+		Z_SlabPush(cls, chunk, chunk);
+		return qtrue;
+	}
+
+	cache->frees[c]++;
+	chunk->next.store(cache->free[c], std::memory_order_relaxed);
+	cache->free[c] = SLAB_OFFSET(chunk);
+
+	if(++cache->numFree[c] > SLAB_CACHE_CHUNKS)
+	{
+		// keep the half that was freed last, it is more likely in the cache
+		for(i = 1; i < SLAB_CACHE_CHUNKS / 2; i++)
+		{
+			chunk = SLAB_CHUNK(chunk->next.load(std::memory_order_relaxed));
+		}
+
+		last = chunk;
+		while(last->next.load(std::memory_order_relaxed))
+		{
+			last = SLAB_CHUNK(last->next.load(std::memory_order_relaxed));
+		}
+
+		Z_SlabPush(cls, SLAB_CHUNK(chunk->next.load(std::memory_order_relaxed)), last);
+		chunk->next.store(0, std::memory_order_relaxed);
+		cache->numFree[c] = SLAB_CACHE_CHUNKS / 2;
+	}
+
+	return qtrue;
+}
+
+/*
+=================
+Z_SlabFreeTags
+
+Must not run while other threads allocate
+=================
+*/
+void Z_SlabFreeTags(int tag)
+{
+	int page, used, i, count;
+	byte *base;
+	slabclass_t *cls;
+	slabchunk_t *chunk;
+
+	used = Q_min(slabPagesUsed.load(), slabNumPages);
+	for(page = 0; page < used; page++)
+	{
+		cls = &slabClasses[slabPageClass[page]];
+		base = slabArena + page * SLAB_PAGE_SIZE;
+		count = SLAB_PAGE_SIZE / cls->chunkSize;
+
+		for(i = 0; i < count; i++)
+		{
+			chunk = (slabchunk_t *)(base + i * cls->chunkSize);
+			if(chunk->tag == tag)
+			{
+				Z_SlabFree(chunk + 1);
+			}
+		}
+	}
+}
+
+/*
+=================
+Z_SlabMeminfo
+
+Per class statistics for meminfo, the counters of other threads may be
+a little behind
+=================
+*/
+void Z_SlabMeminfo(void)
+{
+	int i, j, pages, numCaches, chunks, cached, inUseBytes;
+	int64_t allocs, inUse, fallbacks;
+	slabclass_t *cls;
+	slabcache_t *cache;
+
+	if(!slabArena)
+	{
+		Com_Printf("slabs disabled, set com_slabMegs to use them\n");
+		return;
+	}
+
+	pages = Q_min(slabPagesUsed.load(), slabNumPages);
+	numCaches = Q_min(slabNumCaches.load(), MAX_SLAB_CACHES);
+
+	Com_Printf("        size  pages    chunks     inuse    cached       allocs\n");
+	inUseBytes = 0;
+	fallbacks = 0;
+	for(i = 0; i < (int)NUM_SLAB_CLASSES; i++)
+	{
+		cls = &slabClasses[i];
+		chunks = cls->pages.load() * (SLAB_PAGE_SIZE / cls->chunkSize);
+		allocs = slabSharedAllocs[i].load();
+		inUse = allocs - slabSharedFrees[i].load();
+		cached = 0;
+
+		for(j = 0; j < numCaches; j++)
+		{
+			cache = &slabCaches[j];
+			allocs += cache->allocs[i];
+			inUse += cache->allocs[i] - cache->frees[i];
+			cached += cache->numFree[i];
+		}
+
+		inUseBytes += inUse * cls->chunkSize;
+		Com_Printf("        %4i  %5i  %8i  %8i  %8i  %11lld\n", cls->maxSize, cls->pages.load(), chunks, (int)inUse, cached,
+		           (long long)allocs);
+	}
+
+	for(j = 0; j < numCaches; j++)
+	{
+		fallbacks += slabCaches[j].fallbacks;
+	}
+
+	Com_Printf("%9i bytes (%6.2f MB) in %i of %i slab pages, %i bytes in use, %i thread caches\n", pages * SLAB_PAGE_SIZE,
+	           pages * SLAB_PAGE_SIZE / Square(1024.f), pages, slabNumPages, inUseBytes, numCaches);
+	if(fallbacks)
+	{
+		Com_Printf("        %lld small allocations fell back to the zone, raise com_slabMegs\n", (long long)fallbacks);
+	}
+}
+
+/*
+===============================================================================
+
+ALLOCATION TRACES
+
+"zonetrace <file>" records every zone allocation and free until "zonetrace"
+is given again and writes them to <file>, "zonereplay <file>" runs such a
+trace through the slabs and through the plain zone and prints the times.
+Workers allocate too, so the events are appended under zoneTraceLock and
+the recording is in the order the threads got the lock.
+
+===============================================================================
+*/
+
+#define ZONETRACE_IDENT     (('C'<<24)+('R'<<16)+('T'<<8)+'Z')
+#define ZONETRACE_VERSION   1
+
+enum
+{
+	ZT_ALLOC,
+	ZT_FREE
+};
+
+typedef struct
+{
+	void *ptr;
+	int size;
+	short tag;
+	short op;
+} zoneTraceEvent_t;
+
+// written to the file, ptr is turned into the ordinal of its allocation
+typedef struct
+{
+	int op;
+	int slot;
+	int size;
+	int tag;
+} zoneTraceRecord_t;
+
+static struct
+{
+	std::atomic<qboolean> recording;
+	char fileName[MAX_QPATH];
+	zoneTraceEvent_t *events;
+	int numEvents;
+	int maxEvents;
+} zoneTrace;
+
+static std::mutex zoneTraceLock;
+
+/*
+=================
+Z_TraceEvent
+=================
+*/
+static void Z_TraceEvent(int op, void *ptr, size_t size, int tag)
+{
+	zoneTraceEvent_t *ev;
+	std::lock_guard<std::mutex> lock(zoneTraceLock);
+
+	// the recording can have stopped while this thread waited
+	if(!zoneTrace.recording)
+	{
+		return;
+	}
+
+	if(zoneTrace.numEvents == zoneTrace.maxEvents)
+	{
+		zoneTrace.maxEvents = zoneTrace.maxEvents ? zoneTrace.maxEvents * 2 : 65536;
+		ev = (zoneTraceEvent_t *)realloc(zoneTrace.events, zoneTrace.maxEvents * sizeof(*ev));
+		if(!ev)
+		{
+			zoneTrace.recording = qfalse;
+			return;
+		}
+		zoneTrace.events = ev;
+	}
+
+	ev = &zoneTrace.events[zoneTrace.numEvents++];
+	ev->op = op;
+	ev->ptr = ptr;
+	ev->size = size;
+	ev->tag = tag;
+}
+
+/*
+=================
+Z_TraceAlloc
+=================
+*/
+void Z_TraceAlloc(void *ptr, size_t size, int tag)
+{
+	if(zoneTrace.recording)
+	{
+		Z_TraceEvent(ZT_ALLOC, ptr, size, tag);
+	}
+}
+
+/*
+=================
+Z_TraceFree
+=================
+*/
+void Z_TraceFree(void *ptr)
+{
+	if(zoneTrace.recording)
+	{
+		Z_TraceEvent(ZT_FREE, ptr, 0, 0);
+	}
+}
+
+/*
+=================
+Z_WriteTrace
+
+Turns the pointers into allocation ordinals and writes the trace, frees
+of memory allocated before the recording started are dropped
+=================
+*/
+static void Z_WriteTrace(void)
+{
+	int i, h, hashSize, numAllocs, numRecords;
+	int *hashSlots;
+	void **hashPtrs;
+	zoneTraceEvent_t *ev;
+	zoneTraceRecord_t *records, *rec;
+	fileHandle_t f;
+	int header[3];
+
+	for(hashSize = 1024; hashSize < zoneTrace.numEvents * 2; hashSize <<= 1)
+	{
+	}
+
+	// open addressing from live pointers to their allocation ordinal,
+	// a freed entry keeps its pointer with slot -1 so probing goes on
+	hashPtrs = (void **)calloc(hashSize, sizeof(*hashPtrs));
+	hashSlots = (int *)calloc(hashSize, sizeof(*hashSlots));
+	records = (zoneTraceRecord_t *)malloc(zoneTrace.numEvents * sizeof(*records));
+	if(!hashPtrs || !hashSlots || !records)
+	{
+		free(hashPtrs);
+		free(hashSlots);
+		free(records);
+		Com_Printf("zonetrace: out of memory for %i events\n", zoneTrace.numEvents);
+		return;
+	}
+
+	numAllocs = 0;
+	numRecords = 0;
+	for(i = 0, ev = zoneTrace.events; i < zoneTrace.numEvents; i++, ev++)
+	{
+		h = (int)(((uintptr_t)ev->ptr >> 4) * 2654435761u) & (hashSize - 1);
+
+		if(ev->op == ZT_ALLOC)
+		{
+			while(hashPtrs[h] && hashSlots[h] >= 0)
+			{
+				h = (h + 1) & (hashSize - 1);
+			}
+			hashPtrs[h] = ev->ptr;
+			hashSlots[h] = numAllocs;
+
+			rec = &records[numRecords++];
+			rec->op = LittleLong(ZT_ALLOC);
+			rec->slot = LittleLong(numAllocs);
+			rec->size = LittleLong(ev->size);
+			rec->tag = LittleLong(ev->tag);
+			numAllocs++;
+			continue;
+		}
+
+		while(hashPtrs[h] && (hashPtrs[h] != ev->ptr || hashSlots[h] < 0))
+		{
+			h = (h + 1) & (hashSize - 1);
+		}
+		if(!hashPtrs[h])
+		{
+			continue;
+		}
+
+		rec = &records[numRecords++];
+		rec->op = LittleLong(ZT_FREE);
+		rec->slot = LittleLong(hashSlots[h]);
+		rec->size = 0;
+		rec->tag = 0;
+		hashSlots[h] = -1;
+	}
+
+	f = FS_FOpenFileWrite(zoneTrace.fileName);
+	if(f)
+	{
+		header[0] = LittleLong(ZONETRACE_IDENT);
+		header[1] = LittleLong(ZONETRACE_VERSION);
+		header[2] = LittleLong(numRecords);
+		FS_Write(header, sizeof(header), f);
+		FS_Write(records, numRecords * sizeof(*records), f);
+		FS_FCloseFile(f);
+		Com_Printf("wrote %i allocations and %i frees to %s\n", numAllocs, numRecords - numAllocs, zoneTrace.fileName);
+	}
+	else
+	{
+		Com_Printf("zonetrace: couldn't write %s\n", zoneTrace.fileName);
+	}
+
+	free(hashPtrs);
+	free(hashSlots);
+	free(records);
+}
+
+/*
+=================
+Z_Trace_f
+
+zonetrace <file> to start recording, zonetrace to stop and write it
+=================
+*/
+void Z_Trace_f(void)
+{
+	if(zoneTrace.recording)
+	{
+		// stop first, writing the file allocates too
+		zoneTraceLock.lock();
+		zoneTrace.recording = qfalse;
+		zoneTraceLock.unlock();
+		Z_WriteTrace();
+
+		free(zoneTrace.events);
+		zoneTrace.events = NULL;
+		zoneTrace.numEvents = zoneTrace.maxEvents = 0;
+		return;
+	}
+
+	if(Cmd_Argc() != 2)
+	{
+		Com_Printf("usage: zonetrace <file>, then zonetrace again to write it\n");
+		return;
+	}
+
+	Q_strncpyz(zoneTrace.fileName, Cmd_Argv(1), sizeof(zoneTrace.fileName));
+	COM_DefaultExtension(zoneTrace.fileName, sizeof(zoneTrace.fileName), ".ztrace");
+	zoneTrace.numEvents = 0;
+	zoneTrace.recording = qtrue;
+	Com_Printf("recording zone allocations for %s\n", zoneTrace.fileName);
+}
+
+typedef struct
+{
+	const zoneTraceRecord_t *records;
+	int numRecords;
+	int numSlots;
+	void **slots;                            // one table per thread
+	std::atomic<int> skipped;
+} zoneReplay_t;
+
+static zoneReplay_t zoneReplay;
+
+#define ZONEREPLAY_ROUNDS 5
+
+/*
+=================
+Z_ReplayTrace
+
+Runs the trace with Z_TagMalloc and Z_Free, or only its allocations of up
+to SLAB_MAX_SIZE bytes, and returns the nanoseconds of the fastest of
+ZONEREPLAY_ROUNDS rounds.  fragments is the number of free zone blocks
+the trace leaves behind.  What the trace leaves allocated is freed after
+the clock stopped.
+=================
+*/
+static int64_t Z_ReplayTrace(void **slots, qboolean smallOnly, int *fragments)
+{
+	int i, round;
+	int64_t start, nsec, best;
+	const zoneTraceRecord_t *rec;
+
+	best = 0;
+	for(round = 0; round < ZONEREPLAY_ROUNDS; round++)
+	{
+		Com_Memset(slots, 0, zoneReplay.numSlots * sizeof(*slots));
+
+		start = Sys_Nanoseconds();
+		for(i = 0, rec = zoneReplay.records; i < zoneReplay.numRecords; i++, rec++)
+		{
+			if(rec->op == ZT_ALLOC)
+			{
+				if(!smallOnly || rec->size <= SLAB_MAX_SIZE)
+				{
+					slots[rec->slot] = Z_TagMalloc(rec->size, rec->tag);
+				}
+			}
+			else if(slots[rec->slot])
+			{
+				Z_Free(slots[rec->slot]);
+				slots[rec->slot] = NULL;
+			}
+		}
+		nsec = Sys_Nanoseconds() - start;
+
+		if(!round || nsec < best)
+		{
+			best = nsec;
+		}
+
+		*fragments = Z_FreeBlocks();
+
+		for(i = 0; i < zoneReplay.numSlots; i++)
+		{
+			if(slots[i])
+			{
+				Z_Free(slots[i]);
+			}
+		}
+	}
+
+	return best;
+}
+
+/*
+=================
+Z_ReplaySlabWork
+
+Runs the small allocations of the trace on the slabs alone, one copy of
+the trace per thread
+=================
+*/
+static void Z_ReplaySlabWork(int work, int threadnum)
+{
+	int i, skipped;
+	void **slots;
+	const zoneTraceRecord_t *rec;
+
+	slots = zoneReplay.slots + work * zoneReplay.numSlots;
+	Com_Memset(slots, 0, zoneReplay.numSlots * sizeof(*slots));
+
+	skipped = 0;
+	for(i = 0, rec = zoneReplay.records; i < zoneReplay.numRecords; i++, rec++)
+	{
+		if(rec->op == ZT_ALLOC)
+		{
+			if(rec->size <= SLAB_MAX_SIZE && !(slots[rec->slot] = Z_SlabAlloc(rec->size, rec->tag)))
+			{
+				skipped++;
+			}
+		}
+		else if(slots[rec->slot])
+		{
+			Z_SlabFree(slots[rec->slot]);
+			slots[rec->slot] = NULL;
+		}
+	}
+
+	for(i = 0; i < zoneReplay.numSlots; i++)
+	{
+		if(slots[i])
+		{
+			Z_SlabFree(slots[i]);
+		}
+	}
+
+	zoneReplay.skipped += skipped;
+}
+
+/*
+=================
+Z_Replay_f
+
+zonereplay <file> [threads]
+=================
+*/
+void Z_Replay_f(void)
+{
+	int i, len, numThreads, numSmall, live, peak, numAllocs;
+	int zoneFragments, slabFragments, fragments;
+	int64_t zoneNsec, slabNsec, zoneSmallNsec, slabSmallNsec, threadNsec;
+	int *header, *sizes;
+	char fileName[MAX_QPATH];
+	union
+	{
+		int *i;
+		void *v;
+	} buffer;
+
+	if(Cmd_Argc() < 2)
+	{
+		Com_Printf("usage: zonereplay <file> [threads]\n");
+		return;
+	}
+
+	if(zoneTrace.recording)
+	{
+		Com_Printf("zonereplay: stop zonetrace first\n");
+		return;
+	}
+
+	Q_strncpyz(fileName, Cmd_Argv(1), sizeof(fileName));
+	COM_DefaultExtension(fileName, sizeof(fileName), ".ztrace");
+	numThreads = Cmd_Argc() > 2 ? atoi(Cmd_Argv(2)) : 4;
+	numThreads = Com_Clamp(1, MAX_WORKER_THREADS + 1, numThreads);
+
+	len = FS_ReadFile(fileName, &buffer.v);
+	if(!buffer.v)
+	{
+		Com_Printf("zonereplay: couldn't read %s\n", fileName);
+		return;
+	}
+
+	header = buffer.i;
+	if(len < 12 || LittleLong(header[0]) != ZONETRACE_IDENT || LittleLong(header[1]) != ZONETRACE_VERSION ||
+	   LittleLong(header[2]) < 0 || LittleLong(header[2]) > (int)((len - 12) / sizeof(zoneTraceRecord_t)))
+	{
+		Com_Printf("zonereplay: %s is not a zone trace\n", fileName);
+		FS_FreeFile(buffer.v);
+		return;
+	}
+
+	zoneReplay.records = (zoneTraceRecord_t *)(header + 3);
+	zoneReplay.numRecords = LittleLong(header[2]);
+
+	// the records are used in place, so swap them once and check them,
+	// sizes keeps the size of every live allocation to find the peak
+	sizes = (int *)malloc((size_t)Q_max(zoneReplay.numRecords, 1) * sizeof(*sizes));
+	if(!sizes)
+	{
+		FS_FreeFile(buffer.v);
+		return;
+	}
+
+	numAllocs = numSmall = live = peak = 0;
+	for(i = 0; i < zoneReplay.numRecords; i++)
+	{
+		zoneTraceRecord_t *r = (zoneTraceRecord_t *)&zoneReplay.records[i];
+
+		r->op = LittleLong(r->op);
+		r->slot = LittleLong(r->slot);
+		r->size = LittleLong(r->size);
+		r->tag = LittleLong(r->tag);
+
+		if(r->op == ZT_ALLOC)
+		{
+			if(r->slot != numAllocs || r->size < 0 || r->tag <= TAG_FREE || r->tag >= TAG_STATIC)
+			{
+				break;
+			}
+			sizes[numAllocs++] = r->size;
+			numSmall += r->size <= SLAB_MAX_SIZE;
+			live += r->size;
+			peak = Q_max(peak, live);
+		}
+		else if(r->op == ZT_FREE && r->slot >= 0 && r->slot < numAllocs && sizes[r->slot] >= 0)
+		{
+			live -= sizes[r->slot];
+			sizes[r->slot] = -1;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	free(sizes);
+
+	if(i < zoneReplay.numRecords)
+	{
+		Com_Printf("zonereplay: %s is corrupt at record %i\n", fileName, i);
+		FS_FreeFile(buffer.v);
+		return;
+	}
+
+	// the replay allocates on top of everything that is in use already
+	if(peak > Z_AvailableMemory() / 2)
+	{
+		Com_Printf("zonereplay: %s needs up to %i bytes, more than the zone can spare\n", fileName, peak);
+		FS_FreeFile(buffer.v);
+		return;
+	}
+
+	zoneReplay.numSlots = numAllocs;
+	zoneReplay.slots = (void **)malloc((size_t)Q_max(numAllocs, 1) * sizeof(void *) * numThreads);
+	if(!zoneReplay.slots)
+	{
+		FS_FreeFile(buffer.v);
+		return;
+	}
+
+	slabBypass = qtrue;
+	zoneNsec = Z_ReplayTrace(zoneReplay.slots, qfalse, &zoneFragments);
+	zoneSmallNsec = Z_ReplayTrace(zoneReplay.slots, qtrue, &fragments);
+	slabBypass = qfalse;
+
+	slabNsec = Z_ReplayTrace(zoneReplay.slots, qfalse, &slabFragments);
+	slabSmallNsec = Z_ReplayTrace(zoneReplay.slots, qtrue, &fragments);
+
+	Com_Printf("%s: %i allocations, %i of them up to %i bytes, %i frees, %i bytes peak\n", fileName, numAllocs, numSmall,
+	           SLAB_MAX_SIZE, zoneReplay.numRecords - numAllocs, peak);
+	Com_Printf("                whole trace      small allocations  free zone blocks left\n");
+	Com_Printf("  zone          %8.3f msec    %8.3f msec      %6i\n", zoneNsec / 1e6, zoneSmallNsec / 1e6, zoneFragments);
+
+	if(!slabArena)
+	{
+		Com_Printf("  slabs are disabled, set com_slabMegs to compare\n");
+	}
+	else
+	{
+		Com_Printf("  slabs + zone  %8.3f msec    %8.3f msec      %6i\n", slabNsec / 1e6, slabSmallNsec / 1e6, slabFragments);
+		Com_Printf("  speedup       %8.2fx        %8.2fx\n", slabNsec ? (double)zoneNsec / slabNsec : 0.0,
+		           slabSmallNsec ? (double)zoneSmallNsec / slabSmallNsec : 0.0);
+
+		// every thread replays the small allocations of its own copy of the
+		// trace at the same time, which only the slabs can take
+		zoneReplay.skipped = 0;
+		threadNsec = Sys_Nanoseconds();
+		Com_RunJobs(numThreads, numThreads, Z_ReplaySlabWork);
+		threadNsec = Sys_Nanoseconds() - threadNsec;
+
+		Com_Printf("  %i threads with a copy each of the small allocations  %8.3f msec%s\n", numThreads, threadNsec / 1e6,
+		           zoneReplay.skipped ? va(", %i didn't fit", zoneReplay.skipped.load()) : "");
+	}
+
+	free(zoneReplay.slots);
+	zoneReplay.slots = NULL;
+	FS_FreeFile(buffer.v);
+}
@@ -0,0 +1,492 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+Copyright (C) 2006-xyyz Lars '0xA5EA' Kandler
+
+This file is part of KingpinQ3 source code.
+
+KingpinQ3 source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+KingpinQ3 source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with KingpinQ3 source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// threads.cc -- worker thread pool for splitting a job into independent work items
+
+#include "q_shared.h"
+#include "qcommon.h"
+
+#include <setjmp.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+/*
+===============================================================================
+
+The pool works like RunThreadsOnIndividual in the tools: the calling thread
+publishes a job of workcnt items and takes part in it as thread 0, the
+workers pick up items until all of them are handed out, and the caller
+returns once every item has finished.
+
+Com_StartJobs publishes a job the same way but returns right away, so the
+caller can get on with other work while the workers run it.  The caller
+joins in as thread 0 when it calls Com_WaitJobs.  Only one job can be
+published at a time.
+
+Work functions run outside of the main thread, so they must not call
+Com_Printf, the zone allocator or anything else that touches shared engine
+state.  A Com_Error inside a work function abandons that work item and is
+raised again on the main thread once the job has finished.
+
+===============================================================================
+*/
+
+typedef struct
+{
+	void (*func)(int work, int threadnum);
+	int numThreads;                          // threads allowed to take part, including the caller
+	int workcnt;
+	int dispatch;                            // next work item to hand out
+	int finished;                            // work items completed
+	int generation;                          // bumped for every new job
+	qboolean pending;                        // started by Com_StartJobs, not waited for yet
+} workerJob_t;
+
+static workerJob_t workerJob;
+static int numWorkers;
+static thread_local int workerThreadNum;     // 0 on the main thread and any thread outside the pool
+static qboolean workersFailed;
+static qboolean workersShutdown;
+
+static thread_local jmp_buf *workerAbort;    // set while a work item runs
+static int workerErrorCode = -1;             // first Com_Error of the job, -1 if none
+static char workerErrorMessage[MAXPRINTMSG];
+
+#ifdef _WIN32
+static qboolean workerLockInitialized;
+static CRITICAL_SECTION workerLock;
+static CONDITION_VARIABLE workerStart;
+static CONDITION_VARIABLE workerDone;
+static HANDLE workerThreads[MAX_WORKER_THREADS];
+
+static void Com_WorkerLock(void)    { EnterCriticalSection(&workerLock); }
+static void Com_WorkerUnlock(void)  { LeaveCriticalSection(&workerLock); }
+static void Com_WaitStart(void)     { SleepConditionVariableCS(&workerStart, &workerLock, INFINITE); }
+static void Com_WaitDone(void)      { SleepConditionVariableCS(&workerDone, &workerLock, INFINITE); }
+static void Com_SignalStart(void)   { WakeAllConditionVariable(&workerStart); }
+static void Com_SignalDone(void)    { WakeAllConditionVariable(&workerDone); }
+#else
+static pthread_mutex_t workerLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workerStart = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t workerDone  = PTHREAD_COND_INITIALIZER;
+static pthread_t workerThreads[MAX_WORKER_THREADS];
+
+static void Com_WorkerLock(void)    { pthread_mutex_lock(&workerLock); }
+static void Com_WorkerUnlock(void)  { pthread_mutex_unlock(&workerLock); }
+static void Com_WaitStart(void)     { pthread_cond_wait(&workerStart, &workerLock); }
+static void Com_WaitDone(void)      { pthread_cond_wait(&workerDone, &workerLock); }
+static void Com_SignalStart(void)   { pthread_cond_broadcast(&workerStart); }
+static void Com_SignalDone(void)    { pthread_cond_broadcast(&workerDone); }
+#endif
+
+/*
+=================
+Com_RunWorkItem
+
+Calls func for one work item, a Com_Error inside it ends up here
+=================
+*/
+static void Com_RunWorkItem(void (*func)(int work, int threadnum), int work, int threadnum)
+{
+	jmp_buf abort;
+
+	if(!setjmp(abort))
+	{
+		workerAbort = &abort;
+		func(work, threadnum);
+	}
+
+	workerAbort = NULL;
+}
+
+/*
+=================
+Com_JobError
+
+Called by Com_Error, keeps the first error of the job and leaves the work
+item when called from inside one.  Returns qfalse otherwise.
+=================
+*/
+qboolean Com_JobError(int code, const char *message)
+{
+	if(!workerAbort)
+	{
+		return qfalse;
+	}
+
+	Com_WorkerLock();
+	if(workerErrorCode < 0 || (code == ERR_FATAL && workerErrorCode != ERR_FATAL))
+	{
+		workerErrorCode = code;
+		Q_strncpyz(workerErrorMessage, message, sizeof(workerErrorMessage));
+	}
+	Com_WorkerUnlock();
+
+	longjmp(*workerAbort, 1);
+	return qtrue;
+}
+
+/*
+=================
+Com_RaiseJobError
+
+Raises the error a work item of the finished job ran into
+=================
+*/
+static void Com_RaiseJobError(void)
+{
+	int code;
+
+	if(workerErrorCode < 0)
+	{
+		return;
+	}
+
+	code            = workerErrorCode;
+	workerErrorCode = -1;
+
+	Com_Error(code, "%s", workerErrorMessage);
+}
+
+/*
+=================
+Com_DoJobWork
+
+Hands out work items of the current job until there are none left,
+called with the lock held
+=================
+*/
+static void Com_DoJobWork(int threadnum)
+{
+	int work;
+
+	while(workerJob.dispatch < workerJob.workcnt)
+	{
+		work = workerJob.dispatch++;
+
+		Com_WorkerUnlock();
+		Com_RunWorkItem(workerJob.func, work, threadnum);
+		Com_WorkerLock();
+
+		if(++workerJob.finished == workerJob.workcnt)
+		{
+			Com_SignalDone();
+		}
+	}
+}
+
+/*
+=================
+Com_WorkerLoop
+=================
+*/
+static void Com_WorkerLoop(int threadnum)
+{
+	int generation;
+
+	workerThreadNum = threadnum;
+
+	Com_WorkerLock();
+
+	generation = workerJob.generation;
+
+	while(1)
+	{
+		while(!workersShutdown && workerJob.generation == generation)
+		{
+			Com_WaitStart();
+		}
+
+		if(workersShutdown)
+		{
+			break;
+		}
+
+		generation = workerJob.generation;
+
+		if(threadnum < workerJob.numThreads)
+		{
+			Com_DoJobWork(threadnum);
+		}
+	}
+
+	Com_WorkerUnlock();
+}
+
+#ifdef _WIN32
+static DWORD WINAPI Com_WorkerThread(LPVOID arg)
+{
+	Com_WorkerLoop((int)(intptr_t)arg);
+	return 0;
+}
+#else
+static void *Com_WorkerThread(void *arg)
+{
+	Com_WorkerLoop((int)(intptr_t)arg);
+	return NULL;
+}
+#endif
+
+/*
+=================
+Com_StartWorkers
+
+Makes sure there are at least count worker threads, returns the number
+of workers that are actually running
+=================
+*/
+static int Com_StartWorkers(int count)
+{
+	if(count > MAX_WORKER_THREADS)
+	{
+		count = MAX_WORKER_THREADS;
+	}
+
+#ifdef _WIN32
+	if(!workerLockInitialized)
+	{
+		InitializeCriticalSection(&workerLock);
+		InitializeConditionVariable(&workerStart);
+		InitializeConditionVariable(&workerDone);
+		workerLockInitialized = qtrue;
+	}
+#endif
+
+	while(numWorkers < count && !workersFailed)
+	{
+		// worker n runs as thread n + 1, the caller is thread 0
+#ifdef _WIN32
+		workerThreads[numWorkers] = CreateThread(NULL, 0, Com_WorkerThread, (LPVOID)(intptr_t)(numWorkers + 1), 0, NULL);
+		if(!workerThreads[numWorkers])
+#else
+		if(pthread_create(&workerThreads[numWorkers], NULL, Com_WorkerThread, (void *)(intptr_t)(numWorkers + 1)))
+#endif
+		{
+			Com_Printf(S_COLOR_YELLOW "WARNING: could not create worker thread %i\n", numWorkers + 1);
+			workersFailed = qtrue;
+			break;
+		}
+		numWorkers++;
+	}
+
+	if(numWorkers)
+	{
+		Com_DPrintf("%i worker threads running\n", numWorkers);
+	}
+
+	return numWorkers < count ? numWorkers : count;
+}
+
+/*
+=================
+Com_RunJobs
+
+Calls func for every work item in [0, workcnt) spread over up to numThreads
+threads, including the calling one.  threadnum is in [0, numThreads) and can
+be used to index per thread scratch data.  Runs everything on the calling
+thread if numThreads is 1 or less.  Not reentrant.
+=================
+*/
+void Com_RunJobs(int numThreads, int workcnt, void (*func)(int work, int threadnum))
+{
+	int i;
+
+	Com_WaitJobs();
+
+	if(numThreads > 1 && workcnt > 1)
+	{
+		numThreads = Com_StartWorkers(numThreads - 1) + 1;
+	}
+
+	workerErrorCode = -1;
+
+	if(numThreads <= 1 || workcnt <= 1)
+	{
+		for(i = 0; i < workcnt; i++)
+		{
+			Com_RunWorkItem(func, i, 0);
+		}
+		Com_RaiseJobError();
+		return;
+	}
+
+	Com_WorkerLock();
+
+	workerJob.func       = func;
+	workerJob.numThreads = numThreads;
+	workerJob.workcnt    = workcnt;
+	workerJob.dispatch   = 0;
+	workerJob.finished   = 0;
+	workerJob.generation++;
+
+	Com_SignalStart();
+
+	Com_DoJobWork(0);
+
+	while(workerJob.finished < workerJob.workcnt)
+	{
+		Com_WaitDone();
+	}
+
+	Com_WorkerUnlock();
+
+	Com_RaiseJobError();
+}
+
+/*
+=================
+Com_StartJobs
+
+Hands func for every work item in [0, workcnt) to up to numThreads worker
+threads and returns without waiting for them.  threadnum is in
+[0, numThreads], 0 being the caller once it helps out in Com_WaitJobs.
+Waits for a job that is still pending first.  Runs everything on the
+calling thread if no worker thread can be started.
+=================
+*/
+void Com_StartJobs(int numThreads, int workcnt, void (*func)(int work, int threadnum))
+{
+	int i;
+
+	Com_WaitJobs();
+
+	if(workcnt <= 0)
+	{
+		return;
+	}
+
+	if(numThreads > 0)
+	{
+		numThreads = Com_StartWorkers(numThreads);
+	}
+
+	workerErrorCode = -1;
+
+	if(numThreads <= 0)
+	{
+		for(i = 0; i < workcnt; i++)
+		{
+			Com_RunWorkItem(func, i, 0);
+		}
+		Com_RaiseJobError();
+		return;
+	}
+
+	Com_WorkerLock();
+
+	// the caller is thread 0 and only joins in Com_WaitJobs
+	workerJob.func       = func;
+	workerJob.numThreads = numThreads + 1;
+	workerJob.workcnt    = workcnt;
+	workerJob.dispatch   = 0;
+	workerJob.finished   = 0;
+	workerJob.pending    = qtrue;
+	workerJob.generation++;
+
+	Com_SignalStart();
+
+	Com_WorkerUnlock();
+}
+
+/*
+=================
+Com_WaitJobs
+
+Helps with the work items of the job started by Com_StartJobs that are
+not handed out yet and returns once all of them have finished
+=================
+*/
+void Com_WaitJobs(void)
+{
+	// only the thread that starts jobs ever sets or clears pending
+	if(!workerJob.pending)
+	{
+		return;
+	}
+
+	Com_WorkerLock();
+
+	Com_DoJobWork(0);
+
+	while(workerJob.finished < workerJob.workcnt)
+	{
+		Com_WaitDone();
+	}
+
+	workerJob.pending = qfalse;
+
+	Com_WorkerUnlock();
+
+	Com_RaiseJobError();
+}
+
+/*
+=================
+Com_WorkerThreadNum
+
+The threadnum work functions of the calling thread get, for code further
+down that needs per thread scratch data without being handed threadnum
+=================
+*/
+int Com_WorkerThreadNum(void)
+{
+	return workerThreadNum;
+}
+
+/*
+=================
+Com_ShutdownThreads
+=================
+*/
+void Com_ShutdownThreads(void)
+{
+	int i;
+
+	Com_WaitJobs();
+
+	if(!numWorkers)
+	{
+		return;
+	}
+
+	Com_WorkerLock();
+	workersShutdown = qtrue;
+	Com_SignalStart();
+	Com_WorkerUnlock();
+
+	for(i = 0; i < numWorkers; i++)
+	{
+#ifdef _WIN32
+		WaitForSingleObject(workerThreads[i], INFINITE);
+		CloseHandle(workerThreads[i]);
+#else
+		pthread_join(workerThreads[i], NULL);
+#endif
+	}
+
+	numWorkers      = 0;
+	workersShutdown = qfalse;
+}
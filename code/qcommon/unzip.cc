@@ -1536,6 +1536,18 @@ extern int ZEXPORT unzSetOffset (unzFile file, uLong pos)
     return err;
 }
 
+extern uLong ZEXPORT unzGetLocalOffset (unzFile file)
+{
+    unz_s* s;
+
+    if (file==NULL)
+        return 0;
+    s=(unz_s*)file;
+    if (!s->current_file_ok)
+        return 0;
+    return s->cur_file_info_internal.offset_curfile + s->byte_before_the_zipfile;
+}
+
 #ifdef __cplusplus /* If this is a C++ compiler, end C linkage */
 }
 #endif
@@ -347,6 +347,9 @@ extern uLong ZEXPORT unzGetOffset (unzFile file);
 /* Set the current file offset */
 extern int ZEXPORT unzSetOffset (unzFile file, uLong pos);
 
+/* Get the position of the current file's local header in the zip file */
+extern uLong ZEXPORT unzGetLocalOffset (unzFile file);
+
 
 
 #ifdef __cplusplus
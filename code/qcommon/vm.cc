@@ -40,6 +40,9 @@ vm_t	*currentVM = NULL;
 vm_t	*lastVM    = NULL;
 int		vm_debugLevel;
 
+cvar_t	*vm_hotCompile;		// count at which compiled procedures get recompiled with registers, 0 = never
+cvar_t	*vm_syscallProfile;	// count and time every syscall for vmprofile
+
 // used by Com_Error to get rid of running vm's before longjmp
 static int forced_unload;
 
@@ -64,6 +67,17 @@ void VM_Debug( int level ) {
 	vm_debugLevel = level;
 }
 
+/*
+==============
+VM_IsNative
+
+Dlls share the engine's address space
+==============
+*/
+qboolean VM_IsNative( vm_t *vm ) {
+	return vm && vm->dllHandle ? qtrue : qfalse;
+}
+
 /*
 ==============
 VM_Init
@@ -73,6 +87,10 @@ void VM_Init( void ) {
 	Cvar_Get( "vm_cgame", "0", CVAR_ARCHIVE );	// !@# SHIP WITH SET TO 2 //hypov8 todo: reset default calls this.
 	Cvar_Get( "vm_game", "0", CVAR_ARCHIVE );	// !@# SHIP WITH SET TO 2
 	Cvar_Get( "vm_ui", "0", CVAR_ARCHIVE );		// !@# SHIP WITH SET TO 2
+#ifdef USE_LLVM
+	vm_hotCompile = Cvar_Get( "vm_hotCompile", "0", CVAR_ARCHIVE );
+#endif
+	vm_syscallProfile = Cvar_Get( "vm_syscallProfile", "0", 0 );
 
 	Cmd_AddCommand ("vmprofile", VM_VmProfile_f );
 	Cmd_AddCommand ("vminfo", VM_VmInfo_f );
@@ -298,6 +316,90 @@ void VM_LoadSymbols( vm_t *vm )
 	FS_FreeFile( mapfile.v );
 }
 
+/*
+============
+VM_SetSyscalls
+============
+*/
+void VM_SetSyscalls( vm_t *vm, const vmSyscall_t *syscalls, int numSyscalls ) {
+	vm->syscalls = syscalls;
+	vm->numSyscalls = numSyscalls;
+}
+
+/*
+============
+VM_SyscallNumArgs
+
+How many arguments after the call number need to be copied for a syscall
+============
+*/
+int VM_SyscallNumArgs( vm_t *vm, intptr_t callNum ) {
+	if ( (uintptr_t)callNum < (uintptr_t)vm->numSyscalls && vm->syscalls[callNum].name ) {
+		return vm->syscalls[callNum].numArgs;
+	}
+	return MAX_VMSYSCALL_ARGS - 1;
+}
+
+/*
+============
+VM_SyscallProfileStart
+============
+*/
+int64_t VM_SyscallProfileStart( void ) {
+	if ( !vm_syscallProfile->integer ) {
+		return 0;
+	}
+	return Sys_Nanoseconds();
+}
+
+/*
+============
+VM_SyscallProfileEnd
+============
+*/
+void VM_SyscallProfileEnd( vm_t *vm, intptr_t callNum, int64_t start ) {
+	vmSyscallStat_t	*stat;
+
+	if ( !start || !vm || (uintptr_t)callNum >= MAX_VMSYSCALL_STATS ) {
+		return;
+	}
+
+	stat = &vm->syscallStats[callNum];
+	stat->count++;
+	stat->nsec += Sys_Nanoseconds() - start;
+}
+
+/*
+============
+VM_SystemCall
+
+All syscalls from the vm end up here with their arguments in args,
+the ones in the direct table skip the module's systemCall switch
+============
+*/
+intptr_t VM_SystemCall( vm_t *vm, intptr_t *args ) {
+	intptr_t	(*func)( intptr_t *args );
+	intptr_t	callNum;
+	intptr_t	ret;
+	int64_t		start;
+
+	callNum = args[0];
+	func = vm->systemCall;
+	if ( (uintptr_t)callNum < (uintptr_t)vm->numSyscalls && vm->syscalls[callNum].func ) {
+		func = vm->syscalls[callNum].func;
+	}
+
+	if ( !vm_syscallProfile->integer ) {
+		return func( args );
+	}
+
+	start = Sys_Nanoseconds();
+	ret = func( args );
+	VM_SyscallProfileEnd( vm, callNum, start );
+
+	return ret;
+}
+
 /*
 ============
 VM_DllSyscall
@@ -333,6 +435,7 @@ Dlls will call this directly
 
   For speed, we just grab 15 arguments, and don't worry about exactly
    how many the syscall actually needs; the extra is thrown away.
+   Syscalls in the vm's direct table only grab the ones they use.
 
 ============
 */
@@ -340,19 +443,20 @@ intptr_t QDECL VM_DllSyscall( intptr_t arg, ... ) {
 #if !id386 || defined __clang__
   // rcg010206 - see commentary above
   intptr_t args[MAX_VMSYSCALL_ARGS];
-  int i;
+  int i, numArgs;
   va_list ap;
 
   args[0] = arg;
+  numArgs = VM_SyscallNumArgs( currentVM, arg );
 
   va_start(ap, arg);
-  for (i = 1; i <  int(ARRAY_LEN (args)); i++)
+  for (i = 1; i <= numArgs; i++)
     args[i] = va_arg(ap, intptr_t);
   va_end(ap);
 
-  return currentVM->systemCall( args );
+  return VM_SystemCall( currentVM, args );
 #else // original id code
-	return currentVM->systemCall( &arg );
+	return VM_SystemCall( currentVM, &arg );
 #endif
 }
 
@@ -529,13 +633,20 @@ vm_t *VM_Restart(vm_t *vm, qboolean unpure)
 	if ( vm->dllHandle ) {
 		char	name[MAX_QPATH];
 		intptr_t	(*systemCall)( intptr_t *parms );
+		const vmSyscall_t	*syscalls;
+		int		numSyscalls;
 
 		systemCall = vm->systemCall;
+		syscalls = vm->syscalls;
+		numSyscalls = vm->numSyscalls;
 		Q_strncpyz( name, vm->name, sizeof( name ) );
 
 		VM_Free( vm );
 
 		vm = VM_Create( name, systemCall, VMI_NATIVE );
+		if ( vm ) {
+			VM_SetSyscalls( vm, syscalls, numSyscalls );
+		}
 		return vm;
 	}
 #ifndef USE_LLVM
@@ -888,6 +999,78 @@ static int QDECL VM_ProfileSort( const void *a, const void *b ) {
 	return 0;
 }
 
+static vm_t	*sortSyscallVM;
+
+static int QDECL VM_SyscallProfileSort( const void *a, const void *b ) {
+	vmSyscallStat_t	*sa, *sb;
+
+	sa = &sortSyscallVM->syscallStats[*(const int *)a];
+	sb = &sortSyscallVM->syscallStats[*(const int *)b];
+
+	if ( sa->nsec < sb->nsec ) {
+		return -1;
+	}
+	if ( sa->nsec > sb->nsec ) {
+		return 1;
+	}
+	return 0;
+}
+
+/*
+==============
+VM_SyscallProfile
+
+Lists the syscalls counted while vm_syscallProfile was set
+and clears their counts
+==============
+*/
+static void VM_SyscallProfile( vm_t *vm ) {
+	int		sorted[MAX_VMSYSCALL_STATS];
+	int		i, num, count;
+	int64_t	nsec;
+	char	name[32];
+	const char	*s;
+
+	count = 0;
+	nsec = 0;
+	for ( i = 0, num = 0 ; i < MAX_VMSYSCALL_STATS ; i++ ) {
+		if ( !vm->syscallStats[i].count ) {
+			continue;
+		}
+		sorted[num++] = i;
+		count += vm->syscallStats[i].count;
+		nsec += vm->syscallStats[i].nsec;
+	}
+
+	if ( !num ) {
+		if ( !vm_syscallProfile->integer ) {
+			Com_Printf( "set vm_syscallProfile 1 to count syscalls\n" );
+		}
+		return;
+	}
+
+	sortSyscallVM = vm;
+	qsort( sorted, num, sizeof( sorted[0] ), VM_SyscallProfileSort );
+
+	Com_Printf( "     calls      msec  usec/call syscall\n" );
+	for ( i = 0 ; i < num ; i++ ) {
+		vmSyscallStat_t	*stat;
+
+		stat = &vm->syscallStats[sorted[i]];
+		if ( sorted[i] < vm->numSyscalls && vm->syscalls[sorted[i]].name ) {
+			s = vm->syscalls[sorted[i]].name;
+		} else {
+			Com_sprintf( name, sizeof( name ), "syscall %i", sorted[i] );
+			s = name;
+		}
+		Com_Printf( "%10i %9.2f %10.3f %s\n", stat->count, stat->nsec / 1000000.0,
+			stat->nsec / 1000.0 / stat->count, s );
+	}
+	Com_Printf( "%10i %9.2f            total\n", count, nsec / 1000000.0 );
+
+	Com_Memset( vm->syscallStats, 0, sizeof( vm->syscallStats ) );
+}
+
 /*
 ==============
 VM_VmProfile_f
@@ -906,6 +1089,16 @@ void VM_VmProfile_f( void ) {
 
 	vm = lastVM;
 
+	VM_SyscallProfile( vm );
+
+#if !defined(NO_VM_COMPILED) && (id386 || idx64)
+	// compiled code counts procedures instead of instructions
+	if ( vm->compiled ) {
+		VM_CompiledProfile( vm );
+		return;
+	}
+#endif
+
 	if ( !vm->numSymbols ) {
 		return;
 	}
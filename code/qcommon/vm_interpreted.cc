@@ -504,14 +504,16 @@ nextInstruction2:
 					if (sizeof(intptr_t) != sizeof(int)) {
 						intptr_t argarr[ MAX_VMSYSCALL_ARGS ];
 						int *imagePtr = (int *)&image[programStack];
-						int i;
-						for (i = 0; i < (int)ARRAY_LEN(argarr); ++i) {
+						int i, numArgs;
+						argarr[0] = *(++imagePtr);
+						numArgs = VM_SyscallNumArgs( vm, argarr[0] );
+						for (i = 1; i <= numArgs; ++i) {
 							argarr[i] = *(++imagePtr);
 						}
-						r = vm->systemCall( argarr );
+						r = VM_SystemCall( vm, argarr );
 					} else {
 						intptr_t* argptr = (intptr_t *)&image[ programStack + 4 ];
-						r = vm->systemCall( argptr );
+						r = VM_SystemCall( vm, argptr );
 					}
 				}
 
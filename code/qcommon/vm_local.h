@@ -33,6 +33,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 // Max number of arguments to pass from a vm to engine's syscall handler function for the vm.
 // syscall number + 15 arguments
 #define MAX_VMSYSCALL_ARGS 16
+// syscall numbers vm_syscallProfile keeps counts for
+#define MAX_VMSYSCALL_STATS 1024
 // don't change, this is hardcoded into x86 VMs, opStack protection relies
 // on this
 #define	OPSTACK_SIZE	1024
@@ -141,6 +143,11 @@ typedef struct vmSymbol_s {
 	char	symName[1];		// variable sized
 } vmSymbol_t;
 
+typedef struct {
+	int			count;
+	int64_t		nsec;
+} vmSyscallStat_t;
+
 #define	VM_OFFSET_PROGRAM_STACK		0
 #define	VM_OFFSET_SYSTEM_CALL		4
 
@@ -185,13 +192,26 @@ struct vm_s {
 
 	byte		*jumpTableTargets;
 	int			numJumpTableTargets;
+
+	struct vmHotCode_s	*hotCode;	// procedure counters and second tier of x86_64 compiled code
+
+	const vmSyscall_t	*syscalls;	// directly dispatched syscalls, indexed by call number
+	int			numSyscalls;
+
+	vmSyscallStat_t	syscallStats[MAX_VMSYSCALL_STATS];
 };
 
 
 extern	vm_t	*currentVM;
 extern	int		vm_debugLevel;
+extern	cvar_t	*vm_hotCompile;
+extern	cvar_t	*vm_syscallProfile;
 void VM_Compile( vm_t *vm, vmHeader_t *header );
 int	VM_CallCompiled( vm_t *vm, int *args );
+void VM_CompiledProfile( vm_t *vm );
+
+int VM_SyscallNumArgs( vm_t *vm, intptr_t callNum );
+intptr_t VM_SystemCall( vm_t *vm, intptr_t *args );
 
 void VM_PrepareInterpreter( vm_t *vm, vmHeader_t *header );
 int	VM_CallInterpreted( vm_t *vm, int *args );
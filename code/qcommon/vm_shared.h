@@ -63,6 +63,22 @@ vm_t	*VM_Create( const char *module, intptr_t (*systemCalls)(intptr_t *),
 				   vmInterpret_t interpret );
 // module should be bare: "cgame", not "cgame.dll" or "vm/cgame.qvm"
 
+typedef struct
+{
+  const char *name;
+  intptr_t (*func)(intptr_t *args);   // NULL goes through the systemCall switch
+  int numArgs;                        // arguments after the call number
+} vmSyscall_t;
+
+void VM_SetSyscalls(vm_t *vm, const vmSyscall_t *syscalls, int numSyscalls);
+// syscalls is indexed by call number, listed calls skip the systemCall
+// switch and only copy the arguments they use
+
+int64_t VM_SyscallProfileStart(void);
+void VM_SyscallProfileEnd(vm_t *vm, intptr_t callNum, int64_t start);
+// for syscalls the module makes without going through the vm, counted
+// by vmprofile when vm_syscallProfile is set
+
 void VM_Free(vm_t *vm);
 void VM_Clear(void);
 void VM_Forced_Unload_Start(void);
@@ -72,6 +88,7 @@ vm_t	*VM_Restart(vm_t *vm, qboolean unpure);
 intptr_t QDECL VM_Call(vm_t *vm, int callNum, ...);
 
 void VM_Debug(int level);
+qboolean VM_IsNative(vm_t *vm);
 
 void *VM_ArgPtr(intptr_t intValue);
 void *VM_ExplicitArgPtr(vm_t *vm, intptr_t intValue);
@@ -806,7 +806,7 @@ static int asmcall(int call, int pstack)
 	if (sizeof(intptr_t) == sizeof(int)) {
 		intptr_t *argPosition = (intptr_t *)((byte *)currentVM->dataBase + pstack + 4);
 		argPosition[0] = -1 - call;
-		ret = currentVM->systemCall(argPosition);
+		ret = VM_SystemCall(currentVM, argPosition);
 	} else {
 		intptr_t args[MAX_VMSYSCALL_ARGS];
 
@@ -815,7 +815,7 @@ static int asmcall(int call, int pstack)
 		for( i = 1; i < ARRAY_LEN(args); i++ )
 			args[i] = argPosition[i];
 
-		ret = currentVM->systemCall(args);
+		ret = VM_SystemCall(currentVM, args);
 	}
 
 	currentVM = savedVM;
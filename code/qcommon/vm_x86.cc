@@ -44,6 +44,15 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 static void VM_Destroy_Compiled(vm_t* self);
 
+#define OPSTACK_GUARD	256		// second tier code addresses opStack slots around ebx
+
+// the second tier only has QVMs to work on where they can be loaded
+#if idx64 && defined(USE_LLVM)
+#define VM_HOT_COMPILE 1
+#else
+#define VM_HOT_COMPILE 0
+#endif
+
 /*
 
   eax		scratch
@@ -55,6 +64,7 @@ static void VM_Destroy_Compiled(vm_t* self);
 x86_64:
   r8		vm->instructionPointers
   r9		vm->dataBase
+  r10-r15	opStack values in second tier code
 
 */
 
@@ -420,7 +430,7 @@ static void DoSyscall(void)
   {
     int *data;
 #if idx64
-    int index;
+    int index, numArgs;
     intptr_t args[MAX_VMSYSCALL_ARGS];
 #endif
 
@@ -428,13 +438,14 @@ static void DoSyscall(void)
 
 #if idx64
     args[0] = ~vm_syscallNum;
-    for(index = 1; index < (int)ARRAY_LEN(args); index++)
+    numArgs = VM_SyscallNumArgs(savedVM, args[0]);
+    for(index = 1; index <= numArgs; index++)
       args[index] = data[index];
 
-    vm_opStackBase[vm_opStackOfs + 1] = savedVM->systemCall(args);
+    vm_opStackBase[vm_opStackOfs + 1] = VM_SystemCall(savedVM, args);
 #else
     data[0] = ~vm_syscallNum;
-    vm_opStackBase[vm_opStackOfs + 1] = savedVM->systemCall((intptr_t *) data);
+    vm_opStackBase[vm_opStackOfs + 1] = VM_SystemCall(savedVM, (intptr_t *) data);
 #endif
   }
   else
@@ -1059,6 +1070,1319 @@ qboolean ConstOptimize(vm_t *vm, int callProcOfsSyscall)
   return qfalse;
 }
 
+/*
+=================================================================================
+
+SECOND TIER
+
+With vm_hotCompile set the first tier counts procedure entries and loop
+iterations.  Once the vm is idle, procedures whose count reached vm_hotCompile
+are compiled again after the first tier code: the top of the opStack lives in
+r10d - r15d instead of memory, constants and locals are folded into the
+instructions that use them, compares branch directly on the operands and block
+copies are done inline.  The opStack is written back to memory at jump
+targets, calls and returns, so code of both tiers can jump and call into each
+other.  The first tier entry of a recompiled procedure jumps to the new code.
+
+=================================================================================
+*/
+
+#if VM_HOT_COMPILE
+
+#define HOT_CHECK_CALLS   16      // top level calls between looks at the counters
+#define HOT_MAX_DEPTH     12      // opStack values kept out of memory
+#define HOT_MAX_CODE      512     // bytes a single instruction may compile to
+#define HOT_FIRST_REG     10      // r10d - r15d hold opStack values
+#define HOT_NUM_REGS      6
+#define HOT_COUNT_SIZE    12      // bytes of EmitHotCount
+
+enum
+{
+  R_EAX, R_ECX, R_EDX, R_EBX, R_ESP, R_EBP, R_ESI, R_EDI,
+  R_R8, R_R9, R_R10, R_R11, R_R12, R_R13, R_R14, R_R15
+};
+
+typedef enum
+{
+  PROC_FIRST_TIER,
+  PROC_SECOND_TIER,
+  PROC_FAILED
+} procTier_t;
+
+typedef struct
+{
+  int firstInstruction;
+  int numInstructions;
+  int codeOfs;                    // bytecode offset of the OP_ENTER
+  procTier_t tier;
+} vmProc_t;
+
+typedef struct vmHotCode_s
+{
+  byte *code;                     // bytecode, padded with zeros
+  byte *labels;                   // jump targets, jused of the first tier
+  byte *loopHeads;                // targets of backward branches
+  vmProc_t *procs;
+  int numProcs;
+  int numLoopHeads;
+  unsigned *counts;               // entries and loop iterations of each procedure
+  int *labelOfs;                  // code offset of each instruction of the procedure being compiled
+  int callDoSyscallOfs;
+  int callProcOfs;
+  int callProcOfsSyscall;
+  int codeUsed;                   // second tier code follows the first tier in vm->codeBase
+  int codeSize;
+  int calls;
+  int numHotProcs;
+} vmHotCode_t;
+
+typedef enum
+{
+  HOT_CONST,                      // value is the constant
+  HOT_LOCAL,                      // value is an offset from programStack
+  HOT_REG,                        // value is the register holding it
+  HOT_SLOT                        // undefined value of OP_PUSH, still in memory
+} hotValueType_t;
+
+typedef struct
+{
+  hotValueType_t type;
+  int value;
+} hotValue_t;
+
+static vmHotCode_t *hotCode;
+static vmProc_t *hotProc;
+static int hotStart;
+static hotValue_t hotStack[HOT_MAX_DEPTH];
+static int hotDepth;              // values above the memory opStack
+static int hotMemOfs;             // memory opStack top relative to bl
+static int hotFreeRegs;
+static qboolean hotFailed;
+
+/*
+=================
+VM_ScanProcedures
+
+Finds procedures and loop heads for the counters of the first tier
+=================
+*/
+static vmHotCode_t *VM_ScanProcedures(vm_t *vm, vmHeader_t *header)
+{
+  vmHotCode_t *hot;
+  int i, op, target, maxInstructions;
+
+  hot = static_cast<vmHotCode_t*>(Z_Malloc(sizeof(*hot)));
+  Com_Memset(hot, 0, sizeof(*hot));
+  hot->loopHeads = static_cast<byte*>(Z_Malloc(header->instructionCount));
+  Com_Memset(hot->loopHeads, 0, header->instructionCount);
+
+  for(pc = 0, i = 0; i < header->instructionCount; i++)
+  {
+    op = code[pc++];
+
+    switch(op)
+    {
+    case OP_ENTER:
+      hot->numProcs++;
+      pc += 4;
+      break;
+    case OP_CONST:
+      // constant jumps back are loops as well
+      target = Constant4();
+      if(code[pc] == OP_JUMP && target >= 0 && target <= i && !hot->loopHeads[target])
+      {
+        hot->loopHeads[target] = 1;
+        hot->numLoopHeads++;
+      }
+      break;
+    case OP_EQ: case OP_NE:
+    case OP_LTI: case OP_LEI: case OP_GTI: case OP_GEI:
+    case OP_LTU: case OP_LEU: case OP_GTU: case OP_GEU:
+    case OP_EQF: case OP_NEF:
+    case OP_LTF: case OP_LEF: case OP_GTF: case OP_GEF:
+      target = Constant4();
+      if(target >= 0 && target <= i && !hot->loopHeads[target])
+      {
+        hot->loopHeads[target] = 1;
+        hot->numLoopHeads++;
+      }
+      break;
+    case OP_LEAVE:
+    case OP_LOCAL:
+    case OP_BLOCK_COPY:
+      pc += 4;
+      break;
+    case OP_ARG:
+      pc += 1;
+      break;
+    default:
+      break;
+    }
+  }
+
+  hot->procs = static_cast<vmProc_t*>(Z_Malloc(hot->numProcs * sizeof(*hot->procs) + 1));
+  hot->counts = static_cast<unsigned*>(Z_Malloc(hot->numProcs * sizeof(*hot->counts) + 1));
+  Com_Memset(hot->counts, 0, hot->numProcs * sizeof(*hot->counts));
+
+  // second walk for the extents of the procedures
+  maxInstructions = 0;
+  hot->numProcs = 0;
+  for(pc = 0, i = 0; i < header->instructionCount; i++)
+  {
+    op = code[pc];
+
+    if(op == OP_ENTER)
+    {
+      if(hot->numProcs)
+        hot->procs[hot->numProcs - 1].numInstructions = i - hot->procs[hot->numProcs - 1].firstInstruction;
+
+      hot->procs[hot->numProcs].firstInstruction = i;
+      hot->procs[hot->numProcs].codeOfs = pc;
+      hot->procs[hot->numProcs].tier = PROC_FIRST_TIER;
+      hot->numProcs++;
+    }
+
+    pc++;
+    switch(op)
+    {
+    case OP_ENTER: case OP_LEAVE: case OP_CONST: case OP_LOCAL: case OP_BLOCK_COPY:
+    case OP_EQ: case OP_NE:
+    case OP_LTI: case OP_LEI: case OP_GTI: case OP_GEI:
+    case OP_LTU: case OP_LEU: case OP_GTU: case OP_GEU:
+    case OP_EQF: case OP_NEF:
+    case OP_LTF: case OP_LEF: case OP_GTF: case OP_GEF:
+      pc += 4;
+      break;
+    case OP_ARG:
+      pc += 1;
+      break;
+    default:
+      break;
+    }
+  }
+  if(hot->numProcs)
+    hot->procs[hot->numProcs - 1].numInstructions = i - hot->procs[hot->numProcs - 1].firstInstruction;
+
+  for(i = 0; i < hot->numProcs; i++)
+  {
+    if(hot->procs[i].numInstructions > maxInstructions)
+      maxInstructions = hot->procs[i].numInstructions;
+  }
+  hot->labelOfs = static_cast<int*>(Z_Malloc(maxInstructions * sizeof(int) + 1));
+
+  return hot;
+}
+
+/*
+=================
+VM_FreeHotCode
+=================
+*/
+static void VM_FreeHotCode(vmHotCode_t *hot)
+{
+  Z_Free(hot->code);
+  Z_Free(hot->labels);
+  Z_Free(hot->loopHeads);
+  Z_Free(hot->procs);
+  Z_Free(hot->counts);
+  Z_Free(hot->labelOfs);
+  Z_Free(hot);
+}
+
+/*
+=================
+EmitHotCount
+
+Counts a procedure entry or loop iteration, clobbers eax
+=================
+*/
+static void EmitHotCount(vmHotCode_t *hot, int proc)
+{
+  EmitRexString(0x48, "B8");			// mov rax, 0x123456789abcdef0
+  EmitPtr(&hot->counts[proc]);
+  EmitString("FF 00");				// inc dword ptr [rax]
+}
+
+static void EmitRex(int w, int reg, int index, int base)
+{
+  int rex = 0x40 | (w << 3) | ((reg & 8) >> 1) | ((index & 8) >> 2) | ((base & 8) >> 3);
+
+  if(rex != 0x40)
+    Emit1(rex);
+}
+
+static void EmitModRM(int mod, int reg, int rm)
+{
+  Emit1((mod << 6) | ((reg & 7) << 3) | (rm & 7));
+}
+
+static void EmitOpcode(int opcode)
+{
+  if(opcode > 0xFF)
+    Emit1(opcode >> 8);
+  Emit1(opcode & 0xFF);
+}
+
+// opcode rm, reg or opcode reg, rm depending on the opcode
+static void EmitHotRR(int prefix, int opcode, int reg, int rm)
+{
+  if(prefix)
+    Emit1(prefix);
+  EmitRex(0, reg, 0, rm);
+  EmitOpcode(opcode);
+  EmitModRM(3, reg, rm);
+}
+
+// group opcode with an immediate: add, or, and, sub, xor, cmp
+static void EmitHotAluImm(int ext, int reg, int imm)
+{
+  EmitRex(0, 0, 0, reg);
+  if(iss8(imm))
+  {
+    Emit1(0x83);
+    EmitModRM(3, ext, reg);
+    Emit1(imm);
+  }
+  else
+  {
+    Emit1(0x81);
+    EmitModRM(3, ext, reg);
+    Emit4(imm);
+  }
+}
+
+// opcode reg, [r9 + index + disp], index may be -1
+static void EmitHotData(int prefix, int w, int opcode, int reg, int index, int disp)
+{
+  int mod = !disp ? 0 : (iss8(disp) ? 1 : 2);
+
+  if(prefix)
+    Emit1(prefix);
+  EmitRex(w, reg, index < 0 ? 0 : index, R_R9);
+  EmitOpcode(opcode);
+  if(index < 0)
+    EmitModRM(mod, reg, R_R9);
+  else
+  {
+    EmitModRM(mod, reg, 4);
+    Emit1(((index & 7) << 3) | (R_R9 & 7));
+  }
+
+  if(mod == 1)
+    Emit1(disp);
+  else if(mod == 2)
+    Emit4(disp);
+}
+
+// opcode reg, slot[edi + ebx * 4]
+static void EmitHotStack(int opcode, int reg, int slot)
+{
+  int disp = slot * 4;
+
+  EmitRex(0, reg, 0, 0);
+  Emit1(opcode);
+  EmitModRM(!disp ? 0 : (iss8(disp) ? 1 : 2), reg, 4);
+  Emit1(0x9F);
+  if(disp && iss8(disp))
+    Emit1(disp);
+  else if(disp)
+    Emit4(disp);
+}
+
+// lea reg, [base + disp]
+static void EmitHotLea(int reg, int base, int disp)
+{
+  EmitRex(0, reg, 0, base);
+  Emit1(0x8D);
+  EmitModRM(2, reg, base);
+  Emit4(disp);
+}
+
+static void EmitHotMovImm(int reg, int imm)
+{
+  EmitRex(0, 0, 0, reg);
+  Emit1(0xB8 + (reg & 7));
+  Emit4(imm);
+}
+
+static void HotMoveStack(int n)
+{
+  if(n > 0)
+  {
+    STACK_PUSH(n);			// add bl, n
+  }
+  else if(n < 0)
+  {
+    STACK_POP(-n);			// sub bl, -n
+  }
+}
+
+static void HotFreeReg(int reg)
+{
+  hotFreeRegs |= 1 << (reg - HOT_FIRST_REG);
+}
+
+// writes a value to its slot in the memory opStack
+static void HotStore(const hotValue_t *v, int slot)
+{
+  switch(v->type)
+  {
+  case HOT_CONST:
+    EmitHotStack(0xC7, 0, slot);
+    Emit4(v->value);
+    break;
+  case HOT_LOCAL:
+    EmitHotLea(R_EAX, R_ESI, v->value);
+    EmitHotStack(0x89, R_EAX, slot);
+    break;
+  case HOT_REG:
+    EmitHotStack(0x89, v->value, slot);
+    HotFreeReg(v->value);
+    break;
+  case HOT_SLOT:
+    break;
+  }
+}
+
+// moves the bottom value to memory
+static void HotSpill(void)
+{
+  HotStore(&hotStack[0], hotMemOfs + 1);
+  hotMemOfs++;
+  hotDepth--;
+  memmove(hotStack, hotStack + 1, hotDepth * sizeof(hotStack[0]));
+}
+
+// writes everything back so that bl points at the top of the opStack, as in the first tier
+static void HotFlush(void)
+{
+  int i;
+
+  for(i = 0; i < hotDepth; i++)
+    HotStore(&hotStack[i], hotMemOfs + 1 + i);
+
+  HotMoveStack(hotMemOfs + hotDepth);
+  hotMemOfs = 0;
+  hotDepth = 0;
+}
+
+// keeps the opStack displacements small
+static void HotSync(void)
+{
+  if(hotMemOfs > 16 || hotMemOfs < -16)
+  {
+    HotMoveStack(hotMemOfs);
+    hotMemOfs = 0;
+  }
+}
+
+static int HotAllocReg(void)
+{
+  int i;
+
+  while(!hotFreeRegs)
+  {
+    if(!hotDepth)
+    {
+      hotFailed = qtrue;
+      return R_R10;
+    }
+    HotSpill();
+  }
+
+  for(i = 0; !(hotFreeRegs & (1 << i)); i++);
+  hotFreeRegs &= ~(1 << i);
+
+  return HOT_FIRST_REG + i;
+}
+
+static void HotPush(hotValueType_t type, int value)
+{
+  if(hotDepth == HOT_MAX_DEPTH)
+    HotSpill();
+
+  hotStack[hotDepth].type = type;
+  hotStack[hotDepth].value = value;
+  hotDepth++;
+}
+
+// pops a constant, local or register
+static hotValue_t HotPop(void)
+{
+  hotValue_t v;
+  int slot;
+
+  if(hotDepth)
+  {
+    v = hotStack[--hotDepth];
+    if(v.type != HOT_SLOT)
+      return v;
+    slot = hotMemOfs + 1 + hotDepth;
+  }
+  else
+    slot = hotMemOfs--;
+
+  v.type = HOT_REG;
+  v.value = HotAllocReg();
+  EmitHotStack(0x8B, v.value, slot);
+
+  return v;
+}
+
+static void HotLoad(const hotValue_t *v, int reg)
+{
+  if(v->type == HOT_CONST)
+    EmitHotMovImm(reg, v->value);
+  else if(v->type == HOT_LOCAL)
+    EmitHotLea(reg, R_ESI, v->value);
+  else if(v->value != reg)
+    EmitHotRR(0, 0x89, v->value, reg);
+}
+
+// makes sure a popped value is in a register of its own
+static int HotReg(hotValue_t *v)
+{
+  int reg;
+
+  if(v->type == HOT_REG)
+    return v->value;
+
+  reg = HotAllocReg();
+  HotLoad(v, reg);
+  v->type = HOT_REG;
+  v->value = reg;
+
+  return reg;
+}
+
+// jcc or jmp to an instruction of this or another procedure
+static void EmitHotJump(vm_t *vm, int jcc, int target)
+{
+  int dest;
+
+  if(target >= hotProc->firstInstruction && target < hotProc->firstInstruction + hotProc->numInstructions)
+  {
+    // only targets of the first tier are flushed
+    if(!hotCode->labels[target])
+      hotFailed = qtrue;
+    dest = hotCode->labelOfs[target - hotProc->firstInstruction];
+  }
+  else if(target >= 0 && target < vm->instructionCount)
+    dest = vm->instructionPointers[target] - (intptr_t)vm->codeBase;
+  else
+  {
+    hotFailed = qtrue;
+    dest = compiledOfs;
+  }
+
+  if(jcc)
+  {
+    Emit1(0x0F);
+    Emit1(jcc);
+  }
+  else
+    Emit1(0xE9);
+  Emit4(dest - compiledOfs - 4);
+}
+
+static void EmitHotCall(vm_t *vm, int target)
+{
+  int dest;
+
+  if(target == hotProc->firstInstruction)
+    dest = hotStart;
+  else if(target < vm->instructionCount)
+    dest = vm->instructionPointers[target] - (intptr_t)vm->codeBase;
+  else
+  {
+    hotFailed = qtrue;
+    dest = compiledOfs;
+  }
+
+  EmitCallRel(vm, dest);
+}
+
+static qboolean HotCompare(int op, int a, int b)
+{
+  switch(op)
+  {
+  case OP_EQ:  return a == b;
+  case OP_NE:  return a != b;
+  case OP_LTI: return a < b;
+  case OP_LEI: return a <= b;
+  case OP_GTI: return a > b;
+  case OP_GEI: return a >= b;
+  case OP_LTU: return (unsigned)a < (unsigned)b;
+  case OP_LEU: return (unsigned)a <= (unsigned)b;
+  case OP_GTU: return (unsigned)a > (unsigned)b;
+  default:     return (unsigned)a >= (unsigned)b;
+  }
+}
+
+static int HotFold(int op, int a, int b)
+{
+  switch(op)
+  {
+  case OP_ADD:  return (unsigned)a + (unsigned)b;
+  case OP_SUB:  return (unsigned)a - (unsigned)b;
+  case OP_BAND: return a & b;
+  case OP_BOR:  return a | b;
+  case OP_BXOR: return a ^ b;
+  case OP_LSH:  return (unsigned)a << (b & 31);
+  case OP_RSHI: return a >> (b & 31);
+  case OP_RSHU: return (unsigned)a >> (b & 31);
+  default:      return (unsigned)a * (unsigned)b;
+  }
+}
+
+/*
+=================
+EmitHotBlockCopy
+
+Copies n bytes from edx to eax in the data segment, out of range copies go to VM_BlockCopy for the error
+=================
+*/
+static void EmitHotBlockCopy(vm_t *vm, int n)
+{
+  int fail[3], done, slot, ofs, i;
+
+  EmitString("89 C1");				// mov ecx, eax
+  EmitString("09 D1");				// or ecx, edx
+  for(i = 0; i < 3; i++)
+  {
+    if(i)
+      EmitHotLea(R_ECX, i == 1 ? R_EAX : R_EDX, n);	// lea ecx, [eax/edx + n]
+    EmitString("F7 C1");			// test ecx, ~dataMask
+    Emit4(~vm->dataMask);
+    EmitString("0F 85");			// jnz fail
+    fail[i] = compiledOfs;
+    Emit4(0);
+  }
+
+  if(n <= 64)
+  {
+    for(ofs = 0; n - ofs >= 8; ofs += 8)
+    {
+      EmitHotData(0, 1, 0x8B, R_ECX, R_EDX, ofs);	// mov rcx, [r9 + rdx + ofs]
+      EmitHotData(0, 1, 0x89, R_ECX, R_EAX, ofs);	// mov [r9 + rax + ofs], rcx
+    }
+    if(n - ofs >= 4)
+    {
+      EmitHotData(0, 0, 0x8B, R_ECX, R_EDX, ofs);
+      EmitHotData(0, 0, 0x89, R_ECX, R_EAX, ofs);
+      ofs += 4;
+    }
+    if(n - ofs >= 2)
+    {
+      EmitHotData(0x66, 0, 0x8B, R_ECX, R_EDX, ofs);
+      EmitHotData(0x66, 0, 0x89, R_ECX, R_EAX, ofs);
+      ofs += 2;
+    }
+    if(n - ofs >= 1)
+    {
+      EmitHotData(0, 0, 0x8A, R_ECX, R_EDX, ofs);
+      EmitHotData(0, 0, 0x88, R_ECX, R_EAX, ofs);
+    }
+  }
+  else
+  {
+    EmitString("56 57");			// push rsi; push rdi
+    EmitString("49 8D 34 11");			// lea rsi, [r9 + rdx]
+    EmitString("49 8D 3C 01");			// lea rdi, [r9 + rax]
+    EmitString("B9");				// mov ecx, n
+    Emit4(n);
+    EmitString("F3 A4");			// rep movsb
+    EmitString("5F 5E");			// pop rdi; pop rsi
+  }
+
+  EmitString("E9");				// jmp done
+  done = compiledOfs;
+  Emit4(0);
+
+  // fail: put the operands above everything on the opStack as the first tier has them
+  for(i = 0; i < 3; i++)
+    *(int *)(buf + fail[i]) = compiledOfs - fail[i] - 4;
+
+  slot = hotMemOfs + hotDepth + 1;
+  EmitHotStack(0x89, R_EAX, slot);
+  EmitHotStack(0x89, R_EDX, slot + 1);
+  HotMoveStack(slot + 1);
+  EmitString("B8");				// mov eax, 0x12345678
+  Emit4(VM_BLOCK_COPY);
+  EmitString("B9");				// mov ecx, 0x12345678
+  Emit4(n);
+  EmitCallRel(vm, hotCode->callDoSyscallOfs);
+  HotMoveStack(-(slot + 1));
+
+  *(int *)(buf + done) = compiledOfs - done - 4;
+}
+
+/*
+=================
+VM_CompileHotProcedure
+
+Compiles one procedure after the code already in vm->codeBase, which must be writable
+=================
+*/
+static qboolean VM_CompileHotProcedure(vm_t *vm, vmHotCode_t *hot, int p)
+{
+  static const byte intConditions[] = { 0x84, 0x85, 0x8C, 0x8E, 0x8F, 0x8D, 0x82, 0x86, 0x87, 0x83 };
+  static const byte mirrorConditions[] = { 0x84, 0x85, 0x8F, 0x8D, 0x8C, 0x8E, 0x87, 0x83, 0x82, 0x86 };
+  static const byte floatConditions[] = { 0x84, 0x85, 0x82, 0x86, 0x87, 0x83 };
+  int tierPass, i, op, v, reg, ext, mask;
+  hotValue_t a, b, t;
+
+  hotCode = hot;
+  hotProc = &hot->procs[p];
+  buf = vm->codeBase;
+  code = hot->code;
+
+  hotStart = hot->codeUsed;
+  while(hotStart & 15)
+    buf[hotStart++] = 0xCC;
+
+  // the first pass finds the label offsets, the second one uses them
+  for(tierPass = 0; tierPass < 2; tierPass++)
+  {
+    compiledOfs = hotStart;
+    pc = hotProc->codeOfs;
+    hotDepth = 0;
+    hotMemOfs = 0;
+    hotFreeRegs = (1 << HOT_NUM_REGS) - 1;
+    hotFailed = qfalse;
+
+    for(i = 0; i < hotProc->numInstructions && !hotFailed; i++)
+    {
+      instruction = hotProc->firstInstruction + i;
+
+      if(compiledOfs > hot->codeSize - HOT_MAX_CODE)
+        return qfalse;
+
+      if(hot->labels[instruction])
+        HotFlush();
+      else
+        HotSync();
+
+      hot->labelOfs[i] = compiledOfs;
+
+      if(hot->loopHeads[instruction])
+        EmitHotCount(hot, p);
+
+      op = code[pc++];
+      switch(op)
+      {
+      case 0:
+        break;
+      case OP_BREAK:
+        EmitString("CC");			// int 3
+        break;
+      case OP_ENTER:
+        EmitHotCount(hot, p);
+        EmitString("81 EE");			// sub esi, 0x12345678
+        Emit4(Constant4());
+        break;
+      case OP_LEAVE:
+        HotFlush();
+        EmitString("81 C6");			// add esi, 0x12345678
+        Emit4(Constant4());
+        EmitString("C3");			// ret
+        break;
+      case OP_CONST:
+        HotPush(HOT_CONST, Constant4());
+        break;
+      case OP_LOCAL:
+        HotPush(HOT_LOCAL, Constant4());
+        break;
+      case OP_PUSH:
+        HotPush(HOT_SLOT, 0);
+        break;
+      case OP_POP:
+        if(!hotDepth)
+          hotMemOfs--;
+        else if(hotStack[--hotDepth].type == HOT_REG)
+          HotFreeReg(hotStack[hotDepth].value);
+        break;
+
+      case OP_ARG:
+        a = HotPop();
+        if(a.type == HOT_LOCAL)
+          HotReg(&a);
+        EmitHotLea(R_EDX, R_ESI, Constant1());
+        EmitHotAluImm(4, R_EDX, vm->dataMask);
+        if(a.type == HOT_CONST)
+        {
+          EmitHotData(0, 0, 0xC7, 0, R_EDX, 0);	// mov dword ptr [r9 + rdx], 0x12345678
+          Emit4(a.value);
+        }
+        else
+        {
+          EmitHotData(0, 0, 0x89, a.value, R_EDX, 0);	// mov dword ptr [r9 + rdx], reg
+          HotFreeReg(a.value);
+        }
+        break;
+
+      case OP_CALL:
+        a = HotPop();
+        if(a.type == HOT_CONST)
+        {
+          HotFlush();
+          if(a.value < 0)
+          {
+            EmitHotMovImm(R_EAX, a.value);
+            EmitCallRel(vm, hot->callProcOfsSyscall);
+          }
+          else
+            EmitHotCall(vm, a.value);
+        }
+        else
+        {
+          // the first tier call procedure takes the target from the opStack
+          HotPush(a.type, a.value);
+          HotFlush();
+          EmitCallRel(vm, hot->callProcOfs);
+        }
+        break;
+
+      case OP_JUMP:
+        a = HotPop();
+        if(a.type == HOT_CONST)
+        {
+          HotFlush();
+          EmitHotJump(vm, 0, a.value);
+          break;
+        }
+        reg = HotReg(&a);
+        HotFlush();
+        EmitHotRR(0, 0x89, reg, R_EAX);		// mov eax, reg
+        HotFreeReg(reg);
+        EmitString("81 F8");			// cmp eax, vm->instructionCount
+        Emit4(vm->instructionCount);
+        EmitString("73 04");			// jae +4
+        EmitRexString(0x49, "FF 24 C0");	// jmp qword ptr [r8 + eax * 8]
+        EmitCallErrJump(vm, hot->callDoSyscallOfs);
+        break;
+
+      case OP_EQ: case OP_NE:
+      case OP_LTI: case OP_LEI: case OP_GTI: case OP_GEI:
+      case OP_LTU: case OP_LEU: case OP_GTU: case OP_GEU:
+        b = HotPop();
+        a = HotPop();
+        v = Constant4();
+
+        if(a.type == HOT_CONST && b.type == HOT_CONST)
+        {
+          HotFlush();
+          if(HotCompare(op, a.value, b.value))
+            EmitHotJump(vm, 0, v);
+          break;
+        }
+
+        ext = intConditions[op - OP_EQ];
+        if(a.type == HOT_CONST)
+        {
+          t = a;
+          a = b;
+          b = t;
+          ext = mirrorConditions[op - OP_EQ];
+        }
+
+        HotReg(&a);
+        if(b.type != HOT_CONST)
+          HotReg(&b);
+        HotFlush();
+
+        if(b.type == HOT_CONST && !b.value)
+          EmitHotRR(0, 0x85, a.value, a.value);	// test reg, reg
+        else if(b.type == HOT_CONST)
+          EmitHotAluImm(7, a.value, b.value);	// cmp reg, 0x12345678
+        else
+        {
+          EmitHotRR(0, 0x39, b.value, a.value);	// cmp reg, reg
+          HotFreeReg(b.value);
+        }
+        HotFreeReg(a.value);
+        EmitHotJump(vm, ext, v);
+        break;
+
+      case OP_EQF: case OP_NEF:
+      case OP_LTF: case OP_LEF: case OP_GTF: case OP_GEF:
+        b = HotPop();
+        a = HotPop();
+        v = Constant4();
+
+        if((op == OP_EQF || op == OP_NEF) && b.type == HOT_CONST && !b.value)
+        {
+          // same as the first tier, -0.0f is zero
+          HotReg(&a);
+          HotFlush();
+          EmitRex(0, 0, 0, a.value);
+          Emit1(0xF7);				// test reg, 0x7FFFFFFF
+          EmitModRM(3, 0, a.value);
+          Emit4(0x7FFFFFFF);
+          HotFreeReg(a.value);
+          EmitHotJump(vm, op == OP_EQF ? 0x84 : 0x85, v);
+          break;
+        }
+
+        HotReg(&a);
+        HotReg(&b);
+        EmitHotRR(0x66, 0x0F6E, 0, a.value);	// movd xmm0, reg
+        EmitHotRR(0x66, 0x0F6E, 1, b.value);	// movd xmm1, reg
+        HotFreeReg(a.value);
+        HotFreeReg(b.value);
+        HotFlush();
+        EmitString("0F 2E C1");			// ucomiss xmm0, xmm1
+        EmitHotJump(vm, floatConditions[op - OP_EQF], v);
+        break;
+
+      case OP_LOAD4:
+      case OP_LOAD2:
+      case OP_LOAD1:
+        a = HotPop();
+        ext = op == OP_LOAD4 ? 0x8B : (op == OP_LOAD2 ? 0x0FB7 : 0x0FB6);
+        if(a.type == HOT_CONST)
+        {
+          reg = HotAllocReg();
+          EmitHotData(0, 0, ext, reg, -1, a.value & vm->dataMask);
+        }
+        else
+        {
+          reg = HotReg(&a);
+          EmitHotAluImm(4, reg, vm->dataMask);	// and reg, dataMask
+          EmitHotData(0, 0, ext, reg, reg, 0);	// mov reg, [r9 + reg]
+        }
+        HotPush(HOT_REG, reg);
+        break;
+
+      case OP_STORE4:
+      case OP_STORE2:
+      case OP_STORE1:
+        b = HotPop();
+        a = HotPop();
+        mask = vm->dataMask;
+        if(op == OP_STORE4)
+          mask &= ~3;
+        else if(op == OP_STORE2)
+          mask &= ~1;
+
+        if(b.type == HOT_LOCAL)
+          HotReg(&b);
+
+        reg = -1;
+        v = 0;
+        if(a.type == HOT_CONST)
+          v = a.value & mask;
+        else
+        {
+          if(a.type == HOT_LOCAL)
+            HotLoad(&a, R_EDX);
+          reg = a.type == HOT_REG ? a.value : R_EDX;
+          EmitHotAluImm(4, reg, mask);		// and reg, mask
+        }
+
+        if(b.type == HOT_CONST)
+        {
+          if(op == OP_STORE4)
+          {
+            EmitHotData(0, 0, 0xC7, 0, reg, v);
+            Emit4(b.value);
+          }
+          else if(op == OP_STORE2)
+          {
+            EmitHotData(0x66, 0, 0xC7, 0, reg, v);
+            Emit2(b.value);
+          }
+          else
+          {
+            EmitHotData(0, 0, 0xC6, 0, reg, v);
+            Emit1(b.value);
+          }
+        }
+        else
+        {
+          EmitHotData(op == OP_STORE2 ? 0x66 : 0, 0, op == OP_STORE1 ? 0x88 : 0x89, b.value, reg, v);
+          HotFreeReg(b.value);
+        }
+
+        if(a.type == HOT_REG)
+          HotFreeReg(a.value);
+        break;
+
+      case OP_BLOCK_COPY:
+        b = HotPop();
+        a = HotPop();
+        HotLoad(&a, R_EAX);
+        HotLoad(&b, R_EDX);
+        if(a.type == HOT_REG)
+          HotFreeReg(a.value);
+        if(b.type == HOT_REG)
+          HotFreeReg(b.value);
+        EmitHotBlockCopy(vm, Constant4());
+        break;
+
+      case OP_NEGI:
+      case OP_BCOM:
+      case OP_NEGF:
+      case OP_SEX8:
+      case OP_SEX16:
+        a = HotPop();
+        if(a.type == HOT_CONST && op != OP_NEGF)
+        {
+          if(op == OP_NEGI)
+            v = -(unsigned)a.value;
+          else if(op == OP_BCOM)
+            v = ~a.value;
+          else if(op == OP_SEX8)
+            v = (signed char)a.value;
+          else
+            v = (short)a.value;
+          HotPush(HOT_CONST, v);
+          break;
+        }
+
+        reg = HotReg(&a);
+        if(op == OP_NEGI || op == OP_BCOM)
+        {
+          EmitRex(0, 0, 0, reg);
+          Emit1(0xF7);				// neg reg / not reg
+          EmitModRM(3, op == OP_NEGI ? 3 : 2, reg);
+        }
+        else if(op == OP_NEGF)
+          EmitHotAluImm(6, reg, 0x80000000);	// xor reg, 0x80000000
+        else
+          EmitHotRR(0, op == OP_SEX8 ? 0x0FBE : 0x0FBF, reg, reg);	// movsx reg, reg8/16
+        HotPush(HOT_REG, reg);
+        break;
+
+      case OP_ADD:
+      case OP_SUB:
+      case OP_BAND:
+      case OP_BOR:
+      case OP_BXOR:
+      case OP_MULI:
+      case OP_MULU:
+        b = HotPop();
+        a = HotPop();
+        if(op == OP_MULU)
+          op = OP_MULI;
+
+        if(a.type == HOT_CONST && b.type == HOT_CONST)
+        {
+          HotPush(HOT_CONST, HotFold(op, a.value, b.value));
+          break;
+        }
+        if(a.type == HOT_LOCAL && b.type == HOT_CONST && (op == OP_ADD || op == OP_SUB))
+        {
+          HotPush(HOT_LOCAL, HotFold(op, a.value, b.value));
+          break;
+        }
+        if(a.type == HOT_CONST && op != OP_SUB)
+        {
+          t = a;
+          a = b;
+          b = t;
+          if(a.type == HOT_LOCAL && op == OP_ADD)
+          {
+            HotPush(HOT_LOCAL, HotFold(op, a.value, b.value));
+            break;
+          }
+        }
+
+        reg = HotReg(&a);
+        if(b.type == HOT_CONST)
+        {
+          if(op == OP_MULI)
+          {
+            EmitRex(0, reg, 0, reg);
+            if(iss8(b.value))
+            {
+              Emit1(0x6B);			// imul reg, reg, 0x12
+              EmitModRM(3, reg, reg);
+              Emit1(b.value);
+            }
+            else
+            {
+              Emit1(0x69);			// imul reg, reg, 0x12345678
+              EmitModRM(3, reg, reg);
+              Emit4(b.value);
+            }
+          }
+          else
+            EmitHotAluImm(op == OP_ADD ? 0 : op == OP_SUB ? 5 : op == OP_BAND ? 4 : op == OP_BOR ? 1 : 6, reg, b.value);
+        }
+        else
+        {
+          HotReg(&b);
+          if(op == OP_MULI)
+            EmitHotRR(0, 0x0FAF, reg, b.value);	// imul reg, reg
+          else
+            EmitHotRR(0, op == OP_ADD ? 0x01 : op == OP_SUB ? 0x29 : op == OP_BAND ? 0x21 : op == OP_BOR ? 0x09 : 0x31, b.value, reg);
+          HotFreeReg(b.value);
+        }
+        HotPush(HOT_REG, reg);
+        break;
+
+      case OP_LSH:
+      case OP_RSHI:
+      case OP_RSHU:
+        b = HotPop();
+        a = HotPop();
+        if(a.type == HOT_CONST && b.type == HOT_CONST)
+        {
+          HotPush(HOT_CONST, HotFold(op, a.value, b.value));
+          break;
+        }
+
+        ext = op == OP_LSH ? 4 : (op == OP_RSHI ? 7 : 5);
+        reg = HotReg(&a);
+        if(b.type == HOT_CONST)
+        {
+          EmitRex(0, 0, 0, reg);
+          Emit1(0xC1);				// shl/sar/shr reg, 0x12
+          EmitModRM(3, ext, reg);
+          Emit1(b.value & 31);
+        }
+        else
+        {
+          HotReg(&b);
+          EmitHotRR(0, 0x89, b.value, R_ECX);	// mov ecx, reg
+          HotFreeReg(b.value);
+          EmitRex(0, 0, 0, reg);
+          Emit1(0xD3);				// shl/sar/shr reg, cl
+          EmitModRM(3, ext, reg);
+        }
+        HotPush(HOT_REG, reg);
+        break;
+
+      case OP_DIVI:
+      case OP_DIVU:
+      case OP_MODI:
+      case OP_MODU:
+        b = HotPop();
+        a = HotPop();
+        HotReg(&b);
+        HotLoad(&a, R_EAX);
+        if(a.type == HOT_REG)
+          HotFreeReg(a.value);
+        if(op == OP_DIVI || op == OP_MODI)
+          EmitString("99");			// cdq
+        else
+          EmitString("31 D2");			// xor edx, edx
+        EmitRex(0, 0, 0, b.value);
+        Emit1(0xF7);				// idiv/div reg
+        EmitModRM(3, (op == OP_DIVI || op == OP_MODI) ? 7 : 6, b.value);
+        HotFreeReg(b.value);
+
+        // a register is free now, no spill will clobber eax
+        reg = HotAllocReg();
+        EmitHotRR(0, 0x89, (op == OP_DIVI || op == OP_DIVU) ? R_EAX : R_EDX, reg);
+        HotPush(HOT_REG, reg);
+        break;
+
+      case OP_ADDF:
+      case OP_SUBF:
+      case OP_MULF:
+      case OP_DIVF:
+        b = HotPop();
+        a = HotPop();
+        reg = HotReg(&a);
+        HotReg(&b);
+        EmitHotRR(0x66, 0x0F6E, 0, reg);	// movd xmm0, reg
+        EmitHotRR(0x66, 0x0F6E, 1, b.value);	// movd xmm1, reg
+        HotFreeReg(b.value);
+        EmitString("F3 0F");			// addss/subss/mulss/divss xmm0, xmm1
+        Emit1(op == OP_ADDF ? 0x58 : op == OP_SUBF ? 0x5C : op == OP_MULF ? 0x59 : 0x5E);
+        Emit1(0xC1);
+        EmitHotRR(0x66, 0x0F7E, 0, reg);	// movd reg, xmm0
+        HotPush(HOT_REG, reg);
+        break;
+
+      case OP_CVIF:
+        a = HotPop();
+        reg = HotReg(&a);
+        EmitHotRR(0xF3, 0x0F2A, 0, reg);	// cvtsi2ss xmm0, reg
+        EmitHotRR(0x66, 0x0F7E, 0, reg);	// movd reg, xmm0
+        HotPush(HOT_REG, reg);
+        break;
+
+      case OP_CVFI:
+        a = HotPop();
+        reg = HotReg(&a);
+        EmitHotRR(0x66, 0x0F6E, 0, reg);	// movd xmm0, reg
+        EmitHotRR(0xF3, 0x0F2C, reg, 0);	// cvttss2si reg, xmm0
+        HotPush(HOT_REG, reg);
+        break;
+
+      default:
+        // the first tier has no code for it either
+        return qfalse;
+      }
+    }
+
+    if(hotFailed)
+      return qfalse;
+
+    HotFlush();
+  }
+
+  hot->codeUsed = compiledOfs;
+
+  return qtrue;
+}
+
+/*
+=================
+VM_ProtectCode
+=================
+*/
+static void VM_ProtectCode(vm_t *vm, qboolean writable)
+{
+#ifdef VM_X86_MMAP
+  if(mprotect(vm->codeBase, vm->hotCode->codeSize, writable ? PROT_READ|PROT_WRITE : PROT_READ|PROT_EXEC))
+    Com_Error(ERR_FATAL, "VM_ProtectCode: mprotect failed");
+#elif _WIN32
+  DWORD oldProtect = 0;
+
+  if(!VirtualProtect(vm->codeBase, vm->hotCode->codeSize, writable ? PAGE_READWRITE : PAGE_EXECUTE_READ, &oldProtect))
+    Com_Error(ERR_FATAL, "VM_ProtectCode: VirtualProtect failed");
+#endif
+}
+
+/*
+=================
+VM_CompileHotProcedures
+
+Recompiles the procedures that became hot, called when no code of the vm is running
+=================
+*/
+static void VM_CompileHotProcedures(vm_t *vm)
+{
+  vmHotCode_t *hot = vm->hotCode;
+  vmProc_t *proc;
+  int i, j, entry, threshold, compiled;
+
+  if(++hot->calls < HOT_CHECK_CALLS)
+    return;
+  hot->calls = 0;
+
+  threshold = vm_hotCompile->integer;
+  if(threshold <= 0)
+    return;
+
+  compiled = 0;
+  for(i = 0; i < hot->numProcs; i++)
+  {
+    proc = &hot->procs[i];
+    if(proc->tier != PROC_FIRST_TIER || hot->counts[i] < (unsigned)threshold)
+      continue;
+
+    if(!compiled++)
+      VM_ProtectCode(vm, qtrue);
+
+    if(!VM_CompileHotProcedure(vm, hot, i))
+    {
+      Com_DPrintf("VM file %s: procedure at instruction %i stays in the first tier\n", vm->name, proc->firstInstruction);
+      proc->tier = PROC_FAILED;
+      continue;
+    }
+
+    // send calls and indirect jumps to the new code
+    entry = vm->instructionPointers[proc->firstInstruction] - (intptr_t)vm->codeBase;
+    compiledOfs = entry;
+    EmitString("E9");				// jmp 0x12345678
+    Emit4(hot->labelOfs[0] - entry - 5);
+
+    for(j = 0; j < proc->numInstructions; j++)
+    {
+      if(!j || hot->labels[proc->firstInstruction + j])
+        vm->instructionPointers[proc->firstInstruction + j] = (intptr_t)vm->codeBase + hot->labelOfs[j];
+    }
+
+    proc->tier = PROC_SECOND_TIER;
+    hot->numHotProcs++;
+  }
+
+  if(compiled)
+  {
+    VM_ProtectCode(vm, qfalse);
+    Com_DPrintf("VM file %s: %i procedures in %i bytes of second tier code\n", vm->name, hot->numHotProcs, hot->codeUsed - vm->codeLength);
+  }
+}
+
+static unsigned *sortCounts;
+
+static int VM_CompareProcCounts(const void *a, const void *b)
+{
+  unsigned ca = sortCounts[*(const int *)a];
+  unsigned cb = sortCounts[*(const int *)b];
+
+  return ca < cb ? -1 : (ca > cb ? 1 : 0);
+}
+
+#endif // VM_HOT_COMPILE
+
+/*
+=================
+VM_CompiledProfile
+
+vmprofile for compiled vms, lists the counters of the procedures
+=================
+*/
+void VM_CompiledProfile(vm_t *vm)
+{
+#if VM_HOT_COMPILE
+  vmHotCode_t *hot = vm->hotCode;
+  vmProc_t *proc;
+  vmSymbol_t *sym;
+  int *sorted;
+  int i, numSorted;
+  double total;
+
+  if(!hot)
+  {
+    Com_Printf("%s has no counters, set vm_hotCompile before it is loaded\n", vm->name);
+    return;
+  }
+
+  sorted = static_cast<int*>(Z_Malloc(hot->numProcs * sizeof(int) + 1));
+  numSorted = 0;
+  total = 0;
+  for(i = 0; i < hot->numProcs; i++)
+  {
+    if(hot->counts[i])
+    {
+      sorted[numSorted++] = i;
+      total += hot->counts[i];
+    }
+  }
+
+  sortCounts = hot->counts;
+  qsort(sorted, numSorted, sizeof(int), VM_CompareProcCounts);
+
+  for(i = 0; i < numSorted; i++)
+  {
+    proc = &hot->procs[sorted[i]];
+    sym = VM_ValueToFunctionSymbol(vm, proc->firstInstruction);
+
+    if(sym->symName[0])
+      Com_Printf("%2i%% %9u %c %s\n", (int)(100 * hot->counts[sorted[i]] / total), hot->counts[sorted[i]],
+                 proc->tier == PROC_SECOND_TIER ? '*' : ' ', sym->symName);
+    else
+      Com_Printf("%2i%% %9u %c instruction %i\n", (int)(100 * hot->counts[sorted[i]] / total), hot->counts[sorted[i]],
+                 proc->tier == PROC_SECOND_TIER ? '*' : ' ', proc->firstInstruction);
+
+    hot->counts[sorted[i]] = 0;
+  }
+  Com_Printf("    %9.0f total\n", total);
+  Com_Printf("%i of %i procedures in %i bytes of second tier code (*)\n", hot->numHotProcs, hot->numProcs,
+             hot->codeUsed - vm->codeLength);
+
+  Z_Free(sorted);
+#else
+  Com_Printf("%s: no procedure counters in this build\n", vm->name);
+#endif
+}
+
 /*
 =================
 VM_Compile
@@ -1071,6 +2395,11 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
   int		v;
   int		i;
         int		callProcOfsSyscall, callProcOfs, callDoSyscallOfs;
+  int		codeSize;
+#if VM_HOT_COMPILE
+  vmHotCode_t	*hot;
+  int		proc;
+#endif
 
   jusedSize = header->instructionCount + 2;
 
@@ -1095,6 +2424,19 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
     jused[ *(int *)(vm->jumpTableTargets + ( i * sizeof( int ) ) ) ] = 1;
   }
 
+#if VM_HOT_COMPILE
+  // counters for the second tier, which needs to know all jump targets
+  hot = NULL;
+  if(vm_hotCompile->integer > 0 && vm->jumpTableTargets)
+  {
+    hot = VM_ScanProcedures(vm, header);
+    maxLength += (hot->numProcs + hot->numLoopHeads) * HOT_COUNT_SIZE;
+    Z_Free(buf);
+    buf = static_cast<byte*>(Z_Malloc(maxLength));
+    Com_Memset(buf, 0, maxLength);
+  }
+#endif
+
   // Start buffer with x86-VM specific procedures
   compiledOfs = 0;
 
@@ -1116,6 +2458,9 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
   compiledOfs = vm->entryOfs;
 
   LastCommand = LAST_COMMAND_NONE;
+#if VM_HOT_COMPILE
+  proc = -1;
+#endif
 
   while(instruction < header->instructionCount)
   {
@@ -1127,6 +2472,11 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 
     vm->instructionPointers[ instruction ] = compiledOfs;
 
+#if VM_HOT_COMPILE
+    if(hot && hot->loopHeads[instruction] && proc >= 0)
+      EmitHotCount(hot, proc);
+#endif
+
     if ( !vm->jumpTableTargets )
       jlabel = 1;
     else
@@ -1149,6 +2499,11 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
       EmitString("CC");				// int 3
       break;
     case OP_ENTER:
+#if VM_HOT_COMPILE
+      proc++;
+      if(hot)
+        EmitHotCount(hot, proc);
+#endif
       EmitString("81 EE");				// sub esi, 0x12345678
       Emit4(Constant4());
       break;
@@ -1641,19 +2996,25 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
   }
   }
 
-  // copy to an exact sized buffer with the appropriate permission bits
+  // copy to an exact sized buffer with the appropriate permission bits,
+  // plus as much room for the second tier
   vm->codeLength = compiledOfs;
+  codeSize = compiledOfs;
+#if VM_HOT_COMPILE
+  if(hot)
+    codeSize += compiledOfs;
+#endif
 #ifdef VM_X86_MMAP
-  vm->codeBase = static_cast<byte*>(mmap(NULL, compiledOfs, PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0));
+  vm->codeBase = static_cast<byte*>(mmap(NULL, codeSize, PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0));
   if(vm->codeBase == MAP_FAILED)
     Com_Error(ERR_FATAL, "VM_CompileX86: can't mmap memory");
 #elif _WIN32
   // allocate memory with EXECUTE permissions under windows.
-  vm->codeBase =  static_cast<byte*>(VirtualAlloc(NULL, compiledOfs, MEM_COMMIT, PAGE_EXECUTE_READWRITE));
+  vm->codeBase =  static_cast<byte*>(VirtualAlloc(NULL, codeSize, MEM_COMMIT, PAGE_EXECUTE_READWRITE));
   if(!vm->codeBase)
     Com_Error(ERR_FATAL, "VM_CompileX86: VirtualAlloc failed");
 #else
-  vm->codeBase = malloc(compiledOfs);
+  vm->codeBase = malloc(codeSize);
   if(!vm->codeBase)
           Com_Error(ERR_FATAL, "VM_CompileX86: malloc failed");
 #endif
@@ -1661,21 +3022,38 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
   Com_Memcpy( vm->codeBase, buf, compiledOfs );
 
 #ifdef VM_X86_MMAP
-  if(mprotect(vm->codeBase, compiledOfs, PROT_READ|PROT_EXEC))
+  if(mprotect(vm->codeBase, codeSize, PROT_READ|PROT_EXEC))
     Com_Error(ERR_FATAL, "VM_CompileX86: mprotect failed");
 #elif _WIN32
   {
     DWORD oldProtect = 0;
 
     // remove write permissions.
-    if(!VirtualProtect(vm->codeBase, compiledOfs, PAGE_EXECUTE_READ, &oldProtect))
+    if(!VirtualProtect(vm->codeBase, codeSize, PAGE_EXECUTE_READ, &oldProtect))
       Com_Error(ERR_FATAL, "VM_CompileX86: VirtualProtect failed");
   }
 #endif
 
-  Z_Free( code );
   Z_Free( buf );
-  Z_Free( jused );
+#if VM_HOT_COMPILE
+  if(hot)
+  {
+    // the second tier compiles from the same bytecode and jump targets
+    hot->code = code;
+    hot->labels = jused;
+    hot->callDoSyscallOfs = callDoSyscallOfs;
+    hot->callProcOfs = callProcOfs;
+    hot->callProcOfsSyscall = callProcOfsSyscall;
+    hot->codeUsed = compiledOfs;
+    hot->codeSize = codeSize;
+    vm->hotCode = hot;
+  }
+  else
+#endif
+  {
+    Z_Free( code );
+    Z_Free( jused );
+  }
   Com_Printf( "VM file %s compiled to %i bytes of code\n", vm->name, compiledOfs );
 
   vm->destroy = VM_Destroy_Compiled;
@@ -1688,13 +3066,23 @@ void VM_Compile(vm_t *vm, vmHeader_t *header)
 
 void VM_Destroy_Compiled(vm_t* self)
 {
-#ifdef VM_X86_MMAP
+#if defined(VM_X86_MMAP) && VM_HOT_COMPILE
+  munmap(self->codeBase, self->hotCode ? self->hotCode->codeSize : self->codeLength);
+#elif defined(VM_X86_MMAP)
   munmap(self->codeBase, self->codeLength);
 #elif _WIN32
   VirtualFree(self->codeBase, 0, MEM_RELEASE);
 #else
   free(self->codeBase);
 #endif
+
+#if VM_HOT_COMPILE
+  if(self->hotCode)
+  {
+    VM_FreeHotCode(self->hotCode);
+    self->hotCode = NULL;
+  }
+#endif
 }
 
 /*
@@ -1710,7 +3098,7 @@ extern "C" uint8_t qvmcall64(int *programStack, int *opStack, intptr_t *instruct
 
 int VM_CallCompiled(vm_t *vm, int *args)
 {
-  byte	stack[OPSTACK_SIZE + 15];
+  byte	stack[OPSTACK_SIZE + 2 * OPSTACK_GUARD + 15];
   void	*entryPoint;
   int		programStack, stackOnEntry;
   byte	*image;
@@ -1720,6 +3108,12 @@ int VM_CallCompiled(vm_t *vm, int *args)
 
   currentVM = vm;
 
+#if VM_HOT_COMPILE
+  // nothing of this vm runs at the top level, so its code can be patched
+  if(vm->hotCode && vm->callLevel == 1)
+    VM_CompileHotProcedures(vm);
+#endif
+
   // interpret the code
   vm->currentlyInterpreting = qtrue;
 
@@ -1739,7 +3133,7 @@ int VM_CallCompiled(vm_t *vm, int *args)
 
   // off we go into generated code...
   entryPoint = vm->codeBase + vm->entryOfs;
-  opStack = (int*)PADP(stack, 16);
+  opStack = (int*)PADP(stack + OPSTACK_GUARD, 16);
   *opStack = 0xDEADBEEF;
   opStackOfs = 0;
 
@@ -1780,7 +3174,9 @@ int VM_CallCompiled(vm_t *vm, int *args)
     "pop %%r15\n"
     : "+S" (programStack), "+D" (opStack), "+b" (opStackOfs)
     : "g" (vm->instructionPointers), "g" (vm->dataBase), "g" (entryPoint)
-    : "cc", "memory", "%rax", "%rcx", "%rdx", "%r8", "%r9", "%r10", "%r11"
+    : "cc", "memory", "%rax", "%rcx", "%rdx", "%r8", "%r9", "%r10", "%r11",
+      "%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5", "%xmm6", "%xmm7",
+      "%xmm8", "%xmm9", "%xmm10", "%xmm11", "%xmm12", "%xmm13", "%xmm14", "%xmm15"
   );
 #else
   __asm__ volatile(
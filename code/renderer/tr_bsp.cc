@@ -9283,6 +9283,9 @@ void RE_LoadWorldMap(const char *name)
 
   ri.Printf( PRINT_DEVELOPER, "----- RE_LoadWorldMap( %s ) -----\n", name );
 
+  // decode the images of the map ahead of the shaders asking for them
+  R_BeginImageJobs( name );
+
   // set default sun direction to be used if it isn't
   // overridden by a shader
   tr.sunDirection[0] = 0.45f;
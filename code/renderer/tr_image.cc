@@ -2369,8 +2369,9 @@ static qboolean ParseMakeAlpha( char **text, byte **pic, int *width, int *height
 
 typedef struct
 {
-	char *ext;
-	void ( *ImageLoader )( const char *, unsigned char **, int *, int *, byte );
+	char              *ext;
+	void              ( *ImageLoader )( const char *, unsigned char **, int *, int *, byte );
+	imageDecodeFunc_t ImageDecoder;
 } imageExtToLoaderMap_t;
 
 // Note that the ordering indicates the order of preference used
@@ -2378,18 +2379,62 @@ typedef struct
 static const imageExtToLoaderMap_t imageLoaders[] =
 {
 #ifdef USE_IMAGE_WEBP
-	{ "webp", LoadWEBP },
+	{ "webp", LoadWEBP, DecodeWEBP },
 #endif
-	{ "png",  LoadPNG  },
-	{ "tga",  LoadTGA  },
-	{ "jpg",  LoadJPG  },
-	{ "jpeg", LoadJPG  },
+	{ "png",  LoadPNG,  DecodePNG  },
+	{ "tga",  LoadTGA,  DecodeTGA  },
+	{ "jpg",  LoadJPG,  DecodeJPG  },
+	{ "jpeg", LoadJPG,  DecodeJPG  },
 //	{"dds", LoadDDS},  // need to write some direct uploader routines first
 //	{"hdr", LoadRGBE}  // RGBE just sucks
 };
 
 static int                   numImageLoaders = ARRAY_LEN( imageLoaders );
 
+/*
+=================
+R_FindImageDecoder
+
+Returns the decoder for the extension of name, see tr_image_jobs.cc
+=================
+*/
+imageDecodeFunc_t R_FindImageDecoder( const char *name )
+{
+	const char *ext = COM_GetExtension( name );
+	int        i;
+
+	for ( i = 0; i < numImageLoaders; i++ )
+	{
+		if ( !Q_stricmp( ext, imageLoaders[ i ].ext ) )
+		{
+			return imageLoaders[ i ].ImageDecoder;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+=================
+R_LoadImageFile
+
+Takes the picture from the image jobs if they decoded it ahead,
+otherwise runs the loader
+=================
+*/
+static void R_LoadImageFile( const imageExtToLoaderMap_t *loader, const char *name, byte **pic, int *width, int *height, byte alphaByte )
+{
+	if ( !R_TakeImageJob( name, alphaByte, pic, width, height ) )
+	{
+		loader->ImageLoader( name, pic, width, height, alphaByte );
+	}
+
+	if ( *pic )
+	{
+		R_RecordImageJob( name, alphaByte );
+	}
+}
+
 #if defined(HYPODEBUG_MAP_PRINT)
 //int load_start; // = Sys_Milliseconds(), end;
 
@@ -2563,8 +2608,9 @@ static void R_LoadImage( char **buffer, byte **pic, int *width, int *height, int
 	else
 	{
 		qboolean   orgNameFailed = qfalse;
-		int        i;
+		int        i, found;
 		const char *ext;
+		const char *exts[ ARRAY_LEN( imageLoaders ) ];
 		char       filename[ MAX_QPATH ];
 		byte       alphaByte;
 
@@ -2590,7 +2636,7 @@ static void R_LoadImage( char **buffer, byte **pic, int *width, int *height, int
 				if ( !Q_stricmp( ext, imageLoaders[ i ].ext ) )
 				{
 					// load
-					imageLoaders[ i ].ImageLoader( filename, pic, width, height, alphaByte );
+					R_LoadImageFile( &imageLoaders[ i ], filename, pic, width, height, alphaByte );
 					break;
 				}
 			}
@@ -2616,13 +2662,27 @@ static void R_LoadImage( char **buffer, byte **pic, int *width, int *height, int
 			}
 		}
 
-		// try and find a suitable match using all the image formats supported
+		// try and find a suitable match using all the image formats supported,
+		// asking the filesystem once which of them are there
+		for ( i = 0; i < numImageLoaders; i++ )
+		{
+			exts[ i ] = imageLoaders[ i ].ext;
+		}
+		found = ri.FS_FileExtensions( filename, exts, numImageLoaders );
+
 		for ( i = 0; i < numImageLoaders; i++ )
 		{
-			char *altName = va( "%s.%s", filename, imageLoaders[ i ].ext );
+			char *altName;
+
+			if ( !( found & ( 1 << i ) ) )
+			{
+				continue;
+			}
+
+			altName = va( "%s.%s", filename, imageLoaders[ i ].ext );
 
 			// load
-			imageLoaders[ i ].ImageLoader( altName, pic, width, height, alphaByte );
+			R_LoadImageFile( &imageLoaders[ i ], altName, pic, width, height, alphaByte );
 
 			if ( *pic )
 			{
@@ -0,0 +1,886 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+Copyright (C) 2006-xyyz Lars '0xA5EA' Kandler
+
+This file is part of KingpinQ3 source code.
+
+KingpinQ3 source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+KingpinQ3 source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with KingpinQ3 source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// tr_image_jobs.cc -- decodes the images of a map on worker threads
+#include "tr_local.h"
+#include <setjmp.h>
+
+/*
+===============================================================================
+
+IMAGE JOBS
+
+R_LoadImage decodes every image of a map on the main thread, one after the
+other, as the shaders ask for them.  The files it decodes while a map loads
+are written to an asset list next to the map (maps/<name>.assets), and the
+next load of the map decodes them ahead of time: the files are read on the
+main thread in list order, decoded by r_imageJobs worker threads in windows
+of r_imageJobWindow images, and R_LoadImage takes the decoded pictures as it
+gets to them.  While it uploads one window the workers decode the next one,
+and R_UploadImage still runs on the main thread in the order the shaders
+ask for the images.
+
+The decoders allocate with R_DecodeAlloc, print with R_DecodePrintf and
+fail with R_DecodeError.  On a worker these use malloc, buffer the messages
+and abort the job, since nothing there may touch engine state.  The blocks
+a job has allocated are tracked, so an abort frees what the decoder had no
+chance to.  A job that failed is decoded again by R_LoadImage on the main
+thread, so its warnings and errors are reported as usual.
+
+===============================================================================
+*/
+
+typedef struct
+{
+	jmp_buf  abort;
+	qboolean detached;                       // away from the engine, see R_DecodeAlloc
+	int      errorLevel;
+	char     error[ 256 ];
+	char     *messages;                      // buffered R_DecodePrintf output when detached
+	int      messagesSize;
+	void     **allocs;                       // detached blocks not freed yet, released on abort
+	int      numAllocs;
+	int      maxAllocs;
+} imageDecode_t;
+
+static thread_local imageDecode_t *decodeContext;
+
+typedef struct
+{
+	char              name[ MAX_QPATH ];     // file name as R_LoadImage resolved it
+	byte              alphaByte;
+	imageDecodeFunc_t decode;
+
+	byte              *data;                 // file contents until the job is decoded
+	int               dataLen;
+
+	byte              *pic;                  // malloc'd, copied to the zone when taken
+	int               width, height;
+	char              messages[ 256 ];
+} imageJob_t;
+
+static struct
+{
+	qboolean   active;                       // from RE_LoadWorldMap to RE_EndRegistration
+	char       listName[ MAX_QPATH ];
+
+	imageJob_t *jobs;
+	int        numJobs;
+	int        numThreads;
+
+	int        readyStart, readyEnd;         // decoded, waiting for R_LoadImage
+	int        flightStart, flightEnd;       // handed to the workers
+	int        cursor;                       // next job R_LoadImage is expected to ask for
+	int        numTaken;
+
+	// the images this load decoded, written back when they differ from the list
+	char       *record;
+	int        recordLength;
+	int        recordSize;
+	int        numRecorded;
+	qboolean   mismatch;
+} imageJobs;
+
+/*
+=================
+R_DecodeAlloc
+
+Zone memory on the main thread, zero filled malloc memory when detached
+=================
+*/
+void *R_DecodeAlloc( size_t size )
+{
+	void *ptr;
+	void **allocs;
+
+	if ( decodeContext && decodeContext->detached )
+	{
+		ptr = calloc( 1, size );
+
+		if ( !ptr )
+		{
+			R_DecodeError( ERR_DROP, "R_DecodeAlloc: failed on allocation of %i bytes", ( int ) size );
+		}
+
+		if ( decodeContext->numAllocs == decodeContext->maxAllocs )
+		{
+			allocs = ( void ** ) realloc( decodeContext->allocs, ( decodeContext->maxAllocs + 16 ) * sizeof( *allocs ) );
+
+			if ( !allocs )
+			{
+				free( ptr );
+				R_DecodeError( ERR_DROP, "R_DecodeAlloc: failed to track allocation of %i bytes", ( int ) size );
+			}
+
+			decodeContext->allocs = allocs;
+			decodeContext->maxAllocs += 16;
+		}
+
+		decodeContext->allocs[ decodeContext->numAllocs++ ] = ptr;
+
+		return ptr;
+	}
+
+	return ri.Z_Malloc( size );
+}
+
+/*
+=================
+R_DecodeFree
+=================
+*/
+void R_DecodeFree( void *ptr )
+{
+	int i;
+
+	if ( decodeContext && decodeContext->detached )
+	{
+		// usually the last block allocated
+		for ( i = decodeContext->numAllocs - 1; i >= 0; i-- )
+		{
+			if ( decodeContext->allocs[ i ] == ptr )
+			{
+				decodeContext->allocs[ i ] = decodeContext->allocs[ --decodeContext->numAllocs ];
+				break;
+			}
+		}
+
+		free( ptr );
+		return;
+	}
+
+	ri.Free( ptr );
+}
+
+/*
+=================
+R_DecodePrintf
+=================
+*/
+void QDECL R_DecodePrintf( int printLevel, const char *fmt, ... )
+{
+	va_list argptr;
+	char    text[ 1024 ];
+	int     len;
+
+	va_start( argptr, fmt );
+	Q_vsnprintf( text, sizeof( text ), fmt, argptr );
+	va_end( argptr );
+
+	if ( decodeContext && decodeContext->detached )
+	{
+		len = strlen( decodeContext->messages );
+		Q_strncpyz( decodeContext->messages + len, text, decodeContext->messagesSize - len );
+		return;
+	}
+
+	ri.Printf( printLevel, "%s", text );
+}
+
+/*
+=================
+R_DecodeError
+
+Aborts the decode started by R_DecodeImageFile or R_DecodeImageJob
+=================
+*/
+void QDECL R_DecodeError( int errorLevel, const char *fmt, ... )
+{
+	va_list argptr;
+	char    text[ 1024 ];
+
+	va_start( argptr, fmt );
+	Q_vsnprintf( text, sizeof( text ), fmt, argptr );
+	va_end( argptr );
+
+	if ( decodeContext )
+	{
+		decodeContext->errorLevel = errorLevel;
+		Q_strncpyz( decodeContext->error, text, sizeof( decodeContext->error ) );
+		longjmp( decodeContext->abort, 1 );
+	}
+
+	ri.Error( errorLevel, "%s", text );
+}
+
+/*
+=================
+R_DecodeImageFile
+
+Reads name and decodes it on the calling thread, which must be the main one.
+Errors are raised after the file has been freed.
+=================
+*/
+void R_DecodeImageFile( imageDecodeFunc_t decode, const char *name, byte **pic, int *width, int *height, byte alphaByte )
+{
+	imageDecode_t decode_;
+	byte          *buffer;
+	int           len;
+
+	*pic = NULL;
+
+	len = ri.FS_ReadFile( name, ( void ** ) &buffer );
+
+	if ( !buffer || len < 0 )
+	{
+		return;
+	}
+
+	decode_.detached = qfalse;
+	decodeContext = &decode_;
+
+	if ( setjmp( decode_.abort ) )
+	{
+		decodeContext = NULL;
+		*pic = NULL;
+		ri.FS_FreeFile( buffer );
+		ri.Error( decode_.errorLevel, "%s", decode_.error );
+		return;
+	}
+
+	decode( name, buffer, len, pic, width, height, alphaByte );
+
+	decodeContext = NULL;
+	ri.FS_FreeFile( buffer );
+}
+
+/*
+=================
+R_DecodeImageJob
+
+Decodes the file contents of job detached from the engine, so it can run
+on any thread
+=================
+*/
+static void R_DecodeImageJob( imageJob_t *job )
+{
+	imageDecode_t decode;
+	int           i;
+
+	job->pic = NULL;
+	job->messages[ 0 ] = '\0';
+
+	if ( !job->data )
+	{
+		return;
+	}
+
+	decode.detached = qtrue;
+	decode.messages = job->messages;
+	decode.messagesSize = sizeof( job->messages );
+	decode.allocs = NULL;
+	decode.numAllocs = 0;
+	decode.maxAllocs = 0;
+	decodeContext = &decode;
+
+	if ( setjmp( decode.abort ) )
+	{
+		// the main thread decodes the file again and reports the error
+		decodeContext = NULL;
+
+		for ( i = 0; i < decode.numAllocs; i++ )
+		{
+			free( decode.allocs[ i ] );
+		}
+
+		free( decode.allocs );
+		job->pic = NULL;
+		return;
+	}
+
+	job->decode( job->name, job->data, job->dataLen, &job->pic, &job->width, &job->height, job->alphaByte );
+
+	// what is left belongs to the picture
+	decodeContext = NULL;
+	free( decode.allocs );
+}
+
+/*
+=================
+R_ReadImageJob
+
+Reads the file of job on the main thread
+=================
+*/
+static void R_ReadImageJob( imageJob_t *job )
+{
+	byte *buffer;
+	int  len;
+
+	len = ri.FS_ReadFile( job->name, ( void ** ) &buffer );
+
+	if ( !buffer || len < 0 )
+	{
+		return;
+	}
+
+	// keep it out of the hunk, the temp memory has to be freed in stack order
+	job->data = ( byte * ) malloc( len );
+
+	if ( job->data )
+	{
+		Com_Memcpy( job->data, buffer, len );
+		job->dataLen = len;
+	}
+
+	ri.FS_FreeFile( buffer );
+}
+
+/*
+=================
+R_FreeImageJobs
+
+Frees what is left of the jobs in [start, end)
+=================
+*/
+static void R_FreeImageJobs( int start, int end )
+{
+	int        i;
+	imageJob_t *job;
+
+	for ( i = start; i < end; i++ )
+	{
+		job = &imageJobs.jobs[ i ];
+
+		free( job->data );
+		free( job->pic );
+		job->data = NULL;
+		job->pic = NULL;
+	}
+}
+
+/*
+=================
+R_LoadAssetList
+
+Sets up a job for every image in the asset list, without reading the files
+=================
+*/
+static int R_LoadAssetList( const char *listName )
+{
+	char              *buffer;
+	char              *text_p;
+	char              *token;
+	char              name[ MAX_QPATH ];
+	int               numLines;
+	imageDecodeFunc_t decode;
+	imageJob_t        *job;
+
+	ri.FS_ReadFile( listName, ( void ** ) &buffer );
+
+	if ( !buffer )
+	{
+		return 0;
+	}
+
+	// one image per line, so the line count is enough room
+	numLines = 1;
+
+	for ( text_p = buffer; *text_p; text_p++ )
+	{
+		if ( *text_p == '\n' )
+		{
+			numLines++;
+		}
+	}
+
+	imageJobs.jobs = ( imageJob_t * ) ri.Z_Malloc( numLines * sizeof( imageJob_t ) );
+	imageJobs.numJobs = 0;
+
+	text_p = buffer;
+
+	while ( imageJobs.numJobs < numLines )
+	{
+		token = COM_ParseExt( &text_p, qtrue );
+
+		if ( !token[ 0 ] )
+		{
+			break;
+		}
+
+		Q_strncpyz( name, token, sizeof( name ) );
+
+		token = COM_ParseExt( &text_p, qfalse );
+		decode = R_FindImageDecoder( name );
+
+		if ( !decode )
+		{
+			continue;
+		}
+
+		job = &imageJobs.jobs[ imageJobs.numJobs++ ];
+		Q_strncpyz( job->name, name, sizeof( job->name ) );
+		job->alphaByte = ( byte ) atoi( token );
+		job->decode = decode;
+	}
+
+	ri.FS_FreeFile( buffer );
+
+	return imageJobs.numJobs;
+}
+
+/*
+=================
+R_ImageJobWork
+=================
+*/
+static void R_ImageJobWork( int work, int threadnum )
+{
+	imageJob_t *job = &imageJobs.jobs[ imageJobs.flightStart + work ];
+
+	R_DecodeImageJob( job );
+
+	free( job->data );
+	job->data = NULL;
+}
+
+/*
+=================
+R_StartImageJobWindow
+
+Reads the files of the next window and hands them to the workers
+=================
+*/
+static void R_StartImageJobWindow( void )
+{
+	int i;
+
+	imageJobs.flightEnd = imageJobs.flightStart + Q_max( r_imageJobWindow->integer, 1 );
+
+	if ( imageJobs.flightEnd > imageJobs.numJobs )
+	{
+		imageJobs.flightEnd = imageJobs.numJobs;
+	}
+
+	if ( imageJobs.flightStart >= imageJobs.flightEnd )
+	{
+		return;
+	}
+
+	for ( i = imageJobs.flightStart; i < imageJobs.flightEnd; i++ )
+	{
+		R_ReadImageJob( &imageJobs.jobs[ i ] );
+	}
+
+	ri.StartJobs( imageJobs.numThreads, imageJobs.flightEnd - imageJobs.flightStart, R_ImageJobWork );
+}
+
+/*
+=================
+R_ShutdownImageJobs
+
+Drops everything without touching the asset list, also after an error
+=================
+*/
+void R_ShutdownImageJobs( void )
+{
+	ri.WaitJobs();
+
+	if ( imageJobs.jobs )
+	{
+		R_FreeImageJobs( 0, imageJobs.numJobs );
+		ri.Free( imageJobs.jobs );
+	}
+
+	if ( imageJobs.record )
+	{
+		ri.Free( imageJobs.record );
+	}
+
+	Com_Memset( &imageJobs, 0, sizeof( imageJobs ) );
+}
+
+/*
+=================
+R_BeginImageJobs
+
+Called when a map starts loading, starts decoding the images of its asset
+list if there is one
+=================
+*/
+void R_BeginImageJobs( const char *mapName )
+{
+	char listName[ MAX_QPATH ];
+
+	R_ShutdownImageJobs();
+
+	if ( r_imageJobs->integer <= 0 )
+	{
+		return;
+	}
+
+	COM_StripExtension3( mapName, listName, sizeof( listName ) );
+	Q_strcat( listName, sizeof( listName ), ".assets" );
+
+	Q_strncpyz( imageJobs.listName, listName, sizeof( imageJobs.listName ) );
+	imageJobs.numThreads = Q_min( r_imageJobs->integer, MAX_WORKER_THREADS );
+	imageJobs.active = qtrue;
+
+	if ( R_LoadAssetList( listName ) )
+	{
+		R_StartImageJobWindow();
+	}
+}
+
+/*
+=================
+R_EndImageJobs
+
+Called when registration is done, rewrites the asset list if this load
+did not match it
+=================
+*/
+void R_EndImageJobs( void )
+{
+	if ( !imageJobs.active )
+	{
+		return;
+	}
+
+	ri.WaitJobs();
+
+	if ( imageJobs.numRecorded != imageJobs.numJobs )
+	{
+		imageJobs.mismatch = qtrue;
+	}
+
+	if ( imageJobs.mismatch && imageJobs.numRecorded )
+	{
+		ri.FS_WriteFile( imageJobs.listName, imageJobs.record, imageJobs.recordLength );
+	}
+
+	ri.Printf( PRINT_DEVELOPER, "%i of %i images decoded ahead on %i threads%s\n", imageJobs.numTaken, imageJobs.numRecorded,
+	           imageJobs.numThreads, imageJobs.mismatch ? va( ", %s rewritten", imageJobs.listName ) : "" );
+
+	R_ShutdownImageJobs();
+}
+
+/*
+=================
+R_RecordImageJob
+
+Adds an image R_LoadImage decoded to the asset list of the map
+=================
+*/
+void R_RecordImageJob( const char *name, byte alphaByte )
+{
+	char       line[ MAX_QPATH + 16 ];
+	char       *record;
+	int        len;
+	imageJob_t *job;
+
+	if ( !imageJobs.active )
+	{
+		return;
+	}
+
+	len = Com_sprintf( line, sizeof( line ), "\"%s\" %i\n", name, alphaByte );
+
+	if ( imageJobs.recordLength + len >= imageJobs.recordSize )
+	{
+		imageJobs.recordSize = Q_max( imageJobs.recordSize * 2, 16384 );
+		record = ( char * ) ri.Z_Malloc( imageJobs.recordSize );
+
+		if ( imageJobs.record )
+		{
+			Com_Memcpy( record, imageJobs.record, imageJobs.recordLength );
+			ri.Free( imageJobs.record );
+		}
+
+		imageJobs.record = record;
+	}
+
+	Com_Memcpy( imageJobs.record + imageJobs.recordLength, line, len );
+	imageJobs.recordLength += len;
+
+	if ( imageJobs.numRecorded < imageJobs.numJobs )
+	{
+		job = &imageJobs.jobs[ imageJobs.numRecorded ];
+
+		if ( Q_stricmp( job->name, name ) || job->alphaByte != alphaByte )
+		{
+			imageJobs.mismatch = qtrue;
+		}
+	}
+
+	imageJobs.numRecorded++;
+}
+
+/*
+=================
+R_TakeImageJob
+
+Hands the picture decoded ahead for name to R_LoadImage as zone memory.
+Returns qfalse if it has to be loaded the usual way.
+=================
+*/
+qboolean R_TakeImageJob( const char *name, byte alphaByte, byte **pic, int *width, int *height )
+{
+	int        i;
+	int        size;
+	imageJob_t *job;
+
+	if ( !imageJobs.active || !imageJobs.numJobs )
+	{
+		return qfalse;
+	}
+
+	// the images are asked for in list order, unless the map or its
+	// shaders changed since the list was written
+	for ( i = imageJobs.cursor; i < imageJobs.numJobs; i++ )
+	{
+		job = &imageJobs.jobs[ i ];
+
+		if ( job->alphaByte == alphaByte && !Q_stricmp( job->name, name ) )
+		{
+			break;
+		}
+	}
+
+	if ( i == imageJobs.numJobs )
+	{
+		return qfalse;
+	}
+
+	if ( i >= imageJobs.flightEnd )
+	{
+		// further down the list than the workers got, carry on from there
+		ri.WaitJobs();
+		R_FreeImageJobs( imageJobs.readyStart, imageJobs.flightEnd );
+
+		imageJobs.readyStart = imageJobs.readyEnd = i;
+		imageJobs.flightStart = i;
+		R_StartImageJobWindow();
+	}
+
+	if ( i >= imageJobs.flightStart )
+	{
+		// the window being decoded becomes the ready one, start the next
+		ri.WaitJobs();
+		R_FreeImageJobs( imageJobs.readyStart, imageJobs.flightStart );
+
+		imageJobs.readyStart = imageJobs.flightStart;
+		imageJobs.readyEnd = imageJobs.flightEnd;
+		imageJobs.flightStart = imageJobs.flightEnd;
+		R_StartImageJobWindow();
+	}
+
+	// skipped images won't be asked for any more
+	R_FreeImageJobs( imageJobs.cursor, i );
+	imageJobs.cursor = i + 1;
+
+	job = &imageJobs.jobs[ i ];
+
+	if ( !job->pic )
+	{
+		return qfalse;
+	}
+
+	if ( job->messages[ 0 ] )
+	{
+		ri.Printf( PRINT_WARNING, "%s", job->messages );
+	}
+
+	size = job->width * job->height * 4;
+	*pic = ( byte * ) ri.Z_Malloc( size );
+	Com_Memcpy( *pic, job->pic, size );
+	*width = job->width;
+	*height = job->height;
+
+	free( job->pic );
+	job->pic = NULL;
+
+	imageJobs.numTaken++;
+
+	return qtrue;
+}
+
+/*
+=================
+R_BenchImageJobWork
+=================
+*/
+static void R_BenchImageJobWork( int work, int threadnum )
+{
+	imageJob_t *job = &imageJobs.jobs[ work ];
+
+	R_DecodeImageJob( job );
+
+	free( job->pic );
+	job->pic = NULL;
+}
+
+/*
+=================
+R_ImageDecodeBench
+
+Decodes the images of an asset list once on the calling thread and once on
+numThreads threads and prints the times.  Never touches GL, so it also
+runs before the renderer is initialized.
+=================
+*/
+void R_ImageDecodeBench( const char *assetList, int numThreads )
+{
+	int        i, j;
+	int        start, readMsec, serialMsec, parallelMsec;
+	int        numFailed;
+	int64_t    readBytes, decodedBytes;
+	int        numExts;
+	const char *exts[ 8 ];
+	int        extCounts[ 8 ];
+	const char *ext;
+	imageJob_t *job;
+
+	if ( imageJobs.active )
+	{
+		ri.Printf( PRINT_WARNING, "imageDecodeBench: not while a map is loading\n" );
+		return;
+	}
+
+	if ( numThreads < 2 )
+	{
+		numThreads = 4;
+	}
+
+	numThreads = Q_min( numThreads, MAX_WORKER_THREADS + 1 );
+
+	R_ShutdownImageJobs();
+
+	if ( !R_LoadAssetList( assetList ) )
+	{
+		ri.Printf( PRINT_WARNING, "imageDecodeBench: no images in '%s'\n", assetList );
+		R_ShutdownImageJobs();
+		return;
+	}
+
+	// reading stays on one thread in both runs
+	start = ri.Milliseconds();
+	readBytes = 0;
+	numExts = 0;
+
+	for ( i = 0; i < imageJobs.numJobs; i++ )
+	{
+		job = &imageJobs.jobs[ i ];
+
+		R_ReadImageJob( job );
+		readBytes += job->dataLen;
+
+		ext = COM_GetExtension( job->name );
+
+		for ( j = 0; j < numExts; j++ )
+		{
+			if ( !Q_stricmp( exts[ j ], ext ) )
+			{
+				break;
+			}
+		}
+
+		if ( j == numExts && numExts < ( int ) ARRAY_LEN( exts ) )
+		{
+			exts[ numExts ] = ext;
+			extCounts[ numExts++ ] = 0;
+		}
+
+		if ( j < numExts )
+		{
+			extCounts[ j ]++;
+		}
+	}
+
+	readMsec = ri.Milliseconds() - start;
+
+	start = ri.Milliseconds();
+	numFailed = 0;
+	decodedBytes = 0;
+
+	for ( i = 0; i < imageJobs.numJobs; i++ )
+	{
+		job = &imageJobs.jobs[ i ];
+
+		R_DecodeImageJob( job );
+
+		if ( job->pic )
+		{
+			decodedBytes += job->width * job->height * 4;
+		}
+		else
+		{
+			numFailed++;
+		}
+
+		free( job->pic );
+		job->pic = NULL;
+	}
+
+	serialMsec = ri.Milliseconds() - start;
+
+	// the caller is one of the threads
+	start = ri.Milliseconds();
+	ri.StartJobs( numThreads - 1, imageJobs.numJobs, R_BenchImageJobWork );
+	ri.WaitJobs();
+	parallelMsec = ri.Milliseconds() - start;
+
+	ri.Printf( PRINT_ALL, "%s: %i images (", assetList, imageJobs.numJobs );
+
+	for ( j = 0; j < numExts; j++ )
+	{
+		ri.Printf( PRINT_ALL, "%s%i %s", j ? ", " : "", extCounts[ j ], exts[ j ] );
+	}
+
+	ri.Printf( PRINT_ALL, "), %i failed\n", numFailed );
+	ri.Printf( PRINT_ALL, "  read        %6i msec  %7.1f MB\n", readMsec, readBytes / ( 1024.0 * 1024.0 ) );
+	ri.Printf( PRINT_ALL, "   1 thread   %6i msec  %7.1f MB decoded\n", serialMsec, decodedBytes / ( 1024.0 * 1024.0 ) );
+	ri.Printf( PRINT_ALL, "  %2i threads  %6i msec  %.2fx\n", numThreads, parallelMsec,
+	           parallelMsec ? ( float ) serialMsec / parallelMsec : 0.0f );
+
+	R_ShutdownImageJobs();
+}
+
+/*
+=================
+R_ImageDecodeBench_f
+
+imageDecodeBench [assetlist] [threads], defaults to the list of the
+current map and r_imageJobs threads
+=================
+*/
+void R_ImageDecodeBench_f( void )
+{
+	char listName[ MAX_QPATH ];
+
+	if ( ri.Cmd_Argc() > 1 )
+	{
+		Q_strncpyz( listName, ri.Cmd_Argv( 1 ), sizeof( listName ) );
+	}
+	else if ( tr.world )
+	{
+		COM_StripExtension3( tr.world->name, listName, sizeof( listName ) );
+		Q_strcat( listName, sizeof( listName ), ".assets" );
+	}
+	else
+	{
+		ri.Printf( PRINT_ALL, "usage: imageDecodeBench [assetlist] [threads]\n" );
+		return;
+	}
+
+	R_ImageDecodeBench( listName, ri.Cmd_Argc() > 2 ? atoi( ri.Cmd_Argv( 2 ) ) : r_imageJobs->integer );
+}
@@ -60,7 +60,7 @@ static void  R_JPGErrorExit( j_common_ptr cinfo )
 	/* Let the memory manager delete any temp files before we die */
 	jpeg_destroy( cinfo );
 
-	ri.Error( ERR_FATAL, "%s", buffer );
+	R_DecodeError( ERR_FATAL, "%s", buffer );
 }
 
 static void R_JPGOutputMessage( j_common_ptr cinfo )
@@ -71,10 +71,17 @@ static void R_JPGOutputMessage( j_common_ptr cinfo )
 	( *cinfo->err->format_message )( cinfo, buffer );
 
 	/* Send it to stderr, adding a newline */
-	ri.Printf( PRINT_ALL, "%s\n", buffer );
+	R_DecodePrintf( PRINT_ALL, "%s\n", buffer );
 }
 
-void LoadJPG( const char *filename, unsigned char **pic, int *width, int *height, byte alphaByte )
+/*
+=================
+DecodeJPG
+
+Decodes the JPEG file contents in fbuffer, see R_DecodeAlloc
+=================
+*/
+void DecodeJPG( const char *filename, const byte *fbuffer, int len, unsigned char **pic, int *width, int *height, byte alphaByte )
 {
 	/* This struct contains the JPEG decompression parameters and pointers to
 	 * working space (which is allocated as needed by the JPEG library).
@@ -102,31 +109,12 @@ void LoadJPG( const char *filename, unsigned char **pic, int *width, int *height
 	unsigned int          pixelcount, memcount;
 	unsigned int          sindex, dindex;
 	byte                  *out;
-	int                   len;
-	union
-	{
-		byte *b;
-		void *v;
-	} fbuffer;
 
 	byte *buf;
 #if JPEG_LIB_VERSION < 80
 	FILE *jpegfd;
 #endif
 
-	/* In this example we want to open the input file before doing anything else,
-	 * so that the setjmp() error recovery below can assume the file is open.
-	 * VERY IMPORTANT: use "b" option to fopen() if you are on a machine that
-	 * requires it in order to read binary files.
-	 */
-
-	len = ri.FS_ReadFile( ( char * ) filename, &fbuffer.v );
-
-	if ( !fbuffer.b || len < 0 )
-	{
-		return;
-	}
-
 	/* Step 1: allocate and initialize JPEG decompression object */
 
 	/* We have to set up the error handler first, in case the initialization
@@ -144,10 +132,10 @@ void LoadJPG( const char *filename, unsigned char **pic, int *width, int *height
 	/* Step 2: specify data source (eg, a file) */
 
 #if JPEG_LIB_VERSION < 80
-	jpegfd = fmemopen( fbuffer.b, len, "r" );
+	jpegfd = fmemopen( ( void * ) fbuffer, len, "r" );
 	jpeg_stdio_src( &cinfo, jpegfd );
 #else
-	jpeg_mem_src( &cinfo, fbuffer.b, len );
+	jpeg_mem_src( &cinfo, ( unsigned char * ) fbuffer, len );
 #endif
 
 	/* Step 3: read file parameters with jpeg_read_header() */
@@ -191,20 +179,19 @@ void LoadJPG( const char *filename, unsigned char **pic, int *width, int *height
 	     || pixelcount > 0x1FFFFFFF || cinfo.output_components != 3 )
 	{
 		// Free the memory to make sure we don't leak memory
-		ri.FS_FreeFile( fbuffer.v );
 		jpeg_destroy_decompress( &cinfo );
 #if JPEG_LIB_VERSION < 80
 		fclose( jpegfd );
 #endif
 
-		ri.Error( ERR_DROP, "LoadJPG: %s has an invalid image format: %dx%d*4=%d, components: %d", filename,
+		R_DecodeError( ERR_DROP, "LoadJPG: %s has an invalid image format: %dx%d*4=%d, components: %d", filename,
 		          cinfo.output_width, cinfo.output_height, pixelcount * 4, cinfo.output_components );
 	}
 
 	memcount = pixelcount * 4;
 	row_stride = cinfo.output_width * cinfo.output_components;
 
-	out = (byte*) ri.Z_Malloc( memcount );
+	out = (byte*) R_DecodeAlloc( memcount );
 
 	*width = cinfo.output_width;
 	*height = cinfo.output_height;
@@ -264,7 +251,6 @@ void LoadJPG( const char *filename, unsigned char **pic, int *width, int *height
 #if JPEG_LIB_VERSION < 80
 	fclose( jpegfd );
 #endif
-	ri.FS_FreeFile( fbuffer.v );
 
 	/* At this point you may want to check to see whether any corrupt-data
 	 * warnings occurred (test whether jerr.pub.num_warnings is nonzero).
@@ -273,6 +259,11 @@ void LoadJPG( const char *filename, unsigned char **pic, int *width, int *height
 	/* And we're done! */
 }
 
+void LoadJPG( const char *filename, unsigned char **pic, int *width, int *height, byte alphaByte )
+{
+	R_DecodeImageFile( DecodeJPG, filename, pic, width, height, alphaByte );
+}
+
 /*
 =========================================================
 
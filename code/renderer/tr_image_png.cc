@@ -51,16 +51,23 @@ static void png_read_data( png_structp png, png_bytep data, png_size_t length )
 
 static void png_user_warning_fn( png_structp png_ptr, png_const_charp warning_message )
 {
-	ri.Printf( PRINT_WARNING, "libpng warning: %s\n", warning_message );
+	R_DecodePrintf( PRINT_WARNING, "libpng warning: %s\n", warning_message );
 }
 
 static void png_user_error_fn( png_structp png_ptr, png_const_charp error_message )
 {
-	ri.Printf( PRINT_ERROR, "libpng error: %s\n", error_message );
+	R_DecodePrintf( PRINT_ERROR, "libpng error: %s\n", error_message );
 	longjmp( png_jmpbuf( png_ptr ), 0 );
 }
 
-void LoadPNG( const char *name, byte **pic, int *width, int *height, byte alphaByte )
+/*
+=================
+DecodePNG
+
+Decodes the PNG file contents in data, see R_DecodeAlloc
+=================
+*/
+void DecodePNG( const char *name, const byte *data, int len, byte **pic, int *width, int *height, byte alphaByte )
 {
 	int          bit_depth;
 	int          color_type;
@@ -71,25 +78,15 @@ void LoadPNG( const char *name, byte **pic, int *width, int *height, byte alphaB
 	png_infop    info;
 	png_structp  png;
 	png_bytep    *row_pointers;
-	byte         *data;
 	byte         *out;
 //	int             size;
 
-	// load png
-	ri.FS_ReadFile( name, ( void ** ) &data );
-
-	if ( !data )
-	{
-		return;
-	}
-
 	//png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 	png = png_create_read_struct( PNG_LIBPNG_VER_STRING, ( png_voidp ) NULL, png_user_error_fn, png_user_warning_fn );
 
 	if ( !png )
 	{
-		ri.Printf( PRINT_WARNING, "LoadPNG: png_create_write_struct() failed for (%s)\n", name );
-		ri.FS_FreeFile( data );
+		R_DecodePrintf( PRINT_WARNING, "LoadPNG: png_create_write_struct() failed for (%s)\n", name );
 		return;
 	}
 
@@ -98,8 +95,7 @@ void LoadPNG( const char *name, byte **pic, int *width, int *height, byte alphaB
 
 	if ( !info )
 	{
-		ri.Printf( PRINT_WARNING, "LoadPNG: png_create_info_struct() failed for (%s)\n", name );
-		ri.FS_FreeFile( data );
+		R_DecodePrintf( PRINT_WARNING, "LoadPNG: png_create_info_struct() failed for (%s)\n", name );
 		png_destroy_read_struct( &png, ( png_infopp ) NULL, ( png_infopp ) NULL );
 		return;
 	}
@@ -112,14 +108,13 @@ void LoadPNG( const char *name, byte **pic, int *width, int *height, byte alphaB
 	if ( setjmp( png_jmpbuf( png ) ) )
 	{
 		// if we get here, we had a problem reading the file
-		ri.Printf( PRINT_WARNING, "LoadPNG: first exception handler called for (%s)\n", name );
-		ri.FS_FreeFile( data );
+		R_DecodePrintf( PRINT_WARNING, "LoadPNG: first exception handler called for (%s)\n", name );
 		png_destroy_read_struct( &png, ( png_infopp ) & info, ( png_infopp ) NULL );
 		return;
 	}
 
 	//png_set_write_fn(png, buffer, png_write_data, png_flush_data);
-	png_set_read_fn( png, data, png_read_data );
+	png_set_read_fn( png, ( png_voidp ) data, png_read_data );
 
 	png_set_sig_bytes( png, 0 );
 
@@ -174,16 +169,15 @@ void LoadPNG( const char *name, byte **pic, int *width, int *height, byte alphaB
 	// allocate the memory to hold the image
 	*width = w;
 	*height = h;
-	*pic = out = ( byte * ) ri.Z_Malloc( w * h * 4 );
+	*pic = out = ( byte * ) R_DecodeAlloc( w * h * 4 );
 
-	row_pointers = ( png_bytep * ) ri.Hunk_AllocateTempMemory( sizeof( png_bytep ) * h );
+	row_pointers = ( png_bytep * ) R_DecodeAlloc( sizeof( png_bytep ) * h );
 
 	// set a new exception handler
 	if ( setjmp( png_jmpbuf( png ) ) )
 	{
-		ri.Printf( PRINT_WARNING, "LoadPNG: second exception handler called for (%s)\n", name );
-		ri.Hunk_FreeTempMemory( row_pointers );
-		ri.FS_FreeFile( data );
+		R_DecodePrintf( PRINT_WARNING, "LoadPNG: second exception handler called for (%s)\n", name );
+		R_DecodeFree( row_pointers );
 		png_destroy_read_struct( &png, ( png_infopp ) & info, ( png_infopp ) NULL );
 		return;
 	}
@@ -204,8 +198,12 @@ void LoadPNG( const char *name, byte **pic, int *width, int *height, byte alphaB
 	// clean up after the read, and free any memory allocated
 	png_destroy_read_struct( &png, &info, ( png_infopp ) NULL );
 
-	ri.Hunk_FreeTempMemory( row_pointers );
-	ri.FS_FreeFile( data );
+	R_DecodeFree( row_pointers );
+}
+
+void LoadPNG( const char *name, byte **pic, int *width, int *height, byte alphaByte )
+{
+	R_DecodeImageFile( DecodePNG, name, pic, width, height, alphaByte );
 }
 
 /*
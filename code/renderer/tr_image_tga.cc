@@ -25,31 +25,22 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 /*
 =============
-LoadTGA
+DecodeTGA
+
+Decodes the TGA file contents in buffer, see R_DecodeAlloc
 =============
 */
-void LoadTGA( const char *name, byte **pic, int *width, int *height, byte alphaByte )
+void DecodeTGA( const char *name, const byte *buffer, int len, byte **pic, int *width, int *height, byte alphaByte )
 {
   unsigned int columns, rows, numPixels;
   byte        *pixbuf;
   int         row, column;
-  byte        *buf_p;
-  byte        *buffer;
+  const byte  *buf_p;
   TargaHeader targa_header;
   byte        *targa_rgba;
 
   *pic = NULL;
 
-  //
-  // load the file
-  //
-  ri.FS_ReadFile( ( char * ) name, ( void ** ) &buffer );
-
-  if ( !buffer )
-  {
-    return;
-  }
-
   buf_p = buffer;
 
   targa_header.id_length = *buf_p++;
@@ -74,20 +65,17 @@ void LoadTGA( const char *name, byte **pic, int *width, int *height, byte alphaB
 
   if ( targa_header.image_type != 2 && targa_header.image_type != 10 && targa_header.image_type != 3 )
   {
-    ri.FS_FreeFile( buffer );
-    ri.Error( ERR_DROP, "LoadTGA: Only type 2 (RGB), 3 (gray), and 10 (RGB) TGA images supported (%s)", name );
+    R_DecodeError( ERR_DROP, "LoadTGA: Only type 2 (RGB), 3 (gray), and 10 (RGB) TGA images supported (%s)", name );
   }
 
   if ( targa_header.colormap_type != 0 )
   {
-    ri.FS_FreeFile( buffer );
-    ri.Error( ERR_DROP, "LoadTGA: colormaps not supported (%s)", name );
+    R_DecodeError( ERR_DROP, "LoadTGA: colormaps not supported (%s)", name );
   }
 
   if ( ( targa_header.pixel_size != 32 && targa_header.pixel_size != 24 ) && targa_header.image_type != 3 )
   {
-    ri.FS_FreeFile( buffer );
-    ri.Error( ERR_DROP, "LoadTGA: Only 32 or 24 bit images supported (no colormaps) (%s)", name );
+    R_DecodeError( ERR_DROP, "LoadTGA: Only 32 or 24 bit images supported (no colormaps) (%s)", name );
   }
 
   columns = targa_header.width;
@@ -106,11 +94,10 @@ void LoadTGA( const char *name, byte **pic, int *width, int *height, byte alphaB
 
   if ( !columns || !rows || numPixels > 0x7FFFFFFF || numPixels / columns / 4 != rows )
   {
-    ri.FS_FreeFile( buffer );
-    ri.Error( ERR_DROP, "LoadTGA: %s has an invalid image size", name );
+    R_DecodeError( ERR_DROP, "LoadTGA: %s has an invalid image size", name );
   }
 
-  targa_rgba = (byte*) ri.Z_Malloc( numPixels );
+  targa_rgba = (byte*) R_DecodeAlloc( numPixels );
 
   *pic = targa_rgba;
 
@@ -164,9 +151,8 @@ void LoadTGA( const char *name, byte **pic, int *width, int *height, byte alphaB
             break;
 
           default:
-            ri.Free( targa_rgba );
-            ri.FS_FreeFile( buffer );
-            ri.Error( ERR_DROP, "LoadTGA: illegal pixel_size '%d' in file '%s'", targa_header.pixel_size, name );
+            R_DecodeFree( targa_rgba );
+            R_DecodeError( ERR_DROP, "LoadTGA: illegal pixel_size '%d' in file '%s'", targa_header.pixel_size, name );
         }
       }
     }
@@ -210,9 +196,8 @@ void LoadTGA( const char *name, byte **pic, int *width, int *height, byte alphaB
               break;
 
             default:
-              ri.Free( targa_rgba );
-              ri.FS_FreeFile( buffer );
-              ri.Error( ERR_DROP, "LoadTGA: illegal pixel_size '%d' in file '%s'", targa_header.pixel_size, name );
+              R_DecodeFree( targa_rgba );
+              R_DecodeError( ERR_DROP, "LoadTGA: illegal pixel_size '%d' in file '%s'", targa_header.pixel_size, name );
           }
 
           for ( j = 0; j < packetSize; j++ )
@@ -270,9 +255,8 @@ void LoadTGA( const char *name, byte **pic, int *width, int *height, byte alphaB
                 break;
 
               default:
-                ri.Free( targa_rgba );
-                ri.FS_FreeFile( buffer );
-                ri.Error( ERR_DROP,
+                R_DecodeFree( targa_rgba );
+                R_DecodeError( ERR_DROP,
                           "LoadTGA: illegal pixel_size '%d' in file '%s'", targa_header.pixel_size, name );
             }
 
@@ -315,7 +299,7 @@ breakOut:
 
     //ri.Printf(PRINT_WARNING, "WARNING: '%s' TGA file header declares top-down image, flipping\n", name);
 
-    flip = ( unsigned char * ) ri.Hunk_AllocateTempMemory( columns * 4 );
+    flip = ( unsigned char * ) R_DecodeAlloc( columns * 4 );
 
     for ( row = 0; row < (int)rows / 2; row++ )
     {
@@ -327,7 +311,7 @@ breakOut:
       memcpy( dst, flip, columns * 4 );
     }
 
-    ri.Hunk_FreeTempMemory( flip );
+    R_DecodeFree( flip );
   }
 
 #else
@@ -335,10 +319,18 @@ breakOut:
   // instead we just print a warning
   if ( targa_header.attributes & 0x20 )
   {
-    ri.Printf( PRINT_WARNING, "WARNING: '%s' TGA file header declares top-down image, ignoring\n", name );
+    R_DecodePrintf( PRINT_WARNING, "WARNING: '%s' TGA file header declares top-down image, ignoring\n", name );
   }
 
 #endif
+}
 
-  ri.FS_FreeFile( buffer );
+/*
+=============
+LoadTGA
+=============
+*/
+void LoadTGA( const char *name, byte **pic, int *width, int *height, byte alphaByte )
+{
+  R_DecodeImageFile( DecodeTGA, name, pic, width, height, alphaByte );
 }
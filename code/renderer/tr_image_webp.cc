@@ -31,44 +31,40 @@ LoadWEBP
 =========================================================
 */
 
-void LoadWEBP( const char *filename, unsigned char **pic, int *width, int *height, byte alphaByte )
+/*
+=================
+DecodeWEBP
+
+Decodes the WebP file contents in fbuffer, see R_DecodeAlloc
+=================
+*/
+void DecodeWEBP( const char *filename, const byte *fbuffer, int len, unsigned char **pic, int *width, int *height, byte alphaByte )
 {
 	byte *out;
-	int  len;
 	int  stride;
 	int  size;
-	union
-	{
-		byte *b;
-		void *v;
-	} fbuffer;
-
-	/* read compressed data */
-	len = ri.FS_ReadFile( ( char * ) filename, &fbuffer.v );
-
-	if ( !fbuffer.b || len < 0 )
-	{
-		return;
-	}
 
 	/* validate data and query image size */
-	if ( !WebPGetInfo( fbuffer.b, len, width, height ) )
+	if ( !WebPGetInfo( fbuffer, len, width, height ) )
 	{
-		ri.FS_FreeFile( fbuffer.v );
 		return;
 	}
 
 	stride = *width * sizeof( color4ub_t );
 	size = *height * stride;
 
-	out = (byte*) ri.Z_Malloc( size );
+	out = (byte*) R_DecodeAlloc( size );
 
-	if ( !WebPDecodeRGBAInto( fbuffer.b, len, out, size, stride ) )
+	if ( !WebPDecodeRGBAInto( fbuffer, len, out, size, stride ) )
 	{
-		ri.Free( out );
+		R_DecodeFree( out );
 		return;
 	}
 
-	ri.FS_FreeFile( fbuffer.v );
 	*pic = out;
 }
+
+void LoadWEBP( const char *filename, unsigned char **pic, int *width, int *height, byte alphaByte )
+{
+	R_DecodeImageFile( DecodeWEBP, filename, pic, width, height, alphaByte );
+}
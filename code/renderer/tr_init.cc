@@ -169,6 +169,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 	cvar_t      *r_roundImagesDown;
 	cvar_t      *r_colorMipLevels;
 	cvar_t      *r_picmip;
+	cvar_t      *r_imageJobs;
+	cvar_t      *r_imageJobWindow;
 	cvar_t      *r_finish;
 	cvar_t      *r_clear;
 	cvar_t      *r_swapInterval;
@@ -1393,6 +1395,10 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 		r_picmip = ri.Cvar_Get( "r_picmip", "0", CVAR_ARCHIVE | CVAR_LATCH );
 		AssertCvarRange( r_picmip, 0, 3, qtrue );
 		r_roundImagesDown = ri.Cvar_Get( "r_roundImagesDown", "1", CVAR_ARCHIVE | CVAR_LATCH );
+		r_imageJobs = ri.Cvar_Get( "r_imageJobs", "0", CVAR_ARCHIVE );
+		AssertCvarRange( r_imageJobs, 0, MAX_WORKER_THREADS, qtrue );
+		r_imageJobWindow = ri.Cvar_Get( "r_imageJobWindow", "32", CVAR_ARCHIVE );
+		AssertCvarRange( r_imageJobWindow, 1, 1024, qtrue );
 		r_colorMipLevels = ri.Cvar_Get( "r_colorMipLevels", "0", CVAR_LATCH );
 		r_colorbits = ri.Cvar_Get( "r_colorbits", "0", CVAR_ARCHIVE | CVAR_LATCH );
 		r_alphabits = ri.Cvar_Get( "r_alphabits", "0", CVAR_ARCHIVE | CVAR_LATCH );
@@ -1709,6 +1715,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 		ri.Cmd_AddCommand( "screenshotJPEG", R_ScreenShotJPEG_f );
 		ri.Cmd_AddCommand( "screenshotPNG", R_ScreenShotPNG_f );
 		ri.Cmd_AddCommand( "gfxinfo", GfxInfo_f );
+		ri.Cmd_AddCommand( "imageDecodeBench", R_ImageDecodeBench_f );
 //	ri.Cmd_AddCommand("generatemtr", R_GenerateMaterialFile_f);
 		ri.Cmd_AddCommand( "buildcubemaps", R_BuildCubeMaps );
 
@@ -1869,6 +1876,9 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 		ri.Cmd_RemoveCommand( "buildcubemaps" );
 
 		ri.Cmd_RemoveCommand( "glsl_restart" );
+		ri.Cmd_RemoveCommand( "imageDecodeBench" );
+
+		R_ShutdownImageJobs();
 
 		if ( tr.registered )
 		{
@@ -1947,6 +1957,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 	{
 		R_SyncRenderThread();
 
+		R_EndImageJobs();
+
 		/*
 		   if(!Sys_LowPhysicalMemory())
 		   {
@@ -2132,6 +2144,7 @@ extern "C"
 		re.SetColorGrading = RE_SetColorGrading;
 
 		re.SetAltShaderTokens = R_SetAltShaderTokens;
+		re.ImageDecodeBench = R_ImageDecodeBench;
 
 		return &re;
 	}
@@ -3084,6 +3084,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 	extern cvar_t *r_roundImagesDown;
 	extern cvar_t *r_colorMipLevels; // development aid to see texture mip usage
 	extern cvar_t *r_picmip; // controls picmip values
+	extern cvar_t *r_imageJobs; // worker threads decoding the images of a map ahead, 0 = off
+	extern cvar_t *r_imageJobWindow; // images handed to the workers at once
 	extern cvar_t *r_finish;
 	extern cvar_t *r_drawBuffer;
 	extern cvar_t *r_swapInterval;
@@ -4200,6 +4202,29 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 	void                                LoadWEBP( const char *name, byte **pic, int *width, int *height, byte alphaByte );
 
+// decoding the contents of image files, see tr_image_jobs.cc
+	typedef void ( *imageDecodeFunc_t )( const char *name, const byte *buffer, int len, byte **pic, int *width, int *height, byte alphaByte );
+
+	void                                DecodeTGA( const char *name, const byte *buffer, int len, byte **pic, int *width, int *height, byte alphaByte );
+	void                                DecodeJPG( const char *name, const byte *buffer, int len, byte **pic, int *width, int *height, byte alphaByte );
+	void                                DecodePNG( const char *name, const byte *buffer, int len, byte **pic, int *width, int *height, byte alphaByte );
+	void                                DecodeWEBP( const char *name, const byte *buffer, int len, byte **pic, int *width, int *height, byte alphaByte );
+
+	void                                *R_DecodeAlloc( size_t size );
+	void                                R_DecodeFree( void *ptr );
+	void QDECL                          R_DecodePrintf( int printLevel, const char *fmt, ... ) __attribute__ ( ( format ( printf, 2, 3 ) ) );
+	void QDECL                          R_DecodeError( int errorLevel, const char *fmt, ... ) __attribute__ ( ( format ( printf, 2, 3 ) ) );
+	void                                R_DecodeImageFile( imageDecodeFunc_t decode, const char *name, byte **pic, int *width, int *height, byte alphaByte );
+
+	imageDecodeFunc_t                   R_FindImageDecoder( const char *name );
+	void                                R_BeginImageJobs( const char *mapName );
+	void                                R_EndImageJobs( void );
+	void                                R_ShutdownImageJobs( void );
+	void                                R_RecordImageJob( const char *name, byte alphaByte );
+	qboolean                            R_TakeImageJob( const char *name, byte alphaByte, byte **pic, int *width, int *height );
+	void                                R_ImageDecodeBench( const char *assetList, int numThreads );
+	void                                R_ImageDecodeBench_f( void );
+
 // video stuff
 	const void *RB_TakeVideoFrameCmd( const void *data );
 	void       RE_TakeVideoFrame( int width, int height, byte *captureBuffer, byte *encodeBuffer, qboolean motionJpeg );
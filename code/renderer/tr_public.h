@@ -38,7 +38,7 @@ Maryland 20850 USA.
 
 #include "tr_types.h"
 
-#define REF_API_VERSION 10
+#define REF_API_VERSION 12
 
 // *INDENT-OFF*
 
@@ -189,6 +189,9 @@ typedef struct
 	void ( *ScissorSet ) ( int x, int y, int w, int h );
 
 	void ( *SetAltShaderTokens ) ( const char * );
+
+	// times decoding the images of an asset list, needs no GL context
+	void ( *ImageDecodeBench ) ( const char *assetList, int numThreads );
 } refexport_t;
 
 //
@@ -256,6 +259,11 @@ typedef struct
 	int ( *FS_Read )( void *buffer, int len, fileHandle_t f );
 	int ( *FS_FCloseFile )( fileHandle_t f );
 	int ( *FS_FOpenFileRead )( const char *qpath, fileHandle_t *file, qboolean uniqueFILE );
+	int ( *FS_FileExtensions )( const char *name, const char **exts, int numExts );
+
+	// worker threads, the work items must not call back into the engine
+	void ( *StartJobs )( int numThreads, int workcnt, void ( *func )( int work, int threadnum ) );
+	void ( *WaitJobs )( void );
 
 	// cinematic stuff
 	void ( *CIN_UploadCinematic )( int handle );
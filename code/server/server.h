@@ -51,17 +51,29 @@ typedef struct voipServerPacket_s
 } voipServerPacket_t;
 #endif
 
+// links an entity into the per-cluster lists used for snapshot building
+typedef struct svClusterLink_s
+{
+	struct svEntity_s *ent;
+	int cluster;                                         // -1 for the overflow list
+	struct svClusterLink_s *prev, *next;
+} svClusterLink_t;
+
 typedef struct svEntity_s
 {
 	struct worldSector_s *worldSector;
 	struct svEntity_s *nextEntityInWorldSector;
+	struct svEntity_s *prevEntityInWorldSector;
+
+	svClusterLink_t clusterLinks[MAX_ENT_CLUSTERS];      // one per distinct cluster in clusternums
+	int numClusterLinks;
+	svClusterLink_t overflowLink;                        // on the overflow list if lastCluster is set
 
 	entityState_t baseline;                              // for delta compression of initial sighting
 	int numClusters;                                     // if -1, use headnode instead
 	int clusternums[MAX_ENT_CLUSTERS];
 	int lastCluster;                                     // if all the clusters don't fit in clusternums
 	int areanum, areanum2;
-	int snapshotCounter;                                 // used to prevent double adding from portal views
 } svEntity_t;
 
 typedef enum
@@ -81,7 +93,6 @@ typedef struct
 	// https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=475
 	// the serverId associated with the current checksumFeed (always <= serverId)
 	int checksumFeedServerId;
-	int snapshotCounter;                                 // incremented for each snapshot built
 	int timeResidual;                                    // <= 1000 / sv_frame->value
 	int nextFrameTime;                                   // when time > nextFrameTime, process world
 	struct cmodel_s *models[MAX_MODELS];
@@ -160,16 +171,19 @@ typedef struct client_s
 
 	// downloading
 	char downloadName[MAX_QPATH];                        // if not empty string, we are downloading
-	fileHandle_t download;                               // file being downloaded
+	struct downloadFile_s *download;                     // shared mapping of the file being downloaded
 	int downloadSize;                                    // total bytes (can't use EOF because of paks)
 	int downloadCount;                                   // bytes sent
 	int downloadClientBlock;                             // last block we sent to the client, awaiting ack
 	int downloadCurrentBlock;                            // current block number
 	int downloadXmitBlock;                               // last block we xmited
-	unsigned char *downloadBlocks[MAX_DOWNLOAD_WINDOW];  // the buffers for the download blocks
 	int downloadBlockSize[MAX_DOWNLOAD_WINDOW];
+	int downloadBlockTime[MAX_DOWNLOAD_WINDOW];          // Sys_Milliseconds a block went out, -1 until sent, 0 once resent
 	qboolean downloadEOF;                                // We have sent the EOF block
 	int downloadSendTime;                                // time we last got an ack from the client
+	int downloadRtt;                                     // smoothed block round trip in msec * 8, 0 until measured
+	int downloadRttVar;                                  // mean deviation of the round trip in msec * 4
+	int downloadNextSend;                                // Sys_Milliseconds the next block is paced for
 
 	int deltaMessage;                                    // frame last client usercmd message
 	int nextReliableTime;                                // svs.time when another reliable command will be allowed
@@ -306,6 +320,10 @@ extern cvar_t *sv_lanForceRate;
 extern cvar_t *sv_strictAuth;
 #endif
 extern	cvar_t	*sv_banFile;
+extern cvar_t *sv_snapshotStats;
+extern cvar_t *sv_snapshotThreads;
+extern cvar_t *sv_deltaCache;
+extern cvar_t *sv_traceCache;
 
 extern serverBan_t serverBans[SERVER_MAXBANS];
 extern int serverBansCount;
@@ -331,6 +349,10 @@ void SV_RemoveOperatorCommands(void);
 void SV_MasterShutdown(void);
 int SV_RateMsec(client_t *client);
 
+void SV_ClientHashLink(client_t *cl);
+void SV_ClientHashUnlink(client_t *cl);
+void SV_ClientHashRebuild(void);
+
 
 
 //
@@ -390,6 +412,26 @@ void SV_SendMessageToClient(msg_t *msg, client_t *client);
 void SV_SendClientMessages(void);
 void SV_SendClientSnapshot(client_t *client);
 
+// nanoseconds spent in the stages of snapshot sending, see snapshotBench
+typedef struct
+{
+	int snapshots;
+	int64_t bytes;
+	int64_t build;          // SV_BuildClientSnapshot
+	int64_t playerstate;    // MSG_WriteDeltaPlayerstate
+	int64_t entities;       // SV_EmitPacketEntities
+	int64_t total;          // building and writing the whole message
+} snapshotProfile_t;
+
+void SV_BenchmarkClientSnapshots(int numClients, snapshotProfile_t *profile);
+
+//
+// sv_bench.c
+//
+void SV_SnapshotBench_f(void);
+void SV_TraceBench_f(void);
+void SV_RouteBench_f(void);
+
 //
 // sv_game.c
 //
@@ -444,6 +486,15 @@ clipHandle_t SV_ClipHandleForEntity(const sharedEntity_t *ent);
 
 
 void SV_SectorList_f(void);
+void SV_TraceStats_f(void);
+
+
+svClusterLink_t *SV_ClusterEntities(int cluster);
+// returns the first link of the entities touching the given PVS cluster
+
+svClusterLink_t *SV_OverflowEntities(void);
+// returns the entities that touch more clusters than fit in clusternums[],
+// these have to be tested against the PVS individually
 
 
 int SV_AreaEntities(const vec3_t mins, const vec3_t maxs, int *entityList, int maxcount);
@@ -462,6 +513,9 @@ int SV_PointContents(const vec3_t p, int passEntityNum);
 void SV_Trace(trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int capsule);
 // mins and maxs are relative
 
+void SV_TraceBatch(trace_t *results, int numTraces, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t *ends, int passEntityNum, int contentmask);
+// SV_Trace with TT_AABB from start to each of the ends, the world is traced for all of them at once
+
 // if the entire move stays in a solid volume, trace.allsolid will be set,
 // trace.startsolid will be set, and trace.fraction will be 0
 
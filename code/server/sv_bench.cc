@@ -0,0 +1,1098 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+Copyright (C) 2006-xyyz Lars '0xA5EA' Kandler
+
+This file is part of KingpinQ3 source code.
+
+KingpinQ3 source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+KingpinQ3 source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with KingpinQ3 source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// sv_bench.cc -- snapshotBench, replays the entities of a client demo to synthetic clients
+//                traceBench, synthetic bots tracing through the world entities
+//                routeBench, replays the route queries of the bots on routing caches of different sizes
+
+#include "server.h"
+#include "../botlib/botlib.h"
+#include "../botlib/be_aas.h"
+
+/*
+===============================================================================
+
+The benchmark loads the collision map the demo was recorded on, decodes
+the snapshots of the demo the same way cl_parse does, and for every
+snapshot links its entities into a world without a game module.  The
+synthetic clients look at it from the positions of the players in the
+snapshot and go through the snapshot pipeline of SV_SendClientMessages,
+minus the netchan.
+
+Everything lives on the hunk and in sv / svs, so it only runs while no
+server is.
+
+===============================================================================
+*/
+
+extern cvar_t *cl_shownet;
+
+#define BENCH_PARSE_ENTITIES 8192   // power of two, room for two full frames and then some
+
+typedef struct
+{
+	qboolean valid;
+	int messageNum;
+	int serverTime;
+	int parseEntitiesNum;           // first entity in parseEntities
+	int numEntities;
+	playerState_t ps;
+} benchSnapshot_t;
+
+typedef struct
+{
+	fileHandle_t file;
+	int messageNum;                 // of the last message read
+	entityState_t baselines[MAX_GENTITIES];
+	entityState_t parseEntities[BENCH_PARSE_ENTITIES];
+	int parseEntitiesNum;
+	benchSnapshot_t snapshots[PACKET_BACKUP];
+	benchSnapshot_t snap;           // latest valid snapshot
+} benchDemo_t;
+
+/*
+==================
+SV_BenchDeltaEntity
+==================
+*/
+static void SV_BenchDeltaEntity(benchDemo_t *demo, msg_t *msg, benchSnapshot_t *frame, int newnum, entityState_t *old, qboolean unchanged)
+{
+	entityState_t *state;
+
+	state = &demo->parseEntities[demo->parseEntitiesNum & (BENCH_PARSE_ENTITIES - 1)];
+
+	if(unchanged)
+	{
+		*state = *old;
+	}
+	else
+	{
+		MSG_ReadDeltaEntity(msg, old, state, newnum);
+	}
+
+	if(state->number == (MAX_GENTITIES - 1))
+	{
+		return;     // entity was delta removed
+	}
+
+	demo->parseEntitiesNum++;
+	frame->numEntities++;
+}
+
+/*
+==================
+SV_BenchNextOldEntity
+==================
+*/
+static int SV_BenchNextOldEntity(benchDemo_t *demo, benchSnapshot_t *oldframe, int oldindex, entityState_t **oldstate)
+{
+	if(!oldframe || oldindex >= oldframe->numEntities)
+	{
+		return 99999;
+	}
+
+	*oldstate = &demo->parseEntities[(oldframe->parseEntitiesNum + oldindex) & (BENCH_PARSE_ENTITIES - 1)];
+	return (*oldstate)->number;
+}
+
+/*
+==================
+SV_BenchParsePacketEntities
+
+CL_ParsePacketEntities for the benchmark demo
+==================
+*/
+static void SV_BenchParsePacketEntities(benchDemo_t *demo, msg_t *msg, benchSnapshot_t *oldframe, benchSnapshot_t *newframe)
+{
+	entityState_t *oldstate;
+	int oldindex, oldnum, newnum;
+
+	newframe->parseEntitiesNum = demo->parseEntitiesNum;
+	newframe->numEntities      = 0;
+
+	// delta from the entities present in oldframe
+	oldindex = 0;
+	oldstate = NULL;
+	oldnum   = SV_BenchNextOldEntity(demo, oldframe, oldindex, &oldstate);
+
+	while(1)
+	{
+		// read the entity index number
+		newnum = MSG_ReadBits(msg, GENTITYNUM_BITS);
+
+		if(newnum == (MAX_GENTITIES - 1) || msg->readcount > msg->cursize)
+		{
+			break;
+		}
+
+		while(oldnum < newnum)
+		{
+			// one or more entities from the old packet are unchanged
+			SV_BenchDeltaEntity(demo, msg, newframe, oldnum, oldstate, qtrue);
+			oldnum = SV_BenchNextOldEntity(demo, oldframe, ++oldindex, &oldstate);
+		}
+
+		if(oldnum == newnum)
+		{
+			// delta from previous state
+			SV_BenchDeltaEntity(demo, msg, newframe, newnum, oldstate, qfalse);
+			oldnum = SV_BenchNextOldEntity(demo, oldframe, ++oldindex, &oldstate);
+			continue;
+		}
+
+		// delta from baseline
+		SV_BenchDeltaEntity(demo, msg, newframe, newnum, &demo->baselines[newnum], qfalse);
+	}
+
+	// any remaining entities in the old frame are copied over
+	while(oldnum != 99999)
+	{
+		SV_BenchDeltaEntity(demo, msg, newframe, oldnum, oldstate, qtrue);
+		oldnum = SV_BenchNextOldEntity(demo, oldframe, ++oldindex, &oldstate);
+	}
+}
+
+/*
+==================
+SV_BenchParseSnapshot
+
+CL_ParseSnapshot for the benchmark demo, returns qtrue if demo->snap is a
+new valid snapshot
+==================
+*/
+static qboolean SV_BenchParseSnapshot(benchDemo_t *demo, msg_t *msg)
+{
+	benchSnapshot_t newSnap;
+	benchSnapshot_t *old;
+	byte areamask[MAX_MAP_AREA_BYTES];
+	int deltaNum, len, oldMessageNum;
+
+	Com_Memset(&newSnap, 0, sizeof(newSnap));
+
+	newSnap.serverTime = MSG_ReadLong(msg);
+	newSnap.messageNum = demo->messageNum;
+
+	deltaNum = MSG_ReadByte(msg);
+	MSG_ReadByte(msg);      // snapFlags
+
+	old = NULL;
+	if(!deltaNum)
+	{
+		newSnap.valid = qtrue;
+	}
+	else
+	{
+		old = &demo->snapshots[(newSnap.messageNum - deltaNum) & PACKET_MASK];
+		if(old->valid && old->messageNum == newSnap.messageNum - deltaNum &&
+		   demo->parseEntitiesNum - old->parseEntitiesNum <= BENCH_PARSE_ENTITIES / 2)
+		{
+			newSnap.valid = qtrue;
+		}
+	}
+
+	len = MSG_ReadByte(msg);
+	if(len > (int)sizeof(areamask))
+	{
+		return qfalse;
+	}
+	MSG_ReadData(msg, areamask, len);
+
+	MSG_ReadDeltaPlayerstate(msg, old ? &old->ps : NULL, &newSnap.ps);
+	SV_BenchParsePacketEntities(demo, msg, old, &newSnap);
+
+	if(!newSnap.valid)
+	{
+		return qfalse;
+	}
+
+	// don't let dropped messages look like something valid to delta from
+	oldMessageNum = demo->snap.messageNum + 1;
+	if(newSnap.messageNum - oldMessageNum >= PACKET_BACKUP)
+	{
+		oldMessageNum = newSnap.messageNum - (PACKET_BACKUP - 1);
+	}
+	for(; oldMessageNum < newSnap.messageNum; oldMessageNum++)
+	{
+		demo->snapshots[oldMessageNum & PACKET_MASK].valid = qfalse;
+	}
+
+	demo->snap = newSnap;
+	demo->snapshots[newSnap.messageNum & PACKET_MASK] = newSnap;
+
+	return qtrue;
+}
+
+/*
+==================
+SV_BenchParseGamestate
+
+Only the baselines are of interest, they go to sv.svEntities like
+SV_CreateBaseline would have put them
+==================
+*/
+static void SV_BenchParseGamestate(benchDemo_t *demo, msg_t *msg)
+{
+	entityState_t nullstate;
+	int cmd, newnum;
+
+	MSG_ReadLong(msg);      // serverCommandSequence
+
+	while(msg->readcount <= msg->cursize)
+	{
+		cmd = MSG_ReadByte(msg);
+
+		if(cmd == svc_EOF)
+		{
+			break;
+		}
+
+		if(cmd == svc_configstring)
+		{
+			MSG_ReadShort(msg);
+			MSG_ReadBigString(msg);
+		}
+		else if(cmd == svc_baseline)
+		{
+			newnum = MSG_ReadBits(msg, GENTITYNUM_BITS);
+			if(newnum < 0 || newnum >= MAX_GENTITIES)
+			{
+				break;
+			}
+			Com_Memset(&nullstate, 0, sizeof(nullstate));
+			MSG_ReadDeltaEntity(msg, &nullstate, &demo->baselines[newnum], newnum);
+			sv.svEntities[newnum].baseline = demo->baselines[newnum];
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	MSG_ReadLong(msg);      // clientNum
+	MSG_ReadLong(msg);      // checksumFeed
+}
+
+/*
+==================
+SV_BenchReadSnapshot
+
+Reads demo messages until one of them holds a valid snapshot, returns
+qfalse at the end of the demo
+==================
+*/
+static qboolean SV_BenchReadSnapshot(benchDemo_t *demo)
+{
+	static byte bufData[MAX_MSGLEN];
+	msg_t msg;
+	qboolean parsed;
+	int cmd, seq, len;
+
+	while(1)
+	{
+		if(FS_Read(&seq, 4, demo->file) != 4 || FS_Read(&len, 4, demo->file) != 4)
+		{
+			return qfalse;
+		}
+
+		demo->messageNum = LittleLong(seq);
+		len              = LittleLong(len);
+
+		if(len < 0 || len > (int)sizeof(bufData))
+		{
+			return qfalse;
+		}
+
+		MSG_Init(&msg, bufData, sizeof(bufData));
+		if(FS_Read(msg.data, len, demo->file) != len)
+		{
+			return qfalse;
+		}
+		msg.cursize = len;
+
+		MSG_Bitstream(&msg);
+		MSG_ReadLong(&msg);     // reliableAcknowledge
+
+		parsed = qfalse;
+		while(msg.readcount <= msg.cursize)
+		{
+			cmd = MSG_ReadByte(&msg);
+
+			if(cmd == svc_nop)
+			{
+				continue;
+			}
+			if(cmd == svc_serverCommand)
+			{
+				MSG_ReadLong(&msg);
+				MSG_ReadString(&msg);
+				continue;
+			}
+			if(cmd == svc_gamestate)
+			{
+				SV_BenchParseGamestate(demo, &msg);
+				continue;
+			}
+			if(cmd == svc_snapshot)
+			{
+				parsed = SV_BenchParseSnapshot(demo, &msg);
+				continue;
+			}
+
+			// svc_EOF, and downloads or voip nothing here cares about
+			break;
+		}
+
+		if(parsed)
+		{
+			return qtrue;
+		}
+	}
+}
+
+/*
+==================
+SV_BenchLinkSnapshot
+
+Puts the entities of the snapshot into the world, the way the game would
+have linked them
+==================
+*/
+static void SV_BenchLinkSnapshot(benchSnapshot_t *snap, benchDemo_t *demo)
+{
+	sharedEntity_t *ent;
+	entityState_t *state;
+	clipHandle_t h;
+	int i, solid;
+
+	for(i = 0; i < sv.num_entities; i++)
+	{
+		ent = SV_GentityNum(i);
+		if(ent->r.linked)
+		{
+			SV_UnlinkEntity(ent);
+		}
+	}
+
+	sv.num_entities = 0;
+
+	for(i = 0; i < snap->numEntities; i++)
+	{
+		state = &demo->parseEntities[(snap->parseEntitiesNum + i) & (BENCH_PARSE_ENTITIES - 1)];
+		ent   = SV_GentityNum(state->number);
+
+		Com_Memset(&ent->r, 0, sizeof(ent->r));
+		ent->s = *state;
+
+		VectorCopy(state->pos.trBase, ent->r.currentOrigin);
+		VectorCopy(state->apos.trBase, ent->r.currentAngles);
+
+		solid = state->solid;
+		if(solid == SOLID_BMODEL)
+		{
+			ent->r.bmodel   = qtrue;
+			ent->r.contents = CONTENTS_SOLID;
+			if(state->modelindex > 0 && state->modelindex < CM_NumInlineModels())
+			{
+				h = CM_InlineModel(state->modelindex);
+				CM_ModelBounds(h, ent->r.mins, ent->r.maxs);
+			}
+		}
+		else if(solid)
+		{
+			// decode the packed box of SV_LinkEntity
+			ent->r.contents = CONTENTS_BODY;
+			ent->r.mins[0]  = ent->r.mins[1] = -(solid & 255);
+			ent->r.maxs[0]  = ent->r.maxs[1] = solid & 255;
+			ent->r.mins[2]  = -((solid >> 8) & 255);
+			ent->r.maxs[2]  = ((solid >> 16) & 255) - 32;
+		}
+
+		SV_LinkEntity(ent);
+
+		// SV_LinkEntity recomputes solid, keep the recorded state
+		ent->s = *state;
+
+		if(state->number >= sv.num_entities)
+		{
+			sv.num_entities = state->number + 1;
+		}
+	}
+}
+
+/*
+==================
+SV_BenchPlacePlayers
+
+Gives every synthetic client the recorded playerstate, seen from the
+position of one of the players in the snapshot or the recorder
+==================
+*/
+static void SV_BenchPlacePlayers(benchSnapshot_t *snap, int numClients)
+{
+	int players[MAX_CLIENTS];
+	int i, numPlayers;
+	playerState_t *ps;
+	sharedEntity_t *ent;
+
+	numPlayers = 0;
+	for(i = 0; i < sv.num_entities && i < MAX_CLIENTS; i++)
+	{
+		if(SV_GentityNum(i)->r.linked)
+		{
+			players[numPlayers++] = i;
+		}
+	}
+
+	for(i = 0; i < numClients; i++)
+	{
+		ps  = SV_GameClientNum(i);
+		*ps = snap->ps;
+
+		ps->clientNum = i;
+
+		if(i % (numPlayers + 1) < numPlayers)
+		{
+			ent = SV_GentityNum(players[i % (numPlayers + 1)]);
+			VectorCopy(ent->r.currentOrigin, ps->origin);
+		}
+	}
+}
+
+/*
+==================
+SV_SnapshotBench_f
+
+snapshotBench <map> <demo> [clients] [snapshots]
+==================
+*/
+void SV_SnapshotBench_f(void)
+{
+	benchDemo_t *demo;
+	snapshotProfile_t profile;
+	client_t *cl;
+	int numClients, maxSnapshots, numSnapshots, checksum, i;
+	int64_t start;
+
+	if(Cmd_Argc() < 3)
+	{
+		Com_Printf("Usage: snapshotBench <map> <demo> [clients] [snapshots]\n");
+		return;
+	}
+
+	// Hunk_Clear would take the ui and cgame with it
+	if(!com_dedicated->integer)
+	{
+		Com_Printf("snapshotBench: only available on a dedicated server\n");
+		return;
+	}
+
+	if(com_sv_running->integer)
+	{
+		Com_Printf("snapshotBench: can't run while a server is running\n");
+		return;
+	}
+
+	// the reading side of msg.cc logs through the client's cl_shownet,
+	// which a dedicated server never registers
+	if(!cl_shownet)
+	{
+		cl_shownet = Cvar_Get("cl_shownet", "0", CVAR_TEMP);
+	}
+
+	numClients   = Cmd_Argc() > 3 ? atoi(Cmd_Argv(3)) : 16;
+	maxSnapshots = Cmd_Argc() > 4 ? atoi(Cmd_Argv(4)) : 0;
+	numClients   = Com_Clamp(1, MAX_CLIENTS, numClients);
+
+	Hunk_Clear();
+	CM_ClearMap();
+	Com_Memset(&sv, 0, sizeof(sv));
+	Com_Memset(&svs, 0, sizeof(svs));
+
+	demo = (benchDemo_t *)Hunk_Alloc(sizeof(*demo), h_high);
+	FS_FOpenFileRead(Cmd_Argv(2), &demo->file, qtrue);
+	if(!demo->file)
+	{
+		Com_Printf("snapshotBench: couldn't open %s\n", Cmd_Argv(2));
+		Hunk_Clear();
+		return;
+	}
+
+	CM_LoadMap(va("maps/%s.bsp", Cmd_Argv(1)), qfalse, &checksum);
+	SV_ClearWorld();
+
+	// a world and clients without a game module
+	sv.gentities     = (sharedEntity_t *)Hunk_Alloc(sizeof(sharedEntity_t) * MAX_GENTITIES, h_high);
+	sv.gentitySize   = sizeof(sharedEntity_t);
+	sv.gameClients   = (playerState_t *)Hunk_Alloc(sizeof(playerState_t) * numClients, h_high);
+	sv.gameClientSize = sizeof(playerState_t);
+	sv.state         = SS_GAME;
+
+	svs.clients              = (client_t *)Hunk_Alloc(sizeof(client_t) * numClients, h_high);
+	svs.numSnapshotEntities  = numClients * PACKET_BACKUP * 64;
+	svs.snapshotEntities     = (entityState_t *)Hunk_Alloc(sizeof(entityState_t) * svs.numSnapshotEntities, h_high);
+
+	for(i = 0; i < numClients; i++)
+	{
+		cl          = &svs.clients[i];
+		cl->state   = CS_ACTIVE;
+		cl->gentity = SV_GentityNum(i);
+		cl->netchan.outgoingSequence = 1;
+		Com_sprintf(cl->name, sizeof(cl->name), "bench%i", i);
+	}
+
+	Com_Memset(&profile, 0, sizeof(profile));
+	numSnapshots = 0;
+	start        = Sys_Nanoseconds();
+
+	while((!maxSnapshots || numSnapshots < maxSnapshots) && SV_BenchReadSnapshot(demo))
+	{
+		SV_BenchLinkSnapshot(&demo->snap, demo);
+		SV_BenchPlacePlayers(&demo->snap, numClients);
+
+		sv.time  = demo->snap.serverTime;
+		svs.time = demo->snap.serverTime;
+
+		SV_BenchmarkClientSnapshots(numClients, &profile);
+		numSnapshots++;
+	}
+
+	FS_FCloseFile(demo->file);
+
+	if(!profile.snapshots)
+	{
+		Com_Printf("snapshotBench: no snapshots in %s\n", Cmd_Argv(2));
+	}
+	else
+	{
+		Com_Printf("%i demo snapshots, %i clients, %i client snapshots in %.1f msec (with demo parsing)\n",
+		           numSnapshots, numClients, profile.snapshots, (Sys_Nanoseconds() - start) / 1e6);
+		Com_Printf("%9.0f ns per client snapshot, %.1f bytes per snapshot\n",
+		           (double)profile.total / profile.snapshots, (double)profile.bytes / profile.snapshots);
+		Com_Printf("%9.0f ns SV_BuildClientSnapshot\n", (double)profile.build / profile.snapshots);
+		Com_Printf("%9.0f ns MSG_WriteDeltaPlayerstate\n", (double)profile.playerstate / profile.snapshots);
+		Com_Printf("%9.0f ns SV_EmitPacketEntities (MSG_WriteDeltaEntity, sv_deltaCache %i)\n",
+		           (double)profile.entities / profile.snapshots, sv_deltaCache->integer);
+		Com_Printf("%9.0f ns header and server commands\n",
+		           (double)(profile.total - profile.build - profile.playerstate - profile.entities) / profile.snapshots);
+	}
+
+	// leave nothing behind for the next map load
+	Hunk_Clear();
+	CM_ClearMap();
+	Com_Memset(&sv, 0, sizeof(sv));
+	Com_Memset(&svs, 0, sizeof(svs));
+}
+
+/*
+===============================================================================
+
+traceBench
+
+Runs the entity side of a bot match without a game module: players walk
+around the map clipped by SV_Trace, fire missiles, check their line of
+sight to other players and touch the triggers around them, so the time
+goes into SV_LinkEntity, SV_Trace and SV_AreaEntities the same way it does
+with a server full of bots.
+
+Every few frames each player also fires a burst of shotgun pellets, traced
+once with SV_TraceBatch and once ray by ray with SV_Trace to time both and
+to check that they agree.
+
+===============================================================================
+*/
+
+#define BENCH_LOS_TRACES 4          // line of sight checks per player and frame
+#define BENCH_PLAYER_SPEED 320
+#define BENCH_MISSILE_SPEED 900
+#define BENCH_BURST_TRACES 16       // pellets per burst
+#define BENCH_BURST_FRAMES 4        // frames between the bursts of a player
+
+typedef enum
+{
+	BE_PLAYER,
+	BE_MISSILE,
+	BE_ITEM,
+	BE_MOVER
+} benchEntityType_t;
+
+typedef struct
+{
+	int64_t link, trace, area;      // ns spent in each
+	int links, traces, areas;
+	int64_t areaEntities;           // entities returned by SV_AreaEntities
+	int64_t burstBatch, burstSingle; // ns spent tracing bursts with SV_TraceBatch and SV_Trace
+	int64_t worldBatch, worldSingle; // the world part alone, CM_BoxTraceBatch and CM_BoxTrace
+	int bursts, burstMismatches;
+} traceProfile_t;
+
+/*
+==================
+SV_BenchRandomPoint
+==================
+*/
+static void SV_BenchRandomPoint(int *seed, const vec3_t mins, const vec3_t maxs, vec3_t point)
+{
+	int i;
+
+	for(i = 0; i < 3; i++)
+	{
+		point[i] = mins[i] + Q_random(seed) * (maxs[i] - mins[i]);
+	}
+}
+
+/*
+==================
+SV_BenchLinkEntity
+==================
+*/
+static void SV_BenchLinkEntity(sharedEntity_t *ent, traceProfile_t *profile)
+{
+	int64_t start;
+
+	start = Sys_Nanoseconds();
+	SV_LinkEntity(ent);
+	profile->link += Sys_Nanoseconds() - start;
+	profile->links++;
+}
+
+/*
+==================
+SV_BenchTrace
+==================
+*/
+static void SV_BenchTrace(trace_t *tr, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, traceProfile_t *profile)
+{
+	int64_t t;
+
+	t = Sys_Nanoseconds();
+	SV_Trace(tr, start, mins, maxs, end, passEntityNum, contentmask, TT_AABB);
+	profile->trace += Sys_Nanoseconds() - t;
+	profile->traces++;
+}
+
+/*
+==================
+SV_BenchBurst
+
+Fires a shotgun burst from eye, spread like Bullet_Fire does it, and traces
+it batched and one ray at a time, through the world alone and with the
+entities.  Every other burst uses a small box instead of points, and the
+order of the two alternates so neither always finds the caches warmed up
+by the other.
+==================
+*/
+static void SV_BenchBurst(const vec3_t eye, int passEntityNum, int *seed, traceProfile_t *profile)
+{
+	static vec3_t boxMins = {-4, -4, -4};
+	static vec3_t boxMaxs = {4, 4, 4};
+	trace_t batched[BENCH_BURST_TRACES], single[BENCH_BURST_TRACES];
+	trace_t worldBatched[BENCH_BURST_TRACES], worldSingle[BENCH_BURST_TRACES];
+	vec3_t starts[BENCH_BURST_TRACES], ends[BENCH_BURST_TRACES], forward, right, up, angles;
+	float *mins, *maxs;
+	float r, u;
+	int64_t t;
+	int i, pass;
+
+	VectorSet(angles, Q_crandom(seed) * 30, Q_random(seed) * 360, 0);
+	AngleVectors(angles, forward, right, up);
+
+	for(i = 0; i < BENCH_BURST_TRACES; i++)
+	{
+		r = Q_random(seed) * M_PI * 2.0f;
+		u = sin(r) * Q_crandom(seed) * DEFAULT_SHOTGUN_SPREAD * 16;
+		r = cos(r) * Q_crandom(seed) * DEFAULT_SHOTGUN_SPREAD * 16;
+
+		VectorCopy(eye, starts[i]);
+		VectorMA(eye, 8192 * 16, forward, ends[i]);
+		VectorMA(ends[i], r, right, ends[i]);
+		VectorMA(ends[i], u, up, ends[i]);
+	}
+
+	mins = (profile->bursts & 1) ? boxMins : vec3_origin;
+	maxs = (profile->bursts & 1) ? boxMaxs : vec3_origin;
+
+	for(pass = 0; pass < 2; pass++)
+	{
+		if(pass == ((profile->bursts >> 1) & 1))
+		{
+			t = Sys_Nanoseconds();
+			CM_BoxTraceBatch(worldBatched, BENCH_BURST_TRACES, (const vec3_t *)starts, (const vec3_t *)ends, mins, maxs, 0, MASK_SHOT);
+			profile->worldBatch += Sys_Nanoseconds() - t;
+
+			t = Sys_Nanoseconds();
+			SV_TraceBatch(batched, BENCH_BURST_TRACES, eye, mins, maxs, (const vec3_t *)ends, passEntityNum, MASK_SHOT);
+			profile->burstBatch += Sys_Nanoseconds() - t;
+		}
+		else
+		{
+			t = Sys_Nanoseconds();
+			for(i = 0; i < BENCH_BURST_TRACES; i++)
+			{
+				CM_BoxTrace(&worldSingle[i], eye, ends[i], mins, maxs, 0, MASK_SHOT, TT_AABB);
+			}
+			profile->worldSingle += Sys_Nanoseconds() - t;
+
+			t = Sys_Nanoseconds();
+			for(i = 0; i < BENCH_BURST_TRACES; i++)
+			{
+				SV_Trace(&single[i], eye, mins, maxs, ends[i], passEntityNum, MASK_SHOT, TT_AABB);
+			}
+			profile->burstSingle += Sys_Nanoseconds() - t;
+		}
+	}
+
+	for(i = 0; i < BENCH_BURST_TRACES; i++)
+	{
+		if(memcmp(&batched[i], &single[i], sizeof(trace_t)) || memcmp(&worldBatched[i], &worldSingle[i], sizeof(trace_t)))
+		{
+			profile->burstMismatches++;
+		}
+	}
+
+	profile->bursts++;
+}
+
+/*
+==================
+SV_BenchSpawnEntity
+==================
+*/
+static void SV_BenchSpawnEntity(sharedEntity_t *ent, benchEntityType_t type, int *seed, const vec3_t worldMins, const vec3_t worldMaxs, traceProfile_t *profile)
+{
+	int owner = ent->r.ownerNum;
+
+	Com_Memset(&ent->r, 0, sizeof(ent->r));
+	ent->r.ownerNum = owner;
+
+	SV_BenchRandomPoint(seed, worldMins, worldMaxs, ent->r.currentOrigin);
+
+	switch(type)
+	{
+		case BE_PLAYER:
+			VectorSet(ent->r.mins, -16, -16, -24);
+			VectorSet(ent->r.maxs, 16, 16, 32);
+			ent->r.contents = CONTENTS_BODY;
+			break;
+		case BE_MISSILE:
+			VectorSet(ent->r.mins, -2, -2, -2);
+			VectorSet(ent->r.maxs, 2, 2, 2);
+			break;
+		case BE_ITEM:
+			VectorSet(ent->r.mins, -15, -15, -15);
+			VectorSet(ent->r.maxs, 15, 15, 15);
+			ent->r.contents = CONTENTS_TRIGGER;
+			break;
+		case BE_MOVER:
+			ent->r.bmodel   = qtrue;
+			ent->r.contents = CONTENTS_SOLID;
+			ent->s.modelindex = 1;
+			VectorClear(ent->r.currentOrigin);
+			CM_ModelBounds(CM_InlineModel(1), ent->r.mins, ent->r.maxs);
+			break;
+	}
+
+	SV_BenchLinkEntity(ent, profile);
+}
+
+/*
+==================
+SV_TraceBench_f
+
+traceBench <map> [players] [items] [frames]
+==================
+*/
+void SV_TraceBench_f(void)
+{
+	static benchEntityType_t types[MAX_GENTITIES];
+	static vec3_t velocities[MAX_GENTITIES];
+	traceProfile_t profile;
+	sharedEntity_t *ent, *other;
+	trace_t tr;
+	vec3_t worldMins, worldMaxs, end, eye, mins, maxs;
+	int touch[MAX_GENTITIES];
+	int numPlayers, numItems, numEntities, numFrames, frame, checksum, seed, i, j, num;
+	float frametime;
+	int64_t start, t;
+
+	if(Cmd_Argc() < 2)
+	{
+		Com_Printf("Usage: traceBench <map> [players] [items] [frames]\n");
+		return;
+	}
+
+	if(!com_dedicated->integer)
+	{
+		Com_Printf("traceBench: only available on a dedicated server\n");
+		return;
+	}
+
+	if(com_sv_running->integer)
+	{
+		Com_Printf("traceBench: can't run while a server is running\n");
+		return;
+	}
+
+	numPlayers = Cmd_Argc() > 2 ? atoi(Cmd_Argv(2)) : 32;
+	numItems   = Cmd_Argc() > 3 ? atoi(Cmd_Argv(3)) : 256;
+	numFrames  = Cmd_Argc() > 4 ? atoi(Cmd_Argv(4)) : 1000;
+	numPlayers = Com_Clamp(1, MAX_CLIENTS, numPlayers);
+	numItems   = Com_Clamp(0, ENTITYNUM_MAX_NORMAL - numPlayers * 3 - 1, numItems);
+
+	Hunk_Clear();
+	CM_ClearMap();
+	Com_Memset(&sv, 0, sizeof(sv));
+	Com_Memset(&svs, 0, sizeof(svs));
+
+	CM_LoadMap(va("maps/%s.bsp", Cmd_Argv(1)), qfalse, &checksum);
+	SV_ClearWorld();
+
+	sv.gentities   = (sharedEntity_t *)Hunk_Alloc(sizeof(sharedEntity_t) * MAX_GENTITIES, h_high);
+	sv.gentitySize = sizeof(sharedEntity_t);
+	sv.state       = SS_GAME;
+
+	// keep the spawn points off the walls
+	CM_ModelBounds(CM_InlineModel(0), worldMins, worldMaxs);
+	for(i = 0; i < 3; i++)
+	{
+		worldMins[i] += 64;
+		worldMaxs[i] -= 64;
+	}
+
+	// players, two missiles in flight for each of them, the items on the
+	// map and the movers
+	Com_Memset(&profile, 0, sizeof(profile));
+	seed        = 0x5eed;
+	numEntities = numPlayers * 3 + numItems + (CM_NumInlineModels() > 1 ? 1 : 0);
+	for(i = 0; i < numEntities; i++)
+	{
+		if(i < numPlayers)
+			types[i] = BE_PLAYER;
+		else if(i < numPlayers * 3)
+			types[i] = BE_MISSILE;
+		else if(i < numPlayers * 3 + numItems)
+			types[i] = BE_ITEM;
+		else
+			types[i] = BE_MOVER;
+
+		ent = SV_GentityNum(i);
+		ent->s.number   = i;
+		ent->r.ownerNum = types[i] == BE_MISSILE ? i % numPlayers : ENTITYNUM_NONE;
+		SV_BenchSpawnEntity(ent, types[i], &seed, worldMins, worldMaxs, &profile);
+		VectorClear(velocities[i]);
+	}
+	sv.num_entities = numEntities;
+
+	Com_Memset(&profile, 0, sizeof(profile));
+	frametime = 0.05f;
+	start     = Sys_Nanoseconds();
+
+	for(frame = 0; frame < numFrames; frame++)
+	{
+		for(i = 0; i < numEntities; i++)
+		{
+			ent = SV_GentityNum(i);
+
+			if(types[i] == BE_PLAYER)
+			{
+				// wander around, turning now and then
+				if(!(frame % 20) || VectorCompare(velocities[i], vec3_origin))
+				{
+					velocities[i][0] = Q_crandom(&seed) * BENCH_PLAYER_SPEED;
+					velocities[i][1] = Q_crandom(&seed) * BENCH_PLAYER_SPEED;
+					velocities[i][2] = -100;
+				}
+
+				VectorMA(ent->r.currentOrigin, frametime, velocities[i], end);
+				SV_BenchTrace(&tr, ent->r.currentOrigin, ent->r.mins, ent->r.maxs, end, i, MASK_PLAYERSOLID, &profile);
+				if(tr.fraction < 1)
+				{
+					VectorClear(velocities[i]);
+				}
+				VectorCopy(tr.endpos, ent->r.currentOrigin);
+				SV_BenchLinkEntity(ent, &profile);
+
+				// G_TouchTriggers
+				VectorAdd(ent->r.currentOrigin, ent->r.mins, mins);
+				VectorAdd(ent->r.currentOrigin, ent->r.maxs, maxs);
+				t = Sys_Nanoseconds();
+				num = SV_AreaEntities(mins, maxs, touch, MAX_GENTITIES);
+				profile.area += Sys_Nanoseconds() - t;
+				profile.areaEntities += num;
+				profile.areas++;
+
+				// the bot ai looking for enemies
+				VectorCopy(ent->r.currentOrigin, eye);
+				eye[2] += 26;
+				for(j = 0; j < BENCH_LOS_TRACES; j++)
+				{
+					other = SV_GentityNum((i + 1 + (int)(Q_random(&seed) * (numPlayers - 1))) % numPlayers);
+					SV_BenchTrace(&tr, eye, NULL, NULL, other->r.currentOrigin, i, MASK_SHOT, &profile);
+				}
+
+				if(!((frame + i) % BENCH_BURST_FRAMES))
+				{
+					SV_BenchBurst(eye, i, &seed, &profile);
+				}
+			}
+			else if(types[i] == BE_MISSILE)
+			{
+				if(VectorCompare(velocities[i], vec3_origin))
+				{
+					// fired from the owner at whatever is in front of it
+					other = SV_GentityNum(ent->r.ownerNum);
+					VectorCopy(other->r.currentOrigin, ent->r.currentOrigin);
+					SV_BenchRandomPoint(&seed, worldMins, worldMaxs, end);
+					VectorSubtract(end, ent->r.currentOrigin, velocities[i]);
+					VectorNormalize(velocities[i]);
+					VectorScale(velocities[i], BENCH_MISSILE_SPEED, velocities[i]);
+				}
+
+				VectorMA(ent->r.currentOrigin, frametime, velocities[i], end);
+				SV_BenchTrace(&tr, ent->r.currentOrigin, ent->r.mins, ent->r.maxs, end, ent->r.ownerNum, MASK_SHOT, &profile);
+				if(tr.fraction < 1)
+				{
+					// exploded, splash damage looks for everyone around it
+					VectorSet(mins, tr.endpos[0] - 120, tr.endpos[1] - 120, tr.endpos[2] - 120);
+					VectorSet(maxs, tr.endpos[0] + 120, tr.endpos[1] + 120, tr.endpos[2] + 120);
+					t = Sys_Nanoseconds();
+					num = SV_AreaEntities(mins, maxs, touch, MAX_GENTITIES);
+					profile.area += Sys_Nanoseconds() - t;
+					profile.areaEntities += num;
+					profile.areas++;
+
+					VectorClear(velocities[i]);
+				}
+				VectorCopy(tr.endpos, ent->r.currentOrigin);
+				SV_BenchLinkEntity(ent, &profile);
+			}
+		}
+	}
+
+	Com_Printf("%i players, %i entities, %i frames in %.1f msec\n",
+	           numPlayers, numEntities, numFrames, (Sys_Nanoseconds() - start) / 1e6);
+	if(profile.traces)
+	{
+		Com_Printf("%9.0f ns per SV_Trace, %i traces\n", (double)profile.trace / profile.traces, profile.traces);
+	}
+	if(profile.areas)
+	{
+		Com_Printf("%9.0f ns per SV_AreaEntities, %i queries, %.1f entities each\n",
+		           (double)profile.area / profile.areas, profile.areas, (double)profile.areaEntities / profile.areas);
+	}
+	if(profile.links)
+	{
+		Com_Printf("%9.0f ns per SV_LinkEntity, %i links\n", (double)profile.link / profile.links, profile.links);
+	}
+	if(profile.bursts)
+	{
+		Com_Printf("%9.0f ns per ray with CM_BoxTraceBatch, %.0f ns with CM_BoxTrace\n",
+		           (double)profile.worldBatch / (profile.bursts * BENCH_BURST_TRACES),
+		           (double)profile.worldSingle / (profile.bursts * BENCH_BURST_TRACES));
+		Com_Printf("%9.0f ns per ray with SV_TraceBatch, %.0f ns with SV_Trace, %i bursts of %i, %i mismatches\n",
+		           (double)profile.burstBatch / (profile.bursts * BENCH_BURST_TRACES),
+		           (double)profile.burstSingle / (profile.bursts * BENCH_BURST_TRACES),
+		           profile.bursts, BENCH_BURST_TRACES, profile.burstMismatches);
+	}
+
+	SV_SectorList_f();
+
+	// leave nothing behind for the next map load
+	Hunk_Clear();
+	CM_ClearMap();
+	Com_Memset(&sv, 0, sizeof(sv));
+	Com_Memset(&svs, 0, sizeof(svs));
+}
+
+/*
+===============================================================================
+
+routeBench
+
+Records the route queries of the bots on a running server and replays them
+on an empty botlib routing cache of different sizes, timing the replay and
+reporting how often the cache had to be recalculated or evicted.
+
+===============================================================================
+*/
+
+extern botlib_export_t *botlib_export;
+
+#define BENCH_ROUTE_QUERIES 65536   // default number of route queries to record
+
+/*
+==================
+SV_RouteBench_f
+
+routeBench record [queries]
+routeBench <kilobytes> [kilobytes ...]
+==================
+*/
+void SV_RouteBench_f(void)
+{
+	aas_routecachestats_t stats;
+	int i, budget, numQueries;
+	int64_t start, t;
+
+	if(Cmd_Argc() < 2)
+	{
+		Com_Printf("Usage: routeBench record [queries]\n");
+		Com_Printf("       routeBench <kilobytes> [kilobytes ...]\n");
+		return;
+	}
+
+	if(!com_sv_running->integer || !botlib_export || !botlib_export->aas.AAS_Initialized())
+	{
+		Com_Printf("routeBench: needs a running server with bots and an aas file\n");
+		return;
+	}
+
+	if(!Q_stricmp(Cmd_Argv(1), "record"))
+	{
+		numQueries = Cmd_Argc() > 2 ? atoi(Cmd_Argv(2)) : BENCH_ROUTE_QUERIES;
+		botlib_export->aas.AAS_RecordRouteQueries(numQueries);
+		Com_Printf("routeBench: recording up to %i route queries\n", numQueries);
+		return;
+	}
+
+	for(i = 1; i < Cmd_Argc(); i++)
+	{
+		budget = atoi(Cmd_Argv(i)) * 1024;
+		if(budget <= 0)
+		{
+			Com_Printf("routeBench: bad budget %s\n", Cmd_Argv(i));
+			continue;
+		}
+
+		start      = Sys_Nanoseconds();
+		numQueries = botlib_export->aas.AAS_ReplayRouteQueries(budget, &stats);
+		t          = Sys_Nanoseconds() - start;
+		if(!numQueries)
+		{
+			Com_Printf("routeBench: no route queries recorded\n");
+			return;
+		}
+
+		Com_Printf("%6i KB: %9.0f ns per query, %i queries, %i hits, %i misses (%i from portal tables), %i evictions, %i heap caches, %i KB peak\n",
+		           stats.budget / 1024, (double)t / numQueries, numQueries, stats.hits, stats.misses, stats.portaltables,
+		           stats.evictions, stats.overflows, stats.peakbytes / 1024);
+	}
+}
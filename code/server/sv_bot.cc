@@ -565,9 +565,11 @@ void SV_BotInitCvars (void)
   Cvar_Get ("bot_visualizejumppads", "0", CVAR_CHEAT);  //show jumppads
   Cvar_Get ("bot_forceclustering", "0", 0);             //force cluster calculations
   Cvar_Get ("bot_forcereachability", "0", 0);           //force reachability calculations
+  Cvar_Get ("bot_reachthreads", "0", 0);                //threads to calculate reachabilities on
   Cvar_Get ("bot_forcewrite", "0", 0);                  //force writing aas file
   Cvar_Get ("bot_aasoptimize", "0", 0);                 //no aas file optimisation
   Cvar_Get ("bot_saveroutingcache", "0", 0);            //save routing cache
+  Cvar_Get ("bot_saveportaltables", "0", 0);            //calculate and save the portal travel time tables
   Cvar_Get ("bot_thinktime", "100", CVAR_CHEAT);        //msec the bots thinks
   Cvar_Get ("bot_reloadcharacters", "0", 0);            //reload the bot characters each time
   Cvar_Get ("bot_testichat", "0", 0);                   //test ichats
@@ -624,6 +626,10 @@ void SV_BotInitBotLib (void)
   botlib_import.FS_Write      = FS_Write;
   botlib_import.FS_FCloseFile = FS_FCloseFile;
   botlib_import.FS_Seek       = FS_Seek;
+  botlib_import.FS_MapFile    = FS_MapGameFile;
+  botlib_import.FS_UnmapFile  = FS_UnmapGameFile;
+
+  botlib_import.RunJobs = Com_RunJobs;
 
   //debug lines
   botlib_import.DebugLineCreate = BotImport_DebugLineCreate;
@@ -1397,6 +1397,10 @@ void SV_AddOperatorCommands(void)
 	Cmd_AddCommand("dumpuser", SV_DumpUser_f);
 	Cmd_AddCommand("map_restart", SV_MapRestart_f);
 	Cmd_AddCommand("sectorlist", SV_SectorList_f);
+	Cmd_AddCommand("sv_traceStats", SV_TraceStats_f);
+	Cmd_AddCommand("snapshotBench", SV_SnapshotBench_f);
+	Cmd_AddCommand("traceBench", SV_TraceBench_f);
+	Cmd_AddCommand("routeBench", SV_RouteBench_f);
 	Cmd_AddCommand("map", SV_Map_f);
 	Cmd_SetCommandCompletionFunc("map", SV_CompleteMapName);
 #ifndef PRE_RELEASE_DEMO
@@ -575,6 +575,7 @@ gotnewcl:
 	Com_DPrintf("Going from CS_FREE to CS_CONNECTED for %s\n", newcl->name);
 
 	newcl->state            = CS_CONNECTED;
+	SV_ClientHashLink(newcl);
 	newcl->lastSnapshotTime = 0;
 	newcl->lastPacketTime   = svs.time;
 	newcl->lastConnectTime  = svs.time;
@@ -815,6 +816,97 @@ CLIENT COMMAND EXECUTION
 ============================================================
 */
 
+/*
+=============================================================================
+Download file cache
+
+Clients downloading the same file share one read only mapping of it, and
+the blocks are written into their messages straight from there instead of
+being read into per client buffers.  Files fs_mmap doesn't allow to map are
+read into memory once instead.  The mapping goes away with the last client
+using it.
+=============================================================================
+*/
+typedef struct downloadFile_s
+{
+  char name[MAX_QPATH];
+  byte *data;
+  int size;
+  qboolean mapped;                  // qfalse for a copy, see FS_SV_MapFile
+  int refCount;
+  struct downloadFile_s *next;
+} downloadFile_t;
+
+static downloadFile_t *sv_downloadFiles;
+
+/*
+==================
+SV_OpenDownloadFile
+
+Returns the shared mapping of name, NULL if it can't be opened
+==================
+*/
+static downloadFile_t *SV_OpenDownloadFile(const char *name)
+{
+  downloadFile_t *file;
+  void *data;
+  long size;
+  qboolean mapped;
+
+  for (file = sv_downloadFiles; file; file = file->next)
+  {
+    if (!qstrcmp(file->name, name))
+    {
+      file->refCount++;
+      return file;
+    }
+  }
+
+  size = FS_SV_MapFile(name, &data, &mapped);
+  if (size < 0)
+    return NULL;
+
+  file = (downloadFile_t *) Z_Malloc(sizeof(*file));
+  Q_strncpyz(file->name, name, sizeof(file->name));
+  file->data     = (byte *) data;
+  file->size     = size;
+  file->mapped   = mapped;
+  file->refCount = 1;
+  file->next     = sv_downloadFiles;
+  sv_downloadFiles = file;
+
+  Com_DPrintf("clientDownload: %s \"%s\", %i bytes\n", mapped ? "mapped" : "read", name, file->size);
+
+  return file;
+}
+
+/*
+==================
+SV_ReleaseDownloadFile
+==================
+*/
+static void SV_ReleaseDownloadFile(downloadFile_t *file)
+{
+  downloadFile_t **prev;
+
+  if (--file->refCount > 0)
+    return;
+
+  for (prev = &sv_downloadFiles; *prev; prev = &(*prev)->next)
+  {
+    if (*prev == file)
+    {
+      *prev = file->next;
+      break;
+    }
+  }
+
+  Com_DPrintf("clientDownload: unmapped \"%s\"\n", file->name);
+
+  FS_UnmapFile(file->data, file->size, file->mapped);
+  Z_Free(file);
+}
+
 /*
 ==================
 SV_CloseDownload
@@ -824,23 +916,12 @@ clear/free any download vars
 */
 static void SV_CloseDownload(client_t *cl)
 {
-  int i;
   // EOF
   if (cl->download)
-    FS_FCloseFile(cl->download);
+    SV_ReleaseDownloadFile(cl->download);
 
-  cl->download = 0;
+  cl->download = NULL;
   *cl->downloadName = 0;
-
-  // Free the temporary buffer space
-  for (i = 0; i < MAX_DOWNLOAD_WINDOW; i++)
-  {
-    if (cl->downloadBlocks[i])
-    {
-      Z_Free(cl->downloadBlocks[i]);
-      cl->downloadBlocks[i] = NULL;
-    }
-  }
 }
 
 /*
@@ -870,6 +951,74 @@ static void SV_DoneDownload_f( client_t *cl )
 	SV_SendClientGameState(cl);
 }
 
+/*
+==================
+SV_DownloadRoundTrip
+
+Feeds the round trip of an acknowledged block into the smoothed estimate
+the retransmit timeout and block pacing come from, the way TCP does it.
+Blocks that were sent more than once don't count, their ack could belong
+to either transmission.
+==================
+*/
+static void SV_DownloadRoundTrip(client_t *cl, int sendTime)
+{
+  int rtt, delta;
+
+  if (sendTime <= 0)
+    return;
+
+  rtt = Sys_Milliseconds() - sendTime;
+  if (rtt < 0)
+    return;
+
+  if (!cl->downloadRtt)
+  {
+    cl->downloadRtt    = rtt << 3;
+    cl->downloadRttVar = rtt << 1;
+    return;
+  }
+
+  delta = rtt - (cl->downloadRtt >> 3);
+  cl->downloadRtt += delta;
+  if (delta < 0)
+    delta = -delta;
+  cl->downloadRttVar += delta - (cl->downloadRttVar >> 2);
+}
+
+/*
+==================
+SV_DownloadTimeout
+
+Retransmit timeout of the download window, one second until the round
+trip has been measured like it always was
+==================
+*/
+static int SV_DownloadTimeout(client_t *cl)
+{
+  int rto;
+
+  if (!cl->downloadRtt)
+    return 1000;
+
+  rto = (cl->downloadRtt >> 3) + cl->downloadRttVar;
+
+  return (int) Com_Clamp(50, 1000, rto);
+}
+
+/*
+==================
+SV_DownloadPacing
+
+Msec between two blocks so a full window takes about one round trip,
+no pacing until the round trip has been measured
+==================
+*/
+static int SV_DownloadPacing(client_t *cl)
+{
+  return (cl->downloadRtt >> 3) / MAX_DOWNLOAD_WINDOW;
+}
+
 /*
 ==================
 SV_NextDownload_f
@@ -886,6 +1035,8 @@ static void SV_NextDownload_f( client_t *cl )
 	{
 		Com_DPrintf("clientDownload: %d : client acknowledge of block %d\n", (int)(cl - svs.clients), block);
 
+		SV_DownloadRoundTrip(cl, cl->downloadBlockTime[cl->downloadClientBlock % MAX_DOWNLOAD_WINDOW]);
+
 		// Find out if we are done.  A zero-length block indicates EOF
 		if (cl->downloadBlockSize[cl->downloadClientBlock % MAX_DOWNLOAD_WINDOW] == 0)
 		{
@@ -894,7 +1045,7 @@ static void SV_NextDownload_f( client_t *cl )
 			return;
 		}
 
-		cl->downloadSendTime = svs.time;
+		cl->downloadSendTime = Sys_Milliseconds();
 		cl->downloadClientBlock++;
 		return;
 	}
@@ -930,6 +1081,7 @@ Fill up msg with data, return number of download blocks added
 int SV_WriteDownloadToClient(client_t *cl, msg_t *msg)
 {
 	int curindex;
+	int now;
 	int unreferenced = 1;
 	char errorMessage[1024];
 	char pakbuf[MAX_QPATH], *pakptr;
@@ -981,13 +1133,11 @@ int SV_WriteDownloadToClient(client_t *cl, msg_t *msg)
 			}
 		}
 
-		cl->download = 0;
-
 		// We open the file here
 		if (!(sv_allowDownload->integer & DLF_ENABLE) ||
 		   (sv_allowDownload->integer & DLF_NO_UDP) ||
 		   idPack || unreferenced ||
-			( cl->downloadSize = FS_SV_FOpenFileRead( cl->downloadName, &cl->download ) ) < 0 ) {
+			!( cl->download = SV_OpenDownloadFile( cl->downloadName ) ) ) {
 			// cannot auto-download file
 			if (unreferenced)
 			{
@@ -1040,40 +1190,33 @@ int SV_WriteDownloadToClient(client_t *cl, msg_t *msg)
 
 			*cl->downloadName = 0;
 
-			if (cl->download)
-				FS_FCloseFile(cl->download);
-
 			return 0;
 		}
 
 		Com_Printf("clientDownload: %d : beginning \"%s\"\n", (int)(cl - svs.clients), cl->downloadName);
 
 		// Init
+		cl->downloadSize         = cl->download->size;
 		cl->downloadCurrentBlock = cl->downloadClientBlock = cl->downloadXmitBlock = 0;
 		cl->downloadCount        = 0;
 		cl->downloadEOF          = qfalse;
+		cl->downloadRtt          = cl->downloadRttVar = 0;
+		cl->downloadNextSend     = 0;
 	}
 
-	// Perform any reads that we need to
+	// Queue up the slices of the mapped file that fit into the window
 	while(cl->downloadCurrentBlock - cl->downloadClientBlock < MAX_DOWNLOAD_WINDOW &&
 	      cl->downloadSize != cl->downloadCount)
 	{
 
 		curindex = (cl->downloadCurrentBlock % MAX_DOWNLOAD_WINDOW);
 
-		if (!cl->downloadBlocks[curindex])
-			cl->downloadBlocks[curindex] = static_cast<unsigned char*>(Z_Malloc(MAX_DOWNLOAD_BLKSIZE));
-
-		cl->downloadBlockSize[curindex] = FS_Read(cl->downloadBlocks[curindex], MAX_DOWNLOAD_BLKSIZE, cl->download);
-
-		if (cl->downloadBlockSize[curindex] < 0)
-		{
-			// EOF right now
-			cl->downloadCount = cl->downloadSize;
-			break;
-		}
+		cl->downloadBlockSize[curindex] = cl->downloadSize - cl->downloadCount;
+		if (cl->downloadBlockSize[curindex] > MAX_DOWNLOAD_BLKSIZE)
+			cl->downloadBlockSize[curindex] = MAX_DOWNLOAD_BLKSIZE;
 
 		cl->downloadCount += cl->downloadBlockSize[curindex];
+		cl->downloadBlockTime[curindex] = -1;
 
 		// Load in next block
 		cl->downloadCurrentBlock++;
@@ -1086,6 +1229,7 @@ int SV_WriteDownloadToClient(client_t *cl, msg_t *msg)
 	{
 
 		cl->downloadBlockSize[cl->downloadCurrentBlock % MAX_DOWNLOAD_WINDOW] = 0;
+		cl->downloadBlockTime[cl->downloadCurrentBlock % MAX_DOWNLOAD_WINDOW] = -1;
 		cl->downloadCurrentBlock++;
 
 		cl->downloadEOF = qtrue;  // We have added the EOF block
@@ -1097,15 +1241,21 @@ int SV_WriteDownloadToClient(client_t *cl, msg_t *msg)
 		// Write out the next section of the file, if we have already reached our window,
   // automatically start retransmitting
 
+  now = Sys_Milliseconds();
+
   if (cl->downloadXmitBlock == cl->downloadCurrentBlock)
   {
     // We have transmitted the complete window, should we start resending?
-    if (svs.time - cl->downloadSendTime > 1000)
+    if (now - cl->downloadSendTime > SV_DownloadTimeout(cl))
       cl->downloadXmitBlock = cl->downloadClientBlock;
     else
       return 0;
   }
 
+  // Spread the window over one round trip instead of bursting it out
+  if (now - cl->downloadNextSend < 0)
+    return 0;
+
   // Send current block
   curindex = (cl->downloadXmitBlock % MAX_DOWNLOAD_WINDOW);
 
@@ -1118,19 +1268,26 @@ int SV_WriteDownloadToClient(client_t *cl, msg_t *msg)
 
   MSG_WriteShort(msg, cl->downloadBlockSize[curindex]);
 
-  // Write the block
+  // Write the block straight from the mapping
   if (cl->downloadBlockSize[curindex])
   {
-    MSG_WriteData(msg, cl->downloadBlocks[curindex], cl->downloadBlockSize[curindex]);
+    MSG_WriteData(msg, cl->download->data + cl->downloadXmitBlock * MAX_DOWNLOAD_BLKSIZE, cl->downloadBlockSize[curindex]);
   }
 
+  // only blocks that went out once get their round trip measured
+  if (cl->downloadBlockTime[curindex] < 0)
+    cl->downloadBlockTime[curindex] = now ? now : 1;
+  else
+    cl->downloadBlockTime[curindex] = 0;
+
   Com_DPrintf("clientDownload: %d : writing block %d\n", (int) (cl - svs.clients), cl->downloadXmitBlock);
 
   // Move on to the next block
   // It will get sent with next snap shot.  The rate will keep us in line.
   cl->downloadXmitBlock++;
 
-  cl->downloadSendTime = svs.time;
+  cl->downloadSendTime = now;
+  cl->downloadNextSend = now + SV_DownloadPacing(cl);
 
 	return 1;
 }
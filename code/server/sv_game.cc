@@ -304,6 +304,176 @@ void SV_GetUsercmd(int clientNum, usercmd_t *cmd)
 	*cmd = svs.clients[clientNum].lastUsercmd;
 }
 
+/*
+====================
+SV_GameTrace etc
+
+The hottest game syscalls, called from the vm's direct syscall table
+so they skip the SV_GameSystemCalls switch
+====================
+*/
+static intptr_t SV_GameTrace(intptr_t *args)
+{
+	SV_Trace((trace_t*)VMA(1), (const vec_t*)VMA(2), (vec_t*)VMA(3), (vec_t*)VMA(4), (const vec_t*)VMA(5), args[6], args[7],  TT_AABB);
+	return 0;
+}
+
+static intptr_t SV_GameTraceCapsule(intptr_t *args)
+{
+	SV_Trace((trace_t*)VMA(1), (const vec_t*)VMA(2), (vec_t*)VMA(3), (vec_t*)VMA(4), (const vec_t*)VMA(5), args[6], args[7], TT_CAPSULE);
+	return 0;
+}
+
+static intptr_t SV_GameTraceBatch(intptr_t *args)
+{
+	SV_TraceBatch((trace_t*)VMA(1), args[2], (const vec_t*)VMA(3), (vec_t*)VMA(4), (vec_t*)VMA(5), (const vec3_t*)VMA(6), args[7], args[8]);
+	return 0;
+}
+
+static intptr_t SV_GamePointContents(intptr_t *args)
+{
+	return SV_PointContents((const vec_t*)VMA(1), args[2]);
+}
+
+static intptr_t SV_GameLinkEntity(intptr_t *args)
+{
+	SV_LinkEntity((sharedEntity_t*)VMA(1));
+	return 0;
+}
+
+static intptr_t SV_GameUnlinkEntity(intptr_t *args)
+{
+	SV_UnlinkEntity((sharedEntity_t*)VMA(1));
+	return 0;
+}
+
+static intptr_t SV_GameEntitiesInBox(intptr_t *args)
+{
+	return SV_AreaEntities((const vec_t*)VMA(1), (const vec_t*)VMA(2), (int*)VMA(3), args[4]);
+}
+
+static vmSyscall_t gameSyscalls[G_GET_DIRECT_CALLS + 1];
+
+/*
+====================
+SV_SetGameSyscall
+====================
+*/
+static void SV_SetGameSyscall(int callNum, const char *name, intptr_t (*func)(intptr_t *args), int numArgs)
+{
+	gameSyscalls[callNum].name = name;
+	gameSyscalls[callNum].func = func;
+	gameSyscalls[callNum].numArgs = numArgs;
+}
+
+/*
+====================
+SV_InitGameSyscalls
+====================
+*/
+static void SV_InitGameSyscalls(void)
+{
+	SV_SetGameSyscall(G_TRACE, "G_TRACE", SV_GameTrace, 7);
+	SV_SetGameSyscall(G_TRACECAPSULE, "G_TRACECAPSULE", SV_GameTraceCapsule, 7);
+	SV_SetGameSyscall(G_TRACEBATCH, "G_TRACEBATCH", SV_GameTraceBatch, 8);
+	SV_SetGameSyscall(G_POINT_CONTENTS, "G_POINT_CONTENTS", SV_GamePointContents, 2);
+	SV_SetGameSyscall(G_LINKENTITY, "G_LINKENTITY", SV_GameLinkEntity, 1);
+	SV_SetGameSyscall(G_UNLINKENTITY, "G_UNLINKENTITY", SV_GameUnlinkEntity, 1);
+	SV_SetGameSyscall(G_ENTITIES_IN_BOX, "G_ENTITIES_IN_BOX", SV_GameEntitiesInBox, 4);
+}
+
+/*
+====================
+SV_GameDirectTrace etc
+
+Handed to a game dll in gameDirectCalls_t, called with the native
+calling convention instead of through VM_DllSyscall
+====================
+*/
+static void SV_GameDirectTrace(trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask)
+{
+	int64_t profile = VM_SyscallProfileStart();
+
+	SV_Trace(results, start, (vec_t*)mins, (vec_t*)maxs, end, passEntityNum, contentmask, TT_AABB);
+	VM_SyscallProfileEnd(gvm, G_TRACE, profile);
+}
+
+static void SV_GameDirectTraceCapsule(trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask)
+{
+	int64_t profile = VM_SyscallProfileStart();
+
+	SV_Trace(results, start, (vec_t*)mins, (vec_t*)maxs, end, passEntityNum, contentmask, TT_CAPSULE);
+	VM_SyscallProfileEnd(gvm, G_TRACECAPSULE, profile);
+}
+
+static void SV_GameDirectTraceBatch(trace_t *results, int numTraces, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t *ends, int passEntityNum, int contentmask)
+{
+	int64_t profile = VM_SyscallProfileStart();
+
+	SV_TraceBatch(results, numTraces, start, (vec_t*)mins, (vec_t*)maxs, ends, passEntityNum, contentmask);
+	VM_SyscallProfileEnd(gvm, G_TRACEBATCH, profile);
+}
+
+static int SV_GameDirectPointContents(const vec3_t point, int passEntityNum)
+{
+	int64_t profile = VM_SyscallProfileStart();
+	int contents;
+
+	contents = SV_PointContents(point, passEntityNum);
+	VM_SyscallProfileEnd(gvm, G_POINT_CONTENTS, profile);
+	return contents;
+}
+
+static void SV_GameDirectLinkEntity(sharedEntity_t *ent)
+{
+	int64_t profile = VM_SyscallProfileStart();
+
+	SV_LinkEntity(ent);
+	VM_SyscallProfileEnd(gvm, G_LINKENTITY, profile);
+}
+
+static void SV_GameDirectUnlinkEntity(sharedEntity_t *ent)
+{
+	int64_t profile = VM_SyscallProfileStart();
+
+	SV_UnlinkEntity(ent);
+	VM_SyscallProfileEnd(gvm, G_UNLINKENTITY, profile);
+}
+
+static int SV_GameDirectEntitiesInBox(const vec3_t mins, const vec3_t maxs, int *list, int maxcount)
+{
+	int64_t profile = VM_SyscallProfileStart();
+	int num;
+
+	num = SV_AreaEntities(mins, maxs, list, maxcount);
+	VM_SyscallProfileEnd(gvm, G_ENTITIES_IN_BOX, profile);
+	return num;
+}
+
+/*
+====================
+SV_GetGameDirectCalls
+
+Only a dll can call engine functions directly
+====================
+*/
+static qboolean SV_GetGameDirectCalls(gameDirectCalls_t *calls)
+{
+	if(!VM_IsNative(gvm))
+	{
+		return qfalse;
+	}
+
+	calls->trace = SV_GameDirectTrace;
+	calls->traceCapsule = SV_GameDirectTraceCapsule;
+	calls->traceBatch = SV_GameDirectTraceBatch;
+	calls->pointContents = SV_GameDirectPointContents;
+	calls->linkEntity = SV_GameDirectLinkEntity;
+	calls->unlinkEntity = SV_GameDirectUnlinkEntity;
+	calls->entitiesInBox = SV_GameDirectEntitiesInBox;
+	return qtrue;
+}
+
 //==============================================
 
 static int FloatAsInt(float f)
@@ -403,15 +573,13 @@ intptr_t SV_GameSystemCalls(intptr_t *args)
 			return 0;
 
 		case G_LINKENTITY:
-			SV_LinkEntity((sharedEntity_t*)VMA(1));
-			return 0;
+			return SV_GameLinkEntity(args);
 
 		case G_UNLINKENTITY:
-			SV_UnlinkEntity((sharedEntity_t*)VMA(1));
-			return 0;
+			return SV_GameUnlinkEntity(args);
 
 		case G_ENTITIES_IN_BOX:
-			return SV_AreaEntities((const vec_t*)VMA(1), (const vec_t*)VMA(2), (int*)VMA(3), args[4]);
+			return SV_GameEntitiesInBox(args);
 
 		case G_ENTITY_CONTACT:
 			return SV_EntityContact((vec_t*)VMA(1), (vec_t*)VMA(2), (const sharedEntity_t*)VMA(3), TT_AABB);
@@ -420,15 +588,19 @@ intptr_t SV_GameSystemCalls(intptr_t *args)
 			return SV_EntityContact((vec_t*)VMA(1), (vec_t*)VMA(2), (const sharedEntity_t*)VMA(3), TT_CAPSULE);
 
 		case G_TRACE:
-			SV_Trace((trace_t*)VMA(1), (const vec_t*)VMA(2), (vec_t*)VMA(3), (vec_t*)VMA(4), (const vec_t*)VMA(5), args[6], args[7],  TT_AABB);
-			return 0;
+			return SV_GameTrace(args);
 
 		case G_TRACECAPSULE:
-			SV_Trace((trace_t*)VMA(1), (const vec_t*)VMA(2), (vec_t*)VMA(3), (vec_t*)VMA(4), (const vec_t*)VMA(5), args[6], args[7], TT_CAPSULE);
-			return 0;
+			return SV_GameTraceCapsule(args);
+
+		case G_TRACEBATCH:
+			return SV_GameTraceBatch(args);
+
+		case G_GET_DIRECT_CALLS:
+			return SV_GetGameDirectCalls((gameDirectCalls_t*)VMA(1));
 
 		case G_POINT_CONTENTS:
-			return SV_PointContents((const vec_t*)VMA(1), args[2]);
+			return SV_GamePointContents(args);
 
 		case G_SET_BRUSH_MODEL:
 			SV_SetBrushModel((sharedEntity_t*)VMA(1), (const char*)VMA(2));
@@ -1141,6 +1313,9 @@ void SV_InitGameProgs(void)
 		Com_Error(ERR_FATAL, "VM_Create on game failed");
 	}
 
+	SV_InitGameSyscalls();
+	VM_SetSyscalls(gvm, gameSyscalls, ARRAY_LEN(gameSyscalls));
+
 	SV_InitGameVM(qfalse);
 }
 
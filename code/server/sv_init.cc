@@ -282,6 +282,7 @@ static void SV_Startup( void ) {
 		svs.numSnapshotEntities = sv_maxclients->integer * 4 * 64;
 	}
 	svs.initialized = qtrue;
+	SV_ClientHashRebuild();
 
 	// Don't respect sv_killserver unless a server is actually running
 	if ( sv_killserver->integer ) {
@@ -352,6 +353,8 @@ void SV_ChangeMaxClients( void ) {
 	// free the old clients on the hunk
 	Hunk_FreeTempMemory(oldClients);
 
+	SV_ClientHashRebuild();
+
 	// allocate new snapshot entities
 	if ( com_dedicated->integer ) {
 		svs.numSnapshotEntities = sv_maxclients->integer * PACKET_BACKUP * 64;
@@ -449,6 +452,7 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 
 	// clear pak references
 	FS_ClearPakReferences(0);
+	FS_ClearLookupStats();
 
 	// allocate the snapshot entities on the hunk
 	svs.snapshotEntities = (entityState_t *)Hunk_Alloc(sizeof(entityState_t) * svs.numSnapshotEntities, h_high);
@@ -700,6 +704,10 @@ void SV_Init (void)
 	sv_strictAuth = Cvar_Get("sv_strictAuth", "1", CVAR_ARCHIVE);
 #endif
 	sv_banFile = Cvar_Get("sv_banFile", "serverbans.dat", CVAR_ARCHIVE);
+	sv_snapshotStats = Cvar_Get("sv_snapshotStats", "0", CVAR_TEMP);
+	sv_snapshotThreads = Cvar_Get("sv_snapshotThreads", "0", CVAR_ARCHIVE);
+	sv_deltaCache = Cvar_Get("sv_deltaCache", "1", CVAR_ARCHIVE);
+	sv_traceCache = Cvar_Get("sv_traceCache", "0", CVAR_ARCHIVE);
 
 	// initialize bot cvars so they are listed and can be set before loading the botlib
 	SV_BotInitCvars();
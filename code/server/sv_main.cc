@@ -67,6 +67,10 @@ cvar_t *sv_strictAuth;
 
 #endif
 cvar_t	*sv_banFile;
+cvar_t *sv_snapshotStats;                 // report entities visited / emitted by snapshot building
+cvar_t *sv_snapshotThreads;               // build and encode client snapshots on this many threads
+cvar_t *sv_deltaCache;                    // reuse encoded entity deltas between the clients of a frame
+cvar_t *sv_traceCache;                    // reuse results of identical traces within a frame
 
 serverBan_t serverBans[SERVER_MAXBANS];
 int serverBansCount = 0;
@@ -819,6 +823,169 @@ static void SV_ConnectionlessPacket( netadr_t from, msg_t *msg)
 
 //============================================================================
 
+/*
+===============================================================================
+
+CLIENT ADDRESS HASH
+
+Connected clients are hashed on their base address and qport so in-band
+packets don't have to be matched against every client slot.  The UDP port
+is deliberately left out of the key: address translating routers may change
+it at any time, and SV_PacketEvent fixes it up without rehashing.
+
+The chains are kept by client number outside of client_t, so they survive
+the struct copies in SV_DirectConnect and the reallocation of svs.clients.
+Candidates are always checked against the client slot itself, a stale entry
+can therefore never match the wrong client.
+
+===============================================================================
+*/
+
+#define MAX_CLIENT_HASHES	256		// must be a power of two
+
+static int sv_clientHashes[MAX_CLIENT_HASHES];	// first client number + 1, 0 = empty
+static int sv_clientHashNext[MAX_CLIENTS];		// next client number + 1 in the chain
+static int sv_clientHashIndex[MAX_CLIENTS];		// chain the client is linked into, -1 = none
+
+/*
+================
+SV_ClientHashForAddress
+================
+*/
+static int SV_ClientHashForAddress(netadr_t address, int qport)
+{
+	long hash;
+
+	hash = SVC_HashForAddress(address);
+	hash = hash * 31 + address.type;
+	hash = hash * 31 + (qport & 0xffff);
+	hash = (hash ^ (hash >> 8));
+
+	return hash & (MAX_CLIENT_HASHES - 1);
+}
+
+/*
+================
+SV_ClientHashUnlink
+================
+*/
+void SV_ClientHashUnlink(client_t *cl)
+{
+	int clientNum, index;
+	int *link;
+
+	clientNum = cl - svs.clients;
+	index = sv_clientHashIndex[clientNum];
+
+	if(index < 0)
+		return;
+
+	for(link = &sv_clientHashes[index]; *link; link = &sv_clientHashNext[*link - 1])
+	{
+		if(*link - 1 == clientNum)
+		{
+			*link = sv_clientHashNext[clientNum];
+			break;
+		}
+	}
+
+	sv_clientHashNext[clientNum]  = 0;
+	sv_clientHashIndex[clientNum] = -1;
+}
+
+/*
+================
+SV_ClientHashLink
+
+Called whenever the netchan of a client has been set up
+================
+*/
+void SV_ClientHashLink(client_t *cl)
+{
+	int clientNum, index;
+
+	SV_ClientHashUnlink(cl);
+
+	if(cl->netchan.remoteAddress.type == NA_BOT)
+		return;
+
+	clientNum = cl - svs.clients;
+	index = SV_ClientHashForAddress(cl->netchan.remoteAddress, cl->netchan.qport);
+
+	sv_clientHashNext[clientNum]  = sv_clientHashes[index];
+	sv_clientHashIndex[clientNum] = index;
+	sv_clientHashes[index]        = clientNum + 1;
+}
+
+/*
+================
+SV_ClientHashRebuild
+
+Called after svs.clients has been (re)allocated
+================
+*/
+void SV_ClientHashRebuild(void)
+{
+	int i;
+
+	Com_Memset(sv_clientHashes, 0, sizeof(sv_clientHashes));
+	Com_Memset(sv_clientHashNext, 0, sizeof(sv_clientHashNext));
+
+	for(i = 0; i < MAX_CLIENTS; i++)
+		sv_clientHashIndex[i] = -1;
+
+	if(!svs.clients)
+		return;
+
+	for(i = 0; i < sv_maxclients->integer; i++)
+	{
+		if(svs.clients[i].state != CS_FREE)
+			SV_ClientHashLink(&svs.clients[i]);
+	}
+}
+
+/*
+================
+SV_ClientForAddress
+
+Finds the client a sequenced packet belongs to.  If several slots match,
+the lowest one wins, like the linear search this replaces.
+================
+*/
+static client_t *SV_ClientForAddress(netadr_t from, int qport)
+{
+	client_t *cl, *best;
+	int link;
+
+	best = NULL;
+
+	for(link = sv_clientHashes[SV_ClientHashForAddress(from, qport)]; link; link = sv_clientHashNext[link - 1])
+	{
+		if(link - 1 >= sv_maxclients->integer)
+			continue;
+
+		cl = &svs.clients[link - 1];
+
+		if(cl->state == CS_FREE)
+			continue;
+
+		// it is possible to have multiple clients from a single IP
+		// address, so they are differentiated by the qport variable
+		if(cl->netchan.qport != qport)
+			continue;
+
+		if(!NET_CompareBaseAdr(from, cl->netchan.remoteAddress))
+			continue;
+
+		if(!best || cl < best)
+			best = cl;
+	}
+
+	return best;
+}
+
+//============================================================================
+
 /*
 =================
 SV_PacketEvent
@@ -826,7 +993,6 @@ SV_PacketEvent
 */
 void SV_PacketEvent( netadr_t from, msg_t *msg )
 {
-	int i;
 	client_t *cl;
 	int qport;
 
@@ -844,19 +1010,9 @@ void SV_PacketEvent( netadr_t from, msg_t *msg )
 	qport = MSG_ReadShort(msg) & 0xffff;
 
 	// find which client the message is from
-	for (i = 0, cl = svs.clients; i < sv_maxclients->integer; i++, cl++)
+	cl = SV_ClientForAddress(from, qport);
+	if (cl)
   {
-    if (cl->state == CS_FREE)
-      continue;
-
-    if (!NET_CompareBaseAdr(from, cl->netchan.remoteAddress))
-      continue;
-
-    // it is possible to have multiple clients from a single IP
-    // address, so they are differentiated by the qport variable
-    if (cl->netchan.qport != qport)
-      continue;
-
     // the IP port can't be used to differentiate them, because
     // some address translating routers periodically change UDP
     // port assignments
@@ -983,6 +1139,7 @@ static void SV_CheckTimeouts( void )
       // using the client id cause the cl->name is empty at this point
       Com_DPrintf("Going from CS_ZOMBIE to CS_FREE for client %d\n", i);
       cl->state = CS_FREE; // can now be reused
+      SV_ClientHashUnlink(cl);
       continue;
     }
     if (cl->state >= CS_CONNECTED && cl->lastPacketTime < droppoint)
@@ -993,6 +1150,7 @@ static void SV_CheckTimeouts( void )
       {
         SV_DropClient(cl, "timed out");
         cl->state = CS_FREE; // don't bother with zombie state
+        SV_ClientHashUnlink(cl);
       }
     }
     else
@@ -1178,8 +1336,11 @@ void SV_Frame( int msec )
   // check timeouts
   SV_CheckTimeouts();
 
-  // send messages back to the clients
+  // send messages back to the clients, all in one batch where the
+  // platform supports it
+  NET_BeginPacketBatch();
   SV_SendClientMessages();
+  NET_EndPacketBatch();
 
   // send a heartbeat to the master if needed
   SV_MasterHeartbeat(HEARTBEAT_FOR_MASTER);
@@ -1242,6 +1403,7 @@ int SV_SendQueuedPackets()
   int dlStart, deltaT, delayT;
   static int dlNextRound = 0;
   int timeVal = INT_MAX;
+  NET_BeginPacketBatch();
   // Send out fragmented packets now that we're idle
   delayT = SV_SendQueuedMessages();
   if (delayT >= 0)
@@ -1294,5 +1456,6 @@ int SV_SendQueuedPackets()
     if (SV_SendDownloadMessages())
       timeVal = 0;
   }
+  NET_EndPacketBatch();
   return timeVal;
 }
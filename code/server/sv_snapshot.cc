@@ -23,6 +23,198 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "server.h"
 
+#include <atomic>
+
+/*
+=============================================================================
+Per frame entity delta cache
+
+Clients that acknowledged the same snapshot, and all clients that get an
+entity from its baseline, ask for the same from -> to delta of an entity in
+a frame.  The first client to encode a delta stores its bits, the others
+append them with MSG_WriteRawBits instead of running MSG_WriteDeltaEntity
+again.  Everything is dropped at the start of the next
+SV_SendClientMessages pass.
+
+The encode jobs of sv_snapshotThreads share the cache without a lock: a
+slot is claimed by swapping its stamp to the current pass and published
+with a release store once the bits are in.  Lookups treat slots that are
+still being written as misses.
+=============================================================================
+*/
+#define DELTA_CACHE_SLOTS      4096           // power of two
+#define DELTA_CACHE_PROBES     8
+#define DELTA_CACHE_DATA       (512 * 1024)   // bytes of encoded deltas per pass
+#define DELTA_CACHE_MAXBYTES   1024           // larger deltas are not cached
+
+typedef struct
+{
+  std::atomic<int> stamp;   // pass << 1 while being written, (pass << 1) | 1 once ready
+  unsigned hash;
+  qboolean force;
+  entityState_t from;
+  entityState_t to;
+  int offset;               // into sv_deltaCacheData
+  int numBits;
+} deltaCacheEntry_t;
+
+typedef struct
+{
+  int hits;
+  int misses;
+  int bits;                 // appended from the cache
+} deltaCacheCounts_t;
+
+static deltaCacheEntry_t sv_deltaCacheSlots[DELTA_CACHE_SLOTS];
+static byte sv_deltaCacheData[DELTA_CACHE_DATA];
+static std::atomic<int> sv_deltaCacheUsed;
+static int sv_deltaCachePass;
+static qboolean sv_deltaCacheActive;
+
+// set while SV_BenchmarkClientSnapshots runs
+static snapshotProfile_t *sv_snapshotProfile;
+
+// sv_snapshotStats counters, updated once per client message
+static std::atomic<int> sv_statDeltaHits;
+static std::atomic<int> sv_statDeltaMisses;
+static std::atomic<int> sv_statDeltaBits;     // bits appended from the cache
+
+/*
+=============
+SV_BeginDeltaCache
+Starts a new pass, all entries of the previous one become stale
+=============
+*/
+static void SV_BeginDeltaCache (void)
+{
+  sv_deltaCacheActive = sv_deltaCache->integer ? qtrue : qfalse;
+
+  if (!sv_deltaCacheActive)
+    return;
+
+  // keep the stamps away from 0, which is what unused slots start with
+  if (++sv_deltaCachePass >= (1 << 29) )
+  {
+    sv_deltaCachePass = 1;
+    for (int i = 0; i < DELTA_CACHE_SLOTS; i++)
+    {
+      sv_deltaCacheSlots[i].stamp.store (0, std::memory_order_relaxed);
+    }
+  }
+
+  sv_deltaCacheUsed.store (0, std::memory_order_relaxed);
+}
+
+/*
+=============
+SV_DeltaCacheHash
+=============
+*/
+static unsigned SV_DeltaCacheHash (const entityState_t *from, const entityState_t *to, qboolean force)
+{
+  const int *p = (const int *) from;
+  unsigned hash;
+  int i;
+
+  // the to state of an entity is the same for every client in a pass,
+  // so its number is all that is needed of it
+  hash = (unsigned) to->number * 2654435761u + force;
+
+  for (i = 0; i < (int) (sizeof (*from) / sizeof (int) ); i++)
+  {
+    hash = (hash ^ (unsigned) p[i]) * 16777619u;
+  }
+
+  return hash ^ (hash >> 15);
+}
+
+/*
+=============
+SV_WriteDeltaEntity
+MSG_WriteDeltaEntity for an entity that is still or newly present, going
+through the delta cache
+=============
+*/
+static void SV_WriteDeltaEntity (msg_t *msg, entityState_t *from, entityState_t *to, qboolean force, deltaCacheCounts_t *counts)
+{
+  deltaCacheEntry_t *entry;
+  byte scratchBuf[DELTA_CACHE_MAXBYTES + 32];   // MSG_WriteBits may run a few bytes past maxsize
+  msg_t scratch;
+  unsigned hash;
+  int writing, ready, stamp;
+  int i, numBytes, offset;
+
+  if (!sv_deltaCacheActive)
+  {
+    MSG_WriteDeltaEntity (msg, from, to, force);
+    return;
+  }
+
+  hash    = SV_DeltaCacheHash (from, to, force);
+  writing = sv_deltaCachePass << 1;
+  ready   = writing | 1;
+
+  for (i = 0; i < DELTA_CACHE_PROBES; i++)
+  {
+    entry = &sv_deltaCacheSlots[(hash + i) & (DELTA_CACHE_SLOTS - 1)];
+    stamp = entry->stamp.load (std::memory_order_acquire);
+
+    if (stamp == ready)
+    {
+      if (entry->hash == hash && entry->force == force &&
+          !memcmp (&entry->from, from, sizeof (*from) ) && !memcmp (&entry->to, to, sizeof (*to) ) )
+      {
+        MSG_WriteRawBits (msg, sv_deltaCacheData + entry->offset, entry->numBits);
+        counts->hits++;
+        counts->bits += entry->numBits;
+        return;
+      }
+      continue;
+    }
+
+    if (stamp == writing)
+      continue;   // another thread is filling it
+
+    if (!entry->stamp.compare_exchange_strong (stamp, writing, std::memory_order_acquire) )
+      continue;
+
+    // encode once on its own and keep the bits
+    MSG_Init (&scratch, scratchBuf, DELTA_CACHE_MAXBYTES);
+    scratch.allowoverflow = qtrue;
+    MSG_WriteDeltaEntity (&scratch, from, to, force);
+
+    numBytes = (scratch.bit + 7) >> 3;
+    offset   = -1;
+    if (!scratch.overflowed)
+    {
+      offset = sv_deltaCacheUsed.fetch_add (numBytes, std::memory_order_relaxed);
+    }
+
+    if (offset < 0 || offset + numBytes > DELTA_CACHE_DATA)
+    {
+      // give the slot back, the delta is written directly
+      entry->stamp.store (0, std::memory_order_release);
+      break;
+    }
+
+    Com_Memcpy (sv_deltaCacheData + offset, scratchBuf, numBytes);
+    entry->hash    = hash;
+    entry->force   = force;
+    entry->from    = *from;
+    entry->to      = *to;
+    entry->offset  = offset;
+    entry->numBits = scratch.bit;
+    entry->stamp.store (ready, std::memory_order_release);
+
+    MSG_WriteRawBits (msg, scratchBuf, scratch.bit);
+    counts->misses++;
+    return;
+  }
+
+  MSG_WriteDeltaEntity (msg, from, to, force);
+  counts->misses++;
+}
+
 /*
 =============================================================================
 Delta encode a client frame onto the network channel
@@ -54,6 +246,7 @@ static void SV_EmitPacketEntities (clientSnapshot_t *from, clientSnapshot_t *to,
   int oldindex, newindex;
   int oldnum, newnum;
   int from_num_entities =0;
+  deltaCacheCounts_t counts;
 
   // generate the delta update
 
@@ -68,6 +261,8 @@ static void SV_EmitPacketEntities (clientSnapshot_t *from, clientSnapshot_t *to,
   newindex = 0;
   oldindex = 0;
 
+  Com_Memset (&counts, 0, sizeof (counts) );
+
   while (newindex < to->num_entities || oldindex < from_num_entities)
   {
     if (newindex >= to->num_entities)
@@ -95,7 +290,10 @@ static void SV_EmitPacketEntities (clientSnapshot_t *from, clientSnapshot_t *to,
       // delta update from old position
       // because the force parm is qfalse, this will not result
       // in any bytes being emited if the entity has not changed at all
-      MSG_WriteDeltaEntity (msg, oldent, newent, qfalse);
+      if (memcmp (oldent, newent, sizeof (*newent) ) )
+      {
+        SV_WriteDeltaEntity (msg, oldent, newent, qfalse, &counts);
+      }
       oldindex++;
       newindex++;
       continue;
@@ -104,7 +302,7 @@ static void SV_EmitPacketEntities (clientSnapshot_t *from, clientSnapshot_t *to,
     if (newnum < oldnum)
     {
       // this is a new entity, send it from the baseline
-      MSG_WriteDeltaEntity (msg, &sv.svEntities[newnum].baseline, newent, qtrue);
+      SV_WriteDeltaEntity (msg, &sv.svEntities[newnum].baseline, newent, qtrue, &counts);
       newindex++;
       continue;
     }
@@ -119,22 +317,26 @@ static void SV_EmitPacketEntities (clientSnapshot_t *from, clientSnapshot_t *to,
   }
 
   MSG_WriteBits (msg, (MAX_GENTITIES - 1), GENTITYNUM_BITS);  // end of packetentities
+
+  if (sv_deltaCacheActive && sv_snapshotStats->integer)
+  {
+    sv_statDeltaHits.fetch_add (counts.hits, std::memory_order_relaxed);
+    sv_statDeltaMisses.fetch_add (counts.misses, std::memory_order_relaxed);
+    sv_statDeltaBits.fetch_add (counts.bits, std::memory_order_relaxed);
+  }
 }
 
 /*
 ==================
-SV_WriteSnapshotToClient
+SV_SelectDeltaFrame
+Picks the frame to delta compress the next snapshot from, returns how
+many frames back it is (0 for no delta)
 ==================
 */
-static void SV_WriteSnapshotToClient (client_t *client, msg_t *msg)
+static int SV_SelectDeltaFrame (client_t *client, clientSnapshot_t **deltaframe)
 {
-	clientSnapshot_t *frame, *oldframe;
+	clientSnapshot_t *oldframe;
 	int lastframe;
-	int i;
-	int snapFlags;
-
-	// this is the snapshot we are creating
-	frame = &client->frames[client->netchan.outgoingSequence & PACKET_MASK];
 
 	// try to use a previous frame as the source for delta compressing the snapshot
 	if ( client->deltaMessage <= 0 || client->state != CS_ACTIVE )
@@ -164,6 +366,25 @@ static void SV_WriteSnapshotToClient (client_t *client, msg_t *msg)
 		}
     }
 
+	*deltaframe = oldframe;
+	return lastframe;
+}
+
+/*
+==================
+SV_WriteSnapshotToClient
+==================
+*/
+static void SV_WriteSnapshotToClient (client_t *client, msg_t *msg, clientSnapshot_t *oldframe, int lastframe)
+{
+	clientSnapshot_t *frame;
+	int i;
+	int snapFlags;
+	int64_t t0 = 0, t1;
+
+	// this is the snapshot we are creating
+	frame = &client->frames[client->netchan.outgoingSequence & PACKET_MASK];
+
   MSG_WriteByte (msg, svc_snapshot);
 
   // NOTE, MRE: now sent at the start of every message from server to client
@@ -204,6 +425,11 @@ static void SV_WriteSnapshotToClient (client_t *client, msg_t *msg)
   MSG_WriteByte (msg, frame->areabytes);
   MSG_WriteData (msg, frame->areabits, frame->areabytes);
 
+  if (sv_snapshotProfile)
+  {
+    t0 = Sys_Nanoseconds();
+  }
+
   // delta encode the playerstate
 	if ( oldframe ) 
 	{
@@ -214,9 +440,21 @@ static void SV_WriteSnapshotToClient (client_t *client, msg_t *msg)
 		MSG_WriteDeltaPlayerstate (msg, NULL, &frame->ps);
 	}
 
+  if (sv_snapshotProfile)
+  {
+    t1 = Sys_Nanoseconds();
+    sv_snapshotProfile->playerstate += t1 - t0;
+    t0 = t1;
+  }
+
   // delta encode the entities
   SV_EmitPacketEntities (oldframe, frame, msg);
 
+  if (sv_snapshotProfile)
+  {
+    sv_snapshotProfile->entities += Sys_Nanoseconds() - t0;
+  }
+
   // padding for rate debugging
 	if ( sv_padPackets->integer ) {
 		for ( i = 0 ; i < sv_padPackets->integer ; i++ ) {
@@ -257,8 +495,38 @@ typedef struct
 {
   int numSnapshotEntities;
   int snapshotEntities[MAX_SNAPSHOT_ENTITIES];
+  byte added[MAX_GENTITIES / 8];    // used to prevent double adding from portal views
+  int visited;                      // entities looked at, for sv_snapshotStats
 } snapshotEntityNumbers_t;
 
+// entities that are sent to everyone, see SV_GatherBroadcastEntities
+static int sv_broadcastEntities[MAX_GENTITIES];
+static int sv_numBroadcastEntities;
+static qboolean sv_broadcastEntitiesValid;
+static qboolean sv_sendingClientMessages;
+
+// sv_snapshotStats counters
+static int sv_statSnapshots;
+static int sv_statVisited;
+static int sv_statEmitted;
+static int sv_statMsec;                   // spent in SV_SendClientMessages
+static int sv_statTime;
+
+// snapshots built and encoded in parallel by SV_SendClientMessages
+typedef struct
+{
+  client_t *client;
+  qboolean active;                  // SV_BeginClientSnapshot found a playerstate
+  qboolean bot;                     // needs the snapshot built, but nothing sent
+  snapshotEntityNumbers_t entityNumbers;
+  clientSnapshot_t *oldframe;
+  int lastframe;
+  msg_t msg;
+  byte msgBuf[MAX_MSGLEN];
+} snapshotJob_t;
+
+static snapshotJob_t sv_snapshotJobs[MAX_CLIENTS];
+
 /*
 =======================
 SV_QsortEntityNumbers
@@ -289,11 +557,15 @@ SV_AddEntToSnapshot
 */
 static void SV_AddEntToSnapshot (svEntity_t *svEnt, sharedEntity_t *gEnt, snapshotEntityNumbers_t *eNums)
 {
+  int e;
+
   // if we have already added this entity to this snapshot, don't add again
-  if (svEnt->snapshotCounter == sv.snapshotCounter)
+  e = svEnt - sv.svEntities;
+
+  if (eNums->added[e >> 3] & (1 << (e & 7) ) )
     return;
 
-  svEnt->snapshotCounter = sv.snapshotCounter;
+  eNums->added[e >> 3] |= 1 << (e & 7);
 
   // if we are full, silently discard entities
   if (eNums->numSnapshotEntities == MAX_SNAPSHOT_ENTITIES)
@@ -306,107 +578,127 @@ static void SV_AddEntToSnapshot (svEntity_t *svEnt, sharedEntity_t *gEnt, snapsh
 
 /*
 ===============
-SV_AddEntitiesVisibleFromPoint
+SV_GatherBroadcastEntities
+
+Broadcast entities are sent regardless of the PVS, and the game sets
+SVF_BROADCAST on temp entities after they have been linked, so they can't be
+kept in a list maintained by SV_LinkEntity.  Collect them once per
+SV_SendClientMessages pass instead of once per client.
 ===============
 */
-static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *frame, 
-									snapshotEntityNumbers_t *eNums, qboolean portal ) {
-  int e, i;
+static void SV_GatherBroadcastEntities (void)
+{
+  int e;
   sharedEntity_t *ent;
-  svEntity_t *svEnt;
-  int l;
-  int clientarea, clientcluster;
-  int leafnum;
-  byte *clientpvs;
-  byte *bitvector;
-
-  // during an error shutdown message we may need to transmit
-  // the shutdown message after the server has shutdown, so
-  // specfically check for it
 
-  if (!sv.state)
-    return;
-
-  leafnum       = CM_PointLeafnum (origin);
-  clientarea    = CM_LeafArea (leafnum);
-  clientcluster = CM_LeafCluster (leafnum);
-
-  // calculate the visible areas
-  frame->areabytes = CM_WriteAreaBits (frame->areabits, clientarea);
-
-  clientpvs = CM_ClusterPVS (clientcluster);
-
-	for ( e = 0 ; e < sv.num_entities ; e++ ) {
+  sv_numBroadcastEntities = 0;
 
+  for (e = 0; e < sv.num_entities; e++)
+  {
     ent = SV_GentityNum (e);
 
-    // never send entities that aren't linked in
-		if ( !ent->r.linked ) {
+    if (!ent->r.linked)
       continue;
-		}
 
-		if (ent->s.number != e) {
+    if (ent->s.number != e) {
       Com_DPrintf ("FIXING ENT->S.NUMBER!!!\n");
       ent->s.number = e;
     }
 
-    // entities can be flagged to explicitly not be sent to the client
-		if ( ent->r.svFlags & SVF_NOCLIENT ) {
-      continue;
-		}
-
-    // entities can be flagged to be sent to only one client
-		if ( ent->r.svFlags & SVF_SINGLECLIENT ) {
-			if ( ent->r.singleClient != frame->ps.clientNum ) {
-				continue;
-			}
+    if (ent->r.svFlags & SVF_BROADCAST)
+    {
+      sv_broadcastEntities[sv_numBroadcastEntities++] = e;
     }
+  }
+}
 
-    // entities can be flagged to be sent to everyone but one client
-		if ( ent->r.svFlags & SVF_NOTSINGLECLIENT ) {
-			if ( ent->r.singleClient == frame->ps.clientNum ) {
-				continue;
-			}
-    }
+static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *frame,
+									snapshotEntityNumbers_t *eNums, qboolean portal );
 
-    // entities can be flagged to be sent to a given mask of clients
-    if (ent->r.svFlags & SVF_CLIENTMASK)
-    {
-      if (frame->ps.clientNum >= 32)
-				Com_Error( ERR_DROP, "SVF_CLIENTMASK: clientNum >= 32" );
+/*
+===============
+SV_AddEntityVisibleFromPoint
 
-      if (~ent->r.singleClient & (1 << frame->ps.clientNum) )
-        continue;
-    }
+inPVS is set when the entity was found through the list of a cluster
+that is already known to be in the PVS
+===============
+*/
+static void SV_AddEntityVisibleFromPoint (svEntity_t *svEnt, vec3_t origin, int clientarea, byte *clientpvs,
+                                          qboolean inPVS, clientSnapshot_t *frame, snapshotEntityNumbers_t *eNums)
+{
+  int e, i;
+  int l;
+  sharedEntity_t *ent;
+  byte *bitvector;
 
-    svEnt = SV_SvEntityForGentity (ent);
+  eNums->visited++;
 
-    // don't double add an entity through portals
-    if (svEnt->snapshotCounter == sv.snapshotCounter)
-      continue;
+  e   = svEnt - sv.svEntities;
+  ent = SV_GentityNum (e);
 
-    // broadcast entities are always sent
-    if (ent->r.svFlags & SVF_BROADCAST)
-    {
-      SV_AddEntToSnapshot (svEnt, ent, eNums);
-      continue;
+  // never send entities that aren't linked in
+  // (ent->s.number has been fixed up by SV_GatherBroadcastEntities)
+  if ( !ent->r.linked ) {
+    return;
+  }
+
+  // entities can be flagged to explicitly not be sent to the client
+  if ( ent->r.svFlags & SVF_NOCLIENT ) {
+    return;
+  }
+
+  // entities can be flagged to be sent to only one client
+  if ( ent->r.svFlags & SVF_SINGLECLIENT ) {
+    if ( ent->r.singleClient != frame->ps.clientNum ) {
+      return;
     }
+  }
 
-    // ignore if not touching a PV leaf
-    // check area
-    if (!CM_AreasConnected (clientarea, svEnt->areanum) )
-    {
-      // doors can legally straddle two areas, so
-      // we may need to check another one
-      if (!CM_AreasConnected (clientarea, svEnt->areanum2) )
-        continue;       // blocked by a door
+  // entities can be flagged to be sent to everyone but one client
+  if ( ent->r.svFlags & SVF_NOTSINGLECLIENT ) {
+    if ( ent->r.singleClient == frame->ps.clientNum ) {
+      return;
     }
+  }
+
+  // entities can be flagged to be sent to a given mask of clients
+  if (ent->r.svFlags & SVF_CLIENTMASK)
+  {
+    if (frame->ps.clientNum >= 32)
+      Com_Error( ERR_DROP, "SVF_CLIENTMASK: clientNum >= 32" );
+
+    if (~ent->r.singleClient & (1 << frame->ps.clientNum) )
+      return;
+  }
+
+  // don't double add an entity through portals
+  if (eNums->added[e >> 3] & (1 << (e & 7) ) )
+    return;
+
+  // broadcast entities are always sent
+  if (ent->r.svFlags & SVF_BROADCAST)
+  {
+    SV_AddEntToSnapshot (svEnt, ent, eNums);
+    return;
+  }
+
+  // ignore if not touching a PV leaf
+  // check area
+  if (!CM_AreasConnected (clientarea, svEnt->areanum) )
+  {
+    // doors can legally straddle two areas, so
+    // we may need to check another one
+    if (!CM_AreasConnected (clientarea, svEnt->areanum2) )
+      return;         // blocked by a door
+  }
 
+  if (!inPVS)
+  {
     bitvector = clientpvs;
 
     // check individual leafs
     if (!svEnt->numClusters)
-      continue;
+      return;
 
     l = 0;
 
@@ -431,65 +723,124 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
         }
 
         if (l == svEnt->lastCluster)
-          continue;   // not visible
+          return;     // not visible
       }
       else
       {
-        continue;
+        return;
       }
     }
+  }
 
-    // add it
-    SV_AddEntToSnapshot (svEnt, ent, eNums);
+  // add it
+  SV_AddEntToSnapshot (svEnt, ent, eNums);
 
-    // if its a portal entity, add everything visible from its camera position
-    if (ent->r.svFlags & SVF_PORTAL)
+  // if its a portal entity, add everything visible from its camera position
+  if (ent->r.svFlags & SVF_PORTAL)
+  {
+    if (ent->s.generic1)
     {
-      if (ent->s.generic1)
-      {
-        vec3_t dir;
-        VectorSubtract(ent->s.origin, origin, dir);
+      vec3_t dir;
+      VectorSubtract(ent->s.origin, origin, dir);
 
-        if (VectorLengthSquared (dir) > (float) ent->s.generic1 * ent->s.generic1)
-          continue;
-      }
+      if (VectorLengthSquared (dir) > (float) ent->s.generic1 * ent->s.generic1)
+        return;
+    }
+
+    SV_AddEntitiesVisibleFromPoint (ent->s.origin2, frame, eNums, qtrue);
+  }
+}
 
-      SV_AddEntitiesVisibleFromPoint (ent->s.origin2, frame, eNums, qtrue);
+/*
+===============
+SV_AddEntitiesVisibleFromPoint
+===============
+*/
+static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *frame, 
+									snapshotEntityNumbers_t *eNums, qboolean portal ) {
+  int i, j;
+  int clientarea, clientcluster;
+  int leafnum;
+  int numClusters, cluster;
+  byte *clientpvs;
+  svClusterLink_t *link;
+
+  // during an error shutdown message we may need to transmit
+  // the shutdown message after the server has shutdown, so
+  // specfically check for it
+
+  if (!sv.state)
+    return;
+
+  leafnum       = CM_PointLeafnum (origin);
+  clientarea    = CM_LeafArea (leafnum);
+  clientcluster = CM_LeafCluster (leafnum);
+
+  // calculate the visible areas
+  frame->areabytes = CM_WriteAreaBits (frame->areabits, clientarea);
+
+  clientpvs = CM_ClusterPVS (clientcluster);
+
+  // broadcast entities are sent no matter where they are
+  for (i = 0; i < sv_numBroadcastEntities; i++)
+  {
+    SV_AddEntityVisibleFromPoint (&sv.svEntities[sv_broadcastEntities[i]], origin, clientarea, clientpvs,
+                                  qfalse, frame, eNums);
+  }
+
+  // entities touching too many clusters need the full PVS test
+  for (link = SV_OverflowEntities(); link; link = link->next)
+  {
+    SV_AddEntityVisibleFromPoint (link->ent, origin, clientarea, clientpvs, qfalse, frame, eNums);
+  }
+
+  // walk the entity lists of all clusters in the PVS
+  numClusters = CM_NumClusters();
+
+  for (i = 0; i < (numClusters + 7) >> 3; i++)
+  {
+    if (!clientpvs[i])
+      continue;
+
+    for (j = 0; j < 8; j++)
+    {
+      if (!(clientpvs[i] & (1 << j) ) )
+        continue;
+
+      cluster = (i << 3) + j;
+
+      if (cluster >= numClusters)
+        break;
+
+      for (link = SV_ClusterEntities (cluster); link; link = link->next)
+      {
+        SV_AddEntityVisibleFromPoint (link->ent, origin, clientarea, clientpvs, qtrue, frame, eNums);
+      }
     }
   }
 }
 
 /*
 =============
-SV_BuildClientSnapshot
-Decides which entities are going to be visible to the client, and
-copies off the playerstate and areabits.
-This properly handles multiple recursive portals, but the render
-currently doesn't.
-For viewing through other player's eyes, clent can be something other than client->gentity
+SV_BeginClientSnapshot
+Clears the frame we are creating and copies off the playerstate.
+Returns qfalse if the client has no entity to look from.
 =============
 */
-static void SV_BuildClientSnapshot (client_t *client)
+static qboolean SV_BeginClientSnapshot (client_t *client, snapshotEntityNumbers_t *eNums)
 {
-  vec3_t org;
   clientSnapshot_t *frame;
-  snapshotEntityNumbers_t entityNumbers;
-  int i;
-  sharedEntity_t *ent;
-  entityState_t *state;
-  svEntity_t *svEnt;
   sharedEntity_t *clent;
   int clientNum;
   playerState_t *ps;
 
-  // bump the counter used to prevent double adding
-  sv.snapshotCounter++;
-
   // this is the frame we are creating
   frame = &client->frames[client->netchan.outgoingSequence & PACKET_MASK];
 
   // clear everything in this snapshot
-  entityNumbers.numSnapshotEntities = 0;
+  eNums->numSnapshotEntities = 0;
+  eNums->visited             = 0;
+  Com_Memset(eNums->added, 0, sizeof (eNums->added) );
   Com_Memset(frame->areabits, 0, sizeof (frame->areabits) );
 
   // https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=62
@@ -498,7 +849,7 @@ static void SV_BuildClientSnapshot (client_t *client)
   clent = client->gentity;
 
   if (!clent || client->state == CS_ZOMBIE)
-    return;
+    return qfalse;
 
   // grab the current playerState_t
   ps        = SV_GameClientNum (client - svs.clients);
@@ -514,24 +865,42 @@ static void SV_BuildClientSnapshot (client_t *client)
     Com_Error (ERR_DROP, "SV_SvEntityForGentity: bad gEnt");
   }
 
-  svEnt = &sv.svEntities[clientNum];
+  eNums->added[clientNum >> 3] |= 1 << (clientNum & 7);
+
+  return qtrue;
+}
 
-  svEnt->snapshotCounter = sv.snapshotCounter;
+/*
+=============
+SV_AddClientSnapshotEntities
+Decides which entities are going to be visible to the client.
+This properly handles multiple recursive portals, but the render
+currently doesn't.
+Only touches the client's own frame and eNums, so it can run on a
+worker thread.
+=============
+*/
+static void SV_AddClientSnapshotEntities (client_t *client, snapshotEntityNumbers_t *eNums)
+{
+  vec3_t org;
+  clientSnapshot_t *frame;
+  int i;
+
+  frame = &client->frames[client->netchan.outgoingSequence & PACKET_MASK];
 
   // find the client's viewpoint
-  VectorCopy (ps->origin, org);
-  org[2] += ps->viewheight;
+  VectorCopy (frame->ps.origin, org);
+  org[2] += frame->ps.viewheight;
 
   // add all the entities directly visible to the eye, which
   // may include portal entities that merge other viewpoints
-  SV_AddEntitiesVisibleFromPoint (org, frame, &entityNumbers, qfalse);
+  SV_AddEntitiesVisibleFromPoint (org, frame, eNums, qfalse);
 
   // if there were portals visible, there may be out of order entities
   // in the list which will need to be resorted for the delta compression
-  // to work correctly.  This also catches the error condition
-  // of an entity being included twice.
-  qsort (entityNumbers.snapshotEntities, entityNumbers.numSnapshotEntities,
-         sizeof (entityNumbers.snapshotEntities[0]), SV_QsortEntityNumbers);
+  // to work correctly.
+  qsort (eNums->snapshotEntities, eNums->numSnapshotEntities,
+         sizeof (eNums->snapshotEntities[0]), SV_QsortEntityNumbers);
 
   // now that all viewpoint's areabits have been OR'd together, invert
   // all of them to make it a mask vector, which is what the renderer wants
@@ -540,27 +909,82 @@ static void SV_BuildClientSnapshot (client_t *client)
   {
     ((int *)frame->areabits) [i] = ((int *)frame->areabits)[i]^-1;
   }
+}
 
-  // copy the entity states out
-  frame->num_entities = 0;
+/*
+=============
+SV_AllocSnapshotEntities
+Reserves the client's range in svs.snapshotEntities
+=============
+*/
+static void SV_AllocSnapshotEntities (client_t *client, snapshotEntityNumbers_t *eNums)
+{
+  clientSnapshot_t *frame;
+
+  frame = &client->frames[client->netchan.outgoingSequence & PACKET_MASK];
 
+  frame->num_entities = eNums->numSnapshotEntities;
   frame->first_entity = svs.nextSnapshotEntities;
 
-  for (i = 0; i < entityNumbers.numSnapshotEntities; i++)
+  svs.nextSnapshotEntities += eNums->numSnapshotEntities;
+
+  // this should never hit, map should always be restarted first in SV_Frame
+  if (svs.nextSnapshotEntities >= 0x7FFFFFFE)
   {
-    ent    = SV_GentityNum (entityNumbers.snapshotEntities[i]);
-    state  = &svs.snapshotEntities[svs.nextSnapshotEntities % svs.numSnapshotEntities];
-    *state = ent->s;
-    svs.nextSnapshotEntities++;
-    // this should never hit, map should always be restarted first in SV_Frame
+    Com_Error (ERR_FATAL, "svs.nextSnapshotEntities wrapped");
+  }
 
-    if (svs.nextSnapshotEntities >= 0x7FFFFFFE)
-    {
-      Com_Error (ERR_FATAL, "svs.nextSnapshotEntities wrapped");
-    }
+  sv_statSnapshots++;
+  sv_statVisited += eNums->visited;
+  sv_statEmitted += eNums->numSnapshotEntities;
+}
+
+/*
+=============
+SV_CopySnapshotEntities
+Copies the entity states out into the range reserved by SV_AllocSnapshotEntities
+=============
+*/
+static void SV_CopySnapshotEntities (client_t *client, snapshotEntityNumbers_t *eNums)
+{
+  clientSnapshot_t *frame;
+  int i;
+
+  frame = &client->frames[client->netchan.outgoingSequence & PACKET_MASK];
+
+  for (i = 0; i < frame->num_entities; i++)
+  {
+    svs.snapshotEntities[(frame->first_entity + i) % svs.numSnapshotEntities] =
+      SV_GentityNum (eNums->snapshotEntities[i])->s;
+  }
+}
+
+/*
+=============
+SV_BuildClientSnapshot
+Decides which entities are going to be visible to the client, and
+copies off the playerstate and areabits.
+For viewing through other player's eyes, clent can be something other than client->gentity
+=============
+*/
+static void SV_BuildClientSnapshot (client_t *client)
+{
+  snapshotEntityNumbers_t entityNumbers;
 
-    frame->num_entities++;
+  // broadcast entities are gathered once per SV_SendClientMessages pass,
+  // other callers may have run game code in between
+  if (!sv_sendingClientMessages || !sv_broadcastEntitiesValid)
+  {
+    SV_GatherBroadcastEntities();
+    sv_broadcastEntitiesValid = sv_sendingClientMessages;
   }
+
+  if (!SV_BeginClientSnapshot (client, &entityNumbers) )
+    return;
+
+  SV_AddClientSnapshotEntities (client, &entityNumbers);
+  SV_AllocSnapshotEntities (client, &entityNumbers);
+  SV_CopySnapshotEntities (client, &entityNumbers);
 }
 
 #ifdef USE_VOIP
@@ -621,6 +1045,48 @@ void SV_SendMessageToClient (msg_t *msg, client_t *client)
 	SV_Netchan_Transmit(client, msg);
 }
 
+/*
+=======================
+SV_WriteClientSnapshotMessage
+Everything that goes into a snapshot message except VoIP,
+safe to run on a worker thread
+=======================
+*/
+static void SV_WriteClientSnapshotMessage (client_t *client, msg_t *msg, clientSnapshot_t *oldframe, int lastframe)
+{
+  // NOTE, MRE: all server->client messages now acknowledge
+  // let the client know which reliable clientCommands we have received
+  MSG_WriteLong (msg, client->lastClientCommand);
+
+  // (re)send any reliable server commands
+  SV_UpdateServerCommandsToClient (client, msg);
+
+  // send over all the relevant entityState_t
+  // and the playerState_t
+  SV_WriteSnapshotToClient (client, msg, oldframe, lastframe);
+}
+
+/*
+=======================
+SV_FinishClientSnapshot
+=======================
+*/
+static void SV_FinishClientSnapshot (client_t *client, msg_t *msg)
+{
+#ifdef USE_VOIP
+  SV_WriteVoipToClient (client, msg);
+#endif
+
+  // check for overflow
+  if (msg->overflowed)
+  {
+    Com_Printf ("WARNING: msg overflowed for %s\n", client->name);
+    MSG_Clear (msg);
+  }
+
+  SV_SendMessageToClient (msg, client);
+}
+
 /*
 =======================
 SV_SendClientSnapshot
@@ -631,6 +1097,8 @@ void SV_SendClientSnapshot (client_t *client)
 {
   byte msg_buf[MAX_MSGLEN];
   msg_t msg;
+  clientSnapshot_t *oldframe;
+  int lastframe;
 
   // build the snapshot
   SV_BuildClientSnapshot (client);
@@ -645,30 +1113,167 @@ void SV_SendClientSnapshot (client_t *client)
 
   msg.allowoverflow = qtrue;
 
-  // NOTE, MRE: all server->client messages now acknowledge
-  // let the client know which reliable clientCommands we have received
-  MSG_WriteLong (&msg, client->lastClientCommand);
+  lastframe = SV_SelectDeltaFrame (client, &oldframe);
 
-  // (re)send any reliable server commands
-  SV_UpdateServerCommandsToClient (client, &msg);
+  SV_WriteClientSnapshotMessage (client, &msg, oldframe, lastframe);
 
-  // send over all the relevant entityState_t
-  // and the playerState_t
-  SV_WriteSnapshotToClient (client, &msg);
+  SV_FinishClientSnapshot (client, &msg);
+}
 
+/*
+=======================
+SV_BenchmarkClientSnapshots
+One SV_SendClientMessages pass over the first numClients clients for
+snapshotBench, with the stages timed into profile.  Nothing goes to the
+netchan, every client acknowledges its snapshot right away so the next
+one is delta compressed from it.
+=======================
+*/
+void SV_BenchmarkClientSnapshots (int numClients, snapshotProfile_t *profile)
+{
+  byte msg_buf[MAX_MSGLEN];
+  msg_t msg;
+  client_t *client;
+  clientSnapshot_t *oldframe, *frame;
+  int i, lastframe;
+  int64_t start, built;
 
-#ifdef USE_VOIP
-  SV_WriteVoipToClient (client, &msg);
-#endif
+  sv_sendingClientMessages  = qtrue;
+  sv_broadcastEntitiesValid = qfalse;
+  SV_BeginDeltaCache();
 
-  // check for overflow
-  if (msg.overflowed)
+  for (i = 0; i < numClients; i++)
   {
-    Com_Printf ("WARNING: msg overflowed for %s\n", client->name);
-    MSG_Clear (&msg);
+    client = &svs.clients[i];
+
+    start = Sys_Nanoseconds();
+    SV_BuildClientSnapshot (client);
+    built = Sys_Nanoseconds();
+
+    MSG_Init (&msg, msg_buf, sizeof (msg_buf) );
+    msg.allowoverflow = qtrue;
+
+    lastframe = SV_SelectDeltaFrame (client, &oldframe);
+
+    sv_snapshotProfile = profile;
+    SV_WriteClientSnapshotMessage (client, &msg, oldframe, lastframe);
+    sv_snapshotProfile = NULL;
+
+    profile->build += built - start;
+    profile->total += Sys_Nanoseconds() - start;
+    profile->bytes += msg.cursize;
+    profile->snapshots++;
+
+    frame = &client->frames[client->netchan.outgoingSequence & PACKET_MASK];
+    frame->messageSize  = msg.cursize;
+    frame->messageSent  = svs.time;
+    frame->messageAcked = svs.time;
+
+    client->deltaMessage = client->netchan.outgoingSequence++;
   }
 
-  SV_SendMessageToClient (&msg, client);
+  sv_sendingClientMessages  = qfalse;
+  sv_broadcastEntitiesValid = qfalse;
+  sv_deltaCacheActive       = qfalse;
+}
+
+/*
+=======================
+SV_SnapshotEntitiesJob
+=======================
+*/
+static void SV_SnapshotEntitiesJob (int work, int threadnum)
+{
+  snapshotJob_t *job = &sv_snapshotJobs[work];
+
+  if (job->active)
+  {
+    SV_AddClientSnapshotEntities (job->client, &job->entityNumbers);
+  }
+}
+
+/*
+=======================
+SV_SnapshotEncodeJob
+=======================
+*/
+static void SV_SnapshotEncodeJob (int work, int threadnum)
+{
+  snapshotJob_t *job = &sv_snapshotJobs[work];
+
+  if (job->active)
+  {
+    SV_CopySnapshotEntities (job->client, &job->entityNumbers);
+  }
+
+  if (!job->bot)
+  {
+    SV_WriteClientSnapshotMessage (job->client, &job->msg, job->oldframe, job->lastframe);
+  }
+}
+
+/*
+=======================
+SV_SendClientSnapshots
+Builds and encodes the snapshots of all the given clients on sv_snapshotThreads
+threads.  Everything that touches shared state (the svs.snapshotEntities
+ring, delta frame selection, prints and the netchan) happens on this thread
+between the parallel passes.
+=======================
+*/
+static void SV_SendClientSnapshots (int numJobs)
+{
+  int i;
+  snapshotJob_t *job;
+
+  SV_GatherBroadcastEntities();
+  sv_broadcastEntitiesValid = qtrue;
+
+  for (i = 0; i < numJobs; i++)
+  {
+    job         = &sv_snapshotJobs[i];
+    job->active = SV_BeginClientSnapshot (job->client, &job->entityNumbers);
+    job->bot    = (job->client->gentity && job->client->gentity->r.svFlags & SVF_BOT) ? qtrue : qfalse;
+  }
+
+  Com_RunJobs (sv_snapshotThreads->integer, numJobs, SV_SnapshotEntitiesJob);
+
+  // reserve all ranges before any client looks at the ring, so the
+  // out of date check in SV_SelectDeltaFrame sees the final position
+  for (i = 0; i < numJobs; i++)
+  {
+    job = &sv_snapshotJobs[i];
+    if (job->active)
+    {
+      SV_AllocSnapshotEntities (job->client, &job->entityNumbers);
+    }
+  }
+
+  for (i = 0; i < numJobs; i++)
+  {
+    job = &sv_snapshotJobs[i];
+    if (job->bot)
+      continue;
+
+    job->lastframe = SV_SelectDeltaFrame (job->client, &job->oldframe);
+
+    MSG_Init (&job->msg, job->msgBuf, sizeof (job->msgBuf) );
+    job->msg.allowoverflow = qtrue;
+  }
+
+  Com_RunJobs (sv_snapshotThreads->integer, numJobs, SV_SnapshotEncodeJob);
+
+  for (i = 0; i < numJobs; i++)
+  {
+    job = &sv_snapshotJobs[i];
+    if (!job->bot)
+    {
+      SV_FinishClientSnapshot (job->client, &job->msg);
+    }
+
+    job->client->lastSnapshotTime = svs.time;
+    job->client->rateDelayed      = qfalse;
+  }
 }
 
 /*
@@ -679,8 +1284,19 @@ SV_SendClientMessages
 void SV_SendClientMessages(void)
 {
 	int i;
+	int numJobs;
+	int start;
+	int hits, misses;
 	client_t *c;
 
+	start = Sys_Milliseconds();
+
+	sv_sendingClientMessages  = qtrue;
+	sv_broadcastEntitiesValid = qfalse;
+	SV_BeginDeltaCache();
+
+	numJobs = 0;
+
 	// send a message to each connected client
 	for ( i = 0; i < sv_maxclients->integer; i++ )
 	{
@@ -712,9 +1328,52 @@ void SV_SendClientMessages(void)
 			}
 		}
 
+		if ( sv_snapshotThreads->integer > 1 )
+		{
+			// built and sent together with the others below
+			sv_snapshotJobs[numJobs++].client = c;
+			continue;
+		}
+
 		// generate and send a new message
 		SV_SendClientSnapshot(c);
 		c->lastSnapshotTime = svs.time;
 		c->rateDelayed = qfalse;
 	}
+
+	if ( numJobs )
+	{
+		SV_SendClientSnapshots( numJobs );
+	}
+
+	sv_sendingClientMessages  = qfalse;
+	sv_broadcastEntitiesValid = qfalse;
+	sv_deltaCacheActive       = qfalse;
+
+	sv_statMsec += Sys_Milliseconds() - start;
+
+	if ( sv_snapshotStats->integer && svs.time - sv_statTime >= 1000 )
+	{
+		if ( sv_statSnapshots )
+		{
+			Com_Printf( "snapshots: %i, entities visited: %i (%.1f per snapshot), emitted: %i (%.1f per snapshot)\n",
+				sv_statSnapshots, sv_statVisited, (float)sv_statVisited / sv_statSnapshots,
+				sv_statEmitted, (float)sv_statEmitted / sv_statSnapshots );
+
+			// compare msec with sv_deltaCache 0 to see the CPU the cache saves
+			hits   = sv_statDeltaHits.load();
+			misses = sv_statDeltaMisses.load();
+			Com_Printf( "delta cache: %i hits, %i misses (%.1f%% hit rate), %i bytes reused, %i msec sending\n",
+				hits, misses, hits + misses ? 100.0f * hits / ( hits + misses ) : 0.0f,
+				sv_statDeltaBits.load() / 8, sv_statMsec );
+		}
+		sv_statSnapshots = 0;
+		sv_statVisited   = 0;
+		sv_statEmitted   = 0;
+		sv_statMsec      = 0;
+		sv_statDeltaHits.store( 0 );
+		sv_statDeltaMisses.store( 0 );
+		sv_statDeltaBits.store( 0 );
+		sv_statTime      = svs.time;
+	}
 }
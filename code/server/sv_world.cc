@@ -58,98 +58,718 @@ clipHandle_t SV_ClipHandleForEntity(const sharedEntity_t *ent)
 ENTITY CHECKING
 
 To avoid linearly searching through lists of entities during environment testing,
-the world is carved up with an evenly spaced, axially aligned bsp tree.  Entities
-are kept in chains either at the final leafs, or at the first node that splits
-them, which prevents having to deal with multiple fragments of a single entity.
+the world is carved up with a loose octree.  Every node covers a box of the
+world, and its loose bounds reach half of that box further out on every side.
+An entity is kept in the chain of the deepest node whose box holds the center
+of its bounds and whose loose bounds hold all of it, which prevents having to
+deal with multiple fragments of a single entity without leaving small entities
+high up in the tree just because they cross a split.  Nodes are only split
+along their long axes, so flat maps get a quadtree until the nodes become about
+as small as they are high.
+
+The tree adapts to where the entities are: a node is only split once more than
+SECTOR_SPLIT entities are chained to it, children only exist while something
+is linked in or below them, and empty nodes go back to the pool right away.
 
 ===============================================================================
 */
 
 typedef struct worldSector_s
 {
-	int axis;      // -1 = leaf node
-	float dist;
-	struct worldSector_s *children[2];
+	vec3_t center;
+	vec3_t halfSize;                     // of the box
+	vec3_t mins, maxs;                   // loose bounds, nothing linked below reaches past them
+	int depth;
+	int octant;                          // in the parent
+	int splitAxes;                       // bits of the axes the children halve
+	qboolean split;                      // entities that fit go on to the children
+	struct worldSector_s *parent;
+	struct worldSector_s *children[8];   // NULL if nothing is linked there
+	int numChildren;
 	svEntity_t *entities;
+	int numEntities;
 } worldSector_t;
 
-#define AREA_DEPTH 4
-#define AREA_NODES 64
+#define SECTOR_SPLIT        32
+#define SECTOR_LOOSENESS    0.5f         // of the box size the loose bounds add on every side
+#define SECTOR_MAX_DEPTH    8
+#define AREA_NODES          2048
 
 worldSector_t sv_worldSectors[AREA_NODES];
-int sv_numworldSectors;
+int sv_numworldSectors;                  // in use
 
+static worldSector_t *sv_freeWorldSectors;
+static int sv_worldSectorOverflows;      // allocations that found the pool empty
+
+/*
+===============================================================================
+
+CLUSTER LISTS
+
+Every linked entity is also chained into a doubly linked list for each PVS
+cluster it touches, so snapshot building only has to visit the entities of
+the clusters that are set in a client's PVS instead of every entity in the
+level.  Entities that touch more clusters than fit in clusternums[] are kept
+on a separate overflow list and tested against the PVS individually.
+
+===============================================================================
+*/
+
+static svClusterLink_t **sv_clusterEntities;    // [sv_numClusterLists]
+static int sv_numClusterLists;
+static svClusterLink_t *sv_overflowEntities;
+
+/*
+===============
+SV_ClusterEntities
+===============
+*/
+svClusterLink_t *SV_ClusterEntities(int cluster)
+{
+	if(cluster < 0 || cluster >= sv_numClusterLists)
+	{
+		return NULL;
+	}
+	return sv_clusterEntities[cluster];
+}
+
+/*
+===============
+SV_OverflowEntities
+===============
+*/
+svClusterLink_t *SV_OverflowEntities(void)
+{
+	return sv_overflowEntities;
+}
+
+/*
+===============
+SV_AddClusterLink
+===============
+*/
+static void SV_AddClusterLink(svClusterLink_t *link, svEntity_t *ent, int cluster)
+{
+	svClusterLink_t **head;
+
+	head = (cluster == -1) ? &sv_overflowEntities : &sv_clusterEntities[cluster];
+
+	link->ent     = ent;
+	link->cluster = cluster;
+	link->prev    = NULL;
+	link->next    = *head;
+	if(*head)
+	{
+		(*head)->prev = link;
+	}
+	*head = link;
+}
+
+/*
+===============
+SV_RemoveClusterLink
+===============
+*/
+static void SV_RemoveClusterLink(svClusterLink_t *link)
+{
+	if(link->prev)
+	{
+		link->prev->next = link->next;
+	}
+	else if(link->cluster == -1)
+	{
+		sv_overflowEntities = link->next;
+	}
+	else
+	{
+		sv_clusterEntities[link->cluster] = link->next;
+	}
+	if(link->next)
+	{
+		link->next->prev = link->prev;
+	}
+	link->ent  = NULL;
+	link->prev = link->next = NULL;
+}
+
+/*
+===============
+SV_LinkEntityClusters
+
+Chains the entity into the list of every distinct cluster in clusternums[]
+===============
+*/
+static void SV_LinkEntityClusters(svEntity_t *ent)
+{
+	int i, j;
+	int cluster;
+
+	ent->numClusterLinks = 0;
+	for(i = 0; i < ent->numClusters; i++)
+	{
+		cluster = ent->clusternums[i];
+		if(cluster < 0 || cluster >= sv_numClusterLists)
+		{
+			continue;
+		}
+
+		// several leafs of the entity can share the same cluster
+		for(j = 0; j < i; j++)
+		{
+			if(ent->clusternums[j] == cluster)
+			{
+				break;
+			}
+		}
+		if(j != i)
+		{
+			continue;
+		}
+
+		SV_AddClusterLink(&ent->clusterLinks[ent->numClusterLinks], ent, cluster);
+		ent->numClusterLinks++;
+	}
+
+	if(ent->lastCluster)
+	{
+		SV_AddClusterLink(&ent->overflowLink, ent, -1);
+	}
+}
+
+/*
+===============
+SV_UnlinkEntityClusters
+===============
+*/
+static void SV_UnlinkEntityClusters(svEntity_t *ent)
+{
+	int i;
+
+	for(i = 0; i < ent->numClusterLinks; i++)
+	{
+		SV_RemoveClusterLink(&ent->clusterLinks[i]);
+	}
+	ent->numClusterLinks = 0;
+
+	if(ent->overflowLink.ent)
+	{
+		SV_RemoveClusterLink(&ent->overflowLink);
+	}
+}
 
 /*
 ===============
 SV_SectorList_f
 ===============
 */
+#define SECTOR_OCCUPANCY_BUCKETS 7
 void SV_SectorList_f(void)
 {
-	int i, c;
+	static const char *occupancyNames[SECTOR_OCCUPANCY_BUCKETS] = { "0", "1", "2-3", "4-7", "8-15", "16-31", "32+" };
+	int depthNodes[SECTOR_MAX_DEPTH + 1], depthEntities[SECTOR_MAX_DEPTH + 1];
+	int occupancy[SECTOR_OCCUPANCY_BUCKETS];
+	int i, b, c, total;
 	worldSector_t *sec;
-	svEntity_t *ent;
 
+	Com_Memset(depthNodes, 0, sizeof(depthNodes));
+	Com_Memset(depthEntities, 0, sizeof(depthEntities));
+	Com_Memset(occupancy, 0, sizeof(occupancy));
+
+	total = 0;
 	for(i = 0; i < AREA_NODES; i++)
 	{
 		sec = &sv_worldSectors[i];
+		if(sec->depth < 0)
+		{
+			continue;   // in the pool
+		}
+
+		depthNodes[sec->depth]++;
+		depthEntities[sec->depth] += sec->numEntities;
+		total += sec->numEntities;
+
+		for(b = 0, c = sec->numEntities; c && b < SECTOR_OCCUPANCY_BUCKETS - 1; c >>= 1)
+		{
+			b++;
+		}
+		occupancy[b]++;
+	}
+
+	Com_Printf("%i of %i sectors in use, %i entities, %i pool overflows\n",
+	           sv_numworldSectors, AREA_NODES, total, sv_worldSectorOverflows);
+
+	Com_Printf("depth  sectors  entities\n");
+	for(i = 0; i <= SECTOR_MAX_DEPTH; i++)
+	{
+		if(depthNodes[i])
+		{
+			Com_Printf("%5i  %7i  %8i\n", i, depthNodes[i], depthEntities[i]);
+		}
+	}
+
+	Com_Printf("entities  sectors\n");
+	for(i = 0; i < SECTOR_OCCUPANCY_BUCKETS; i++)
+	{
+		Com_Printf("%8s  %7i\n", occupancyNames[i], occupancy[i]);
+	}
+}
+
+/*
+===============
+SV_SetSectorSplitAxes
+
+Children halve the axes that are at least half as long as the longest one
+===============
+*/
+static void SV_SetSectorSplitAxes(worldSector_t *node)
+{
+	float longest;
+	int i;
 
-		c = 0;
-		for(ent = sec->entities; ent; ent = ent->nextEntityInWorldSector)
+	longest = node->halfSize[0];
+	if(node->halfSize[1] > longest)
+		longest = node->halfSize[1];
+	if(node->halfSize[2] > longest)
+		longest = node->halfSize[2];
+
+	node->splitAxes = 0;
+	for(i = 0; i < 3; i++)
+	{
+		if(node->halfSize[i] * 2 >= longest)
 		{
-			c++;
+			node->splitAxes |= 1 << i;
 		}
-		Com_Printf("sector %i: %i entities\n", i, c);
 	}
 }
 
 /*
 ===============
-SV_CreateworldSector
+SV_AllocWorldSector
 
-Builds a uniformly subdivided tree for the given world size
+Returns a new child of parent for the given octant, NULL if the pool is empty
 ===============
 */
-static worldSector_t *SV_CreateworldSector( int depth, vec3_t mins, vec3_t maxs ) {
-	worldSector_t *anode;
-	vec3_t size;
-	vec3_t mins1, maxs1, mins2, maxs2;
+static worldSector_t *SV_AllocWorldSector(worldSector_t *parent, int octant)
+{
+	worldSector_t *node;
+	int i;
 
-	anode = &sv_worldSectors[sv_numworldSectors];
+	node = sv_freeWorldSectors;
+	if(!node)
+	{
+		sv_worldSectorOverflows++;
+		return NULL;
+	}
+	sv_freeWorldSectors = node->parent;
 	sv_numworldSectors++;
 
-	if(depth == AREA_DEPTH)
+	Com_Memset(node, 0, sizeof(*node));
+
+	if(!parent)
+	{
+		return node;    // the root, SV_ClearWorld sets it up
+	}
+
+	for(i = 0; i < 3; i++)
+	{
+		node->center[i]   = parent->center[i];
+		node->halfSize[i] = parent->halfSize[i];
+		if(parent->splitAxes & (1 << i))
+		{
+			node->halfSize[i] *= 0.5f;
+			node->center[i]   += (octant & (1 << i)) ? node->halfSize[i] : -node->halfSize[i];
+		}
+		node->mins[i] = node->center[i] - (1 + SECTOR_LOOSENESS) * node->halfSize[i];
+		node->maxs[i] = node->center[i] + (1 + SECTOR_LOOSENESS) * node->halfSize[i];
+	}
+	node->depth  = parent->depth + 1;
+	node->octant = octant;
+	node->parent = parent;
+	SV_SetSectorSplitAxes(node);
+
+	parent->children[octant] = node;
+	parent->numChildren++;
+
+	return node;
+}
+
+/*
+===============
+SV_FreeEmptySectors
+
+Gives node and the ancestors that end up empty with it back to the pool
+===============
+*/
+static void SV_FreeEmptySectors(worldSector_t *node)
+{
+	worldSector_t *parent;
+
+	while(node && node->parent && !node->numEntities && !node->numChildren)
+	{
+		parent = node->parent;
+		parent->children[node->octant] = NULL;
+		parent->numChildren--;
+
+		node->depth  = -1;
+		node->parent = sv_freeWorldSectors;
+		sv_freeWorldSectors = node;
+		sv_numworldSectors--;
+
+		node = parent;
+	}
+}
+
+/*
+===============
+SV_SectorForBox
+
+Walks down from node to the deepest sector that can hold the box
+===============
+*/
+static worldSector_t *SV_SectorForBox(worldSector_t *node, const vec3_t absmin, const vec3_t absmax)
+{
+	worldSector_t *child;
+	vec3_t center, radius;
+	float half;
+	int i, octant;
+
+	for(i = 0; i < 3; i++)
+	{
+		center[i] = 0.5f * (absmin[i] + absmax[i]);
+		radius[i] = 0.5f * (absmax[i] - absmin[i]);
+
+		// only the root can be asked about boxes outside of it
+		if(center[i] < node->center[i] - node->halfSize[i] || center[i] > node->center[i] + node->halfSize[i])
+		{
+			return node;
+		}
+	}
+
+	while(node->split)
+	{
+		octant = 0;
+		for(i = 0; i < 3; i++)
+		{
+			half = node->halfSize[i];
+			if(node->splitAxes & (1 << i))
+			{
+				half *= 0.5f;
+				if(center[i] >= node->center[i])
+				{
+					octant |= 1 << i;
+				}
+			}
+
+			// must stay within the loose bounds of the child
+			if(radius[i] > half * SECTOR_LOOSENESS)
+			{
+				return node;
+			}
+		}
+
+		child = node->children[octant];
+		if(!child)
+		{
+			child = SV_AllocWorldSector(node, octant);
+			if(!child)
+			{
+				break;
+			}
+		}
+		node = child;
+	}
+
+	return node;
+}
+
+/*
+===============
+SV_AddSectorEntity
+===============
+*/
+static void SV_AddSectorEntity(worldSector_t *node, svEntity_t *ent)
+{
+	ent->worldSector             = node;
+	ent->prevEntityInWorldSector = NULL;
+	ent->nextEntityInWorldSector = node->entities;
+	if(node->entities)
 	{
-		anode->axis        = -1;
-		anode->children[0] = anode->children[1] = NULL;
-		return anode;
+		node->entities->prevEntityInWorldSector = ent;
 	}
+	node->entities = ent;
+	node->numEntities++;
+}
+
+/*
+===============
+SV_RemoveSectorEntity
+
+Takes the entity out of its sector chain, returns the sector it was in
+===============
+*/
+static worldSector_t *SV_RemoveSectorEntity(svEntity_t *ent)
+{
+	worldSector_t *node;
+
+	node = ent->worldSector;
 
-	VectorSubtract(maxs, mins, size);
-	if(size[0] > size[1])
+	if(ent->prevEntityInWorldSector)
 	{
-		anode->axis = 0;
+		ent->prevEntityInWorldSector->nextEntityInWorldSector = ent->nextEntityInWorldSector;
 	}
 	else
 	{
-		anode->axis = 1;
+		node->entities = ent->nextEntityInWorldSector;
 	}
+	if(ent->nextEntityInWorldSector)
+	{
+		ent->nextEntityInWorldSector->prevEntityInWorldSector = ent->prevEntityInWorldSector;
+	}
+	node->numEntities--;
+
+	ent->worldSector             = NULL;
+	ent->nextEntityInWorldSector = ent->prevEntityInWorldSector = NULL;
 
-	anode->dist = 0.5 * (maxs[anode->axis] + mins[anode->axis]);
-	VectorCopy(mins, mins1);
-	VectorCopy(mins, mins2);
-	VectorCopy(maxs, maxs1);
-	VectorCopy(maxs, maxs2);
+	return node;
+}
+
+/*
+===============
+SV_SplitSector
+
+Lets the entities of a crowded sector move down into its children
+===============
+*/
+static void SV_SplitSector(worldSector_t *node)
+{
+	svEntity_t *ent, *next;
+	sharedEntity_t *gEnt;
+	worldSector_t *target;
 
-	maxs1[anode->axis] = mins2[anode->axis] = anode->dist;
+	node->split = qtrue;
 
-	anode->children[0] = SV_CreateworldSector(depth + 1, mins2, maxs2);
-	anode->children[1] = SV_CreateworldSector(depth + 1, mins1, maxs1);
+	for(ent = node->entities; ent; ent = next)
+	{
+		next = ent->nextEntityInWorldSector;
 
-	return anode;
+		gEnt   = SV_GEntityForSvEntity(ent);
+		target = SV_SectorForBox(node, gEnt->r.absmin, gEnt->r.absmax);
+		if(target != node)
+		{
+			SV_RemoveSectorEntity(ent);
+			SV_AddSectorEntity(target, ent);
+		}
+	}
 }
 
+/*
+===============================================================================
+
+TRACE CACHE
+
+Game and bot code often repeat the same trace several times in a server
+frame.  With sv_traceCache set, SV_Trace remembers its results until the
+server time changes, hashed on the trace coordinates snapped to whole units.
+A hit needs every parameter to match exactly, so it returns just what
+tracing again would.  Linking or unlinking an entity drops the results whose
+swept box touches its old or new bounds.  Game code that changes the
+contents or owner of an entity without relinking it is not noticed, which is
+why the cache is optional.  Only the main thread uses it, traces on worker
+threads (the reachability calculation) always trace.
+
+===============================================================================
+*/
+
+#define TRACE_CACHE_SIZE    1024         // power of two
+
+typedef struct
+{
+	vec3_t start, end;
+	vec3_t mins, maxs;
+	int passEntityNum;
+	int contentmask;
+	int capsule;
+} traceCacheKey_t;
+
+typedef struct
+{
+	traceCacheKey_t key;
+	vec3_t absmin, absmax;               // swept box of the trace
+	int frame;                           // valid while it matches sv_traceCache.frame
+	int listed;                          // frame it was added to the used list in
+	trace_t trace;
+} traceCacheEntry_t;
+
+static struct
+{
+	traceCacheEntry_t entries[TRACE_CACHE_SIZE];
+	int used[TRACE_CACHE_SIZE];          // entries filled in this frame
+	int numUsed;
+	int frame;
+	int time;                            // sv.time of the frame
+	int hits, misses;
+	int dropped;                         // by entity links
+	int replaced;                        // by another trace with the same hash
+} sv_traceCacheData;
+
+/*
+===============
+SV_ClearTraceCache
+===============
+*/
+static void SV_ClearTraceCache(void)
+{
+	sv_traceCacheData.frame++;
+	sv_traceCacheData.time    = sv.time;
+	sv_traceCacheData.numUsed = 0;
+}
+
+/*
+===============
+SV_FindCachedTrace
+
+Returns the entry the trace of key goes to, hit is set if it holds the
+result of the same trace made earlier in this frame
+===============
+*/
+static traceCacheEntry_t *SV_FindCachedTrace(const traceCacheKey_t *key, qboolean *hit)
+{
+	traceCacheEntry_t *entry;
+	unsigned hash;
+	int i;
+
+	if(sv_traceCacheData.time != sv.time || !sv_traceCacheData.frame)
+	{
+		SV_ClearTraceCache();
+	}
+
+	hash = key->passEntityNum * 31 + key->contentmask * 7 + key->capsule;
+	for(i = 0; i < 3; i++)
+	{
+		hash = hash * 131 + (int)key->start[i];
+		hash = hash * 131 + (int)key->end[i];
+		hash = hash * 131 + (int)(key->maxs[i] - key->mins[i]);
+	}
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+
+	entry = &sv_traceCacheData.entries[hash & (TRACE_CACHE_SIZE - 1)];
+
+	*hit = (qboolean)(entry->frame == sv_traceCacheData.frame && !memcmp(&entry->key, key, sizeof(*key)));
+	if(*hit)
+	{
+		sv_traceCacheData.hits++;
+	}
+	else
+	{
+		sv_traceCacheData.misses++;
+	}
+
+	return entry;
+}
+
+/*
+===============
+SV_CacheTrace
+===============
+*/
+static void SV_CacheTrace(traceCacheEntry_t *entry, const traceCacheKey_t *key, const trace_t *trace)
+{
+	int i;
+
+	if(entry->frame == sv_traceCacheData.frame)
+	{
+		sv_traceCacheData.replaced++;
+	}
+
+	entry->key   = *key;
+	entry->trace = *trace;
+	entry->frame = sv_traceCacheData.frame;
+
+	// the same box SV_ClipTraceToEntities looks for entities in
+	for(i = 0; i < 3; i++)
+	{
+		if(key->end[i] > key->start[i])
+		{
+			entry->absmin[i] = key->start[i] + key->mins[i] - 1;
+			entry->absmax[i] = key->end[i] + key->maxs[i] + 1;
+		}
+		else
+		{
+			entry->absmin[i] = key->end[i] + key->mins[i] - 1;
+			entry->absmax[i] = key->start[i] + key->maxs[i] + 1;
+		}
+	}
+
+	if(entry->listed != sv_traceCacheData.frame)
+	{
+		entry->listed = sv_traceCacheData.frame;
+		sv_traceCacheData.used[sv_traceCacheData.numUsed++] = entry - sv_traceCacheData.entries;
+	}
+}
+
+/*
+===============
+SV_DropCachedTraces
+
+Forgets the cached traces that pass through the given box
+===============
+*/
+static void SV_DropCachedTraces(const vec3_t absmin, const vec3_t absmax)
+{
+	traceCacheEntry_t *entry;
+	int i;
+
+	if(sv_traceCacheData.time != sv.time)
+	{
+		return;     // nothing of this frame cached yet
+	}
+
+	for(i = 0; i < sv_traceCacheData.numUsed; i++)
+	{
+		entry = &sv_traceCacheData.entries[sv_traceCacheData.used[i]];
+
+		if(entry->frame != sv_traceCacheData.frame
+		   || entry->absmin[0] > absmax[0] || entry->absmin[1] > absmax[1] || entry->absmin[2] > absmax[2]
+		   || entry->absmax[0] < absmin[0] || entry->absmax[1] < absmin[1] || entry->absmax[2] < absmin[2])
+		{
+			continue;
+		}
+
+		entry->frame = 0;
+		sv_traceCacheData.dropped++;
+	}
+}
+
+/*
+===============
+SV_TraceStats_f
+===============
+*/
+void SV_TraceStats_f(void)
+{
+	int lookups;
+
+	lookups = sv_traceCacheData.hits + sv_traceCacheData.misses;
+
+	Com_Printf("trace cache %s, %i of %i entries filled in the last frame\n",
+	           sv_traceCache->integer ? "on" : "off", sv_traceCacheData.numUsed, TRACE_CACHE_SIZE);
+	Com_Printf("%i hits, %i misses, %.1f%% hit rate\n",
+	           sv_traceCacheData.hits, sv_traceCacheData.misses, lookups ? 100.0 * sv_traceCacheData.hits / lookups : 0.0);
+	Com_Printf("%i dropped by entity links, %i replaced by other traces\n",
+	           sv_traceCacheData.dropped, sv_traceCacheData.replaced);
+
+	if(!Q_stricmp(Cmd_Argv(1), "reset"))
+	{
+		sv_traceCacheData.hits     = 0;
+		sv_traceCacheData.misses   = 0;
+		sv_traceCacheData.dropped  = 0;
+		sv_traceCacheData.replaced = 0;
+	}
+}
+
+
 /*
 ===============
 SV_ClearWorld
@@ -160,14 +780,41 @@ void SV_ClearWorld(void)
 {
 	clipHandle_t h;
 	vec3_t mins, maxs;
+	worldSector_t *root;
+	int i;
 
 	Com_Memset(sv_worldSectors, 0, sizeof(sv_worldSectors));
-	sv_numworldSectors = 0;
+	sv_numworldSectors      = 0;
+	sv_worldSectorOverflows = 0;
+
+	sv_freeWorldSectors = NULL;
+	for(i = AREA_NODES - 1; i >= 0; i--)
+	{
+		sv_worldSectors[i].depth  = -1;
+		sv_worldSectors[i].parent = sv_freeWorldSectors;
+		sv_freeWorldSectors = &sv_worldSectors[i];
+	}
+
+	// the svEntities were cleared with the rest of the server,
+	// so every cluster list starts out empty
+	sv_numClusterLists  = CM_NumClusters();
+	sv_clusterEntities  = (svClusterLink_t **)Hunk_Alloc(sizeof(*sv_clusterEntities) * sv_numClusterLists, h_high);
+	sv_overflowEntities = NULL;
 
 	// get world map bounds
 	h = CM_InlineModel(0);
 	CM_ModelBounds(h, mins, maxs);
-	SV_CreateworldSector(0, mins, maxs);
+
+	// the root is the first sector and never goes back to the pool
+	root = SV_AllocWorldSector(NULL, 0);
+	for(i = 0; i < 3; i++)
+	{
+		root->center[i]   = 0.5f * (mins[i] + maxs[i]);
+		root->halfSize[i] = 0.5f * (maxs[i] - mins[i]) + 1;
+	}
+	SV_SetSectorSplitAxes(root);
+
+	SV_ClearTraceCache();
 }
 
 
@@ -180,36 +827,21 @@ SV_UnlinkEntity
 void SV_UnlinkEntity(sharedEntity_t *gEnt)
 {
 	svEntity_t *ent;
-	svEntity_t *scan;
-	worldSector_t *ws;
 
 	ent = SV_SvEntityForGentity(gEnt);
 
 	gEnt->r.linked = qfalse;
 
-	ws = ent->worldSector;
-	if(!ws)
-	{
-		return;     // not linked in anywhere
-	}
-	ent->worldSector = NULL;
+	SV_UnlinkEntityClusters(ent);
 
-	if(ws->entities == ent)
+	if(!ent->worldSector)
 	{
-		ws->entities = ent->nextEntityInWorldSector;
-		return;
+		return;     // not linked in anywhere
 	}
 
-	for(scan = ws->entities; scan; scan = scan->nextEntityInWorldSector)
-	{
-		if(scan->nextEntityInWorldSector == ent)
-		{
-			scan->nextEntityInWorldSector = ent->nextEntityInWorldSector;
-			return;
-		}
-	}
+	SV_DropCachedTraces(gEnt->r.absmin, gEnt->r.absmax);
 
-	Com_Printf("WARNING: SV_UnlinkEntity: not found in worldSector\n");
+	SV_FreeEmptySectors(SV_RemoveSectorEntity(ent));
 }
 
 
@@ -222,7 +854,7 @@ SV_LinkEntity
 #define MAX_TOTAL_ENT_LEAFS 128
 void SV_LinkEntity(sharedEntity_t *gEnt)
 {
-	worldSector_t *node;
+	worldSector_t *node, *oldSector;
 	int leafs[MAX_TOTAL_ENT_LEAFS];
 	int cluster;
 	int num_leafs;
@@ -234,9 +866,16 @@ void SV_LinkEntity(sharedEntity_t *gEnt)
 
 	ent = SV_SvEntityForGentity(gEnt);
 
+	// unlink from old position, the sector is only freed once the entity
+	// has been linked again since most of the time it goes right back
+	oldSector = NULL;
 	if(ent->worldSector)
 	{
-		SV_UnlinkEntity(gEnt);              // unlink from old position
+		gEnt->r.linked = qfalse;
+		SV_UnlinkEntityClusters(ent);
+		oldSector = SV_RemoveSectorEntity(ent);
+
+		SV_DropCachedTraces(gEnt->r.absmin, gEnt->r.absmax);
 	}
 
 	// encode the size into the entityState_t for client prediction
@@ -308,6 +947,11 @@ void SV_LinkEntity(sharedEntity_t *gEnt)
 	gEnt->r.absmax[1] += 1;
 	gEnt->r.absmax[2] += 1;
 
+	if(gEnt->r.contents)
+	{
+		SV_DropCachedTraces(gEnt->r.absmin, gEnt->r.absmax);
+	}
+
 	// link to PVS leafs
 	ent->numClusters = 0;
 	ent->lastCluster = 0;
@@ -322,6 +966,7 @@ void SV_LinkEntity(sharedEntity_t *gEnt)
 	// entity is outside the world and can be considered unlinked
 	if(!num_leafs)
 	{
+		SV_FreeEmptySectors(oldSector);
 		return;
 	}
 
@@ -373,24 +1018,18 @@ void SV_LinkEntity(sharedEntity_t *gEnt)
 
 	gEnt->r.linkcount++;
 
-	// find the first world sector node that the ent's box crosses
-	node = sv_worldSectors;
-	while(1)
+	// find the deepest world sector that holds the ent's box
+	node = SV_SectorForBox(sv_worldSectors, gEnt->r.absmin, gEnt->r.absmax);
+
+	// link it in
+	SV_AddSectorEntity(node, ent);
+	if(!node->split && node->numEntities > SECTOR_SPLIT && node->depth < SECTOR_MAX_DEPTH)
 	{
-		if(node->axis == -1)
-			break;
-		if(gEnt->r.absmin[node->axis] > node->dist)
-			node = node->children[0];
-		else if(gEnt->r.absmax[node->axis] < node->dist)
-			node = node->children[1];
-		else
-			break;                                                                                  // crosses the node
+		SV_SplitSector(node);
 	}
+	SV_FreeEmptySectors(oldSector);
 
-	// link it in
-	ent->worldSector             = node;
-	ent->nextEntityInWorldSector = node->entities;
-	node->entities               = ent;
+	SV_LinkEntityClusters(ent);
 
 	gEnt->r.linked = qtrue;
 }
@@ -424,6 +1063,8 @@ static void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap )
 {
 	svEntity_t *check, *next;
 	sharedEntity_t *gcheck;
+	worldSector_t *child;
+	int i;
 
 	for (check = node->entities; check; check = next)
 	{
@@ -451,19 +1092,26 @@ static void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap )
 		ap->count++;
 	}
 
-	if(node->axis == -1)
+	if(!node->numChildren)
 	{
 		return;     // terminal node
 	}
 
-	// recurse down both sides
-	if(ap->maxs[node->axis] > node->dist)
+	// recurse down the children whose loose bounds touch the box
+	for(i = 0; i < 8; i++)
 	{
-		SV_AreaEntities_r(node->children[0], ap);
-	}
-	if(ap->mins[node->axis] < node->dist)
-	{
-		SV_AreaEntities_r(node->children[1], ap);
+		child = node->children[i];
+		if(!child
+		   || child->mins[0] > ap->maxs[0]
+		   || child->mins[1] > ap->maxs[1]
+		   || child->mins[2] > ap->maxs[2]
+		   || child->maxs[0] < ap->mins[0]
+		   || child->maxs[1] < ap->mins[1]
+		   || child->maxs[2] < ap->mins[2])
+		{
+			continue;
+		}
+		SV_AreaEntities_r(child, ap);
 	}
 }
 
@@ -658,30 +1306,20 @@ static void SV_ClipMoveToEntities( moveclip_t *clip ) {
 
 /*
 ==================
-SV_Trace
+SV_ClipTraceToEntities
 
-Moves the given mins/maxs volume through the world from start to end.
-passEntityNum and entities owned by passEntityNum are explicitly not checked.
+Finishes a trace that has already been clipped to the world by clipping it
+to the solid entities along the move
 ==================
 */
-void SV_Trace(trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int capsule)
+static void SV_ClipTraceToEntities(trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int capsule)
 {
 	moveclip_t clip;
 	int i;
 
-	if(!mins)
-	{
-		mins = vec3_origin;
-	}
-	if(!maxs)
-	{
-		maxs = vec3_origin;
-	}
-
 	Com_Memset(&clip, 0, sizeof(moveclip_t));
 
-	// clip to world
-	CM_BoxTrace(&clip.trace, start, end, mins, maxs, 0, contentmask, (traceType_t)capsule);
+	clip.trace = *results;
 	clip.trace.entityNum = clip.trace.fraction != 1.0 ? ENTITYNUM_WORLD : ENTITYNUM_NONE;
 	if(clip.trace.fraction == 0)
 	{
@@ -723,6 +1361,102 @@ void SV_Trace(trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, co
 }
 
 
+/*
+==================
+SV_Trace
+
+Moves the given mins/maxs volume through the world from start to end.
+passEntityNum and entities owned by passEntityNum are explicitly not checked.
+==================
+*/
+void SV_Trace(trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int capsule)
+{
+	traceCacheKey_t key;
+	traceCacheEntry_t *cached;
+	qboolean hit;
+
+	if(!mins)
+	{
+		mins = vec3_origin;
+	}
+	if(!maxs)
+	{
+		maxs = vec3_origin;
+	}
+
+	cached = NULL;
+	if(sv_traceCache->integer && Com_WorkerThreadNum() == 0)
+	{
+		VectorCopy(start, key.start);
+		VectorCopy(end, key.end);
+		VectorCopy(mins, key.mins);
+		VectorCopy(maxs, key.maxs);
+		key.passEntityNum = passEntityNum;
+		key.contentmask   = contentmask;
+		key.capsule       = capsule;
+
+		cached = SV_FindCachedTrace(&key, &hit);
+		if(hit)
+		{
+			*results = cached->trace;
+			return;
+		}
+	}
+
+	// clip to world
+	CM_BoxTrace(results, start, end, mins, maxs, 0, contentmask, (traceType_t)capsule);
+
+	SV_ClipTraceToEntities(results, start, mins, maxs, end, passEntityNum, contentmask, capsule);
+
+	if(cached)
+	{
+		SV_CacheTrace(cached, &key, results);
+	}
+}
+
+
+/*
+==================
+SV_TraceBatch
+
+SV_Trace from start to each of the ends.  The world part of all the traces
+runs through CM_BoxTraceBatch, the entities are clipped one trace at a time.
+==================
+*/
+void SV_TraceBatch(trace_t *results, int numTraces, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t *ends, int passEntityNum, int contentmask)
+{
+	vec3_t starts[MAX_TRACE_BATCH];
+	int i;
+
+	if(numTraces < 0 || numTraces > MAX_TRACE_BATCH)
+	{
+		Com_Error(ERR_DROP, "SV_TraceBatch: bad numTraces %i", numTraces);
+	}
+
+	if(!mins)
+	{
+		mins = vec3_origin;
+	}
+	if(!maxs)
+	{
+		maxs = vec3_origin;
+	}
+
+	for(i = 0; i < numTraces; i++)
+	{
+		VectorCopy(start, starts[i]);
+	}
+
+	// clip to world
+	CM_BoxTraceBatch(results, numTraces, (const vec3_t *)starts, ends, mins, maxs, 0, contentmask);
+
+	for(i = 0; i < numTraces; i++)
+	{
+		SV_ClipTraceToEntities(&results[i], start, mins, maxs, ends[i], passEntityNum, contentmask, TT_AABB);
+	}
+}
+
+
 
 /*
 =============
@@ -32,6 +32,7 @@
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/time.h>
+#include <time.h>
 #include <pwd.h>
 #include <libgen.h>
 #include <fcntl.h>
@@ -109,6 +110,20 @@ int Sys_Milliseconds(void)
   return curtime;
 }
 
+/*
+ ================
+ Sys_Nanoseconds
+ ================
+ */
+int64_t Sys_Nanoseconds(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 /*
  ==================
  Sys_RandomBytes
@@ -205,6 +220,46 @@ FILE *Sys_FOpen( const char *ospath, const char *mode ) {
 	return fopen( ospath, mode );
 }
 
+/*
+==================
+Sys_MapFile
+==================
+*/
+void *Sys_MapFile( FILE *f, long length ) {
+	void *data;
+
+	data = mmap( NULL, length, PROT_READ, MAP_SHARED, fileno( f ), 0 );
+	if ( data == MAP_FAILED )
+		return NULL;
+
+	return data;
+}
+
+/*
+==================
+Sys_UnmapFile
+==================
+*/
+void Sys_UnmapFile( void *data, long length ) {
+	munmap( data, length );
+}
+
+/*
+==================
+Sys_FileTime
+
+Modification time of an open file, 0 if it can't be found
+==================
+*/
+int64_t Sys_FileTime( FILE *f ) {
+	struct stat buf;
+
+	if ( fstat( fileno( f ), &buf ) )
+		return 0;
+
+	return (int64_t)buf.st_mtime;
+}
+
 /*
  ==================
  Sys_Mkdir
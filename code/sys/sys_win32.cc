@@ -37,6 +37,7 @@ extern "C" {
 #include <stdio.h>
 #include <direct.h>
 #include <io.h>
+#include <sys/stat.h>
 #include <conio.h>
 #include <wincrypt.h>
 #include <shlobj.h>
@@ -150,6 +151,27 @@ int Sys_Milliseconds(void)
 	return sys_curtime;
 }
 
+/*
+================
+Sys_Nanoseconds
+================
+*/
+int64_t Sys_Nanoseconds(void)
+{
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER count;
+
+	if(!frequency.QuadPart)
+	{
+		QueryPerformanceFrequency(&frequency);
+	}
+	QueryPerformanceCounter(&count);
+
+	// split to keep the multiplication from overflowing
+	return (count.QuadPart / frequency.QuadPart) * 1000000000 +
+	       (count.QuadPart % frequency.QuadPart) * 1000000000 / frequency.QuadPart;
+}
+
 /*
 ================
 Sys_RandomBytes
@@ -299,6 +321,54 @@ FILE *Sys_FOpen( const char *ospath, const char *mode ) {
 	return fopen( ospath, mode );
 }
 
+/*
+==============
+Sys_MapFile
+==============
+*/
+void *Sys_MapFile( FILE *f, long length )
+{
+	HANDLE mapping;
+	void *data;
+
+	mapping = CreateFileMapping( (HANDLE)_get_osfhandle( _fileno( f ) ), NULL, PAGE_READONLY, 0, 0, NULL );
+	if( !mapping )
+		return NULL;
+
+	// the view keeps the mapping alive
+	data = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, length );
+	CloseHandle( mapping );
+
+	return data;
+}
+
+/*
+==============
+Sys_UnmapFile
+==============
+*/
+void Sys_UnmapFile( void *data, long length )
+{
+	UnmapViewOfFile( data );
+}
+
+/*
+==============
+Sys_FileTime
+
+Modification time of an open file, 0 if it can't be found
+==============
+*/
+int64_t Sys_FileTime( FILE *f )
+{
+	struct _stat64 buf;
+
+	if( _fstat64( _fileno( f ), &buf ) )
+		return 0;
+
+	return (int64_t)buf.st_mtime;
+}
+
 /*
 ==============
 Sys_Mkdir